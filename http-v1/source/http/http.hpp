@@ -0,0 +1,3763 @@
+#pragma once
+
+#include "../server.hpp"
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <list>
+#include <zlib.h>
+#ifdef HTTP_ZSTD
+#include <zstd.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// ================================================================
+//                            Util模块
+// ================================================================
+std::unordered_map<int, std::string> _statu_msg = {
+    {100, "Continue"},
+    {101, "Switching Protocol"},
+    {200, "OK"},
+    {201, "Created"},
+    {202, "Accepted"},
+    {204, "No Content"},
+    {206, "Partial Content"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
+    {304, "Not Modified"},
+    {307, "Temporary Redirect"},
+    {308, "Permanent Redirect"},
+    {400, "Bad Request"},
+    {401, "Unauthorized"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {408, "Request Timeout"},
+    {411, "Length Required"},
+    {413, "Payload Too Large"},
+    {414, "URI Too Long"},
+    {415, "Unsupported Media Type"},
+    {426, "Upgrade Required"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Timeout"},
+    {505, "HTTP Version Not Supported"}};
+
+std::unordered_map<std::string, std::string> _mime_msg = {
+    {".aac", "audio/aac"},
+    {".bin", "application/octet-stream"},
+    {".bmp", "image/bmp"},
+    {".css", "text/css"},
+    {".csv", "text/csv"},
+    {".gif", "image/gif"},
+    {".htm", "text/html"},
+    {".html", "text/html"},
+    {".ico", "image/vnd.microsoft.icon"},
+    {".jpeg", "image/jpeg"},
+    {".jpg", "image/jpeg"},
+    {".js", "text/javascript"},
+    {".json", "application/json"},
+    {".mp3", "audio/mpeg"},
+    {".mp4", "video/mp4"},
+    {".pdf", "application/pdf"},
+    {".png", "image/png"},
+    {".svg", "image/svg+xml"},
+    {".tar", "application/x-tar"},
+    {".txt", "text/plain"},
+    {".wasm", "application/wasm"},
+    {".webp", "image/webp"},
+    {".xml", "application/xml"},
+    {".zip", "application/zip"}};
+
+class Util
+{
+public:
+    // 按 sep 切分字符串，忽略空串
+    static size_t Split(const std::string &src, const std::string &sep, std::vector<std::string> *arry)
+    {
+        size_t offset = 0;
+        while (offset < src.size())
+        {
+            size_t pos = src.find(sep, offset);
+            if (pos == std::string::npos)
+            {
+                arry->push_back(src.substr(offset));
+                return arry->size();
+            }
+            if (pos != offset)
+                arry->push_back(src.substr(offset, pos - offset));
+            offset = pos + sep.size();
+        }
+        return arry->size();
+    }
+
+    static bool ReadFile(const std::string &filename, std::string *buf)
+    {
+        std::ifstream ifs(filename, std::ios::binary);
+        if (ifs.is_open() == false)
+        {
+            ERR_LOG("Open %s File Failed", filename.c_str());
+            return false;
+        }
+        ifs.seekg(0, ifs.end);
+        size_t fsize = ifs.tellg();
+        ifs.seekg(0, ifs.beg);
+        buf->resize(fsize);
+        ifs.read(&(*buf)[0], fsize);
+        if (ifs.good() == false)
+        {
+            ERR_LOG("Read %s File Failed", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static bool WriteFile(const std::string &filename, const std::string &buf)
+    {
+        std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+        if (ofs.is_open() == false)
+        {
+            ERR_LOG("Open %s File Failed", filename.c_str());
+            return false;
+        }
+        ofs.write(buf.c_str(), buf.size());
+        if (ofs.good() == false)
+        {
+            ERR_LOG("Write %s File Failed", filename.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // URL 编码：. - _ ~ 字母 数字 保持不变，其余编码为 %HH；查询字符串中空格编码为 +
+    static std::string UrlEncode(const std::string &url, bool convert_space_to_plus)
+    {
+        std::string res;
+        for (auto &c : url)
+        {
+            if (c == '.' || c == '-' || c == '_' || c == '~' || isalnum((unsigned char)c))
+            {
+                res += c;
+                continue;
+            }
+            if (c == ' ' && convert_space_to_plus)
+            {
+                res += '+';
+                continue;
+            }
+            char tmp[4] = {0};
+            snprintf(tmp, 4, "%%%02X", (unsigned char)c);
+            res += tmp;
+        }
+        return res;
+    }
+
+    static char HexToI(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        else if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    static std::string UrlDecode(const std::string &url, bool convert_plus_to_space)
+    {
+        std::string res;
+        for (size_t i = 0; i < url.size(); i++)
+        {
+            if (url[i] == '+' && convert_plus_to_space)
+            {
+                res += ' ';
+                continue;
+            }
+            if (url[i] == '%' && i + 2 < url.size() && HexToI(url[i + 1]) >= 0 && HexToI(url[i + 2]) >= 0)
+            {
+                res += (char)((HexToI(url[i + 1]) << 4) + HexToI(url[i + 2]));
+                i += 2;
+                continue;
+            }
+            res += url[i];
+        }
+        return res;
+    }
+
+    static std::string StatuDesc(int statu)
+    {
+        auto it = _statu_msg.find(statu);
+        if (it != _statu_msg.end())
+            return it->second;
+        return "Unknow";
+    }
+
+    // 根据文件扩展名获取 mime
+    static std::string ExtMime(const std::string &filename)
+    {
+        size_t pos = filename.find_last_of('.');
+        if (pos == std::string::npos)
+            return "application/octet-stream";
+        auto it = _mime_msg.find(filename.substr(pos));
+        if (it == _mime_msg.end())
+            return "application/octet-stream";
+        return it->second;
+    }
+
+    static bool IsDirectory(const std::string &filename)
+    {
+        struct stat st;
+        if (stat(filename.c_str(), &st) < 0)
+            return false;
+        return S_ISDIR(st.st_mode);
+    }
+
+    static bool IsRegular(const std::string &filename)
+    {
+        struct stat st;
+        if (stat(filename.c_str(), &st) < 0)
+            return false;
+        return S_ISREG(st.st_mode);
+    }
+
+    // 请求的资源路径不能跳出相对根目录(按 / 切分计算目录深度，深度小于 0 即非法)
+    static bool ValidPath(const std::string &path)
+    {
+        std::vector<std::string> subdir;
+        Split(path, "/", &subdir);
+        int level = 0;
+        for (auto &dir : subdir)
+        {
+            if (dir == "..")
+            {
+                level--;
+                if (level < 0)
+                    return false;
+                continue;
+            }
+            level++;
+        }
+        return true;
+    }
+
+    // SHA-1 摘要(20 字节)，用于 WebSocket 握手
+    static std::string Sha1(const std::string &data)
+    {
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        std::string msg = data;
+        uint64_t bits = (uint64_t)data.size() * 8;
+        msg.push_back((char)0x80);
+        while (msg.size() % 64 != 56)
+            msg.push_back(0);
+        for (int i = 7; i >= 0; i--)
+            msg.push_back((char)(bits >> (i * 8)));
+        for (size_t off = 0; off < msg.size(); off += 64)
+        {
+            uint32_t w[80];
+            const unsigned char *p = (const unsigned char *)msg.data() + off;
+            for (int i = 0; i < 16; i++)
+                w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+            for (int i = 16; i < 80; i++)
+            {
+                uint32_t t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+                w[i] = t << 1 | t >> 31;
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; i++)
+            {
+                uint32_t f, k;
+                if (i < 20)
+                    f = (b & c) | (~b & d), k = 0x5A827999;
+                else if (i < 40)
+                    f = b ^ c ^ d, k = 0x6ED9EBA1;
+                else if (i < 60)
+                    f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+                else
+                    f = b ^ c ^ d, k = 0xCA62C1D6;
+                uint32_t t = (a << 5 | a >> 27) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = b << 30 | b >> 2;
+                b = a;
+                a = t;
+            }
+            h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+        }
+        std::string out;
+        for (int i = 0; i < 5; i++)
+            for (int j = 3; j >= 0; j--)
+                out.push_back((char)(h[i] >> (j * 8)));
+        return out;
+    }
+
+    static std::string Base64Encode(const std::string &data)
+    {
+        static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        size_t i = 0;
+        for (; i + 3 <= data.size(); i += 3)
+        {
+            uint32_t v = (unsigned char)data[i] << 16 | (unsigned char)data[i + 1] << 8 | (unsigned char)data[i + 2];
+            out += table[v >> 18];
+            out += table[(v >> 12) & 63];
+            out += table[(v >> 6) & 63];
+            out += table[v & 63];
+        }
+        if (i < data.size())
+        {
+            uint32_t v = (unsigned char)data[i] << 16;
+            if (i + 1 < data.size())
+                v |= (unsigned char)data[i + 1] << 8;
+            out += table[v >> 18];
+            out += table[(v >> 12) & 63];
+            out += i + 1 < data.size() ? table[(v >> 6) & 63] : '=';
+            out += '=';
+        }
+        return out;
+    }
+
+    // 严格的 UTF-8 校验：拒绝过长编码、代理区与超出 U+10FFFF 的码点
+    static bool ValidUtf8(const char *data, size_t len)
+    {
+        const unsigned char *p = (const unsigned char *)data, *end = p + len;
+        while (p < end)
+        {
+            if (*p < 0x80)
+            {
+                p++;
+                continue;
+            }
+            int n;
+            uint32_t cp;
+            if ((*p & 0xE0) == 0xC0)
+                n = 1, cp = *p & 0x1F;
+            else if ((*p & 0xF0) == 0xE0)
+                n = 2, cp = *p & 0x0F;
+            else if ((*p & 0xF8) == 0xF0)
+                n = 3, cp = *p & 0x07;
+            else
+                return false;
+            if (end - p <= n)
+                return false;
+            for (int i = 1; i <= n; i++)
+            {
+                if ((p[i] & 0xC0) != 0x80)
+                    return false;
+                cp = cp << 6 | (p[i] & 0x3F);
+            }
+            static const uint32_t min_cp[] = {0, 0x80, 0x800, 0x10000};
+            if (cp < min_cp[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                return false;
+            p += n + 1;
+        }
+        return true;
+    }
+
+    // 十进制长度(Content-Length)：只允许数字，不允许空串、符号、空白与溢出
+    static bool ParseLength(const std::string &str, size_t *val)
+    {
+        if (str.empty() || str.size() > 20 || str.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        char *end = nullptr;
+        errno = 0;
+        unsigned long long n = strtoull(str.c_str(), &end, 10);
+        if (errno == ERANGE || *end != '\0' || n > SIZE_MAX)
+            return false;
+        *val = n;
+        return true;
+    }
+
+    // 逗号分隔的头部值中是否含有 token(不区分大小写)
+    static bool HasToken(const std::string &value, const char *token)
+    {
+        std::vector<std::string> parts;
+        Util::Split(value, ",", &parts);
+        for (auto &part : parts)
+        {
+            size_t b = part.find_first_not_of(" \t");
+            size_t e = part.find_last_not_of(" \t");
+            if (b != std::string::npos && strcasecmp(part.substr(b, e - b + 1).c_str(), token) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+// ================================================================
+//                            HttpRequest模块
+// ================================================================
+class HttpRequest
+{
+public:
+    std::string _method;                                   // 请求方法
+    std::string _path;                                     // 资源路径
+    std::string _uri;                                      // 原始请求目标(未解码的路径与查询字符串)，反向代理原样转发
+    std::string _version;                                  // 协议版本
+    std::string _body;                                     // 请求正文
+    std::smatch _matches;                                  // 路由正则提取的数据
+    std::unordered_map<std::string, std::string> _headers; // 头部字段
+    std::unordered_map<std::string, std::string> _params;  // 查询字符串
+
+public:
+    HttpRequest()
+        : _version("HTTP/1.1")
+    { }
+
+    void ReSet()
+    {
+        _method.clear();
+        _path.clear();
+        _uri.clear();
+        _version = "HTTP/1.1";
+        _body.clear();
+        std::smatch match;
+        _matches.swap(match);
+        _headers.clear();
+        _params.clear();
+    }
+
+    void SetHeader(const std::string &key, const std::string &val)
+    {
+        _headers[key] = val;
+    }
+    bool HasHeader(const std::string &key) const
+    {
+        return _headers.find(key) != _headers.end();
+    }
+    std::string GetHeader(const std::string &key) const
+    {
+        auto it = _headers.find(key);
+        if (it == _headers.end())
+            return "";
+        return it->second;
+    }
+
+    void SetParam(const std::string &key, const std::string &val)
+    {
+        _params[key] = val;
+    }
+    bool HasParam(const std::string &key) const
+    {
+        return _params.find(key) != _params.end();
+    }
+    std::string GetParam(const std::string &key) const
+    {
+        auto it = _params.find(key);
+        if (it == _params.end())
+            return "";
+        return it->second;
+    }
+
+    // 解析器已拒绝非法的 Content-Length，这里对非法值返回 0
+    size_t ContentLength() const
+    {
+        size_t len = 0;
+        auto it = _headers.find("Content-Length");
+        if (it == _headers.end() || !Util::ParseLength(it->second, &len))
+            return 0;
+        return len;
+    }
+
+    // 请求体是否分块：以 Transfer-Encoding 的最后一个编码为准(RFC 7230 3.3.3)
+    bool Chunked() const
+    {
+        auto it = _headers.find("Transfer-Encoding");
+        if (it == _headers.end())
+            return false;
+        size_t pos = it->second.rfind(',');
+        return Util::HasToken(pos == std::string::npos ? it->second : it->second.substr(pos + 1), "chunked");
+    }
+
+    // 是否短连接：显式 Connection 头优先，否则 HTTP/1.1 默认长连接、HTTP/1.0 默认短连接
+    bool Close() const
+    {
+        std::string conn = GetHeader("Connection"); // 逗号分隔的选项列表，如 "close, X-Custom"
+        if (Util::HasToken(conn, "close"))
+            return true;
+        if (Util::HasToken(conn, "keep-alive"))
+            return false;
+        return _version != "HTTP/1.1";
+    }
+};
+
+// ================================================================
+//                            HttpResponse模块
+// ================================================================
+class HttpResponse
+{
+public:
+    int _statu;
+    bool _redirect_flag;
+    bool _cacheable; // 允许放入响应缓存(见 HttpServer::EnableResponseCache)
+    std::string _body;
+    std::string _redirect_url;
+    std::unordered_map<std::string, std::string> _headers;
+
+public:
+    HttpResponse()
+        : _statu(200), _redirect_flag(false), _cacheable(false)
+    { }
+    HttpResponse(int statu)
+        : _statu(statu), _redirect_flag(false), _cacheable(false)
+    { }
+
+    void ReSet()
+    {
+        _statu = 200;
+        _redirect_flag = false;
+        _cacheable = false;
+        _body.clear();
+        _redirect_url.clear();
+        _headers.clear();
+    }
+
+    void SetHeader(const std::string &key, const std::string &val)
+    {
+        _headers[key] = val;
+    }
+    bool HasHeader(const std::string &key) const
+    {
+        return _headers.find(key) != _headers.end();
+    }
+    std::string GetHeader(const std::string &key) const
+    {
+        auto it = _headers.find(key);
+        if (it == _headers.end())
+            return "";
+        return it->second;
+    }
+
+    void SetContent(const std::string &body, const std::string &type = "text/html")
+    {
+        _body = body;
+        SetHeader("Content-Type", type);
+    }
+
+    void SetRedirect(const std::string &url, int statu = 302)
+    {
+        _statu = statu;
+        _redirect_flag = true;
+        _redirect_url = url;
+    }
+
+    // 同一请求(方法、路径、查询字符串、Vary 头)总是得到相同的响应时调用，之后直接由缓存回复
+    void SetCacheable()
+    {
+        _cacheable = true;
+    }
+
+    bool Close() const
+    {
+        return strcasecmp(GetHeader("Connection").c_str(), "close") == 0;
+    }
+};
+
+// ================================================================
+//                            Compress模块
+// ================================================================
+// 响应压缩：gzip/deflate 使用 zlib(链接 -lz)，定义 HTTP_ZSTD 时支持 zstd(链接 -lzstd)。
+// 按 Accept-Encoding 协商，压缩结果逐段写入 Buffer，流式响应可以边生成边压缩
+#define COMPRESS_CHUNK (16 * 1024)
+#define COMPRESS_SCRATCH_RETAIN (1024 * 1024) // 线程复用的压缩输出缓冲区超过该容量则释放
+
+enum ContentCoding
+{
+    CODING_IDENTITY,
+    CODING_DEFLATE,
+    CODING_GZIP,
+    CODING_ZSTD,
+    CODING_COUNT
+};
+
+struct CompressOptions
+{
+    size_t min_size;                 // 小于该长度的响应不压缩
+    int level;                       // 压缩级别(zlib 1-9，zstd 1-19)
+    size_t offload_size;             // 不小于该长度且设置了计算线程池时在线程池中压缩，0 表示总在事件循环中压缩
+    bool precompressed;              // 静态资源存在 .gz/.zst 文件时直接发送
+    std::vector<std::string> types;  // 压缩的 Content-Type 前缀
+
+    CompressOptions()
+        : min_size(1024), level(6), offload_size(256 * 1024), precompressed(true),
+          types{"text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"}
+    { }
+
+    bool Compressible(const std::string &content_type) const
+    {
+        for (auto &t : types)
+        {
+            if (content_type.compare(0, t.size(), t) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+class Compressor
+{
+public:
+    Compressor(ContentCoding coding, int level)
+        : _coding(coding), _level(level), _ok(false)
+#ifdef HTTP_ZSTD
+          , _zstd(nullptr)
+#endif
+    {
+        if (coding == CODING_GZIP || coding == CODING_DEFLATE)
+        {
+            memset(&_zs, 0, sizeof(_zs));
+            // windowBits 加 16 输出 gzip 头尾，否则为 zlib 格式(HTTP 的 deflate 编码)
+            int bits = coding == CODING_GZIP ? 15 + 16 : 15;
+            _ok = deflateInit2(&_zs, level, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+#ifdef HTTP_ZSTD
+        else if (coding == CODING_ZSTD)
+        {
+            _zstd = ZSTD_createCCtx();
+            _ok = _zstd != nullptr && !ZSTD_isError(ZSTD_CCtx_setParameter(_zstd, ZSTD_c_compressionLevel, level));
+        }
+#endif
+        if (!_ok)
+            ERR_LOG("Compressor %s Init Failed", Name(coding));
+    }
+    ~Compressor()
+    {
+        if (_coding == CODING_GZIP || _coding == CODING_DEFLATE)
+            deflateEnd(&_zs);
+#ifdef HTTP_ZSTD
+        if (_zstd)
+            ZSTD_freeCCtx(_zstd);
+#endif
+    }
+
+    bool Ok()
+    {
+        return _ok;
+    }
+    ContentCoding Coding()
+    {
+        return _coding;
+    }
+    int Level()
+    {
+        return _level;
+    }
+    // 开始压缩新的一段内容(复用压缩状态，避免每次重新分配)
+    void Reset()
+    {
+        if (_coding == CODING_GZIP || _coding == CODING_DEFLATE)
+            _ok = deflateReset(&_zs) == Z_OK;
+#ifdef HTTP_ZSTD
+        else if (_coding == CODING_ZSTD)
+            _ok = !ZSTD_isError(ZSTD_CCtx_reset(_zstd, ZSTD_reset_session_only));
+#endif
+    }
+    // 压缩一段输入追加到 out；flush 为 true 时输出目前为止的全部数据(流式响应需要及时送达时使用)
+    bool Update(const char *data, size_t len, Buffer *out, bool flush = false)
+    {
+        return Run(data, len, out, flush ? STEP_FLUSH : STEP_CONTINUE);
+    }
+    // 结束压缩，输出剩余数据与尾部
+    bool Finish(Buffer *out)
+    {
+        return Run(nullptr, 0, out, STEP_END);
+    }
+
+    static const char *Name(ContentCoding coding)
+    {
+        switch (coding)
+        {
+        case CODING_DEFLATE:
+            return "deflate";
+        case CODING_GZIP:
+            return "gzip";
+        case CODING_ZSTD:
+            return "zstd";
+        default:
+            return "identity";
+        }
+    }
+    // 本次编译支持的编码
+    static bool Supported(ContentCoding coding)
+    {
+#ifdef HTTP_ZSTD
+        if (coding == CODING_ZSTD)
+            return true;
+#endif
+        return coding == CODING_GZIP || coding == CODING_DEFLATE;
+    }
+    // 按 Accept-Encoding 的 q 值选择编码，q 值相同时 zstd > gzip > deflate，都不接受时返回 CODING_IDENTITY
+    static ContentCoding Negotiate(const std::string &accept)
+    {
+        double q[CODING_COUNT] = {0, 0, 0, 0};
+        double star = -1;
+        bool listed[CODING_COUNT] = {false, false, false, false};
+        std::vector<std::string> items;
+        Util::Split(accept, ",", &items);
+        for (auto &item : items)
+        {
+            std::vector<std::string> parts;
+            Util::Split(item, ";", &parts);
+            if (parts.empty())
+                continue;
+            std::string name = Trim(parts[0]);
+            double value = 1;
+            for (size_t i = 1; i < parts.size(); i++)
+            {
+                std::string param = Trim(parts[i]);
+                if (param.compare(0, 2, "q=") == 0)
+                    value = atof(param.c_str() + 2);
+            }
+            if (name == "*")
+                star = value;
+            for (int c = CODING_DEFLATE; c < CODING_COUNT; c++)
+            {
+                if (strcasecmp(name.c_str(), Name((ContentCoding)c)) == 0)
+                {
+                    q[c] = value;
+                    listed[c] = true;
+                }
+            }
+        }
+        ContentCoding best = CODING_IDENTITY;
+        double best_q = 0;
+        for (int c = CODING_DEFLATE; c < CODING_COUNT; c++)
+        {
+            double v = listed[c] ? q[c] : (star > 0 ? star : 0);
+            if (Supported((ContentCoding)c) && v > 0 && v >= best_q)
+            {
+                best = (ContentCoding)c;
+                best_q = v;
+            }
+        }
+        return best;
+    }
+    // 客户端是否接受某个编码
+    static bool Accepts(const std::string &accept, ContentCoding coding)
+    {
+        std::vector<std::string> items;
+        Util::Split(accept, ",", &items);
+        for (auto &item : items)
+        {
+            std::vector<std::string> parts;
+            Util::Split(item, ";", &parts);
+            if (parts.empty() || strcasecmp(Trim(parts[0]).c_str(), Name(coding)) != 0)
+                continue;
+            for (size_t i = 1; i < parts.size(); i++)
+            {
+                std::string param = Trim(parts[i]);
+                if (param.compare(0, 2, "q=") == 0)
+                    return atof(param.c_str() + 2) > 0;
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    enum Step
+    {
+        STEP_CONTINUE,
+        STEP_FLUSH,
+        STEP_END
+    };
+
+    static std::string Trim(const std::string &str)
+    {
+        size_t b = str.find_first_not_of(" \t");
+        if (b == std::string::npos)
+            return "";
+        size_t e = str.find_last_not_of(" \t");
+        return str.substr(b, e - b + 1);
+    }
+
+    bool Run(const char *data, size_t len, Buffer *out, Step step)
+    {
+        if (!_ok)
+            return false;
+#ifdef HTTP_ZSTD
+        if (_coding == CODING_ZSTD)
+        {
+            ZSTD_EndDirective mode = step == STEP_END ? ZSTD_e_end : (step == STEP_FLUSH ? ZSTD_e_flush : ZSTD_e_continue);
+            ZSTD_inBuffer in = {data, len, 0};
+            size_t remain;
+            do
+            {
+                out->EnsureWriteSpace(COMPRESS_CHUNK);
+                ZSTD_outBuffer o = {out->WritePos(), COMPRESS_CHUNK, 0};
+                remain = ZSTD_compressStream2(_zstd, &o, &in, mode);
+                if (ZSTD_isError(remain))
+                    return _ok = false;
+                out->MoveWriteOffset(o.pos);
+            } while (in.pos < in.size || (mode != ZSTD_e_continue && remain != 0));
+            return true;
+        }
+#endif
+        int mode = step == STEP_END ? Z_FINISH : (step == STEP_FLUSH ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        _zs.next_in = (Bytef *)data;
+        _zs.avail_in = len;
+        int ret;
+        do
+        {
+            out->EnsureWriteSpace(COMPRESS_CHUNK);
+            _zs.next_out = (Bytef *)out->WritePos();
+            _zs.avail_out = COMPRESS_CHUNK;
+            ret = deflate(&_zs, mode);
+            if (ret == Z_STREAM_ERROR)
+                return _ok = false;
+            out->MoveWriteOffset(COMPRESS_CHUNK - _zs.avail_out);
+        } while (_zs.avail_out == 0 || (mode == Z_FINISH && ret != Z_STREAM_END));
+        return true;
+    }
+
+private:
+    ContentCoding _coding;
+    int _level;
+    bool _ok;
+    z_stream _zs;
+#ifdef HTTP_ZSTD
+    ZSTD_CCtx *_zstd;
+#endif
+};
+
+// ================================================================
+//                            ResponseCache模块
+// ================================================================
+// 热点资源的响应缓存：保存序列化好的状态行、头部与正文，命中时整块写入输出缓冲区
+// (开启零拷贝且超过阈值时直接引用)。每个事件循环一个分片，只在所属线程中访问，不加锁
+#define DEFAULT_RESPONSE_CACHE_TTL 60 // 秒
+
+class ResponseCache
+{
+public:
+    using Block = std::shared_ptr<const std::string>;
+
+    // budget 为本分片最多占用的字节数(键 + 响应)，ttl 秒后条目过期
+    ResponseCache(size_t budget, uint32_t ttl = DEFAULT_RESPONSE_CACHE_TTL)
+        : _budget(budget), _ttl_us((uint64_t)ttl * 1000 * 1000), _bytes(0), _hits(0), _misses(0), _evictions(0)
+    { }
+
+    // 命中时移到表头，过期的条目顺便删除
+    Block Get(const std::string &key)
+    {
+        auto it = _index.find(key);
+        if (it == _index.end())
+        {
+            _misses++;
+            return nullptr;
+        }
+        if (it->second->expire_us <= MonotonicMicros())
+        {
+            Erase(it->second);
+            _misses++;
+            return nullptr;
+        }
+        _lru.splice(_lru.begin(), _lru, it->second);
+        _hits++;
+        return it->second->block;
+    }
+
+    // 放入(或替换)一个条目，超出预算时从表尾淘汰；单个条目超过预算时不缓存
+    void Put(const std::string &key, const Block &block)
+    {
+        size_t size = key.size() + block->size();
+        if (size > _budget)
+            return;
+        auto it = _index.find(key);
+        if (it != _index.end())
+            Erase(it->second);
+        while (_bytes + size > _budget && !_lru.empty())
+        {
+            Erase(std::prev(_lru.end()));
+            _evictions++;
+        }
+        _lru.push_front(Entry{key, block, MonotonicMicros() + _ttl_us});
+        _index[key] = _lru.begin();
+        _bytes += size;
+    }
+
+    void Clear()
+    {
+        _lru.clear();
+        _index.clear();
+        _bytes = 0;
+    }
+
+    size_t Bytes()
+    {
+        return _bytes;
+    }
+    size_t Count()
+    {
+        return _lru.size();
+    }
+    uint64_t Hits()
+    {
+        return _hits;
+    }
+    uint64_t Misses()
+    {
+        return _misses;
+    }
+    uint64_t Evictions()
+    {
+        return _evictions;
+    }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        Block block;
+        uint64_t expire_us;
+    };
+    using EntryIter = std::list<Entry>::iterator;
+
+    void Erase(EntryIter it)
+    {
+        _bytes -= it->key.size() + it->block->size();
+        _index.erase(it->key);
+        _lru.erase(it);
+    }
+
+private:
+    size_t _budget;
+    uint64_t _ttl_us;
+    size_t _bytes;
+    std::list<Entry> _lru; // 表头为最近使用
+    std::unordered_map<std::string, EntryIter> _index;
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evictions;
+};
+
+// ================================================================
+//                            HttpContext模块
+// ================================================================
+// 请求接收与解析的上下文：数据可能分多次到达，记录当前解析阶段
+typedef enum
+{
+    RECV_HTTP_ERROR,
+    RECV_HTTP_LINE,
+    RECV_HTTP_HEAD,
+    RECV_HTTP_BODY,
+    RECV_HTTP_OVER
+} HttpRecvStatu;
+
+#define MAX_LINE 8192
+
+class HttpStream;
+class WebSocket;
+class ProxySession;
+
+class HttpContext
+{
+public:
+    HttpContext()
+        : _resp_statu(200), _recv_statu(RECV_HTTP_LINE), _pending(false), _cache(nullptr)
+    { }
+
+    void ReSet()
+    {
+        _resp_statu = 200;
+        _recv_statu = RECV_HTTP_LINE;
+        _request.ReSet();
+    }
+
+    int RespStatu()
+    {
+        return _resp_statu;
+    }
+    HttpRecvStatu RecvStatu()
+    {
+        return _recv_statu;
+    }
+    HttpRequest &Request()
+    {
+        return _request;
+    }
+    // 请求已交给计算线程池，响应写回之前不解析后续请求(保证流水线响应顺序)
+    void SetPending(bool pending)
+    {
+        _pending = pending;
+    }
+    bool Pending()
+    {
+        return _pending;
+    }
+    // 连接所属事件循环的响应缓存分片，连接建立时设置，ReSet 不清空
+    void SetCache(ResponseCache *cache)
+    {
+        _cache = cache;
+    }
+    ResponseCache *Cache()
+    {
+        return _cache;
+    }
+    // 正在处理的流式请求，处理完之前不解析后续请求
+    void SetStream(const std::shared_ptr<HttpStream> &stream)
+    {
+        _stream = stream;
+    }
+    const std::shared_ptr<HttpStream> &Stream()
+    {
+        return _stream;
+    }
+    // 已升级为 WebSocket 的连接，之后的数据都按帧解析
+    void SetWebSocket(const std::shared_ptr<WebSocket> &ws)
+    {
+        _websocket = ws;
+    }
+    const std::shared_ptr<WebSocket> &GetWebSocket()
+    {
+        return _websocket;
+    }
+    // 反向代理会话(首次命中代理路由时创建，之后的请求复用其管道)
+    void SetProxy(const std::shared_ptr<ProxySession> &proxy)
+    {
+        _proxy = proxy;
+    }
+    const std::shared_ptr<ProxySession> &GetProxy()
+    {
+        return _proxy;
+    }
+
+    // 只解析请求行与头部，停在 RECV_HTTP_BODY(流式路由的请求体交给 HttpStream)
+    void RecvHttpRequestHead(Buffer *buf)
+    {
+        switch (_recv_statu)
+        {
+        case RECV_HTTP_LINE:
+            RecvHttpLine(buf);
+        case RECV_HTTP_HEAD:
+            RecvHttpHead(buf);
+        default:
+            break;
+        }
+    }
+
+    // 接收并解析请求，不同状态之间不 break，一次尽量解析完整
+    void RecvHttpRequest(Buffer *buf)
+    {
+        switch (_recv_statu)
+        {
+        case RECV_HTTP_LINE:
+            RecvHttpLine(buf);
+        case RECV_HTTP_HEAD:
+            RecvHttpHead(buf);
+        case RECV_HTTP_BODY:
+            RecvHttpBody(buf);
+        default:
+            break;
+        }
+    }
+
+private:
+    bool ParseHttpLine(const std::string &line)
+    {
+        std::smatch matches;
+        // 只编译一次，多个线程并发匹配同一个 const 正则是安全的
+        static const std::regex e("(GET|HEAD|POST|PUT|DELETE|OPTIONS|PATCH) ([^?]*)(?:\\?(.*))? (HTTP/1\\.[01])(?:\n|\r\n)?",
+                                  std::regex::icase);
+        bool ret = std::regex_match(line, matches, e);
+        if (ret == false)
+        {
+            _recv_statu = RECV_HTTP_ERROR;
+            _resp_statu = 400; // BAD REQUEST
+            return false;
+        }
+        // 0 : 整行  1 : 方法  2 : 资源路径  3 : 查询字符串  4 : 协议版本
+        _request._method = matches[1];
+        std::transform(_request._method.begin(), _request._method.end(), _request._method.begin(), ::toupper);
+        _request._path = Util::UrlDecode(matches[2], false);
+        _request._uri = matches[3].matched ? matches[2].str() + "?" + matches[3].str() : matches[2].str();
+        _request._version = matches[4];
+
+        std::vector<std::string> query_string_arry;
+        std::string query_string = matches[3];
+        Util::Split(query_string, "&", &query_string_arry);
+        for (auto &str : query_string_arry)
+        {
+            size_t pos = str.find("=");
+            if (pos == std::string::npos)
+            {
+                _recv_statu = RECV_HTTP_ERROR;
+                _resp_statu = 400;
+                return false;
+            }
+            std::string key = Util::UrlDecode(str.substr(0, pos), true);
+            std::string val = Util::UrlDecode(str.substr(pos + 1), true);
+            _request.SetParam(key, val);
+        }
+        return true;
+    }
+
+    bool RecvHttpLine(Buffer *buf)
+    {
+        if (_recv_statu != RECV_HTTP_LINE)
+            return false;
+        std::string line = buf->GetLine();
+        if (line.size() == 0)
+        {
+            // 缓冲区中没有完整的一行，且数据过长则认为出错
+            if (buf->ReadAbleSize() > MAX_LINE)
+            {
+                _recv_statu = RECV_HTTP_ERROR;
+                _resp_statu = 414; // URI TOO LONG
+                return false;
+            }
+            return true;
+        }
+        if (line.size() > MAX_LINE)
+        {
+            _recv_statu = RECV_HTTP_ERROR;
+            _resp_statu = 414;
+            return false;
+        }
+        if (ParseHttpLine(line) == false)
+            return false;
+        _recv_statu = RECV_HTTP_HEAD;
+        return true;
+    }
+
+    bool RecvHttpHead(Buffer *buf)
+    {
+        if (_recv_statu != RECV_HTTP_HEAD)
+            return false;
+        // 一行一行取出，遇到空行为止
+        while (1)
+        {
+            std::string line = buf->GetLine();
+            if (line.size() == 0)
+            {
+                if (buf->ReadAbleSize() > MAX_LINE)
+                {
+                    _recv_statu = RECV_HTTP_ERROR;
+                    _resp_statu = 431;
+                    return false;
+                }
+                return true;
+            }
+            if (line.size() > MAX_LINE)
+            {
+                _recv_statu = RECV_HTTP_ERROR;
+                _resp_statu = 431;
+                return false;
+            }
+            if (line == "\n" || line == "\r\n")
+                break;
+            if (ParseHttpHead(line) == false)
+                return false;
+        }
+        if (_request.HasHeader("Transfer-Encoding"))
+        {
+            // 最后一个编码不是 chunked 时无法确定请求体的边界
+            if (!_request.Chunked())
+            {
+                _recv_statu = RECV_HTTP_ERROR;
+                _resp_statu = 501; // NOT IMPLEMENTED
+                return false;
+            }
+            _request._headers.erase("Content-Length"); // 同时出现时以 Transfer-Encoding 为准，不再转发
+        }
+        size_t len;
+        if (_request.HasHeader("Content-Length") && !Util::ParseLength(_request.GetHeader("Content-Length"), &len))
+        {
+            _recv_statu = RECV_HTTP_ERROR;
+            _resp_statu = 400;
+            return false;
+        }
+        _recv_statu = RECV_HTTP_BODY;
+        return true;
+    }
+
+    bool ParseHttpHead(std::string &line)
+    {
+        // key: val\r\n
+        if (line.back() == '\n')
+            line.pop_back();
+        if (line.back() == '\r')
+            line.pop_back();
+        size_t pos = line.find(": ");
+        if (pos == std::string::npos)
+        {
+            _recv_statu = RECV_HTTP_ERROR;
+            _resp_statu = 400;
+            return false;
+        }
+        std::string key = line.substr(0, pos), val = line.substr(pos + 2);
+        // 决定请求体边界的两个字段统一名字的大小写，代理据此分帧的同时不会转发另一种写法
+        if (strcasecmp(key.c_str(), "Content-Length") == 0)
+        {
+            if (_request.HasHeader("Content-Length"))
+            {
+                _recv_statu = RECV_HTTP_ERROR;
+                _resp_statu = 400; // 重复的 Content-Length
+                return false;
+            }
+            key = "Content-Length";
+        }
+        else if (strcasecmp(key.c_str(), "Transfer-Encoding") == 0)
+        {
+            key = "Transfer-Encoding";
+            if (_request.HasHeader(key))
+                val = _request.GetHeader(key) + ", " + val; // 多个字段按顺序合并为一个列表
+        }
+        _request.SetHeader(key, val);
+        return true;
+    }
+
+    bool RecvHttpBody(Buffer *buf)
+    {
+        if (_recv_statu != RECV_HTTP_BODY)
+            return false;
+        size_t content_length = _request.ContentLength();
+        if (content_length == 0)
+        {
+            _recv_statu = RECV_HTTP_OVER;
+            return true;
+        }
+        // 当前还需要接收的正文长度
+        size_t real_len = content_length - _request._body.size();
+        if (buf->ReadAbleSize() >= real_len)
+        {
+            _request._body.append(buf->ReadPos(), real_len);
+            buf->MoveReadOffset(real_len);
+            _recv_statu = RECV_HTTP_OVER;
+            return true;
+        }
+        // 数据不足，取出全部数据等待新数据到来
+        _request._body.append(buf->ReadPos(), buf->ReadAbleSize());
+        buf->MoveReadOffset(buf->ReadAbleSize());
+        return true;
+    }
+
+private:
+    int _resp_statu;           // 响应状态码
+    HttpRecvStatu _recv_statu; // 当前接收及解析的阶段
+    HttpRequest _request;      // 已经解析得到的请求信息
+    bool _pending;             // 是否有请求正在计算线程池中处理
+    ResponseCache *_cache;     // 未开启响应缓存时为 nullptr
+    std::shared_ptr<HttpStream> _stream;
+    std::shared_ptr<WebSocket> _websocket; // 升级为 WebSocket 后非空
+    std::shared_ptr<ProxySession> _proxy;
+};
+
+// ================================================================
+//                            HttpStream模块
+// ================================================================
+// 流式请求：请求体按到达顺序分段交给处理方(Content-Length 或 chunked)，不在内存中拼接；
+// 响应以 chunked 编码分段写出(HTTP/1.0 不分块，写完后关闭连接)。
+// 输入侧用 PauseInput/ResumeInput 限速，输出侧 Write 返回 false 时等待 OnWritable，
+// 每个连接占用的内存与消息大小无关。所有方法只能在连接所属线程中调用
+#define MAX_CHUNK_LINE 1024
+#define CHUNK_HEAD_RESERVE 18 // "%zx\r\n" 的最大长度
+
+class HttpStream
+{
+public:
+    using DataCallBack = std::function<void(const char *, size_t)>;
+    using NotifyCallBack = std::function<void()>;
+
+    HttpStream(Connection *conn, const HttpRequest &req, bool close)
+        : _conn(conn), _version(req._version), _close(close || req.Close()), _in_paused(false), _head_sent(false),
+          _chunked_out(req._version == "HTTP/1.1"), _ended(false), _closed(false), _remaining(0),
+          _compress_opts(nullptr), _accept_coding(CODING_IDENTITY), _zbuf(CHUNK_HEAD_RESERVE)
+    {
+        if (req.Chunked())
+            _in_state = BODY_CHUNK_SIZE;
+        else
+        {
+            _remaining = req.ContentLength();
+            _in_state = _remaining > 0 ? BODY_LENGTH : BODY_DONE;
+        }
+        if (!_chunked_out)
+            _close = true; // 没有分块编码时以关闭连接表示响应结束
+    }
+
+    // ---------------- 请求体 ----------------
+    // 每到达一段正文调用一次，data 只在回调期间有效
+    void OnData(const DataCallBack &cb)
+    {
+        _data_cb = cb;
+    }
+    // 正文接收完毕
+    void OnEnd(const NotifyCallBack &cb)
+    {
+        _end_cb = cb;
+    }
+    // 连接在响应结束之前关闭(之后的 Write 都返回 false)
+    void OnClose(const NotifyCallBack &cb)
+    {
+        _close_cb = cb;
+    }
+    void PauseInput()
+    {
+        _in_paused = true;
+        _conn->PauseInput();
+    }
+    // 恢复后继续交付缓冲区中剩余的正文
+    void ResumeInput()
+    {
+        if (!_in_paused || _closed)
+            return;
+        _in_paused = false;
+        _conn->ResumeInput();
+        if (_resume_cb)
+            _resume_cb();
+    }
+    bool BodyDone()
+    {
+        return _in_state == BODY_DONE;
+    }
+
+    // ---------------- 响应 ----------------
+    // 写出状态行与头部，不调用时第一次 Write 写出 200。
+    // 开启了压缩且 Content-Type 可压缩时，之后写入的数据边写边压缩
+    void WriteHead(HttpResponse &rsp)
+    {
+        if (_head_sent || _closed)
+            return;
+        _head_sent = true;
+        rsp._headers.erase("Content-Length");
+        if (_compress_opts && _accept_coding != CODING_IDENTITY && rsp.HasHeader("Content-Encoding") == false &&
+            _compress_opts->Compressible(rsp.GetHeader("Content-Type")))
+        {
+            _compressor.reset(new Compressor(_accept_coding, _compress_opts->level));
+            if (_compressor->Ok())
+            {
+                rsp.SetHeader("Content-Encoding", Compressor::Name(_accept_coding));
+                rsp.SetHeader("Vary", "Accept-Encoding");
+            }
+            else
+                _compressor.reset();
+        }
+        if (_chunked_out)
+            rsp.SetHeader("Transfer-Encoding", "chunked");
+        rsp.SetHeader("Connection", _close ? "close" : "keep-alive");
+        if (rsp.HasHeader("Content-Type") == false)
+            rsp.SetHeader("Content-Type", "application/octet-stream");
+        std::string head = _version + " " + std::to_string(rsp._statu) + " " + Util::StatuDesc(rsp._statu) + "\r\n";
+        for (auto &h : rsp._headers)
+            head += h.first + ": " + h.second + "\r\n";
+        head += "\r\n";
+        _conn->Send(head.data(), head.size());
+    }
+    // 写出一段响应体，返回 false 表示输出积压已超过高水位(或连接已关闭)，应等待 OnWritable 再继续
+    bool Write(const char *data, size_t len)
+    {
+        if (_closed || _ended)
+            return false;
+        if (!_head_sent)
+        {
+            HttpResponse rsp(200);
+            WriteHead(rsp);
+        }
+        if (_compressor)
+        {
+            _compressor->Update(data, len, &_zbuf);
+            WriteCompressed();
+        }
+        else
+            WriteRaw(data, len);
+        return Writable();
+    }
+    bool Write(const std::string &data)
+    {
+        return Write(data.data(), data.size());
+    }
+    // 压缩时把压缩器中积累的数据立即送出(如逐条推送的事件)，未压缩时无需调用
+    void Flush()
+    {
+        if (_compressor && !_closed && !_ended)
+        {
+            _compressor->Update(nullptr, 0, &_zbuf, true);
+            WriteCompressed();
+        }
+    }
+    // 输出积压回落到低水位
+    void OnWritable(const NotifyCallBack &cb)
+    {
+        _writable_cb = cb;
+    }
+    // 响应结束；请求体还没有接收完时关闭连接
+    void End()
+    {
+        if (_closed || _ended)
+            return;
+        if (!_head_sent)
+        {
+            HttpResponse rsp(200);
+            WriteHead(rsp);
+        }
+        if (_compressor)
+        {
+            _compressor->Finish(&_zbuf);
+            WriteCompressed();
+        }
+        _ended = true;
+        if (_chunked_out)
+            _conn->Send("0\r\n\r\n", 5);
+        if (_in_state != BODY_DONE)
+            _close = true;
+        if (_close)
+            _conn->Shutdown();
+        else if (_resume_cb)
+            _resume_cb(); // 继续处理流水线中的后续请求
+    }
+    bool Closed()
+    {
+        return _closed;
+    }
+    EventLoop *Loop()
+    {
+        return _conn->Loop();
+    }
+    Connection *GetConnection()
+    {
+        return _conn;
+    }
+
+private:
+    friend class HttpServer;
+
+    // 请求与响应都已结束
+    bool Finished()
+    {
+        return _ended && (_in_state == BODY_DONE || _close);
+    }
+    bool CloseAfter()
+    {
+        return _close;
+    }
+    void SetResume(const NotifyCallBack &cb)
+    {
+        _resume_cb = cb;
+    }
+    void SetCompression(const CompressOptions *opts, ContentCoding coding)
+    {
+        _compress_opts = opts;
+        _accept_coding = coding;
+    }
+
+    // 按分块编码写出一段(不压缩)
+    void WriteRaw(const char *data, size_t len)
+    {
+        if (len == 0)
+            return;
+        if (_chunked_out)
+        {
+            char size[32];
+            int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+            _conn->Send(size, n);
+            _conn->Send(data, len);
+            _conn->Send("\r\n", 2);
+        }
+        else
+            _conn->Send(data, len);
+    }
+    // 压缩输出写完后才知道长度：在缓冲区中原地前插 chunk 大小、追加 CRLF，整块一次发送
+    void WriteCompressed()
+    {
+        size_t len = _zbuf.ReadAbleSize();
+        if (len == 0)
+            return;
+        if (_chunked_out)
+        {
+            char size[32];
+            int n = snprintf(size, sizeof(size), "%zx\r\n", len);
+            _zbuf.Prepend(size, n);
+            _zbuf.Write("\r\n", 2);
+        }
+        _conn->Send(_zbuf.ReadPos(), _zbuf.ReadAbleSize());
+        _zbuf.Clear();
+    }
+    // 输出积压越过高水位时连接会暂停读取，回落到低水位时经低水位回调通知 OnWritable
+    bool Writable()
+    {
+        return !_closed && _conn->PendingOutput() < _conn->HighWaterMark();
+    }
+
+    // 消费缓冲区中的正文，暂停、出错或正文结束时停止
+    void Feed(Buffer *buf)
+    {
+        while (buf->ReadAbleSize() > 0 && _in_state != BODY_DONE && !_in_paused && !_closed)
+        {
+            if (_in_state == BODY_LENGTH || _in_state == BODY_CHUNK_DATA)
+            {
+                size_t len = std::min<uint64_t>(buf->ReadAbleSize(), _remaining);
+                _remaining -= len;
+                if (_remaining == 0)
+                    _in_state = _in_state == BODY_LENGTH ? BODY_DONE : BODY_CHUNK_CRLF;
+                if (_data_cb)
+                    _data_cb(buf->ReadPos(), len);
+                buf->MoveReadOffset(len);
+                continue;
+            }
+            std::string line = buf->GetLine();
+            if (line.empty())
+            {
+                if (buf->ReadAbleSize() > MAX_CHUNK_LINE)
+                    return BadBody();
+                return; // 等待完整的一行
+            }
+            if (_in_state == BODY_CHUNK_SIZE)
+            {
+                char *end = nullptr;
+                _remaining = strtoull(line.c_str(), &end, 16);
+                if (end == line.c_str() || (*end != ';' && *end != '\r' && *end != '\n'))
+                    return BadBody();
+                _in_state = _remaining == 0 ? BODY_CHUNK_TRAILER : BODY_CHUNK_DATA;
+            }
+            else if (_in_state == BODY_CHUNK_CRLF)
+            {
+                if (line != "\r\n" && line != "\n")
+                    return BadBody();
+                _in_state = BODY_CHUNK_SIZE;
+            }
+            else if (line == "\r\n" || line == "\n") // BODY_CHUNK_TRAILER，忽略尾部头字段
+                _in_state = BODY_DONE;
+        }
+        if (_in_state == BODY_DONE && _end_cb)
+        {
+            NotifyCallBack cb = _end_cb;
+            _end_cb = nullptr;
+            cb();
+        }
+    }
+
+    void BadBody()
+    {
+        ERR_LOG("Bad chunked request body, close connection");
+        _in_state = BODY_DONE;
+        _ended = true;
+        _close = true;
+        _conn->Shutdown();
+        HandleClose();
+    }
+
+    // 由 HttpServer 在连接关闭或输出回落时调用
+    void HandleClose()
+    {
+        if (_closed)
+            return;
+        _closed = true;
+        if (!_ended && _close_cb)
+            _close_cb();
+    }
+    void HandleWritable()
+    {
+        if (!_closed && !_ended && _writable_cb)
+            _writable_cb();
+    }
+
+private:
+    enum BodyState
+    {
+        BODY_LENGTH,
+        BODY_CHUNK_SIZE,
+        BODY_CHUNK_DATA,
+        BODY_CHUNK_CRLF,
+        BODY_CHUNK_TRAILER,
+        BODY_DONE
+    };
+    Connection *_conn;
+    std::string _version;
+    bool _close; // 响应结束后关闭连接
+    bool _in_paused;
+    bool _head_sent;
+    bool _chunked_out;
+    bool _ended;
+    bool _closed;
+    BodyState _in_state;
+    uint64_t _remaining; // 当前 Content-Length 或 chunk 剩余字节数
+    const CompressOptions *_compress_opts; // 未开启压缩时为 nullptr
+    ContentCoding _accept_coding;          // 按 Accept-Encoding 协商的编码
+    std::unique_ptr<Compressor> _compressor;
+    Buffer _zbuf; // 压缩输出，写出后清空
+    DataCallBack _data_cb;
+    NotifyCallBack _end_cb;
+    NotifyCallBack _close_cb;
+    NotifyCallBack _writable_cb;
+    NotifyCallBack _resume_cb;
+};
+
+// ================================================================
+//                            WebSocket模块
+// ================================================================
+// RFC 6455：GET 升级握手之后连接只收发帧。帧在输入缓冲区中原地解析与去掩码，
+// 未分片的消息直接以缓冲区中的数据交给处理方，分片消息拼接后交付。
+// 心跳由时间轮驱动：一个周期内没有收到任何帧则发送 ping，再过一个周期仍没有则关闭连接。
+// 除 WebSocketGroup::Broadcast 外的方法只能在连接所属线程中调用
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_MAX_MESSAGE (16 * 1024 * 1024) // 单条消息上限(含分片拼接)
+#define WS_PING_INTERVAL 30               // 秒
+#define WS_CLOSE_TIMEOUT 5                // 发出关闭帧后等待对端回应的秒数
+#define WS_MAX_HEADER 14
+
+typedef enum
+{
+    WS_CONTINUATION = 0x0,
+    WS_TEXT = 0x1,
+    WS_BINARY = 0x2,
+    WS_CLOSE = 0x8,
+    WS_PING = 0x9,
+    WS_PONG = 0xA
+} WsOpcode;
+
+typedef enum
+{
+    WS_CLOSE_NORMAL = 1000,
+    WS_CLOSE_GOING_AWAY = 1001,
+    WS_CLOSE_PROTOCOL_ERROR = 1002,
+    WS_CLOSE_NO_STATUS = 1005,
+    WS_CLOSE_ABNORMAL = 1006,
+    WS_CLOSE_INVALID_DATA = 1007,
+    WS_CLOSE_TOO_BIG = 1009
+} WsCloseCode;
+
+struct WebSocketOptions
+{
+    size_t max_message;                 // 超出时以 1009 关闭
+    uint32_t ping_interval;             // 0 表示不发心跳
+    std::vector<std::string> protocols; // 支持的子协议，选客户端列表中第一个支持的
+
+    WebSocketOptions()
+        : max_message(WS_MAX_MESSAGE), ping_interval(WS_PING_INTERVAL)
+    { }
+};
+
+class WebSocketGroup;
+
+class WebSocket : public std::enable_shared_from_this<WebSocket>
+{
+public:
+    using MessageHandler = std::function<void(const char *, size_t, bool)>; // 数据、长度、是否二进制
+    using CloseHandler = std::function<void(uint16_t, const std::string &)>;
+    using NotifyHandler = std::function<void()>;
+
+    WebSocket(Connection *conn, const WebSocketOptions *opts, const std::string &protocol)
+        : _conn(conn), _opts(opts), _protocol(protocol), _fragmented(false), _msg_binary(false), _out_fragmenting(false),
+          _close_sent(false), _close_received(false), _closed(false), _alive(false), _ping_sent(false), _keepalive_timer(0)
+    { }
+
+    // 收到一条完整消息，data 只在回调期间有效
+    void OnMessage(const MessageHandler &cb)
+    {
+        _message_cb = cb;
+    }
+    // 连接关闭(关闭握手完成、协议错误或连接断开，后者的状态码为 1006)，只调用一次
+    void OnClose(const CloseHandler &cb)
+    {
+        _close_cb = cb;
+    }
+    // 输出积压回落到低水位
+    void OnWritable(const NotifyHandler &cb)
+    {
+        _writable_cb = cb;
+    }
+
+    // 发送一条消息；返回 false 表示连接已关闭或输出积压超过高水位(应等待 OnWritable)
+    bool Send(const char *data, size_t len, bool binary = false)
+    {
+        if (_out_fragmenting)
+            return false;
+        return SendFrame(binary ? WS_BINARY : WS_TEXT, true, data, len);
+    }
+    bool Send(const std::string &msg, bool binary = false)
+    {
+        return Send(msg.data(), msg.size(), binary);
+    }
+    // 分片发送一条消息，fin 为 true 的分片结束该消息；期间到达的广播在消息结束后发出
+    bool SendFragment(const char *data, size_t len, bool binary, bool fin)
+    {
+        WsOpcode op = _out_fragmenting ? WS_CONTINUATION : (binary ? WS_BINARY : WS_TEXT);
+        _out_fragmenting = !fin;
+        bool ok = SendFrame(op, fin, data, len);
+        if (fin)
+        {
+            for (auto &frame : _deferred)
+                SendBlock(frame);
+            _deferred.clear();
+        }
+        return ok;
+    }
+    void Ping(const std::string &payload = "")
+    {
+        SendFrame(WS_PING, true, payload.data(), std::min<size_t>(payload.size(), 125));
+    }
+    // 发起关闭握手，对端回应关闭帧后断开连接，超时未回应则直接断开
+    void Close(uint16_t code = WS_CLOSE_NORMAL, const std::string &reason = "")
+    {
+        if (_close_sent || _closed)
+            return;
+        SendClose(code, reason);
+        std::weak_ptr<WebSocket> weak = shared_from_this();
+        _conn->Loop()->RunAfter(WS_CLOSE_TIMEOUT, [weak]() {
+            std::shared_ptr<WebSocket> ws = weak.lock();
+            if (ws && !ws->_closed)
+                ws->_conn->Shutdown();
+        });
+    }
+
+    bool Closed()
+    {
+        return _closed || _close_sent;
+    }
+    const std::string &Protocol()
+    {
+        return _protocol;
+    }
+    Connection *GetConnection()
+    {
+        return _conn;
+    }
+    EventLoop *Loop()
+    {
+        return _conn->Loop();
+    }
+
+    // Sec-WebSocket-Accept
+    static std::string AcceptKey(const std::string &key)
+    {
+        return Util::Base64Encode(Util::Sha1(key + WS_GUID));
+    }
+
+    // 按 4 字节掩码原地异或，phase 为 data[0] 在掩码中的位置
+    static void Unmask(char *data, size_t len, const unsigned char mask[4], size_t phase = 0)
+    {
+        unsigned char m[4];
+        for (int i = 0; i < 4; i++)
+            m[i] = mask[(phase + i) & 3];
+        uint32_t m32;
+        memcpy(&m32, m, 4);
+        size_t i = 0;
+#if defined(__AVX2__)
+        __m256i mv = _mm256_set1_epi32((int)m32);
+        for (; i + 32 <= len; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+            _mm256_storeu_si256((__m256i *)(data + i), _mm256_xor_si256(v, mv));
+        }
+#elif defined(__SSE2__)
+        __m128i mv = _mm_set1_epi32((int)m32);
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+            _mm_storeu_si128((__m128i *)(data + i), _mm_xor_si128(v, mv));
+        }
+#elif defined(__ARM_NEON)
+        uint8x16_t mv = vreinterpretq_u8_u32(vdupq_n_u32(m32));
+        for (; i + 16 <= len; i += 16)
+            vst1q_u8((uint8_t *)data + i, veorq_u8(vld1q_u8((const uint8_t *)data + i), mv));
+#endif
+        uint64_t m64 = (uint64_t)m32 << 32 | m32;
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t v;
+            memcpy(&v, data + i, 8);
+            v ^= m64;
+            memcpy(data + i, &v, 8);
+        }
+        for (; i < len; i++)
+            data[i] ^= m[i & 3];
+    }
+
+    // 服务端帧头(不带掩码)，返回长度
+    static size_t EncodeHeader(WsOpcode op, bool fin, uint64_t len, char *out)
+    {
+        out[0] = (char)((fin ? 0x80 : 0) | op);
+        if (len < 126)
+        {
+            out[1] = (char)len;
+            return 2;
+        }
+        if (len <= 0xFFFF)
+        {
+            out[1] = 126;
+            out[2] = (char)(len >> 8);
+            out[3] = (char)len;
+            return 4;
+        }
+        out[1] = 127;
+        for (int i = 0; i < 8; i++)
+            out[2 + i] = (char)(len >> (56 - 8 * i));
+        return 10;
+    }
+    // 序列化一整帧，广播时所有连接共享
+    static std::shared_ptr<const std::string> EncodeFrame(WsOpcode op, const char *data, size_t len)
+    {
+        char head[WS_MAX_HEADER];
+        size_t n = EncodeHeader(op, true, len, head);
+        std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+        frame->reserve(n + len);
+        frame->append(head, n);
+        frame->append(data, len);
+        return frame;
+    }
+
+private:
+    friend class HttpServer;
+    friend class WebSocketGroup;
+
+    // 解析缓冲区中的完整帧，不完整的帧留在缓冲区中
+    void Feed(Buffer *buf)
+    {
+        while (!_closed && !_close_received && buf->ReadAbleSize() >= 2)
+        {
+            unsigned char *p = (unsigned char *)buf->ReadPos();
+            size_t avail = buf->ReadAbleSize();
+            bool fin = p[0] & 0x80;
+            int op = p[0] & 0x0F;
+            uint64_t len = p[1] & 0x7F;
+            size_t head = 2;
+            if (len == 126)
+            {
+                if (avail < 4)
+                    return;
+                len = (uint64_t)p[2] << 8 | p[3];
+                head = 4;
+            }
+            else if (len == 127)
+            {
+                if (avail < 10)
+                    return;
+                // 64 位长度的最高位必须为 0 (RFC 6455 5.2)
+                if (p[2] & 0x80)
+                    return Fail(WS_CLOSE_PROTOCOL_ERROR, "bad payload length");
+                len = 0;
+                for (int i = 0; i < 8; i++)
+                    len = len << 8 | p[2 + i];
+                head = 10;
+            }
+            // 没有协商扩展，RSV 必须为 0；客户端发来的帧必须带掩码
+            if ((p[0] & 0x70) || !(p[1] & 0x80))
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "bad frame header");
+            if (op != WS_CONTINUATION && op != WS_TEXT && op != WS_BINARY && op != WS_CLOSE && op != WS_PING && op != WS_PONG)
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "unknown opcode");
+            bool control = op & 0x08;
+            if (control && (!fin || len > 125))
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "bad control frame");
+            // 先比较再相减，避免长度相加回绕
+            if (!control && (_message.size() > _opts->max_message || len > _opts->max_message - _message.size()))
+                return Fail(WS_CLOSE_TOO_BIG, "message too big");
+            if (avail < head + 4 || avail - head - 4 < len)
+                return; // 等待整帧到达
+            char *payload = (char *)p + head + 4;
+            Unmask(payload, len, p + head);
+            _alive = true;
+            HandleFrame((WsOpcode)op, fin, payload, len);
+            buf->MoveReadOffset(head + 4 + len);
+        }
+    }
+
+    void HandleFrame(WsOpcode op, bool fin, const char *data, size_t len)
+    {
+        switch (op)
+        {
+        case WS_TEXT:
+        case WS_BINARY:
+            if (_fragmented)
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "expected continuation");
+            if (fin)
+                return Deliver(data, len, op == WS_BINARY);
+            _fragmented = true;
+            _msg_binary = op == WS_BINARY;
+            _message.assign(data, len);
+            return;
+        case WS_CONTINUATION:
+            if (!_fragmented)
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "unexpected continuation");
+            _message.append(data, len);
+            if (fin)
+            {
+                _fragmented = false;
+                std::string message;
+                message.swap(_message);
+                Deliver(message.data(), message.size(), _msg_binary);
+            }
+            return;
+        case WS_PING:
+            SendFrame(WS_PONG, true, data, len);
+            return;
+        case WS_PONG:
+            _ping_sent = false;
+            return;
+        case WS_CLOSE:
+            return HandleCloseFrame(data, len);
+        default:
+            return;
+        }
+    }
+
+    void Deliver(const char *data, size_t len, bool binary)
+    {
+        if (!binary && !Util::ValidUtf8(data, len))
+            return Fail(WS_CLOSE_INVALID_DATA, "invalid utf-8");
+        if (_message_cb)
+            _message_cb(data, len, binary);
+    }
+
+    void HandleCloseFrame(const char *data, size_t len)
+    {
+        uint16_t code = WS_CLOSE_NO_STATUS;
+        std::string reason;
+        if (len == 1)
+            return Fail(WS_CLOSE_PROTOCOL_ERROR, "bad close payload");
+        if (len >= 2)
+        {
+            code = (uint16_t)((unsigned char)data[0] << 8 | (unsigned char)data[1]);
+            reason.assign(data + 2, len - 2);
+            bool valid = (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+            if (!valid)
+                return Fail(WS_CLOSE_PROTOCOL_ERROR, "bad close code");
+            if (!Util::ValidUtf8(reason.data(), reason.size()))
+                return Fail(WS_CLOSE_INVALID_DATA, "invalid close reason");
+        }
+        _close_received = true;
+        if (!_close_sent)
+            SendClose(code == WS_CLOSE_NO_STATUS ? (uint16_t)WS_CLOSE_NORMAL : code, "");
+        Finish(code, reason);
+    }
+
+    // 协议错误：发送关闭帧后断开
+    void Fail(uint16_t code, const std::string &reason)
+    {
+        DBG_LOG("WebSocket fd:%d closed: %s", _conn->GetFd(), reason.c_str());
+        if (!_close_sent)
+            SendClose(code, reason);
+        Finish(code, reason);
+    }
+
+    // 关闭握手结束，发送完关闭帧后断开连接
+    void Finish(uint16_t code, const std::string &reason)
+    {
+        if (_closed)
+            return;
+        _closed = true;
+        if (_keepalive_timer)
+            _conn->Loop()->TimerCancel(_keepalive_timer);
+        _conn->Shutdown();
+        CloseHandler cb;
+        cb.swap(_close_cb);
+        if (cb)
+            cb(code, reason);
+    }
+
+    void SendClose(uint16_t code, const std::string &reason)
+    {
+        char payload[125];
+        payload[0] = (char)(code >> 8);
+        payload[1] = (char)code;
+        size_t n = std::min<size_t>(reason.size(), sizeof(payload) - 2);
+        memcpy(payload + 2, reason.data(), n);
+        SendFrame(WS_CLOSE, true, payload, n + 2);
+        _close_sent = true;
+    }
+
+    bool SendFrame(WsOpcode op, bool fin, const char *data, size_t len)
+    {
+        if (_closed || _close_sent)
+            return false;
+        char head[WS_MAX_HEADER];
+        size_t n = EncodeHeader(op, fin, len, head);
+        _conn->Send(head, n);
+        if (len > 0)
+            _conn->Send(data, len);
+        return _conn->PendingOutput() < _conn->HighWaterMark();
+    }
+
+    // 发送序列化好的整帧(广播)；输出积压超过高水位的慢连接丢弃该帧
+    bool SendBlock(const std::shared_ptr<const std::string> &frame)
+    {
+        if (_closed || _close_sent)
+            return false;
+        if (_conn->PendingOutput() >= _conn->HighWaterMark())
+            return false;
+        if (_out_fragmenting)
+        {
+            _deferred.push_back(frame); // 数据帧不能插入分片消息中间
+            return true;
+        }
+        _conn->SendBlock(frame);
+        return true;
+    }
+
+    // 心跳：本周期内收到过帧则什么都不做，否则发 ping；上一个 ping 没有回应则断开
+    void StartKeepalive()
+    {
+        if (_opts->ping_interval == 0 || _closed)
+            return;
+        std::weak_ptr<WebSocket> weak = shared_from_this();
+        _keepalive_timer = _conn->Loop()->RunAfter(_opts->ping_interval, [weak]() {
+            std::shared_ptr<WebSocket> ws = weak.lock();
+            if (ws)
+                ws->Keepalive();
+        });
+    }
+    void Keepalive()
+    {
+        _keepalive_timer = 0;
+        if (_closed)
+            return;
+        if (_close_sent || (_ping_sent && !_alive))
+        {
+            INF_LOG("WebSocket fd:%d keepalive timeout", _conn->GetFd());
+            return Finish(WS_CLOSE_ABNORMAL, "keepalive timeout");
+        }
+        if (!_alive)
+        {
+            Ping();
+            _ping_sent = true;
+        }
+        _alive = false;
+        StartKeepalive();
+    }
+
+    // 优雅关闭期间的空闲判断：先发 1001 关闭帧，关闭握手完成后由 Finish 断开
+    bool DrainIdle()
+    {
+        if (!_closed && !_close_sent)
+            Close(WS_CLOSE_GOING_AWAY, "server shutdown");
+        return false;
+    }
+
+    void HandleWritable()
+    {
+        if (!_closed && _writable_cb)
+            _writable_cb();
+    }
+
+    // 连接已断开
+    void HandleClose()
+    {
+        if (_closed)
+            return;
+        _closed = true;
+        if (_keepalive_timer)
+            _conn->Loop()->TimerCancel(_keepalive_timer);
+        CloseHandler cb;
+        cb.swap(_close_cb);
+        if (cb)
+            cb(WS_CLOSE_ABNORMAL, "");
+    }
+
+private:
+    Connection *_conn;
+    const WebSocketOptions *_opts;
+    std::string _protocol;
+    std::string _message; // 正在拼接的分片消息
+    bool _fragmented;
+    bool _msg_binary;
+    bool _out_fragmenting; // 正在分片发送一条消息
+    std::vector<std::shared_ptr<const std::string>> _deferred; // 分片发送期间到达的广播帧
+    bool _close_sent;
+    bool _close_received;
+    bool _closed;
+    bool _alive;     // 本心跳周期内收到过帧
+    bool _ping_sent; // 已发出 ping 尚未收到帧
+    uint64_t _keepalive_timer;
+    MessageHandler _message_cb;
+    CloseHandler _close_cb;
+    NotifyHandler _writable_cb;
+};
+
+// 广播组：消息只序列化一次，按连接所属的事件循环分片，在各自的线程中发给组内连接。
+// Join/Leave 在连接所属线程中调用，Broadcast 可在任意线程调用；组的生命周期须长于服务器
+class WebSocketGroup
+{
+public:
+    WebSocketGroup()
+        : _size(0), _dropped(0)
+    { }
+
+    void Join(const std::shared_ptr<WebSocket> &ws)
+    {
+        Shard *shard = ShardFor(ws->Loop());
+        if (shard->members.emplace(ws.get(), ws).second)
+            _size.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Leave(const std::shared_ptr<WebSocket> &ws)
+    {
+        Shard *shard = ShardFor(ws->Loop());
+        if (shard->members.erase(ws.get()) > 0)
+            _size.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Broadcast(const char *data, size_t len, bool binary = false)
+    {
+        std::shared_ptr<const std::string> frame = WebSocket::EncodeFrame(binary ? WS_BINARY : WS_TEXT, data, len);
+        std::vector<std::pair<EventLoop *, Shard *>> shards;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (auto &it : _shards)
+                shards.emplace_back(it.first, it.second.get());
+        }
+        for (auto &it : shards)
+            it.first->RunInLoop(std::bind(&WebSocketGroup::FanOut, this, it.second, frame));
+    }
+    void Broadcast(const std::string &msg, bool binary = false)
+    {
+        Broadcast(msg.data(), msg.size(), binary);
+    }
+
+    // 组内连接数(关闭的连接在下一次广播时移除)
+    size_t Size()
+    {
+        return _size.load(std::memory_order_relaxed);
+    }
+    // 因输出积压被跳过的次数
+    uint64_t Dropped()
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Shard
+    {
+        std::unordered_map<WebSocket *, std::weak_ptr<WebSocket>> members; // 只在所属线程中访问
+    };
+
+    Shard *ShardFor(EventLoop *loop)
+    {
+        loop->AssertInLoop();
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::unique_ptr<Shard> &shard = _shards[loop];
+        if (!shard)
+            shard.reset(new Shard());
+        return shard.get();
+    }
+
+    void FanOut(Shard *shard, const std::shared_ptr<const std::string> &frame)
+    {
+        for (auto it = shard->members.begin(); it != shard->members.end();)
+        {
+            std::shared_ptr<WebSocket> ws = it->second.lock();
+            if (!ws || ws->_closed)
+            {
+                it = shard->members.erase(it);
+                _size.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (!ws->SendBlock(frame))
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            ++it;
+        }
+    }
+
+private:
+    std::mutex _mutex; // 保护 _shards 本身，分片内容只由所属线程访问
+    std::unordered_map<EventLoop *, std::unique_ptr<Shard>> _shards;
+    std::atomic<size_t> _size;
+    std::atomic<uint64_t> _dropped;
+};
+
+// ================================================================
+//                            Proxy模块
+// ================================================================
+// 反向代理：请求头与响应头在用户态解析、改写，正文在客户端与上游之间原样转发：
+//   1. 已经读入缓冲区的正文直接发送，其余部分经客户端会话自己的管道(每个方向一个) splice 转发，
+//      不进入用户态；chunked 正文只在缓冲区中解析分块行，分块数据同样 splice
+//   2. 上游按轮询或最少未完成请求选择，跳过本线程中被标记为不可用的上游，连接失败时换下一个
+//   3. 每个上游有自己的超时：timeout 秒内请求和响应都没有进展时回 504，响应头已发出则断开客户端
+//   4. 客户端连接有用户态传输层时请求体经缓冲区转发，响应体只在内核 TLS 下 splice
+#define DEFAULT_PROXY_TIMEOUT 30             // 秒，由时间轮计时，精度 1 秒
+#define DEFAULT_PROXY_PIPE_SIZE (256 * 1024)
+#define DEFAULT_PROXY_SPLICE_MIN (16 * 1024) // 剩余正文小于该值时直接拷贝，splice 的系统调用开销不划算
+#define MAX_PROXY_HEAD (64 * 1024)           // 上游响应头上限
+
+typedef enum
+{
+    BALANCE_ROUND_ROBIN,
+    BALANCE_LEAST_PENDING // 未完成请求最少(所有事件循环合计)
+} BalancePolicy;
+
+struct ProxyOptions
+{
+    BalancePolicy balance;
+    bool splice;       // false 时正文全部经缓冲区拷贝转发
+    size_t splice_min;
+    size_t pipe_size;  // 每个管道的容量，见 SplicePipe
+
+    ProxyOptions()
+        : balance(BALANCE_ROUND_ROBIN), splice(true), splice_min(DEFAULT_PROXY_SPLICE_MIN),
+          pipe_size(DEFAULT_PROXY_PIPE_SIZE)
+    { }
+};
+
+// 按 HTTP 分帧规则转发一个消息体：缓冲区中属于正文的数据(包括分块行)原样发给目标连接，
+// 处于数据段中时调用者可以用 splice 转发数据段的剩余部分，再用 Consumed 记账
+class BodyRelay
+{
+public:
+    typedef enum
+    {
+        RELAY_NONE,
+        RELAY_LENGTH,
+        RELAY_CHUNKED,
+        RELAY_UNTIL_CLOSE // 没有长度，以连接关闭表示结束
+    } Mode;
+
+    BodyRelay()
+        : _state(STATE_DONE), _remaining(0)
+    { }
+
+    void Reset(Mode mode, uint64_t length = 0)
+    {
+        _remaining = length;
+        if (mode == RELAY_LENGTH && length > 0)
+            _state = STATE_LENGTH;
+        else if (mode == RELAY_CHUNKED)
+            _state = STATE_CHUNK_SIZE;
+        else if (mode == RELAY_UNTIL_CLOSE)
+            _state = STATE_UNTIL_CLOSE;
+        else
+            _state = STATE_DONE;
+    }
+
+    // 转发 buf 开头属于正文的数据，返回转发的字节数，分块格式错误时返回 -1
+    ssize_t Forward(Buffer *buf, Connection *out)
+    {
+        size_t before = buf->ReadAbleSize();
+        while (buf->ReadAbleSize() > 0 && _state != STATE_DONE)
+        {
+            if (InData())
+            {
+                uint64_t len = std::min<uint64_t>(buf->ReadAbleSize(), DataLeft());
+                out->Send(buf->ReadPos(), len);
+                buf->MoveReadOffset(len);
+                Consumed(len);
+                continue;
+            }
+            std::string line = buf->GetLine();
+            if (line.empty())
+            {
+                if (buf->ReadAbleSize() > MAX_CHUNK_LINE)
+                    return -1;
+                break; // 等待完整的一行
+            }
+            out->Send(line.data(), line.size());
+            if (_state == STATE_CHUNK_SIZE)
+            {
+                char *end = nullptr;
+                _remaining = strtoull(line.c_str(), &end, 16);
+                if (end == line.c_str() || (*end != ';' && *end != '\r' && *end != '\n'))
+                    return -1;
+                _state = _remaining == 0 ? STATE_CHUNK_TRAILER : STATE_CHUNK_DATA;
+            }
+            else if (_state == STATE_CHUNK_CRLF)
+            {
+                if (line != "\r\n" && line != "\n")
+                    return -1;
+                _state = STATE_CHUNK_SIZE;
+            }
+            else if (line == "\r\n" || line == "\n") // STATE_CHUNK_TRAILER，尾部头字段原样转发
+                _state = STATE_DONE;
+        }
+        return before - buf->ReadAbleSize();
+    }
+
+    // 数据段中还剩多少字节，不在数据段中为 0，没有长度的正文为 UINT64_MAX
+    uint64_t DataLeft()
+    {
+        if (_state == STATE_UNTIL_CLOSE)
+            return UINT64_MAX;
+        return InData() ? _remaining : 0;
+    }
+    // 数据段中的 len 字节已经转发
+    void Consumed(uint64_t len)
+    {
+        if (_state == STATE_UNTIL_CLOSE)
+            return;
+        _remaining -= len;
+        if (_remaining == 0)
+            _state = _state == STATE_LENGTH ? STATE_DONE : STATE_CHUNK_CRLF;
+    }
+    bool UntilClose()
+    {
+        return _state == STATE_UNTIL_CLOSE;
+    }
+    // 没有长度的正文在连接关闭时结束
+    void Finish()
+    {
+        _state = STATE_DONE;
+    }
+    bool Done()
+    {
+        return _state == STATE_DONE;
+    }
+
+private:
+    bool InData()
+    {
+        return _state == STATE_LENGTH || _state == STATE_CHUNK_DATA || _state == STATE_UNTIL_CLOSE;
+    }
+
+private:
+    enum State
+    {
+        STATE_LENGTH,
+        STATE_CHUNK_SIZE,
+        STATE_CHUNK_DATA,
+        STATE_CHUNK_CRLF,
+        STATE_CHUNK_TRAILER,
+        STATE_UNTIL_CLOSE,
+        STATE_DONE
+    };
+    State _state;
+    uint64_t _remaining; // 当前 Content-Length 或 chunk 剩余字节数
+};
+
+
+// 一组上游及其负载均衡状态，所有事件循环共享；生命周期须长于使用它的服务器
+class ReverseProxy
+{
+public:
+    ReverseProxy(const ProxyOptions &opts = ProxyOptions())
+        : _opts(opts), _rr(0), _requests(0), _failures(0), _timeouts(0), _spliced(0), _copied(0)
+    { }
+
+    // 服务器启动前添加上游；timeout 为该上游的超时(秒)，连接超时等见 UpstreamOptions
+    void AddUpstream(const std::string &ip, uint16_t port, uint32_t timeout = DEFAULT_PROXY_TIMEOUT,
+                     const UpstreamOptions &opts = UpstreamOptions())
+    {
+        assert(timeout > 0);
+        _backends.emplace_back(new Backend(ip, port, timeout, opts));
+    }
+    size_t UpstreamCount()
+    {
+        return _backends.size();
+    }
+    Upstream &GetUpstream(size_t i)
+    {
+        return _backends[i]->upstream;
+    }
+    // 上游 i 当前未完成的请求数、累计分配到的请求数(含失败后换走的)
+    uint32_t Pending(size_t i)
+    {
+        return _backends[i]->pending.load(std::memory_order_relaxed);
+    }
+    uint64_t Served(size_t i)
+    {
+        return _backends[i]->served.load(std::memory_order_relaxed);
+    }
+    // 代理的请求数、回了 502/504 或中途断开的请求数、其中超时的请求数
+    uint64_t Requests()
+    {
+        return _requests.load(std::memory_order_relaxed);
+    }
+    uint64_t Failures()
+    {
+        return _failures.load(std::memory_order_relaxed);
+    }
+    uint64_t Timeouts()
+    {
+        return _timeouts.load(std::memory_order_relaxed);
+    }
+    // 经管道转发与经缓冲区拷贝转发的正文字节数
+    uint64_t SplicedBytes()
+    {
+        return _spliced.load(std::memory_order_relaxed);
+    }
+    uint64_t CopiedBytes()
+    {
+        return _copied.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class ProxySession;
+
+    struct Backend
+    {
+        Backend(const std::string &ip, uint16_t port, uint32_t t, const UpstreamOptions &opts)
+            : upstream(ip, port, opts), timeout(t), pending(0), served(0)
+        { }
+        Upstream upstream;
+        uint32_t timeout;
+        std::atomic<uint32_t> pending;
+        std::atomic<uint64_t> served;
+    };
+
+    // pools 为调用线程中各上游的连接池；跳过已经试过的与不可用的上游，没有可选的返回 -1
+    int Pick(const std::vector<UpstreamPool *> &pools, const std::vector<bool> &tried)
+    {
+        size_t n = _backends.size();
+        size_t start = _rr.fetch_add(1, std::memory_order_relaxed);
+        int best = -1;
+        for (size_t k = 0; k < n; k++)
+        {
+            size_t i = (start + k) % n;
+            if (tried[i] || !pools[i]->Healthy())
+                continue;
+            if (_opts.balance == BALANCE_ROUND_ROBIN)
+                return i;
+            if (best < 0 || Pending(i) < Pending(best))
+                best = i;
+        }
+        return best;
+    }
+
+private:
+    ProxyOptions _opts;
+    std::vector<std::unique_ptr<Backend>> _backends;
+    std::atomic<uint64_t> _rr; // 轮询位置，最少未完成请求时用于打散相同负载的上游
+    std::atomic<uint64_t> _requests;
+    std::atomic<uint64_t> _failures;
+    std::atomic<uint64_t> _timeouts;
+    std::atomic<uint64_t> _spliced;
+    std::atomic<uint64_t> _copied;
+};
+
+// 一个客户端连接上的代理会话，同一时刻最多一个请求在转发(流水线中的后续请求留在缓冲区)。
+// 上游连接的回调只持有弱引用，并按请求序号过滤过期的回调；所有方法只在连接所属线程中调用
+class ProxySession : public std::enable_shared_from_this<ProxySession>
+{
+public:
+    using NotifyCallBack = std::function<void()>;
+
+    ProxySession(Connection *client)
+        : _client(client), _proxy(nullptr), _active(false), _seq(0), _backend(-1), _attempts(0),
+          _client_close(false), _head_request(false), _retryable(false), _head_done(false), _rsp_started(false),
+          _upstream_keepalive(false), _timer(0), _last_progress(0)
+    { }
+    ~ProxySession()
+    {
+        if (_active)
+            EndExchange();
+    }
+
+    bool Active()
+    {
+        return _active;
+    }
+    // 请求结束且连接保持时调用，由 HttpServer 继续处理缓冲区中的后续请求
+    void SetResume(const NotifyCallBack &cb)
+    {
+        _resume_cb = cb;
+    }
+
+    // 请求头已解析：选择上游并转发，close 表示响应后关闭客户端连接
+    void Start(ReverseProxy *proxy, const HttpRequest &req, bool close)
+    {
+        if (_proxy != proxy)
+        {
+            _proxy = proxy;
+            _pools.clear();
+            for (auto &backend : proxy->_backends)
+                _pools.push_back(backend->upstream.For(_client->Loop()));
+        }
+        _active = true;
+        _seq++;
+        _proxy->_requests.fetch_add(1, std::memory_order_relaxed);
+        _client_version = req._version;
+        _client_close = close || req.Close();
+        _head_request = req._method == "HEAD";
+        _head_done = false;
+        _rsp_started = false;
+        _upstream_keepalive = false;
+        _attempts = 0;
+        _req_head = RequestHead(req);
+        if (req.Chunked())
+            _req_body.Reset(BodyRelay::RELAY_CHUNKED);
+        else
+            _req_body.Reset(BodyRelay::RELAY_LENGTH, req.ContentLength());
+        _retryable = _req_body.Done() && (req._method == "GET" || req._method == "HEAD" || req._method == "OPTIONS");
+        _tried.assign(_pools.size(), false);
+        _last_progress = MonotonicMicros();
+        _client->PauseInput(); // 连上上游之前请求体留在内核中
+        Connect();
+    }
+
+    // 客户端的输入缓冲区中有新数据(请求体)
+    void OnClientData()
+    {
+        PumpRequest();
+    }
+    // 客户端输出积压回落到低水位
+    void HandleWritable()
+    {
+        Connection *up = UpstreamConn();
+        if (!_active || up == nullptr)
+            return;
+        UpdateUpstreamInput(up);
+        if (!up->InputPaused() && up->InBuffer()->ReadAbleSize() > 0)
+            PumpResponse(up);
+    }
+    // 客户端连接关闭：放弃正在转发的请求
+    void HandleClose()
+    {
+        if (!_active)
+            return;
+        Connection *up = UpstreamConn();
+        if (up)
+            _pools[_backend]->Release(up, false);
+        EndExchange();
+    }
+
+private:
+    using WeakSession = std::weak_ptr<ProxySession>;
+
+    static bool HopByHop(const std::string &name, const std::string &connection)
+    {
+        static const char *names[] = {"Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Upgrade"};
+        for (auto n : names)
+        {
+            if (strcasecmp(name.c_str(), n) == 0)
+                return true;
+        }
+        return Util::HasToken(connection, name.c_str()); // Connection 中列出的字段也只对本跳有效
+    }
+
+    // 原样转发请求目标与端到端的头部，追加 X-Forwarded-For，与上游之间总是长连接
+    std::string RequestHead(const HttpRequest &req)
+    {
+        std::string connection = req.GetHeader("Connection");
+        std::string head = req._method + " " + req._uri + " " + req._version + "\r\n";
+        std::string forwarded;
+        bool chunked = req.Chunked();
+        for (auto &h : req._headers)
+        {
+            if (HopByHop(h.first, connection))
+                continue;
+            if (chunked && strcasecmp(h.first.c_str(), "Content-Length") == 0)
+                continue; // 按 chunked 分帧时不能再带 Content-Length，否则上游可能按另一种方式分帧
+            if (strcasecmp(h.first.c_str(), "X-Forwarded-For") == 0)
+            {
+                forwarded = h.second;
+                continue;
+            }
+            head += h.first + ": " + h.second + "\r\n";
+        }
+        if (_peer.empty())
+            _peer = _client->PeerAddress().Ip(); // Unix 套接字上的客户端没有地址，不追加
+        if (!_peer.empty())
+            forwarded = forwarded.empty() ? _peer : forwarded + ", " + _peer;
+        if (!forwarded.empty())
+            head += "X-Forwarded-For: " + forwarded + "\r\n";
+        head += "Connection: keep-alive\r\n\r\n";
+        return head;
+    }
+
+    // 当前上游连接，已关闭时为 nullptr
+    Connection *UpstreamConn()
+    {
+        if (_backend < 0 || !_upstream.Valid())
+            return nullptr;
+        return _pools[_backend]->Client().Pool()->Get(_upstream);
+    }
+    bool Owns(uint64_t seq, Connection *conn)
+    {
+        return _active && _seq == seq && conn->Handle() == _upstream;
+    }
+    std::shared_ptr<SplicePipe> Pipe(std::shared_ptr<SplicePipe> *pipe)
+    {
+        if (!*pipe)
+            pipe->reset(new SplicePipe(_proxy->_opts.pipe_size));
+        return *pipe;
+    }
+    void Progress()
+    {
+        _last_progress = MonotonicMicros();
+    }
+
+    void SetBackend(int idx)
+    {
+        ClearBackend();
+        _backend = idx;
+        _proxy->_backends[idx]->pending.fetch_add(1, std::memory_order_relaxed);
+        _proxy->_backends[idx]->served.fetch_add(1, std::memory_order_relaxed);
+    }
+    void ClearBackend()
+    {
+        if (_backend >= 0)
+            _proxy->_backends[_backend]->pending.fetch_sub(1, std::memory_order_relaxed);
+        _backend = -1;
+        _upstream = ConnHandle();
+    }
+
+    void Connect()
+    {
+        int idx = _proxy->Pick(_pools, _tried);
+        if (idx < 0)
+            return Fail(502, "no upstream available");
+        _tried[idx] = true;
+        SetBackend(idx);
+        _attempts++;
+        WeakSession self = shared_from_this();
+        uint64_t seq = _seq;
+        UpstreamPool *pool = _pools[idx];
+        pool->Acquire([self, seq, pool](Connection *conn) {
+            std::shared_ptr<ProxySession> s = self.lock();
+            if (s && s->_active && s->_seq == seq)
+                return s->OnUpstream(conn);
+            if (conn) // 请求已经放弃，新连接直接归还
+                pool->Release(conn);
+        });
+    }
+
+    void OnUpstream(Connection *conn)
+    {
+        if (conn == nullptr)
+        {
+            DBG_LOG("Upstream %s:%u unavailable, try next", _pools[_backend]->Ip().c_str(), _pools[_backend]->Port());
+            return Connect();
+        }
+        WeakSession self = shared_from_this();
+        _upstream = conn->Handle();
+        conn->SetMessageCallBack(std::bind(&ProxySession::UpstreamMessage, self, _seq, std::placeholders::_1,
+                                           std::placeholders::_2));
+        conn->SetClosedCallBack(std::bind(&ProxySession::UpstreamClosed, self, _seq, std::placeholders::_1));
+        conn->SetLowWaterMarkCallBack(std::bind(&ProxySession::UpstreamWritable, self, _seq, std::placeholders::_1));
+        conn->SetHighWaterMarkCallBack(nullptr);
+        conn->SetConnectedCallBack(nullptr);
+        conn->SetAnyEventCallBack(nullptr);
+        conn->Send(_req_head.data(), _req_head.size());
+        Progress();
+        if (_timer == 0)
+            ArmTimer(_proxy->_backends[_backend]->timeout);
+        _client->ResumeInput();
+        PumpRequest();
+    }
+
+    // ---------------- 请求体：客户端 -> 上游 ----------------
+    void PumpRequest()
+    {
+        Connection *up = UpstreamConn();
+        if (!_active || up == nullptr)
+            return;
+        Buffer *buf = _client->InBuffer();
+        if (!_req_body.Done() && !_client->Splicing())
+        {
+            ssize_t n = _req_body.Forward(buf, up);
+            if (n < 0)
+                return Fail(400, "bad chunked request body");
+            if (n > 0)
+            {
+                _proxy->_copied.fetch_add(n, std::memory_order_relaxed);
+                Progress();
+            }
+            if (!_req_body.Done() && buf->ReadAbleSize() == 0 && _proxy->_opts.splice &&
+                !_client->GetTransportFilter() && _req_body.DataLeft() >= _proxy->_opts.splice_min)
+            {
+                _client->SpliceInput(Pipe(&_up_pipe), _req_body.DataLeft(),
+                                     std::bind(&ProxySession::ClientSpliced, WeakSession(shared_from_this()), _seq,
+                                               std::placeholders::_1, std::placeholders::_2));
+            }
+        }
+        UpdateClientInput(up);
+    }
+
+    static void ClientSpliced(const WeakSession &self, uint64_t seq, Connection *, size_t len)
+    {
+        std::shared_ptr<ProxySession> s = self.lock();
+        if (!s || !s->_active || s->_seq != seq)
+            return;
+        Connection *up = s->UpstreamConn();
+        if (up == nullptr)
+            return;
+        up->SendPipe(s->_up_pipe, len);
+        s->_req_body.Consumed(len);
+        s->_proxy->_spliced.fetch_add(len, std::memory_order_relaxed);
+        s->Progress();
+        s->UpdateClientInput(up);
+    }
+
+    static void UpstreamWritable(const WeakSession &self, uint64_t seq, Connection *conn)
+    {
+        std::shared_ptr<ProxySession> s = self.lock();
+        if (s && s->Owns(seq, conn))
+            s->PumpRequest();
+    }
+
+    // 请求体已转发完(后续的流水线请求等本次响应结束)或上游输出积压时暂停读取客户端
+    void UpdateClientInput(Connection *up)
+    {
+        bool pause = _req_body.Done() || up->PendingOutput() >= up->HighWaterMark();
+        if (pause && !_client->InputPaused())
+            _client->PauseInput();
+        else if (!pause && _client->InputPaused())
+            _client->ResumeInput();
+    }
+
+    // ---------------- 响应：上游 -> 客户端 ----------------
+    static void UpstreamMessage(const WeakSession &self, uint64_t seq, Connection *conn, Buffer *buf)
+    {
+        std::shared_ptr<ProxySession> s = self.lock();
+        if (!s || !s->Owns(seq, conn))
+        {
+            // 已归还或放弃的连接上不应再有数据
+            buf->MoveReadOffset(buf->ReadAbleSize());
+            conn->Shutdown();
+            return;
+        }
+        s->_rsp_started = true;
+        s->Progress();
+        s->PumpResponse(conn);
+    }
+
+    void PumpResponse(Connection *up)
+    {
+        Buffer *buf = up->InBuffer();
+        while (!_head_done)
+        {
+            int ret = ResponseHead(buf);
+            if (ret == 0)
+                return;
+            if (ret < 0)
+                return Fail(502, "bad upstream response head");
+        }
+        if (!_rsp_body.Done() && !up->Splicing())
+        {
+            ssize_t n = _rsp_body.Forward(buf, _client);
+            if (n < 0)
+                return Abort("bad chunked upstream response");
+            if (n > 0)
+                _proxy->_copied.fetch_add(n, std::memory_order_relaxed);
+            if (!_rsp_body.Done() && buf->ReadAbleSize() == 0 && CanSpliceToClient() &&
+                _rsp_body.DataLeft() >= _proxy->_opts.splice_min)
+            {
+                up->SpliceInput(Pipe(&_down_pipe), _rsp_body.UntilClose() ? 0 : _rsp_body.DataLeft(),
+                                std::bind(&ProxySession::UpstreamSpliced, WeakSession(shared_from_this()), _seq,
+                                          std::placeholders::_1, std::placeholders::_2));
+            }
+        }
+        if (_rsp_body.Done())
+            return FinishExchange(up);
+        UpdateUpstreamInput(up);
+    }
+
+    static void UpstreamSpliced(const WeakSession &self, uint64_t seq, Connection *conn, size_t len)
+    {
+        std::shared_ptr<ProxySession> s = self.lock();
+        if (!s || !s->Owns(seq, conn))
+            return;
+        s->_rsp_started = true;
+        s->Progress();
+        s->_client->SendPipe(s->_down_pipe, len);
+        s->_rsp_body.Consumed(len);
+        s->_proxy->_spliced.fetch_add(len, std::memory_order_relaxed);
+        if (s->_rsp_body.Done())
+            return s->FinishExchange(conn);
+        s->UpdateUpstreamInput(conn);
+    }
+
+    static void UpstreamClosed(const WeakSession &self, uint64_t seq, Connection *conn)
+    {
+        std::shared_ptr<ProxySession> s = self.lock();
+        if (s && s->Owns(seq, conn))
+            s->OnUpstreamClosed();
+    }
+
+    void OnUpstreamClosed()
+    {
+        _upstream = ConnHandle();
+        if (_head_done && _rsp_body.UntilClose())
+        {
+            _rsp_body.Finish();
+            return FinishExchange(nullptr);
+        }
+        // 复用的长连接可能恰好被上游关闭：幂等且没有请求体的请求在没有收到任何响应时重试一次
+        if (!_rsp_started && _attempts < 2 && _retryable)
+        {
+            _tried[_backend] = false;
+            return Connect();
+        }
+        if (!_head_done)
+            return Fail(502, "upstream closed before response");
+        Abort("upstream closed in the middle of the response");
+    }
+
+    // 解析一个响应头并改写后发给客户端：返回 1 表示已处理(1xx 之后还要继续解析)，0 表示数据不足，-1 表示格式错误
+    int ResponseHead(Buffer *buf)
+    {
+        const char *begin = buf->ReadPos();
+        const char *end = (const char *)memmem(begin, buf->ReadAbleSize(), "\r\n\r\n", 4);
+        if (end == nullptr)
+            return buf->ReadAbleSize() > MAX_PROXY_HEAD ? -1 : 0;
+        std::string head(begin, end + 2 - begin); // 只保留最后一个头部字段的 CRLF
+        buf->MoveReadOffset(end + 4 - begin);
+        // 状态行：HTTP/1.x SP 状态码 SP 描述
+        size_t eol = head.find("\r\n");
+        if (eol < 12 || head.compare(0, 7, "HTTP/1.") != 0 || head[8] != ' ')
+            return -1;
+        std::string version = head.substr(0, 8);
+        int statu = atoi(head.c_str() + 9);
+        if (statu < 100 || statu > 999)
+            return -1;
+        std::string reason = eol > 13 ? head.substr(13, eol - 13) : Util::StatuDesc(statu);
+        std::vector<std::pair<std::string, std::string>> fields; // 保留顺序与重复字段(如 Set-Cookie)
+        std::string connection, encoding, length;
+        for (size_t pos = eol + 2; pos < head.size();)
+        {
+            size_t next = head.find("\r\n", pos);
+            size_t colon = head.find(':', pos);
+            if (colon == std::string::npos || colon >= next)
+                return -1;
+            std::string name = head.substr(pos, colon - pos);
+            size_t vb = head.find_first_not_of(" \t", colon + 1);
+            std::string value = vb < next ? head.substr(vb, next - vb) : "";
+            if (strcasecmp(name.c_str(), "Connection") == 0)
+                connection = value;
+            else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0)
+                encoding = value;
+            else if (strcasecmp(name.c_str(), "Content-Length") == 0)
+                length = value;
+            fields.emplace_back(std::move(name), std::move(value));
+            pos = next + 2;
+        }
+        bool interim = statu < 200;
+        if (statu == 101)
+            return -1; // 不转发协议升级
+        if (!interim)
+        {
+            _upstream_keepalive = version == "HTTP/1.1" ? !Util::HasToken(connection, "close")
+                                                        : Util::HasToken(connection, "keep-alive");
+            if (_head_request || statu == 204 || statu == 304)
+                _rsp_body.Reset(BodyRelay::RELAY_NONE);
+            else if (Util::HasToken(encoding, "chunked"))
+                _rsp_body.Reset(BodyRelay::RELAY_CHUNKED);
+            else if (!length.empty())
+            {
+                size_t len;
+                if (!Util::ParseLength(length, &len))
+                    return -1;
+                _rsp_body.Reset(BodyRelay::RELAY_LENGTH, len);
+            }
+            else
+            {
+                _rsp_body.Reset(BodyRelay::RELAY_UNTIL_CLOSE);
+                _upstream_keepalive = false;
+            }
+            // 以关闭连接结束的响应对客户端同样如此
+            if (_rsp_body.UntilClose() || _client->Pool()->Draining())
+                _client_close = true;
+            _head_done = true;
+        }
+        else if (_client_version != "HTTP/1.1")
+            return 1; // HTTP/1.0 客户端不认识 1xx
+        std::string out = _client_version + " " + std::to_string(statu) + " " + reason + "\r\n";
+        for (auto &f : fields)
+        {
+            if (!HopByHop(f.first, connection))
+                out += f.first + ": " + f.second + "\r\n";
+        }
+        if (!interim)
+            out += _client_close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+        out += "\r\n";
+        _client->Send(out.data(), out.size());
+        return 1;
+    }
+
+    // 响应体可以 splice 到客户端：没有传输层，或者传输层由内核完成(内核 TLS)
+    bool CanSpliceToClient()
+    {
+        TransportFilter *filter = _client->GetTransportFilter();
+        return _proxy->_opts.splice && (filter == nullptr || filter->Passthrough());
+    }
+
+    // 客户端输出积压超过高水位时暂停读取上游，回落后由 HandleWritable 恢复
+    void UpdateUpstreamInput(Connection *up)
+    {
+        bool pause = _client->PendingOutput() >= _client->HighWaterMark();
+        if (pause && !up->InputPaused())
+            up->PauseInput();
+        else if (!pause && up->InputPaused())
+            up->ResumeInput();
+    }
+
+    // ---------------- 结束 ----------------
+    // 响应已完整转发；up 为 nullptr 表示上游连接已关闭
+    void FinishExchange(Connection *up)
+    {
+        bool req_done = _req_body.Done() && !_client->Splicing();
+        if (up)
+        {
+            bool reusable = _upstream_keepalive && req_done && up->PendingOutput() == 0 && !up->Splicing();
+            _pools[_backend]->Release(up, reusable);
+        }
+        if (!req_done)
+            _client_close = true; // 请求体没有读完，无法继续解析后续请求
+        Complete();
+    }
+
+    // 响应头发出之前失败：回错误响应
+    void Fail(int statu, const char *why)
+    {
+        ERR_LOG("Proxy fd:%d %d: %s", _client->GetFd(), statu, why);
+        if (statu != 400)
+            _proxy->_failures.fetch_add(1, std::memory_order_relaxed);
+        Connection *up = UpstreamConn();
+        if (up)
+            _pools[_backend]->Release(up, false);
+        if (!_req_body.Done() || _client->Splicing() || _client->Pool()->Draining())
+            _client_close = true;
+        std::string body = "<html><head><meta http-equiv='Content-Type' content='text/html;charset=utf-8'></head><body><h1>";
+        body += std::to_string(statu) + " " + Util::StatuDesc(statu) + "</h1></body></html>";
+        std::string head = _client_version + " " + std::to_string(statu) + " " + Util::StatuDesc(statu) + "\r\n";
+        head += "Content-Type: text/html\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+        head += _client_close ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+        _client->Send(head.data(), head.size());
+        if (!_head_request)
+            _client->Send(body.data(), body.size());
+        Complete();
+    }
+
+    // 响应头已经发出之后失败：只能断开客户端
+    void Abort(const char *why)
+    {
+        ERR_LOG("Proxy fd:%d aborted: %s", _client->GetFd(), why);
+        _proxy->_failures.fetch_add(1, std::memory_order_relaxed);
+        Connection *up = UpstreamConn();
+        if (up)
+            _pools[_backend]->Release(up, false);
+        _client_close = true;
+        Complete();
+    }
+
+    void Complete()
+    {
+        EndExchange();
+        Buffer *buf = _client->InBuffer();
+        if (_client_close)
+        {
+            buf->MoveReadOffset(buf->ReadAbleSize()); // 连接即将关闭，丢弃剩余数据
+            if (_client->InputPaused())
+                _client->ResumeInput();
+            _client->Shutdown();
+            return;
+        }
+        _client->ResumeInput();
+        if (_resume_cb)
+            _resume_cb();
+    }
+
+    void EndExchange()
+    {
+        _active = false;
+        if (_timer != 0)
+            _client->Loop()->TimerCancel(_timer);
+        _timer = 0;
+        ClearBackend();
+        // 上游没有取走的数据还留在管道里，下次换一个新管道
+        if (_up_pipe && _up_pipe->Size() > 0)
+            _up_pipe.reset();
+    }
+
+    // 超时检查：按最后一次进展的时间重新计时，不在每次收发时刷新定时器
+    void ArmTimer(uint32_t delay)
+    {
+        WeakSession self = shared_from_this();
+        uint64_t seq = _seq;
+        _timer = _client->Loop()->RunAfter(delay, [self, seq]() {
+            std::shared_ptr<ProxySession> s = self.lock();
+            if (s && s->_active && s->_seq == seq)
+                s->OnTimer();
+        });
+    }
+
+    void OnTimer()
+    {
+        _timer = 0;
+        uint32_t timeout = _proxy->_backends[_backend]->timeout;
+        uint64_t idle = (MonotonicMicros() - _last_progress) / 1000000;
+        if (idle < timeout)
+            return ArmTimer(timeout - idle);
+        _proxy->_timeouts.fetch_add(1, std::memory_order_relaxed);
+        if (!_head_done)
+            return Fail(504, "upstream timeout");
+        Abort("upstream timeout");
+    }
+
+private:
+    Connection *_client;
+    ReverseProxy *_proxy;
+    std::vector<UpstreamPool *> _pools; // 本线程中各上游的连接池
+    std::string _peer;                  // 客户端地址(X-Forwarded-For)
+    bool _active;
+    uint64_t _seq;      // 请求序号，过滤上一个请求遗留的回调
+    int _backend;       // 当前上游下标，-1 表示没有
+    ConnHandle _upstream;
+    std::vector<bool> _tried;
+    int _attempts;
+    std::string _client_version;
+    bool _client_close; // 响应结束后关闭客户端连接
+    bool _head_request;
+    bool _retryable;    // 幂等且没有请求体，上游关闭时可以重试
+    bool _head_done;    // 最终响应头已发给客户端
+    bool _rsp_started;  // 收到过上游的数据
+    bool _upstream_keepalive;
+    std::string _req_head;
+    BodyRelay _req_body;
+    BodyRelay _rsp_body;
+    std::shared_ptr<SplicePipe> _up_pipe;   // 请求体：客户端 -> 上游
+    std::shared_ptr<SplicePipe> _down_pipe; // 响应体：上游 -> 客户端
+    uint64_t _timer;
+    uint64_t _last_progress; // 微秒
+    NotifyCallBack _resume_cb;
+};
+
+// ================================================================
+//                            HttpServer模块
+// ================================================================
+class HttpServer
+{
+public:
+    using Handler = std::function<void(const HttpRequest &, HttpResponse *)>;
+    struct RouteEntry
+    {
+        std::regex pattern;
+        Handler handler;
+        bool offload; // 在计算线程池中执行
+    };
+    using Handlers = std::vector<RouteEntry>;
+    // 流式路由：头部解析完即调用，请求体与响应经 HttpStream 分段收发
+    using StreamHandler = std::function<void(const HttpRequest &, const std::shared_ptr<HttpStream> &)>;
+    struct StreamEntry
+    {
+        std::string method;
+        std::regex pattern;
+        StreamHandler handler;
+    };
+    // WebSocket 路由：握手成功(已回 101)后调用，处理方在其中设置回调
+    using WebSocketHandler = std::function<void(const HttpRequest &, const std::shared_ptr<WebSocket> &)>;
+    struct WebSocketEntry
+    {
+        std::regex pattern;
+        WebSocketHandler handler;
+        WebSocketOptions options;
+    };
+    struct ProxyEntry
+    {
+        std::regex pattern;
+        std::shared_ptr<ReverseProxy> proxy;
+    };
+
+    HttpServer(uint16_t port, const std::string &ip = "0.0.0.0", const SocketOptions &opts = SocketOptions())
+        : _server(port, ip, opts), _cache_budget(0), _cache_ttl(DEFAULT_RESPONSE_CACHE_TTL), _compress_enabled(false)
+    {
+        Init();
+    }
+    // 热重启：接管旧进程交出的监听套接字(见 TcpServer::TakeOverListenFd)
+    HttpServer(ListenFd listen_fd, const SocketOptions &opts = SocketOptions())
+        : _server(listen_fd, opts), _cache_budget(0), _cache_ttl(DEFAULT_RESPONSE_CACHE_TTL), _compress_enabled(false)
+    {
+        Init();
+    }
+
+    void SetBaseDir(const std::string &path)
+    {
+        assert(Util::IsDirectory(path) == true);
+        _basedir = path;
+    }
+    // 路由：pattern 为正则表达式，按注册顺序匹配
+    // offload 为 true 时处理函数在计算线程池中执行(需先 SetComputePool)，响应仍由连接所属线程写回
+    void Get(const std::string &pattern, const Handler &handler, bool offload = false)
+    {
+        _get_route.push_back(RouteEntry{std::regex(pattern), handler, offload});
+    }
+    void Post(const std::string &pattern, const Handler &handler, bool offload = false)
+    {
+        _post_route.push_back(RouteEntry{std::regex(pattern), handler, offload});
+    }
+    void Put(const std::string &pattern, const Handler &handler, bool offload = false)
+    {
+        _put_route.push_back(RouteEntry{std::regex(pattern), handler, offload});
+    }
+    void Delete(const std::string &pattern, const Handler &handler, bool offload = false)
+    {
+        _delete_route.push_back(RouteEntry{std::regex(pattern), handler, offload});
+    }
+    // 流式路由优先于普通路由匹配，适合大文件上传/下载
+    void Stream(const std::string &method, const std::string &pattern, const StreamHandler &handler)
+    {
+        _stream_route.push_back(StreamEntry{method, std::regex(pattern), handler});
+    }
+    // WebSocket 路由：带 Upgrade: websocket 的 GET 请求在此升级，其余请求照常走普通路由
+    void WebSocketRoute(const std::string &pattern, const WebSocketHandler &handler,
+                        const WebSocketOptions &opts = WebSocketOptions())
+    {
+        _ws_route.push_back(WebSocketEntry{std::regex(pattern), handler, opts});
+    }
+    // 反向代理路由：路径匹配的请求(任意方法)头部解析完即转发给 proxy 中的上游，优先于流式路由与普通路由
+    void Proxy(const std::string &pattern, const std::shared_ptr<ReverseProxy> &proxy)
+    {
+        _proxy_route.push_back(ProxyEntry{std::regex(pattern), proxy});
+    }
+    // 开启响应压缩：按 Accept-Encoding 协商，达到 min_size 且类型可压缩的 200 响应被压缩；
+    // 大响应在计算线程池中压缩(需先 SetComputePool)；静态资源优先发送预先压缩好的 .gz/.zst 文件
+    void EnableCompression(const CompressOptions &opts = CompressOptions())
+    {
+        _compress_enabled = true;
+        _compress = opts;
+    }
+    // 计算线程池：threads 个工作线程，最多 max_pending 个排队请求，超出直接回 503
+    void SetComputePool(int threads, size_t max_pending = DEFAULT_COMPUTE_QUEUE_LIMIT)
+    {
+        _compute.reset(new ComputePool(threads, max_pending));
+    }
+    ComputePool *GetComputePool()
+    {
+        return _compute.get();
+    }
+    // 开启响应缓存：静态资源与调用了 SetCacheable 的 GET/HEAD 200 响应被缓存，
+    // 键为方法、路径、查询字符串以及 vary 中列出的请求头；budget 为每个事件循环分片的字节上限
+    void EnableResponseCache(size_t budget, uint32_t ttl = DEFAULT_RESPONSE_CACHE_TTL,
+                             const std::vector<std::string> &vary = std::vector<std::string>())
+    {
+        _cache_budget = budget;
+        _cache_ttl = ttl;
+        _cache_vary = vary;
+    }
+    // 任意线程调用：清空所有分片(资源更新后)
+    void PurgeResponseCache()
+    {
+        std::unique_lock<std::mutex> lock(_cache_mutex);
+        for (auto &it : _caches)
+            it.first->RunInLoop(std::bind(&ResponseCache::Clear, it.second.get()));
+    }
+    // 以 Prometheus 文本格式导出所有 EventLoop 的指标
+    void EnableMetrics(const std::string &path = "/metrics")
+    {
+        Get(path, [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent(MetricsRegistry::Instance().ExportPrometheus(), "text/plain; version=0.0.4");
+        });
+    }
+    // 导出慢回调/卡顿环形缓冲区(需先 LoopWatchdog::Instance().Start() 才有卡顿记录)
+    void EnableStallDump(const std::string &path = "/debug/stalls")
+    {
+        Get(path, [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent(StallLog::Instance().Dump(), "text/plain");
+        });
+    }
+    void SetThreadCount(int count)
+    {
+        _server.SetThreadCount(count);
+    }
+    TcpServer &GetTcpServer()
+    {
+        return _server;
+    }
+    // 运行直到优雅关闭完成
+    void Listen()
+    {
+        _server.Start();
+    }
+    // 优雅关闭：处理中的请求写完响应后关闭连接，空闲的长连接立即关闭
+    void Shutdown(uint32_t deadline = DEFAULT_DRAIN_DEADLINE)
+    {
+        _server.Shutdown(deadline);
+    }
+
+private:
+    void Init()
+    {
+        _server.SetConnectedCallBack(std::bind(&HttpServer::OnConnected, this, std::placeholders::_1));
+        _server.SetMessageCallBack(std::bind(&HttpServer::OnMessage, this, std::placeholders::_1, std::placeholders::_2));
+        _server.SetIdlePredicate(std::bind(&HttpServer::IsIdle, std::placeholders::_1));
+        _server.SetClosedCallBack(std::bind(&HttpServer::OnClosed, this, std::placeholders::_1));
+    }
+
+    // 空闲：没有接收到一半的请求、没有在计算线程池中的请求、响应已发送完；
+    // WebSocket 连接从不空闲，第一次询问时发出关闭帧，由关闭握手断开
+    static bool IsIdle(Connection *conn)
+    {
+        HttpContext *context = conn->GetContext()->Get<HttpContext>();
+        if (context->GetWebSocket())
+            return context->GetWebSocket()->DrainIdle();
+        if (context->GetProxy() && context->GetProxy()->Active())
+            return false;
+        return context->RecvStatu() == RECV_HTTP_LINE && !context->Pending() && !context->Stream() &&
+               conn->InBuffer()->ReadAbleSize() == 0 && conn->PendingOutput() == 0;
+    }
+
+    void ErrorHandler(const HttpRequest &, HttpResponse *rsp)
+    {
+        std::string body;
+        body += "<html><head><meta http-equiv='Content-Type' content='text/html;charset=utf-8'></head><body><h1>";
+        body += std::to_string(rsp->_statu) + " " + Util::StatuDesc(rsp->_statu);
+        body += "</h1></body></html>";
+        rsp->SetContent(body, "text/html");
+    }
+
+    // 组织响应并发送
+    void WriteReponse(Connection *conn, const HttpRequest &req, HttpResponse &rsp)
+    {
+        if (req.Close() == true || conn->Pool()->Draining())
+            rsp.SetHeader("Connection", "close");
+        else if (rsp.HasHeader("Connection") == false)
+            rsp.SetHeader("Connection", "keep-alive");
+        if (rsp.HasHeader("Content-Length") == false)
+            rsp.SetHeader("Content-Length", std::to_string(rsp._body.size()));
+        if (rsp._body.empty() == false && rsp.HasHeader("Content-Type") == false)
+            rsp.SetHeader("Content-Type", "application/octet-stream");
+        if (rsp._redirect_flag == true)
+            rsp.SetHeader("Location", rsp._redirect_url);
+
+        std::string head;
+        head += req._version + " " + std::to_string(rsp._statu) + " " + Util::StatuDesc(rsp._statu) + "\r\n";
+        for (auto &h : rsp._headers)
+            head += h.first + ": " + h.second + "\r\n";
+        head += "\r\n";
+        ResponseCache *cache = conn->GetContext()->Get<HttpContext>()->Cache();
+        if (cache != nullptr && rsp._cacheable && rsp._statu == 200 && Cacheable(req) && !rsp.Close())
+        {
+            // 序列化为一整块，之后命中时原样发送
+            if (req._method != "HEAD")
+                head += rsp._body;
+            ResponseCache::Block block = std::make_shared<const std::string>(std::move(head));
+            cache->Put(CacheKey(req), block);
+            return conn->SendBlock(block);
+        }
+        conn->Send(head.data(), head.size());
+        if (req._method != "HEAD")
+            conn->Send(rsp._body.data(), rsp._body.size());
+    }
+
+    // 只缓存长连接上的 GET/HEAD：缓存的响应带 Connection: keep-alive
+    bool Cacheable(const HttpRequest &req)
+    {
+        return (req._method == "GET" || req._method == "HEAD") && !req.Close();
+    }
+
+    std::string CacheKey(const HttpRequest &req)
+    {
+        std::string key = req._method + " " + req._path + " " + req._version;
+        if (!req._params.empty())
+        {
+            std::map<std::string, std::string> params(req._params.begin(), req._params.end()); // 与顺序无关
+            for (auto &p : params)
+                key += "\n?" + p.first + "=" + p.second;
+        }
+        for (auto &name : _cache_vary)
+            key += "\n" + name + ": " + req.GetHeader(name);
+        if (_compress_enabled) // 压缩后的响应按协商出的编码区分
+            key += std::string("\n~") + Compressor::Name(Compressor::Negotiate(req.GetHeader("Accept-Encoding")));
+        return key;
+    }
+
+    // 命中时整块发送，返回 false 表示需要正常处理
+    bool ReplyFromCache(Connection *conn, HttpContext *context, const HttpRequest &req)
+    {
+        ResponseCache *cache = context->Cache();
+        if (cache == nullptr || !Cacheable(req) || conn->Pool()->Draining())
+            return false;
+        ResponseCache::Block block = cache->Get(CacheKey(req));
+        if (!block)
+            return false;
+        conn->SendBlock(block);
+        return true;
+    }
+
+    ResponseCache *CacheFor(EventLoop *loop)
+    {
+        std::unique_lock<std::mutex> lock(_cache_mutex);
+        std::unique_ptr<ResponseCache> &cache = _caches[loop];
+        if (!cache)
+            cache.reset(new ResponseCache(_cache_budget, _cache_ttl));
+        return cache.get();
+    }
+
+    bool IsFileHandler(const HttpRequest &req)
+    {
+        if (_basedir.empty())
+            return false;
+        if (req._method != "GET" && req._method != "HEAD")
+            return false;
+        if (Util::ValidPath(req._path) == false)
+            return false;
+        std::string req_path = _basedir + req._path;
+        if (req._path.back() == '/')
+            req_path += "index.html";
+        return Util::IsRegular(req_path);
+    }
+
+    void FileHandler(const HttpRequest &req, HttpResponse *rsp)
+    {
+        std::string req_path = _basedir + req._path;
+        if (req._path.back() == '/')
+            req_path += "index.html";
+        rsp->SetHeader("Content-Type", Util::ExtMime(req_path));
+        rsp->SetCacheable();
+        if (SendPrecompressed(req, req_path, rsp))
+            return;
+        Util::ReadFile(req_path, &rsp->_body);
+    }
+
+    // 客户端接受且存在预先压缩好的同名文件时直接发送
+    bool SendPrecompressed(const HttpRequest &req, const std::string &path, HttpResponse *rsp)
+    {
+        if (!_compress_enabled || !_compress.precompressed || req._method == "HEAD")
+            return false;
+        std::string accept = req.GetHeader("Accept-Encoding");
+        static const std::pair<ContentCoding, const char *> siblings[] = {{CODING_ZSTD, ".zst"}, {CODING_GZIP, ".gz"}};
+        for (auto &sib : siblings)
+        {
+            if (!Compressor::Supported(sib.first) || !Compressor::Accepts(accept, sib.first))
+                continue;
+            std::string file = path + sib.second;
+            if (Util::IsRegular(file) && Util::ReadFile(file, &rsp->_body))
+            {
+                rsp->SetHeader("Content-Encoding", Compressor::Name(sib.first));
+                rsp->SetHeader("Vary", "Accept-Encoding");
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ShouldCompress(const HttpRequest &req, const HttpResponse &rsp)
+    {
+        if (!_compress_enabled || rsp._statu != 200 || req._method == "HEAD")
+            return false;
+        if (rsp._body.size() < _compress.min_size || rsp.HasHeader("Content-Encoding"))
+            return false;
+        if (!_compress.Compressible(rsp.GetHeader("Content-Type")))
+            return false;
+        return Compressor::Negotiate(req.GetHeader("Accept-Encoding")) != CODING_IDENTITY;
+    }
+
+    // 压缩响应体，可在任意线程中调用；每个线程复用各编码的压缩器与输出缓冲区
+    void CompressResponse(const HttpRequest &req, HttpResponse *rsp)
+    {
+        static thread_local std::unique_ptr<Compressor> compressors[CODING_COUNT];
+        static thread_local Buffer scratch;
+        ContentCoding coding = Compressor::Negotiate(req.GetHeader("Accept-Encoding"));
+        std::unique_ptr<Compressor> &c = compressors[coding];
+        if (!c || c->Level() != _compress.level)
+            c.reset(new Compressor(coding, _compress.level));
+        else
+            c->Reset();
+        bool ok = c->Update(rsp->_body.data(), rsp->_body.size(), &scratch) && c->Finish(&scratch);
+        if (ok) // 压缩失败时原样发送
+        {
+            rsp->_body.assign(scratch.ReadPos(), scratch.ReadAbleSize());
+            rsp->SetHeader("Content-Encoding", Compressor::Name(coding));
+            rsp->SetHeader("Vary", "Accept-Encoding");
+        }
+        scratch.Shrink(COMPRESS_SCRATCH_RETAIN);
+    }
+
+    // 大响应交给计算线程池压缩，完成后与卸载的路由一样写回；线程池已满时返回 false
+    bool OffloadCompress(Connection *conn, HttpContext *context, HttpResponse &rsp)
+    {
+        if (!_compute || _compress.offload_size == 0 || rsp._body.size() < _compress.offload_size)
+            return false;
+        std::shared_ptr<HttpRequest> req = std::make_shared<HttpRequest>(context->Request());
+        std::shared_ptr<HttpResponse> out = std::make_shared<HttpResponse>();
+        std::swap(*out, rsp);
+        ConnHandle handle = conn->Handle();
+        ConnectionPool *pool = conn->Pool();
+        bool ok = _compute->Submit([this, req, out, handle, pool]() {
+            CompressResponse(*req, out.get());
+            pool->RunInLoop(handle, std::bind(&HttpServer::OnOffloadDone, this, std::placeholders::_1, req, out));
+        });
+        if (ok == false)
+        {
+            std::swap(*out, rsp);
+            return false;
+        }
+        context->ReSet();
+        context->SetPending(true);
+        return true;
+    }
+
+    void Dispatcher(HttpRequest &req, HttpResponse *rsp, Handlers &handlers)
+    {
+        for (auto &route : handlers)
+        {
+            if (std::regex_match(req._path, req._matches, route.pattern))
+                return route.handler(req, rsp);
+        }
+        rsp->_statu = 404;
+    }
+
+    Handlers *RouteTable(const std::string &method)
+    {
+        if (method == "GET" || method == "HEAD")
+            return &_get_route;
+        else if (method == "POST")
+            return &_post_route;
+        else if (method == "PUT")
+            return &_put_route;
+        else if (method == "DELETE")
+            return &_delete_route;
+        return nullptr;
+    }
+
+    void Route(HttpRequest &req, HttpResponse *rsp)
+    {
+        if (IsFileHandler(req) == true)
+            return FileHandler(req, rsp);
+        Handlers *handlers = RouteTable(req._method);
+        if (handlers == nullptr)
+        {
+            rsp->_statu = 405;
+            return;
+        }
+        Dispatcher(req, rsp, *handlers);
+    }
+
+    // 请求命中的路由要求在计算线程池中执行时返回该路由
+    const RouteEntry *OffloadRoute(const HttpRequest &req)
+    {
+        if (!_compute || IsFileHandler(req))
+            return nullptr;
+        Handlers *handlers = RouteTable(req._method);
+        if (handlers == nullptr)
+            return nullptr;
+        for (auto &route : *handlers)
+        {
+            if (std::regex_match(req._path, route.pattern))
+                return route.offload ? &route : nullptr;
+        }
+        return nullptr;
+    }
+
+    // 复制请求交给计算线程池，完成后经 ConnectionPool::RunInLoop 回到连接所属线程写响应；
+    // 连接在此期间关闭时句柄失效，结果直接丢弃。线程池排满时返回 false
+    bool Offload(Connection *conn, HttpContext *context, const RouteEntry *route)
+    {
+        std::shared_ptr<HttpRequest> req = std::make_shared<HttpRequest>(context->Request());
+        ConnHandle handle = conn->Handle();
+        ConnectionPool *pool = conn->Pool();
+        bool ok = _compute->Submit([this, req, route, handle, pool]() {
+            std::shared_ptr<HttpResponse> rsp = std::make_shared<HttpResponse>(200);
+            // smatch 引用的是原请求中的字符串，需在副本上重新匹配
+            std::regex_match(req->_path, req->_matches, route->pattern);
+            route->handler(*req, rsp.get());
+            if (ShouldCompress(*req, *rsp))
+                CompressResponse(*req, rsp.get());
+            pool->RunInLoop(handle, std::bind(&HttpServer::OnOffloadDone, this, std::placeholders::_1, req, rsp));
+        });
+        if (ok == false)
+            return false;
+        context->ReSet();
+        context->SetPending(true);
+        return true;
+    }
+
+    void OnOffloadDone(Connection *conn, std::shared_ptr<HttpRequest> req, std::shared_ptr<HttpResponse> rsp)
+    {
+        HttpContext *context = conn->GetContext()->Get<HttpContext>();
+        context->SetPending(false);
+        if (rsp->_statu >= 400 && rsp->_body.empty())
+            ErrorHandler(*req, rsp.get());
+        WriteReponse(conn, *req, *rsp);
+        Buffer *buffer = conn->InBuffer();
+        if (rsp->Close() == true)
+        {
+            buffer->MoveReadOffset(buffer->ReadAbleSize());
+            conn->Shutdown();
+            return;
+        }
+        // 继续处理等待期间到达的请求
+        if (buffer->ReadAbleSize() > 0)
+            OnMessage(conn, buffer);
+    }
+
+    // 请求命中的流式路由，同时填充 _matches
+    const StreamEntry *StreamRoute(HttpRequest &req)
+    {
+        for (auto &route : _stream_route)
+        {
+            if (route.method == req._method && std::regex_match(req._path, req._matches, route.pattern))
+                return &route;
+        }
+        return nullptr;
+    }
+
+    void StartStream(Connection *conn, HttpContext *context, const StreamEntry *route)
+    {
+        std::shared_ptr<HttpStream> stream = std::make_shared<HttpStream>(conn, context->Request(), conn->Pool()->Draining());
+        ConnHandle handle = conn->Handle();
+        ConnectionPool *pool = conn->Pool();
+        // 恢复读取或响应结束后，在下一轮继续处理缓冲区中的数据(不在处理方的回调中重入)
+        stream->SetResume([this, handle, pool]() {
+            pool->QueueInLoop(handle, std::bind(&HttpServer::ResumeStream, this, std::placeholders::_1));
+        });
+        if (_compress_enabled && context->Request()._method != "HEAD")
+            stream->SetCompression(&_compress, Compressor::Negotiate(context->Request().GetHeader("Accept-Encoding")));
+        context->SetStream(stream);
+        route->handler(context->Request(), stream);
+    }
+
+    // 返回 false 表示流式请求尚未结束，缓冲区中的数据留待之后处理
+    bool FeedStream(Connection *, HttpContext *context, Buffer *buffer)
+    {
+        std::shared_ptr<HttpStream> stream = context->Stream(); // 回调中可能被替换
+        if (!stream->Finished())
+            stream->Feed(buffer);
+        if (!stream->Finished())
+            return false;
+        if (stream->CloseAfter())
+        {
+            buffer->MoveReadOffset(buffer->ReadAbleSize()); // 连接即将关闭，丢弃剩余数据
+            return false;
+        }
+        context->SetStream(nullptr);
+        context->ReSet();
+        return true;
+    }
+
+    void ResumeStream(Connection *conn)
+    {
+        HttpContext *context = conn->GetContext()->Get<HttpContext>();
+        if (context->Stream() && !FeedStream(conn, context, conn->InBuffer()))
+            return;
+        if (conn->InBuffer()->ReadAbleSize() > 0)
+            OnMessage(conn, conn->InBuffer());
+    }
+
+    const ProxyEntry *ProxyRoute(HttpRequest &req)
+    {
+        for (auto &route : _proxy_route)
+        {
+            if (std::regex_match(req._path, req._matches, route.pattern))
+                return &route;
+        }
+        return nullptr;
+    }
+
+    // 请求交给代理会话，转发结束(连接保持时)后在下一轮继续处理缓冲区中的后续请求
+    void StartProxy(Connection *conn, HttpContext *context, const ProxyEntry *route)
+    {
+        if (!context->GetProxy())
+        {
+            std::shared_ptr<ProxySession> session = std::make_shared<ProxySession>(conn);
+            ConnHandle handle = conn->Handle();
+            ConnectionPool *pool = conn->Pool();
+            session->SetResume([this, handle, pool]() {
+                pool->QueueInLoop(handle, std::bind(&HttpServer::ResumeProxy, this, std::placeholders::_1));
+            });
+            context->SetProxy(session);
+        }
+        std::shared_ptr<ProxySession> session = context->GetProxy();
+        session->Start(route->proxy.get(), context->Request(), conn->Pool()->Draining());
+        context->ReSet();
+    }
+
+    void ResumeProxy(Connection *conn)
+    {
+        if (conn->InBuffer()->ReadAbleSize() > 0)
+            OnMessage(conn, conn->InBuffer());
+    }
+
+    // 请求命中的 WebSocket 路由：GET、带 Upgrade: websocket 且路径匹配
+    const WebSocketEntry *WebSocketRouteFor(HttpRequest &req)
+    {
+        if (req._method != "GET" || strcasecmp(req.GetHeader("Upgrade").c_str(), "websocket") != 0)
+            return nullptr;
+        for (auto &route : _ws_route)
+        {
+            if (std::regex_match(req._path, req._matches, route.pattern))
+                return &route;
+        }
+        return nullptr;
+    }
+
+    // 校验握手并回 101，之后连接上的数据都按帧解析；握手失败时回错误响应并关闭连接
+    void Upgrade(Connection *conn, HttpContext *context, const WebSocketEntry *route)
+    {
+        HttpRequest &req = context->Request();
+        HttpResponse rsp(101);
+        std::string key = req.GetHeader("Sec-WebSocket-Key");
+        if (req._version != "HTTP/1.1" || !Util::HasToken(req.GetHeader("Connection"), "upgrade") || key.size() != 24 ||
+            req.ContentLength() > 0 || conn->Pool()->Draining())
+            rsp._statu = conn->Pool()->Draining() ? 503 : 400;
+        else if (req.GetHeader("Sec-WebSocket-Version") != "13")
+        {
+            rsp._statu = 426;
+            rsp.SetHeader("Sec-WebSocket-Version", "13");
+        }
+        if (rsp._statu != 101)
+        {
+            ErrorHandler(req, &rsp);
+            rsp.SetHeader("Connection", "close");
+            WriteReponse(conn, req, rsp);
+            context->ReSet();
+            conn->InBuffer()->MoveReadOffset(conn->InBuffer()->ReadAbleSize());
+            conn->Shutdown();
+            return;
+        }
+        // 子协议：按客户端给出的顺序选第一个服务端支持的
+        std::string protocol;
+        std::vector<std::string> offered;
+        Util::Split(req.GetHeader("Sec-WebSocket-Protocol"), ",", &offered);
+        for (auto &p : offered)
+        {
+            for (auto &supported : route->options.protocols)
+            {
+                if (protocol.empty() && Util::HasToken(p, supported.c_str()))
+                    protocol = supported;
+            }
+        }
+        std::string head = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n";
+        head += "Sec-WebSocket-Accept: " + WebSocket::AcceptKey(key) + "\r\n";
+        if (!protocol.empty())
+            head += "Sec-WebSocket-Protocol: " + protocol + "\r\n";
+        head += "\r\n";
+        conn->Send(head.data(), head.size());
+        std::shared_ptr<WebSocket> ws = std::make_shared<WebSocket>(conn, &route->options, protocol);
+        context->SetWebSocket(ws);
+        route->handler(req, ws);
+        context->ReSet();
+        ws->StartKeepalive();
+    }
+
+    void OnConnected(Connection *conn)
+    {
+        HttpContext context;
+        if (_cache_budget > 0)
+            context.SetCache(CacheFor(conn->Loop()));
+        conn->SetContext(context);
+        conn->SetLowWaterMarkCallBack(std::bind(&HttpServer::OnWritable, this, std::placeholders::_1));
+    }
+
+    void OnWritable(Connection *conn)
+    {
+        HttpContext *context = conn->GetContext()->Get<HttpContext>();
+        if (context->Stream())
+            context->Stream()->HandleWritable();
+        else if (context->GetWebSocket())
+            context->GetWebSocket()->HandleWritable();
+        else if (context->GetProxy())
+            context->GetProxy()->HandleWritable();
+    }
+
+    void OnClosed(Connection *conn)
+    {
+        if (conn->GetContext()->Empty())
+            return;
+        HttpContext *context = conn->GetContext()->Get<HttpContext>();
+        if (context->Stream())
+            context->Stream()->HandleClose();
+        else if (context->GetWebSocket())
+            context->GetWebSocket()->HandleClose();
+        else if (context->GetProxy())
+            context->GetProxy()->HandleClose();
+    }
+
+    // 一次可能到达多个请求(流水线)，循环处理
+    void OnMessage(Connection *conn, Buffer *buffer)
+    {
+        while (buffer->ReadAbleSize() > 0)
+        {
+            HttpContext *context = conn->GetContext()->Get<HttpContext>();
+            if (context->GetWebSocket())
+            {
+                std::shared_ptr<WebSocket> ws = context->GetWebSocket(); // 回调中可能关闭连接
+                return ws->Feed(buffer);
+            }
+            if (context->Pending())
+                return; // 上一个请求还在计算线程池中，数据留在缓冲区
+            if (context->GetProxy() && context->GetProxy()->Active())
+            {
+                std::shared_ptr<ProxySession> proxy = context->GetProxy();
+                return proxy->OnClientData(); // 请求体，后续请求等转发结束
+            }
+            if (context->Stream())
+            {
+                if (!FeedStream(conn, context, buffer))
+                    return;
+                continue;
+            }
+            if (!_stream_route.empty() || !_ws_route.empty() || !_proxy_route.empty())
+            {
+                context->RecvHttpRequestHead(buffer);
+                const ProxyEntry *proxy_route = nullptr;
+                if (context->RecvStatu() == RECV_HTTP_BODY && (proxy_route = ProxyRoute(context->Request())) != nullptr)
+                    return StartProxy(conn, context, proxy_route);
+                const WebSocketEntry *ws_route = nullptr;
+                if (context->RecvStatu() == RECV_HTTP_BODY && (ws_route = WebSocketRouteFor(context->Request())) != nullptr)
+                {
+                    Upgrade(conn, context, ws_route);
+                    continue;
+                }
+                const StreamEntry *route = nullptr;
+                if (context->RecvStatu() == RECV_HTTP_BODY && (route = StreamRoute(context->Request())) != nullptr)
+                {
+                    StartStream(conn, context, route);
+                    if (!FeedStream(conn, context, buffer)) // 没有请求体时在这里结束请求体
+                        return;
+                    continue;
+                }
+            }
+            context->RecvHttpRequest(buffer);
+            HttpRequest &req = context->Request();
+            HttpResponse rsp(context->RespStatu());
+            if (context->RespStatu() >= 400)
+            {
+                // 请求格式错误：返回错误页面并关闭连接，剩余数据不再处理
+                ErrorHandler(req, &rsp);
+                rsp.SetHeader("Connection", "close");
+                WriteReponse(conn, req, rsp);
+                context->ReSet();
+                buffer->MoveReadOffset(buffer->ReadAbleSize());
+                conn->Shutdown();
+                return;
+            }
+            if (context->RecvStatu() != RECV_HTTP_OVER)
+                return; // 请求不完整，等待新数据
+            if (ReplyFromCache(conn, context, req))
+            {
+                context->ReSet();
+                continue;
+            }
+            const RouteEntry *route = OffloadRoute(req);
+            if (route != nullptr)
+            {
+                if (Offload(conn, context, route))
+                    return;
+                // 计算线程池已满，降级为 503
+                rsp._statu = 503;
+                rsp.SetHeader("Retry-After", "1");
+            }
+            else
+                Route(req, &rsp);
+            if (rsp._statu >= 400 && rsp._body.empty())
+                ErrorHandler(req, &rsp);
+            if (ShouldCompress(req, rsp))
+            {
+                if (OffloadCompress(conn, context, rsp))
+                    return;
+                CompressResponse(req, &rsp);
+            }
+            WriteReponse(conn, req, rsp);
+            context->ReSet();
+            if (rsp.Close() == true)
+            {
+                buffer->MoveReadOffset(buffer->ReadAbleSize());
+                conn->Shutdown();
+                return;
+            }
+        }
+    }
+
+private:
+    Handlers _get_route;
+    Handlers _post_route;
+    Handlers _put_route;
+    Handlers _delete_route;
+    std::vector<StreamEntry> _stream_route;
+    std::vector<WebSocketEntry> _ws_route;
+    std::vector<ProxyEntry> _proxy_route;
+    std::string _basedir; // 静态资源根目录
+    TcpServer _server;
+    size_t _cache_budget; // 0 表示未开启响应缓存
+    uint32_t _cache_ttl;
+    std::vector<std::string> _cache_vary;
+    std::mutex _cache_mutex; // 只保护 _caches 的增删，分片本身只在所属线程中访问
+    std::unordered_map<EventLoop *, std::unique_ptr<ResponseCache>> _caches;
+    bool _compress_enabled;
+    CompressOptions _compress;
+    std::unique_ptr<ComputePool> _compute; // 最后声明，析构时先停止工作线程
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "../server.hpp"
+
+#define RPC_MAX_FRAME (16 * 1024 * 1024) // 单帧上限，超出视为协议错误
+#define RPC_SCRATCH_RETAIN (1024 * 1024) // 回复缓冲区超过该容量时在本批次后释放
+
+// ================================================================
+//                            Codec模块
+// ================================================================
+// 分帧：从输入缓冲区的可读数据开头识别一帧，帧数据直接指向缓冲区(不拷贝)；
+// 编码：回复体已写入缓冲区，在其前面原地补上帧头。
+// 同一个编解码器被所有从属Reactor共享，实现不能保存连接相关的状态
+typedef enum
+{
+    FRAME_INCOMPLETE, // 数据不足，等待更多数据
+    FRAME_COMPLETE,
+    FRAME_ERROR // 帧格式错误，连接将被关闭
+} FrameStatu;
+
+struct Frame
+{
+    const char *body;   // 帧体，指向输入缓冲区，只在本帧处理期间有效
+    size_t body_len;
+    size_t frame_len;   // 帧头 + 帧体，处理完后从缓冲区中消费的长度
+
+    Frame()
+        : body(nullptr), body_len(0), frame_len(0)
+    { }
+};
+
+class FrameCodec
+{
+public:
+    virtual ~FrameCodec() { }
+    // 识别一帧，不移动读指针
+    virtual FrameStatu Decode(Buffer *buf, Frame *frame) = 0;
+    // buf 的可读数据为回复体，在前面补上帧头
+    virtual void Encode(Buffer *buf) = 0;
+};
+
+// 定长长度字段 + 帧体，长度为网络字节序、不含长度字段本身
+class LengthFieldCodec : public FrameCodec
+{
+public:
+    LengthFieldCodec(int field_size = 4, size_t max_frame = RPC_MAX_FRAME)
+        : _field_size(field_size), _max_frame(max_frame)
+    {
+        assert(field_size == 1 || field_size == 2 || field_size == 4 || field_size == 8);
+    }
+
+    virtual FrameStatu Decode(Buffer *buf, Frame *frame)
+    {
+        if (buf->ReadAbleSize() < (uint64_t)_field_size)
+            return FRAME_INCOMPLETE;
+        uint64_t len = PeekLength(buf);
+        if (len > _max_frame)
+            return FRAME_ERROR;
+        if (buf->ReadAbleSize() < _field_size + len)
+            return FRAME_INCOMPLETE;
+        frame->body = buf->ReadPos() + _field_size;
+        frame->body_len = len;
+        frame->frame_len = _field_size + len;
+        return FRAME_COMPLETE;
+    }
+
+    virtual void Encode(Buffer *buf)
+    {
+        uint64_t len = buf->ReadAbleSize();
+        assert(_field_size == 8 || len < (1ULL << (8 * _field_size)));
+        switch (_field_size)
+        {
+        case 1:
+            return buf->PrependInt8((uint8_t)len);
+        case 2:
+            return buf->PrependInt16((uint16_t)len);
+        case 4:
+            return buf->PrependInt32((uint32_t)len);
+        default:
+            return buf->PrependInt64(len);
+        }
+    }
+
+private:
+    uint64_t PeekLength(Buffer *buf)
+    {
+        switch (_field_size)
+        {
+        case 1:
+            return buf->PeekInt8();
+        case 2:
+            return buf->PeekInt16();
+        case 4:
+            return buf->PeekInt32();
+        default:
+            return buf->PeekInt64();
+        }
+    }
+
+private:
+    int _field_size;
+    size_t _max_frame;
+};
+
+// ================================================================
+//                            RpcServer模块
+// ================================================================
+// 请求/响应式二进制协议服务器：一次读事件中到达的所有完整帧依次交给处理函数，
+// 各帧的回复编码后拼成一块，处理完本批次再一次性交给连接发送
+typedef enum
+{
+    RPC_REPLY,    // 把 reply 中的数据(可以为空)作为回复发送
+    RPC_NO_REPLY, // 单向消息
+    RPC_CLOSE     // 发送回复后关闭连接，后续的帧不再处理(不要在处理函数中直接 Shutdown，本批次的回复会丢失)
+} RpcAction;
+
+class RpcServer
+{
+public:
+    using Handler = std::function<RpcAction(Connection *, const char *, size_t, Buffer *)>;
+
+    RpcServer(uint16_t port, const std::string &ip = "0.0.0.0", const SocketOptions &opts = SocketOptions::LowLatencyRpc())
+        : _server(port, ip, opts), _codec(new LengthFieldCodec())
+    {
+        _server.SetMessageCallBack(std::bind(&RpcServer::OnMessage, this, std::placeholders::_1, std::placeholders::_2));
+        _server.SetIdlePredicate(std::bind(&RpcServer::IsIdle, std::placeholders::_1));
+    }
+
+    // 替换编解码器(须在 Start 之前调用)
+    void SetCodec(const std::shared_ptr<FrameCodec> &codec)
+    {
+        _codec = codec;
+    }
+    void SetHandler(const Handler &handler)
+    {
+        _handler = handler;
+    }
+    void SetThreadCount(int count)
+    {
+        _server.SetThreadCount(count);
+    }
+    TcpServer &GetTcpServer()
+    {
+        return _server;
+    }
+    // 运行直到优雅关闭完成
+    void Start()
+    {
+        _server.Start();
+    }
+    void Shutdown(uint32_t deadline = DEFAULT_DRAIN_DEADLINE)
+    {
+        _server.Shutdown(deadline);
+    }
+
+private:
+    // 空闲：没有接收到一半的帧，回复已发送完
+    static bool IsIdle(Connection *conn)
+    {
+        return conn->InBuffer()->ReadAbleSize() == 0 && conn->PendingOutput() == 0;
+    }
+
+    void OnMessage(Connection *conn, Buffer *buf)
+    {
+        // Shutdown 会用剩余数据再调用一次本函数，此时不再处理
+        if (!conn->Connected())
+            return;
+        static thread_local Buffer batch; // 本批次的回复
+        static thread_local Buffer reply; // 单个回复，帧头前插到回复体前面
+        batch.Clear();
+        while (conn->Connected())
+        {
+            Frame frame;
+            FrameStatu statu = _codec->Decode(buf, &frame);
+            if (statu == FRAME_INCOMPLETE)
+                break;
+            if (statu == FRAME_ERROR)
+            {
+                DBG_LOG("Bad frame, close fd:%d", conn->GetFd());
+                buf->MoveReadOffset(buf->ReadAbleSize());
+                Flush(conn, &batch);
+                conn->Shutdown();
+                return;
+            }
+            reply.Clear();
+            RpcAction action = _handler ? _handler(conn, frame.body, frame.body_len, &reply) : RPC_NO_REPLY;
+            buf->MoveReadOffset(frame.frame_len);
+            if (action != RPC_NO_REPLY)
+            {
+                _codec->Encode(&reply);
+                batch.WriteBufferAndConsume(reply);
+            }
+            if (action == RPC_CLOSE)
+            {
+                buf->MoveReadOffset(buf->ReadAbleSize());
+                Flush(conn, &batch);
+                conn->Shutdown();
+                return;
+            }
+        }
+        Flush(conn, &batch);
+        reply.Shrink(RPC_SCRATCH_RETAIN);
+        batch.Shrink(RPC_SCRATCH_RETAIN);
+    }
+
+    void Flush(Connection *conn, Buffer *batch)
+    {
+        if (batch->ReadAbleSize() > 0)
+            conn->Send(batch->ReadPos(), batch->ReadAbleSize());
+        batch->Clear();
+    }
+
+private:
+    TcpServer _server;
+    std::shared_ptr<FrameCodec> _codec;
+    Handler _handler;
+};
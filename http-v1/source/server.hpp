@@ -1,3 +1,5 @@
+#pragma once
+
 #define INF 0
 #define DBG 1
 #define ERR 2
@@ -18,798 +20,5940 @@
 #define ERR_LOG(format, ...) LOG(ERR, format, ##__VA_ARGS__);
 
 #include <unordered_map>
+#include <typeinfo>
+#include <type_traits>
 #include <functional>
 #include <algorithm>
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <cstddef>
 #include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <map>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
 #include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include <arpa/inet.h>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/un.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <endian.h>
+#include <execinfo.h>
 #include <pthread.h>
+#include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 // ================================================================
-//                            Buffer模块
+//                            Metrics模块
 // ================================================================
-#define DEFAULT_BUFFER_SIZE 1024
+// 每个EventLoop一份指标，只由所属线程写入，导出线程无锁读取：
+//   - LoopMetrics 按缓存行对齐分配，不同线程的指标不会伪共享
+//   - 单写者使用 relaxed load + store 累加，不需要带 lock 前缀的原子读改写
+//   - 对象由注册表持有且永不释放，EventLoop 销毁后槽位退役并可被新的 EventLoop 复用
+#define CACHELINE_SIZE 64
+#define MAX_METRIC_LOOPS 256
+#define METRIC_HIST_BUCKETS 24 // 2^0 ~ 2^22 以及 +Inf
 
-class Buffer
+inline void RelaxedAdd(std::atomic<uint64_t> &v, uint64_t n)
+{
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class MetricCounter
 {
 public:
-    Buffer()
-        : _buffer(DEFAULT_BUFFER_SIZE), _reader_idx(0), _writer_idx(0)
+    MetricCounter()
+        : _value(0)
+    { }
+    void Add(uint64_t n = 1)
     {
+        RelaxedAdd(_value, n);
     }
-
-    // 返回底层缓冲区起始地址
-    char *Begin()
+    void Set(uint64_t v)
     {
-        return _buffer.data();
+        _value.store(v, std::memory_order_relaxed);
     }
-
-    // 当前写指针位置
-    char *WritePos()
+    uint64_t Get() const
     {
-        return Begin() + _writer_idx;
+        return _value.load(std::memory_order_relaxed);
     }
 
-    // 当前读指针位置
-    char *ReadPos()
+private:
+    std::atomic<uint64_t> _value;
+};
+
+// 以 2 的幂为桶边界的直方图：桶 i 统计 (2^(i-1), 2^i] 内的值
+class MetricHistogram
+{
+public:
+    MetricHistogram()
     {
-        return Begin() + _reader_idx;
+        for (int i = 0; i < METRIC_HIST_BUCKETS; i++)
+            _buckets[i].store(0, std::memory_order_relaxed);
+    }
+    void Observe(uint64_t v)
+    {
+        int idx = v <= 1 ? 0 : 64 - __builtin_clzll(v - 1);
+        if (idx >= METRIC_HIST_BUCKETS)
+            idx = METRIC_HIST_BUCKETS - 1;
+        RelaxedAdd(_buckets[idx], 1);
+        _count.Add(1);
+        _sum.Add(v);
+    }
+    uint64_t Bucket(int i) const
+    {
+        return _buckets[i].load(std::memory_order_relaxed);
+    }
+    uint64_t Count() const
+    {
+        return _count.Get();
+    }
+    uint64_t Sum() const
+    {
+        return _sum.Get();
     }
 
-    // 尾部剩余可写空间大小
-    uint64_t TailIdleSize()
+private:
+    std::atomic<uint64_t> _buckets[METRIC_HIST_BUCKETS];
+    MetricCounter _count;
+    MetricCounter _sum;
+};
+
+// 事件循环当前正在执行的位置，供看门狗线程读取(只由所属线程写入)
+struct LoopProbe
+{
+    std::atomic<uint64_t> iter_begin_us; // 本轮循环开始时间，阻塞在 epoll_wait 中时为 0
+    std::atomic<uint64_t> iter_seq;      // 循环轮次，看门狗据此对同一次卡顿只上报一次
+    std::atomic<int> fd;                 // 正在执行的回调所属描述符(任务为 -1)
+    std::atomic<int> kind;               // 正在执行的回调类型(CallbackKind)
+    pthread_t tid;                       // 事件循环线程，用于投递栈采样信号
+
+    LoopProbe()
+        : iter_begin_us(0), iter_seq(0), fd(-1), kind(0), tid(0)
+    { }
+};
+
+struct LoopMetrics
+{
+    int id; // 注册表槽位，导出时作为 loop 标签
+    MetricCounter polls;           // epoll_wait 次数
+    MetricCounter events;          // 就绪事件总数
+    MetricCounter tasks;           // 执行的任务数
+    MetricCounter task_queue_depth; // 最近一次取出的任务队列长度
+    MetricCounter accepts;         // 接受的连接数
+    MetricCounter accept_shed;     // 描述符耗尽被拒绝的连接数
+    MetricCounter bytes_in;
+    MetricCounter bytes_out;
+    MetricCounter buffer_grows;    // Buffer 扩容次数
+    MetricCounter timer_fires;     // 时间轮中到期执行的定时任务数
+    MetricCounter conn_opened;
+    MetricCounter conn_closed;
+    MetricCounter slow_callbacks;  // 超出预算的回调/任务数
+    MetricCounter stalls;          // 看门狗检测到的循环卡顿次数
+    MetricCounter spin_hits;       // 忙轮询期间等到事件的次数
+    MetricCounter spin_misses;     // 忙轮询超时转为阻塞等待的次数
+    MetricCounter spin_budget_us;  // 当前忙轮询时长
+    MetricCounter arena_bytes;     // Arena 已映射字节数
+    MetricCounter arena_local_pages;  // 最近一次检查时位于本地节点的页数
+    MetricCounter arena_remote_pages; // 最近一次检查时位于远端节点的页数
+    MetricHistogram events_per_poll;
+    MetricHistogram iteration_us;  // 单轮循环耗时(微秒)
+    MetricHistogram task_depth;    // 每轮任务队列长度分布
+    LoopProbe probe;
+    char _pad[CACHELINE_SIZE];     // 尾部填充，避免与相邻分配共享缓存行
+
+    // 当前线程所属 EventLoop 的指标(不在事件循环线程中时为 nullptr)
+    static LoopMetrics *&Current()
     {
-        return _buffer.size() - _writer_idx;
+        static thread_local LoopMetrics *current = nullptr;
+        return current;
     }
+};
 
-    // 头部已读但尚未复用的空间大小
-    uint64_t HeadIdleSize()
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &Instance()
     {
-        return _reader_idx;
+        static MetricsRegistry registry;
+        return registry;
     }
 
-    // 当前可读数据大小
-    uint64_t ReadAbleSize()
+    // 分配一份指标(仅在创建 EventLoop 时调用，加锁不影响导出)
+    LoopMetrics *Register()
     {
-        return _writer_idx - _reader_idx;
+        std::unique_lock<std::mutex> lock(_mtx);
+        for (int i = 0; i < MAX_METRIC_LOOPS; i++)
+        {
+            if (_in_use[i])
+                continue;
+            LoopMetrics *m = _slots[i].load(std::memory_order_acquire);
+            if (m == nullptr)
+            {
+                void *mem = nullptr;
+                if (posix_memalign(&mem, CACHELINE_SIZE, sizeof(LoopMetrics)) != 0)
+                    abort();
+                m = new (mem) LoopMetrics();
+                m->id = i;
+                _slots[i].store(m, std::memory_order_release);
+            }
+            _in_use[i] = true;
+            return m;
+        }
+        ERR_LOG("Too many event loops for metrics registry");
+        abort();
     }
 
-    // 向后移动读指针（消费数据）
-    void MoveReadOffset(uint64_t len)
+    // EventLoop 销毁时退役，计数保留(Prometheus 计数器单调递增)
+    void Retire(LoopMetrics *m)
     {
-        _reader_idx += len;
+        std::unique_lock<std::mutex> lock(_mtx);
+        _in_use[m->id] = false;
     }
 
-    // 向后移动写指针（写入完成后调用）
-    void MoveWriteOffset(uint64_t len)
+    // 按槽位读取指标(未分配时为 nullptr)，不加锁
+    LoopMetrics *Slot(int i)
     {
-        // 写入空间应已由 EnsureWriteSpace 保证
-        assert(len <= TailIdleSize());
-        _writer_idx += len;
+        return _slots[i].load(std::memory_order_acquire);
     }
 
-    // 确保至少有 len 字节可写空间
-    // 优先复用头部空间，其次进行扩容
-    void EnsureWriteSpace(uint64_t len)
+    // 导出为 Prometheus 文本格式，只读取原子变量，不加锁
+    std::string ExportPrometheus()
     {
-        // 尾部空间足够，直接写
-        if (len <= TailIdleSize())
-            return;
+        std::vector<LoopMetrics *> loops;
+        for (int i = 0; i < MAX_METRIC_LOOPS; i++)
+        {
+            LoopMetrics *m = _slots[i].load(std::memory_order_acquire);
+            if (m != nullptr)
+                loops.push_back(m);
+        }
+        std::string out;
+        ExportCounter(out, loops, "reactor_polls_total", "epoll_wait calls", &LoopMetrics::polls, "counter");
+        ExportCounter(out, loops, "reactor_events_total", "ready events returned by epoll_wait", &LoopMetrics::events, "counter");
+        ExportCounter(out, loops, "reactor_tasks_total", "queued tasks executed", &LoopMetrics::tasks, "counter");
+        ExportCounter(out, loops, "reactor_task_queue_depth", "task queue length at last drain", &LoopMetrics::task_queue_depth, "gauge");
+        ExportCounter(out, loops, "reactor_accepts_total", "accepted connections", &LoopMetrics::accepts, "counter");
+        ExportCounter(out, loops, "reactor_accept_shed_total", "connections shed on fd exhaustion", &LoopMetrics::accept_shed, "counter");
+        ExportCounter(out, loops, "reactor_bytes_in_total", "bytes received", &LoopMetrics::bytes_in, "counter");
+        ExportCounter(out, loops, "reactor_bytes_out_total", "bytes sent", &LoopMetrics::bytes_out, "counter");
+        ExportCounter(out, loops, "reactor_buffer_grows_total", "buffer reallocations", &LoopMetrics::buffer_grows, "counter");
+        ExportCounter(out, loops, "reactor_timer_fires_total", "timer expirations", &LoopMetrics::timer_fires, "counter");
+        ExportCounter(out, loops, "reactor_connections_opened_total", "connections opened", &LoopMetrics::conn_opened, "counter");
+        ExportCounter(out, loops, "reactor_connections_closed_total", "connections closed", &LoopMetrics::conn_closed, "counter");
+        ExportCounter(out, loops, "reactor_slow_callbacks_total", "callbacks and tasks over budget", &LoopMetrics::slow_callbacks, "counter");
+        ExportCounter(out, loops, "reactor_stalls_total", "loop iterations flagged by the watchdog", &LoopMetrics::stalls, "counter");
+        ExportCounter(out, loops, "reactor_spin_hits_total", "busy-poll rounds that found events", &LoopMetrics::spin_hits, "counter");
+        ExportCounter(out, loops, "reactor_spin_misses_total", "busy-poll rounds that fell back to blocking", &LoopMetrics::spin_misses, "counter");
+        ExportCounter(out, loops, "reactor_spin_budget_us", "current busy-poll budget in microseconds", &LoopMetrics::spin_budget_us, "gauge");
+        ExportCounter(out, loops, "reactor_arena_bytes", "bytes mapped by the loop arena", &LoopMetrics::arena_bytes, "gauge");
+        ExportCounter(out, loops, "reactor_arena_local_pages", "arena pages on the loop's node at last check", &LoopMetrics::arena_local_pages, "gauge");
+        ExportCounter(out, loops, "reactor_arena_remote_pages", "arena pages on other nodes at last check", &LoopMetrics::arena_remote_pages, "gauge");
 
-        // 通过前移可读数据复用空间
-        if (len <= TailIdleSize() + HeadIdleSize())
+        out += "# HELP reactor_connections active connections\n# TYPE reactor_connections gauge\n";
+        for (auto m : loops)
         {
-            uint64_t readable = ReadAbleSize();
-            std::memmove(Begin(), ReadPos(), readable);
-            /*
-             * 这里使用memmove而不使用memcpy或copy
-             * “memmove 和 memcpy 的区别在于是否支持内存重叠。在我的 Buffer 实现中，
-             * 需要在同一块缓冲区内把可读数据整体前移复用空间，这属于典型的重叠拷贝场景，
-             * 所以必须使用 memmove，否则行为是未定义的。”
-             */
-            _reader_idx = 0;
-            _writer_idx = readable;
+            uint64_t opened = m->conn_opened.Get(), closed = m->conn_closed.Get();
+            out += "reactor_connections{loop=\"" + std::to_string(m->id) + "\"} " +
+                   std::to_string(opened > closed ? opened - closed : 0) + "\n";
         }
-        else
+        ExportHistogram(out, loops, "reactor_events_per_poll", "ready events per epoll_wait", &LoopMetrics::events_per_poll);
+        ExportHistogram(out, loops, "reactor_loop_iteration_us", "event loop iteration time in microseconds", &LoopMetrics::iteration_us);
+        ExportHistogram(out, loops, "reactor_task_queue_depth_per_iteration", "tasks drained per iteration", &LoopMetrics::task_depth);
+        return out;
+    }
+
+private:
+    MetricsRegistry()
+    {
+        for (int i = 0; i < MAX_METRIC_LOOPS; i++)
         {
-            // 扩容：采用倍增策略，减少频繁 realloc
-            uint64_t new_size = _buffer.size();
-            uint64_t need_size = _writer_idx + len;
+            _slots[i].store(nullptr, std::memory_order_relaxed);
+            _in_use[i] = false;
+        }
+    }
 
-            while (new_size < need_size)
+    static void ExportCounter(std::string &out, const std::vector<LoopMetrics *> &loops, const char *name,
+                              const char *help, MetricCounter LoopMetrics::*field, const char *type)
+    {
+        out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+        for (auto m : loops)
+            out += std::string(name) + "{loop=\"" + std::to_string(m->id) + "\"} " + std::to_string((m->*field).Get()) + "\n";
+    }
+
+    static void ExportHistogram(std::string &out, const std::vector<LoopMetrics *> &loops, const char *name,
+                                const char *help, MetricHistogram LoopMetrics::*field)
+    {
+        out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " histogram\n";
+        for (auto m : loops)
+        {
+            const MetricHistogram &h = m->*field;
+            std::string loop = "loop=\"" + std::to_string(m->id) + "\"";
+            uint64_t cumulative = 0;
+            for (int i = 0; i < METRIC_HIST_BUCKETS - 1; i++)
             {
-                new_size *= 2;
+                cumulative += h.Bucket(i);
+                out += std::string(name) + "_bucket{" + loop + ",le=\"" + std::to_string(1ULL << i) + "\"} " +
+                       std::to_string(cumulative) + "\n";
             }
-
-            _buffer.resize(new_size);
+            cumulative += h.Bucket(METRIC_HIST_BUCKETS - 1);
+            out += std::string(name) + "_bucket{" + loop + ",le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+            out += std::string(name) + "_sum{" + loop + "} " + std::to_string(h.Sum()) + "\n";
+            out += std::string(name) + "_count{" + loop + "} " + std::to_string(h.Count()) + "\n";
         }
     }
 
-    // 写入任意二进制数据
-    void Write(const void *data, uint64_t len)
-    {
-        // 允许空写
-        if (len == 0)
-            return;
+private:
+    std::mutex _mtx; // 只保护注册/退役
+    std::atomic<LoopMetrics *> _slots[MAX_METRIC_LOOPS];
+    bool _in_use[MAX_METRIC_LOOPS];
+};
 
-        // 非空写入必须保证数据指针有效
-        assert(data != nullptr);
+// ================================================================
+//                            Watchdog模块
+// ================================================================
+// 慢回调与事件循环卡顿检测：
+//   - CallbackScope 为每个 Channel 回调和任务计时，超出预算时记下描述符与回调类型
+//   - 看门狗线程周期检查各 EventLoop 本轮开始时间，超过阈值即向该线程投递信号，
+//     由卡住的线程在信号处理函数中 backtrace 采样自己的调用栈
+//   - 记录写入固定大小的环形缓冲区，Dump 时才做符号化(链接时加 -rdynamic 可显示函数名)
+#define STALL_RING_SIZE 256
+#define STALL_MAX_FRAMES 32
+#define STALL_SIGNAL SIGUSR2
+#define DEFAULT_CALLBACK_BUDGET_US 10000 // 单个回调/任务预算 10ms
+#define DEFAULT_STALL_THRESHOLD_MS 100   // 单轮循环超过 100ms 视为卡顿
 
-        EnsureWriteSpace(len);
+enum CallbackKind
+{
+    CB_NONE,
+    CB_READ,
+    CB_WRITE,
+    CB_ERROR,
+    CB_CLOSE,
+    CB_EVENT,
+    CB_TASK
+};
 
-        const char *d = static_cast<const char *>(data);
-        std::copy(d, d + len, WritePos());
+inline const char *CallbackKindName(int kind)
+{
+    static const char *names[] = {"none", "read", "write", "error", "close", "event", "task"};
+    if (kind < CB_NONE || kind > CB_TASK)
+        return "unknown";
+    return names[kind];
+}
 
-        MoveWriteOffset(len);
+inline uint64_t MonotonicMicros()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+struct StallRecord
+{
+    uint64_t when_us;    // 记录时间(单调时钟)
+    uint64_t elapsed_us; // 回调耗时，或检测到卡顿时本轮已持续的时间
+    int loop;            // 指标槽位
+    int fd;              // 回调所属描述符，任务为 -1
+    int kind;            // CallbackKind
+    bool stall;          // true: 看门狗检测到的卡顿  false: 回调结束后发现超预算
+    int depth;           // 栈帧数(仅卡顿记录)
+    void *frames[STALL_MAX_FRAMES];
+};
+
+class StallLog
+{
+public:
+    static StallLog &Instance()
+    {
+        static StallLog log;
+        return log;
     }
 
-    // 从缓冲区读取 len 字节到外部缓冲区
-    void Read(void *buf, uint64_t len)
+    // 只在超预算/卡顿时调用，加锁不影响正常路径
+    void Push(const StallRecord &rec)
     {
-        assert(len <= ReadAbleSize());
-        std::copy(ReadPos(), ReadPos() + len, static_cast<char *>(buf));
-        MoveReadOffset(len);
+        std::unique_lock<std::mutex> lock(_mtx);
+        _ring[_total % STALL_RING_SIZE] = rec;
+        _total++;
     }
 
-    // 写入字符串内容（不包含结尾 '\0'）
-    void WriteString(const std::string &data)
+    // 按时间先后返回环形缓冲区中保留的记录
+    std::vector<StallRecord> Snapshot()
     {
-        Write(data.c_str(), data.size());
+        std::unique_lock<std::mutex> lock(_mtx);
+        std::vector<StallRecord> out;
+        uint64_t begin = _total > STALL_RING_SIZE ? _total - STALL_RING_SIZE : 0;
+        for (uint64_t i = begin; i < _total; i++)
+            out.push_back(_ring[i % STALL_RING_SIZE]);
+        return out;
     }
 
-    // 将另一个 Buffer 的可读数据复制到当前 Buffer
-    // 不影响源 Buffer 状态
-    void WriteBuffer(Buffer &data)
+    // 累计记录数(含已被覆盖的)
+    uint64_t Total()
     {
-        Write(data.ReadPos(), data.ReadAbleSize());
+        std::unique_lock<std::mutex> lock(_mtx);
+        return _total;
     }
 
-    // 将另一个 Buffer 的可读数据写入并消费
-    void WriteBufferAndConsume(Buffer &data)
+    void Clear()
     {
-        uint64_t len = data.ReadAbleSize();
-        Write(data.ReadPos(), len);
-        data.MoveReadOffset(len);
+        std::unique_lock<std::mutex> lock(_mtx);
+        _total = 0;
     }
 
-    // 读取指定长度并以 string 形式返回
-    std::string ReadAsString(uint64_t len)
+    // 文本格式导出，卡顿记录附带符号化的调用栈
+    std::string Dump()
     {
-        assert(len <= ReadAbleSize());
-        std::string str;
-        str.resize(len);
-        Read(&str[0], len);
-        return str;
+        std::string out;
+        for (auto &rec : Snapshot())
+        {
+            char line[256];
+            snprintf(line, sizeof(line), "[%s] loop=%d fd=%d cb=%s elapsed_us=%llu at_us=%llu\n",
+                     rec.stall ? "stall" : "slow", rec.loop, rec.fd, CallbackKindName(rec.kind),
+                     (unsigned long long)rec.elapsed_us, (unsigned long long)rec.when_us);
+            out += line;
+            if (rec.depth <= 0)
+                continue;
+            char **symbols = backtrace_symbols(rec.frames, rec.depth);
+            for (int i = 0; i < rec.depth; i++)
+            {
+                snprintf(line, sizeof(line), "    #%-2d %s\n", i, symbols ? symbols[i] : "?");
+                out += line;
+            }
+            free(symbols);
+        }
+        return out;
     }
 
-    // 查找当前可读区中的 '\n'
-    char *FindCRLF()
+private:
+    StallLog()
+        : _total(0)
+    { }
+
+private:
+    std::mutex _mtx;
+    StallRecord _ring[STALL_RING_SIZE];
+    uint64_t _total;
+};
+
+class LoopWatchdog
+{
+public:
+    static LoopWatchdog &Instance()
     {
-        void *res = memchr(ReadPos(), '\n', ReadAbleSize());
-        return static_cast<char *>(res);
+        static LoopWatchdog watchdog;
+        return watchdog;
     }
 
-    // 读取一行数据（包含 '\n'）
-    std::string GetLine()
+    // 单个回调/任务的耗时预算(微秒)，0 表示不检查
+    static void SetCallbackBudget(uint64_t us)
     {
-        char *pos = FindCRLF();
-        if (pos == nullptr)
-            return "";
-        return ReadAsString(pos - ReadPos() + 1);
+        Budget().store(us, std::memory_order_relaxed);
+    }
+    static uint64_t CallbackBudget()
+    {
+        return Budget().load(std::memory_order_relaxed);
     }
 
-    // 清空缓冲区（逻辑清空，不释放内存）
-    void Clear()
+    // 启动看门狗线程：任一 EventLoop 单轮超过 stall_ms 即采样其调用栈
+    void Start(uint64_t stall_ms = DEFAULT_STALL_THRESHOLD_MS)
     {
-        _reader_idx = 0;
-        _writer_idx = 0;
+        std::unique_lock<std::mutex> lock(_mtx);
+        if (_running)
+            return;
+        _stall_us = stall_ms * 1000;
+        // 首次 backtrace 会加载 libgcc 并分配内存，提前在普通上下文中完成
+        void *warm[1];
+        backtrace(warm, 1);
+        Sample();
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = &LoopWatchdog::OnSignal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(STALL_SIGNAL, &sa, nullptr);
+        _running = true;
+        _thread = std::thread(&LoopWatchdog::ThreadEntry, this);
     }
 
-    ~Buffer() {}
+    void Stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            if (!_running)
+                return;
+            _running = false;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
 
-private:
-    std::vector<char> _buffer; // 实际存储空间
-    uint64_t _reader_idx;      // 读指针
-    uint64_t _writer_idx;      // 写指针
-};
+    ~LoopWatchdog()
+    {
+        Stop();
+    }
 
-// ================================================================
-//                            Socket模块
-// ================================================================
-#define MAX_LISTEN 1024
+private:
+    // 信号处理函数与看门狗之间交换栈采样结果，gen 区分不同批次，迟到的采样不会被误用
+    struct StallSample
+    {
+        std::atomic<uint64_t> gen;
+        std::atomic<uint64_t> done;
+        int depth;
+        void *frames[STALL_MAX_FRAMES + 1];
+    };
 
-// Socket：对 TCP socket 的最小、正确、非阻塞封装
-// 职责：
-//   1. 封装系统调用（socket / bind / listen / accept / recv / send）
-//   2. 正确处理 errno 语义（EAGAIN / EINTR / peer closed）
-//   3. 不涉及任何业务逻辑、不做 Buffer 拼包
+    LoopWatchdog()
+        : _running(false), _stall_us(DEFAULT_STALL_THRESHOLD_MS * 1000)
+    { }
 
-class Socket
-{
-public:
-    // 构造一个无效 socket
-    Socket()
-        : _sockfd(-1)
+    static std::atomic<uint64_t> &Budget()
     {
+        static std::atomic<uint64_t> budget(DEFAULT_CALLBACK_BUDGET_US);
+        return budget;
     }
 
-    // 用已有 fd 构造（常用于 accept 之后）
-    Socket(int fd)
-        : _sockfd(fd)
+    static StallSample &Sample()
     {
+        static StallSample sample;
+        return sample;
     }
 
-    // 创建 TCP 套接字
-    bool CreateSocket()
+    // 运行在卡住的线程上，只做 backtrace 与原子写
+    static void OnSignal(int)
     {
-        // AF_INET      : IPv4
-        // SOCK_STREAM  : TCP
-        int fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (fd < 0)
-        {
-            ERR_LOG("Creat Socket ERR");
-            return false;
-        }
-        _sockfd = fd;
-        return true;
+        int saved = errno;
+        StallSample &s = Sample();
+        uint64_t gen = s.gen.load(std::memory_order_acquire);
+        s.depth = backtrace(s.frames, STALL_MAX_FRAMES + 1);
+        s.done.store(gen, std::memory_order_release);
+        errno = saved;
     }
 
-    // 绑定 IP + 端口
-    bool Bind(uint16_t port, const std::string &ip)
+    // 向目标线程投递信号并等待采样完成，返回栈帧数(去掉信号处理函数自身)
+    int Capture(pthread_t tid, void **frames)
     {
-        sockaddr_in server;
-        server.sin_family = AF_INET;
-        server.sin_port = htons(port); // 主机序 -> 网络序
-        server.sin_addr.s_addr = inet_addr(ip.c_str());
-
-        socklen_t len = sizeof(server);
-        int ret = bind(_sockfd, (const sockaddr *)&server, len);
-        if (ret < 0)
+        StallSample &s = Sample();
+        uint64_t gen = s.gen.load(std::memory_order_relaxed) + 1;
+        s.gen.store(gen, std::memory_order_release);
+        if (pthread_kill(tid, STALL_SIGNAL) != 0)
+            return 0;
+        for (int i = 0; i < 100; i++)
         {
-            ERR_LOG("Bind ERR");
-            return false;
+            if (s.done.load(std::memory_order_acquire) == gen)
+            {
+                int depth = s.depth > 1 ? s.depth - 1 : 0;
+                memcpy(frames, s.frames + 1, depth * sizeof(void *));
+                return depth;
+            }
+            usleep(500);
         }
-        return true;
+        return 0;
     }
 
-    // 监听套接字，进入 LISTEN 状态
-    bool Listen(int backlog = MAX_LISTEN)
+    void ThreadEntry()
     {
-        // backlog 是内核对半连接队列 / 全连接队列的容量提示
-        int ret = listen(_sockfd, backlog);
-        if (ret < 0)
+        std::vector<uint64_t> reported(MAX_METRIC_LOOPS, 0);
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (_running)
         {
-            ERR_LOG("Listen ERR");
-            return false;
+            uint64_t interval = std::max<uint64_t>(_stall_us / 4, 1000);
+            _cond.wait_for(lock, std::chrono::microseconds(interval));
+            if (!_running)
+                break;
+            lock.unlock();
+            Check(reported);
+            lock.lock();
         }
-        return true;
     }
 
-    // 接受新连接
-    // 返回值：
-    //   >=0 : 新连接 fd
-    //   -1  : 当前无可 accept 的连接（EAGAIN / EINTR），或系统错误
-    int Accept()
+    void Check(std::vector<uint64_t> &reported)
     {
-        // 非阻塞 listen fd 下，accept 可能频繁返回 EAGAIN
-        int fd = accept(_sockfd, nullptr, nullptr);
-        if (fd < 0)
+        uint64_t now = MonotonicMicros();
+        for (int i = 0; i < MAX_METRIC_LOOPS; i++)
         {
-            // 非异常情况：当前无连接或被信号中断
-            if (errno == EAGAIN || errno == EINTR)
-                return -1;
+            LoopMetrics *m = MetricsRegistry::Instance().Slot(i);
+            if (m == nullptr)
+                continue;
+            uint64_t begin = m->probe.iter_begin_us.load(std::memory_order_acquire);
+            if (begin == 0 || begin > now || now - begin < _stall_us)
+                continue;
+            // 同一轮循环只上报一次
+            uint64_t seq = m->probe.iter_seq.load(std::memory_order_relaxed) + 1;
+            if (reported[i] == seq)
+                continue;
+            reported[i] = seq;
 
-            // 真正的系统错误
-            ERR_LOG("Accept ERR");
-            return -1;
+            StallRecord rec;
+            memset(&rec, 0, sizeof(rec));
+            rec.when_us = now;
+            rec.elapsed_us = now - begin;
+            rec.loop = i;
+            rec.fd = m->probe.fd.load(std::memory_order_relaxed);
+            rec.kind = m->probe.kind.load(std::memory_order_relaxed);
+            rec.stall = true;
+            rec.depth = Capture(m->probe.tid, rec.frames);
+            m->stalls.Add(); // stalls 只由看门狗线程写入
+            StallLog::Instance().Push(rec);
+            ERR_LOG("Loop %d stalled %llu ms in %s callback, fd=%d", i,
+                    (unsigned long long)(rec.elapsed_us / 1000), CallbackKindName(rec.kind), rec.fd);
         }
-        return fd;
     }
 
-    // 客户端主动发起连接
-    bool Connect(uint16_t port, const std::string &ip)
+private:
+    std::mutex _mtx;
+    std::condition_variable _cond;
+    std::thread _thread;
+    bool _running;
+    uint64_t _stall_us;
+};
+
+// 在事件循环线程中为一次回调计时，并让看门狗知道当前正在执行什么
+class CallbackScope
+{
+public:
+    CallbackScope(int fd, int kind)
+        : _m(LoopMetrics::Current())
     {
-        sockaddr_in server;
-        server.sin_family = AF_INET;
-        server.sin_port = htons(port);
-        server.sin_addr.s_addr = inet_addr(ip.c_str());
+        if (_m == nullptr) // 不在事件循环线程中
+            return;
+        _prev_fd = _m->probe.fd.load(std::memory_order_relaxed);
+        _prev_kind = _m->probe.kind.load(std::memory_order_relaxed);
+        _m->probe.fd.store(fd, std::memory_order_relaxed);
+        _m->probe.kind.store(kind, std::memory_order_relaxed);
+        _begin = MonotonicMicros();
+    }
 
-        socklen_t len = sizeof(server);
-        int ret = connect(_sockfd, (const sockaddr *)&server, len);
-        if (ret < 0)
-        {
+    ~CallbackScope()
+    {
+        if (_m == nullptr)
+            return;
+        uint64_t cost = MonotonicMicros() - _begin;
+        uint64_t budget = LoopWatchdog::CallbackBudget();
+        if (budget != 0 && cost > budget)
+        {
+            StallRecord rec;
+            memset(&rec, 0, sizeof(rec));
+            rec.when_us = _begin + cost;
+            rec.elapsed_us = cost;
+            rec.loop = _m->id;
+            rec.fd = _m->probe.fd.load(std::memory_order_relaxed);
+            rec.kind = _m->probe.kind.load(std::memory_order_relaxed);
+            _m->slow_callbacks.Add();
+            StallLog::Instance().Push(rec);
+        }
+        _m->probe.fd.store(_prev_fd, std::memory_order_relaxed);
+        _m->probe.kind.store(_prev_kind, std::memory_order_relaxed);
+    }
+
+private:
+    LoopMetrics *_m;
+    int _prev_fd;
+    int _prev_kind;
+    uint64_t _begin;
+};
+
+// ================================================================
+//                            Arena模块
+// ================================================================
+// 每个EventLoop可选的本地内存区，用于Buffer存储与Connection对象：
+//   - 以 2MB 为单位向内核申请(mmap)，按 2 的幂大小分级，释放的块挂回对应空闲链表复用
+//   - 申请到的内存通过 mbind(MPOL_PREFERRED) 绑定到事件循环线程所在的 NUMA 节点
+//   - 可选透明大页(madvise)或显式大页(MAP_HUGETLB，失败时回退为透明大页)
+//   - 每块内存前有 16 字节头部记录所属 Arena，任意线程都可以释放；没有启用 Arena 的线程回退到全局 operator new
+//   - 使用 move_pages 查询页面实际所在节点，统计本地/远端页比例
+#define ARENA_CHUNK_SIZE (2 * 1024 * 1024)
+#define ARENA_MIN_SHIFT 6   // 最小分级 64B
+#define ARENA_MAX_SHIFT 20  // 最大分级 1MB，更大的申请单独映射
+#define ARENA_HEADER_SIZE 16
+#define ARENA_MPOL_PREFERRED 1
+
+enum ArenaHugePage
+{
+    HUGE_PAGE_NONE,
+    HUGE_PAGE_TRANSPARENT, // madvise(MADV_HUGEPAGE)
+    HUGE_PAGE_EXPLICIT     // MAP_HUGETLB，需预留大页
+};
+
+struct ArenaOptions
+{
+    bool numa_bind = true;                     // 绑定到当前线程所在节点
+    ArenaHugePage huge_page = HUGE_PAGE_NONE;
+};
+
+class LoopArena
+{
+public:
+    explicit LoopArena(const ArenaOptions &opts = ArenaOptions())
+        : _opts(opts), _node(CurrentNode()), _huge_page(opts.huge_page), _bump(nullptr), _bump_left(0),
+          _mapped(0), _in_use(0), _live(0), _orphaned(false), _metrics(LoopMetrics::Current())
+    {
+        for (int i = 0; i <= ARENA_MAX_SHIFT; i++)
+            _free[i] = nullptr;
+    }
+
+    // 当前线程所属事件循环的 Arena(未启用时为 nullptr)
+    static LoopArena *&Current()
+    {
+        static thread_local LoopArena *current = nullptr;
+        return current;
+    }
+
+    // 从当前线程的 Arena 申请，未启用时使用全局 operator new
+    static void *Allocate(size_t n)
+    {
+        LoopArena *arena = Current();
+        if (arena == nullptr)
+        {
+            Header *h = (Header *)::operator new(n + ARENA_HEADER_SIZE);
+            h->arena = nullptr;
+            return (char *)h + ARENA_HEADER_SIZE;
+        }
+        return arena->Alloc(n);
+    }
+
+    // 任意线程调用，归还到申请时所属的 Arena
+    static void Free(void *p)
+    {
+        if (p == nullptr)
+            return;
+        Header *h = (Header *)((char *)p - ARENA_HEADER_SIZE);
+        if (h->arena == nullptr)
+            return ::operator delete(h);
+        LoopArena *arena = h->arena;
+        if (arena->Release(h))
+            delete arena; // 事件循环已销毁且最后一块内存已归还
+    }
+
+    // 事件循环销毁时调用：仍有内存未归还则延迟到最后一次 Free 时释放
+    static void Retire(LoopArena *arena)
+    {
+        bool last;
+        {
+            std::unique_lock<std::mutex> lock(arena->_mtx);
+            arena->_orphaned = true;
+            arena->_metrics = nullptr;
+            last = arena->_live == 0;
+        }
+        if (last)
+            delete arena;
+    }
+
+    int Node()
+    {
+        return _node;
+    }
+    ArenaHugePage HugePage()
+    {
+        return _huge_page;
+    }
+    size_t MappedBytes()
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        return _mapped;
+    }
+    size_t InUseBytes()
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        return _in_use;
+    }
+
+    // 查询已映射页面实际所在的节点，返回本地页占比(无页面时为 1)
+    double LocalRatio(uint64_t *local = nullptr, uint64_t *remote = nullptr)
+    {
+        std::vector<void *> pages;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            long psz = sysconf(_SC_PAGESIZE);
+            for (auto &r : _regions)
+                for (size_t off = 0; off < r.second; off += psz)
+                    pages.push_back((char *)r.first + off);
+        }
+        uint64_t l = 0, rm = 0;
+        std::vector<int> status(pages.size());
+        if (!pages.empty() && syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) == 0)
+        {
+            for (int st : status)
+            {
+                if (st < 0) // 尚未访问过的页面
+                    continue;
+                if (st == _node)
+                    l++;
+                else
+                    rm++;
+            }
+        }
+        if (local)
+            *local = l;
+        if (remote)
+            *remote = rm;
+        std::unique_lock<std::mutex> lock(_mtx);
+        if (_metrics)
+        {
+            _metrics->arena_local_pages.Set(l);
+            _metrics->arena_remote_pages.Set(rm);
+        }
+        return l + rm == 0 ? 1.0 : (double)l / (l + rm);
+    }
+
+    // 文本报告：节点、大页模式、映射/使用量、页面分布
+    std::string Report()
+    {
+        static const char *huge[] = {"none", "transparent", "explicit"};
+        uint64_t local = 0, remote = 0;
+        double ratio = LocalRatio(&local, &remote);
+        char line[256];
+        snprintf(line, sizeof(line), "node=%d huge_page=%s mapped=%zu in_use=%zu local_pages=%llu remote_pages=%llu local_ratio=%.3f\n",
+                 _node, huge[_huge_page], MappedBytes(), InUseBytes(), (unsigned long long)local,
+                 (unsigned long long)remote, ratio);
+        return line;
+    }
+
+    // 当前线程运行所在的 NUMA 节点
+    static int CurrentNode()
+    {
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) < 0)
+            return 0;
+        return node;
+    }
+
+private:
+    struct Header
+    {
+        LoopArena *arena;
+        uint32_t shift; // 分级，0 表示单独映射
+        uint32_t size;  // 单独映射的长度(页数)
+    };
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    ~LoopArena()
+    {
+        for (auto &r : _regions)
+            munmap(r.first, r.second);
+    }
+
+    void *Alloc(size_t n)
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        uint32_t shift = ARENA_MIN_SHIFT;
+        while (shift <= ARENA_MAX_SHIFT && ((size_t)1 << shift) < n)
+            shift++;
+        Header *h;
+        if (shift > ARENA_MAX_SHIFT)
+        {
+            size_t len = RoundUp(n + ARENA_HEADER_SIZE);
+            h = (Header *)Map(len);
+            h->shift = 0;
+            h->size = len / sysconf(_SC_PAGESIZE);
+            _in_use += len;
+        }
+        else
+        {
+            size_t slot = ((size_t)1 << shift) + ARENA_HEADER_SIZE;
+            if (_free[shift] != nullptr)
+            {
+                h = (Header *)_free[shift];
+                _free[shift] = _free[shift]->next;
+            }
+            else
+            {
+                if (_bump_left < slot)
+                {
+                    _bump = (char *)Map(ARENA_CHUNK_SIZE);
+                    _bump_left = ARENA_CHUNK_SIZE;
+                }
+                h = (Header *)_bump;
+                _bump += slot;
+                _bump_left -= slot;
+            }
+            h->shift = shift;
+            _in_use += slot;
+        }
+        h->arena = this;
+        _live++;
+        return (char *)h + ARENA_HEADER_SIZE;
+    }
+
+    // 返回 true 表示 Arena 已退役且没有存活的内存
+    bool Release(Header *h)
+    {
+        std::unique_lock<std::mutex> lock(_mtx);
+        if (h->shift == 0)
+        {
+            size_t len = (size_t)h->size * sysconf(_SC_PAGESIZE);
+            _in_use -= len;
+            Unmap(h, len);
+        }
+        else
+        {
+            _in_use -= ((size_t)1 << h->shift) + ARENA_HEADER_SIZE;
+            FreeNode *node = (FreeNode *)h;
+            node->next = _free[h->shift];
+            _free[h->shift] = node;
+        }
+        _live--;
+        return _orphaned && _live == 0;
+    }
+
+    size_t RoundUp(size_t len)
+    {
+        size_t unit = _huge_page == HUGE_PAGE_NONE ? sysconf(_SC_PAGESIZE) : ARENA_CHUNK_SIZE;
+        return (len + unit - 1) / unit * unit;
+    }
+
+    void *Map(size_t len)
+    {
+        void *p = MAP_FAILED;
+        if (_huge_page == HUGE_PAGE_EXPLICIT)
+        {
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                ERR_LOG("MAP_HUGETLB Failed, Fall Back To Transparent Huge Pages: %s", strerror(errno));
+                _huge_page = HUGE_PAGE_TRANSPARENT;
+            }
+        }
+        if (p == MAP_FAILED)
+        {
+            p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            if (_huge_page == HUGE_PAGE_TRANSPARENT)
+                madvise(p, len, MADV_HUGEPAGE);
+        }
+        // 页面尚未分配，绑定策略在首次访问时生效
+        if (_opts.numa_bind && _node < 64)
+        {
+            unsigned long mask = 1UL << _node;
+            if (syscall(SYS_mbind, p, len, ARENA_MPOL_PREFERRED, &mask, 64, 0) < 0)
+                DBG_LOG("Mbind Failed: %s", strerror(errno));
+        }
+        _regions[p] = len;
+        _mapped += len;
+        if (_metrics)
+            _metrics->arena_bytes.Set(_mapped);
+        return p;
+    }
+
+    void Unmap(void *p, size_t len)
+    {
+        munmap(p, len);
+        _regions.erase(p);
+        _mapped -= len;
+        if (_metrics)
+            _metrics->arena_bytes.Set(_mapped);
+    }
+
+private:
+    ArenaOptions _opts;
+    int _node;
+    ArenaHugePage _huge_page; // 实际生效的大页模式
+    std::mutex _mtx;          // 事件循环线程内几乎无竞争，只在跨线程释放时起作用
+    FreeNode *_free[ARENA_MAX_SHIFT + 1];
+    char *_bump;              // 当前 2MB 块中未分配部分的起点
+    size_t _bump_left;
+    std::map<void *, size_t> _regions;
+    size_t _mapped;
+    size_t _in_use;
+    size_t _live;             // 尚未归还的块数
+    bool _orphaned;
+    LoopMetrics *_metrics;    // 所属事件循环的指标，arena_* 只在持锁时写入
+};
+
+// 供 std::vector 等容器使用，存储从当前线程的 Arena 中申请
+template <class T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+
+    ArenaAllocator() { }
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &) { }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(LoopArena::Allocate(n * sizeof(T)));
+    }
+    void deallocate(T *p, size_t)
+    {
+        LoopArena::Free(p);
+    }
+};
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &, const ArenaAllocator<U> &)
+{
+    return true;
+}
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &, const ArenaAllocator<U> &)
+{
+    return false;
+}
+
+// ================================================================
+//                            Buffer模块
+// ================================================================
+#define DEFAULT_BUFFER_SIZE 1024
+#define DEFAULT_BUFFER_PREPEND 8 // 头部预留空间，足够前插一个 64 位长度字段
+
+class Buffer
+{
+public:
+    // prepend：头部预留空间大小，读写指针从这里开始，清空和整理时保持
+    explicit Buffer(uint64_t prepend = DEFAULT_BUFFER_PREPEND)
+        : _buffer(prepend + DEFAULT_BUFFER_SIZE), _reader_idx(prepend), _writer_idx(prepend), _prepend(prepend)
+    {
+    }
+
+    // 返回底层缓冲区起始地址
+    char *Begin()
+    {
+        return _buffer.data();
+    }
+
+    // 当前写指针位置
+    char *WritePos()
+    {
+        return Begin() + _writer_idx;
+    }
+
+    // 当前读指针位置
+    char *ReadPos()
+    {
+        return Begin() + _reader_idx;
+    }
+
+    // 尾部剩余可写空间大小
+    uint64_t TailIdleSize()
+    {
+        return _buffer.size() - _writer_idx;
+    }
+
+    // 头部空闲空间大小(预留空间 + 已读但尚未复用的空间)，即可前插的字节数
+    uint64_t HeadIdleSize()
+    {
+        return _reader_idx;
+    }
+
+    // 头部预留空间大小
+    uint64_t PrependSize()
+    {
+        return _prepend;
+    }
+
+    // 当前可读数据大小
+    uint64_t ReadAbleSize()
+    {
+        return _writer_idx - _reader_idx;
+    }
+
+    // 向后移动读指针（消费数据）
+    void MoveReadOffset(uint64_t len)
+    {
+        _reader_idx += len;
+    }
+
+    // 向后移动写指针（写入完成后调用）
+    void MoveWriteOffset(uint64_t len)
+    {
+        // 写入空间应已由 EnsureWriteSpace 保证
+        assert(len <= TailIdleSize());
+        _writer_idx += len;
+    }
+
+    // 确保至少有 len 字节可写空间
+    // 优先复用头部空间(保留预留空间)，其次进行扩容
+    void EnsureWriteSpace(uint64_t len)
+    {
+        // 尾部空间足够，直接写
+        if (len <= TailIdleSize())
+            return;
+
+        // 通过前移可读数据复用空间，前移后头部仍保留 _prepend 字节
+        uint64_t reusable = HeadIdleSize() > _prepend ? HeadIdleSize() - _prepend : 0;
+        if (len <= TailIdleSize() + reusable)
+        {
+            uint64_t readable = ReadAbleSize();
+            std::memmove(Begin() + _prepend, ReadPos(), readable);
+            /*
+             * 这里使用memmove而不使用memcpy或copy
+             * “memmove 和 memcpy 的区别在于是否支持内存重叠。在我的 Buffer 实现中，
+             * 需要在同一块缓冲区内把可读数据整体前移复用空间，这属于典型的重叠拷贝场景，
+             * 所以必须使用 memmove，否则行为是未定义的。”
+             */
+            _reader_idx = _prepend;
+            _writer_idx = _prepend + readable;
+        }
+        else
+        {
+            // 扩容：采用倍增策略，减少频繁 realloc
+            uint64_t new_size = _buffer.size();
+            uint64_t need_size = _writer_idx + len;
+
+            while (new_size < need_size)
+            {
+                new_size *= 2;
+            }
+
+            _buffer.resize(new_size);
+            if (LoopMetrics *m = LoopMetrics::Current())
+                m->buffer_grows.Add();
+        }
+    }
+
+    // 写入任意二进制数据
+    void Write(const void *data, uint64_t len)
+    {
+        // 允许空写
+        if (len == 0)
+            return;
+
+        // 非空写入必须保证数据指针有效
+        assert(data != nullptr);
+
+        EnsureWriteSpace(len);
+
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, WritePos());
+
+        MoveWriteOffset(len);
+    }
+
+    // 从缓冲区读取 len 字节到外部缓冲区
+    void Read(void *buf, uint64_t len)
+    {
+        assert(len <= ReadAbleSize());
+        std::copy(ReadPos(), ReadPos() + len, static_cast<char *>(buf));
+        MoveReadOffset(len);
+    }
+
+    // 写入字符串内容（不包含结尾 '\0'）
+    void WriteString(const std::string &data)
+    {
+        Write(data.c_str(), data.size());
+    }
+
+    // 将另一个 Buffer 的可读数据复制到当前 Buffer
+    // 不影响源 Buffer 状态
+    void WriteBuffer(Buffer &data)
+    {
+        Write(data.ReadPos(), data.ReadAbleSize());
+    }
+
+    // 将另一个 Buffer 的可读数据写入并消费
+    void WriteBufferAndConsume(Buffer &data)
+    {
+        uint64_t len = data.ReadAbleSize();
+        Write(data.ReadPos(), len);
+        data.MoveReadOffset(len);
+    }
+
+    // 在可读数据前面插入数据，使用头部预留与已读空间，不足时整体后移可读数据
+    // 协议编码先写消息体，长度确定后再前插帧头/Content-Length/chunk 大小，省去第二个缓冲区
+    void Prepend(const void *data, uint64_t len)
+    {
+        if (len == 0)
+            return;
+        assert(data != nullptr);
+        if (len > HeadIdleSize())
+        {
+            uint64_t readable = ReadAbleSize();
+            EnsureWriteSpace(len);
+            if (len > HeadIdleSize())
+            {
+                std::memmove(ReadPos() + len, ReadPos(), readable);
+                _reader_idx += len;
+                _writer_idx += len;
+            }
+        }
+        _reader_idx -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, ReadPos());
+    }
+
+    // 网络字节序整数：Peek 不移动读指针，Read 消费，Write 追加到尾部，Prepend 插入到可读数据前面
+    uint8_t PeekInt8()
+    {
+        assert(ReadAbleSize() >= sizeof(uint8_t));
+        return (uint8_t)*ReadPos();
+    }
+    uint16_t PeekInt16()
+    {
+        uint16_t v;
+        PeekRaw(&v, sizeof(v));
+        return be16toh(v);
+    }
+    uint32_t PeekInt32()
+    {
+        uint32_t v;
+        PeekRaw(&v, sizeof(v));
+        return be32toh(v);
+    }
+    uint64_t PeekInt64()
+    {
+        uint64_t v;
+        PeekRaw(&v, sizeof(v));
+        return be64toh(v);
+    }
+    uint8_t ReadInt8()
+    {
+        uint8_t v = PeekInt8();
+        MoveReadOffset(sizeof(v));
+        return v;
+    }
+    uint16_t ReadInt16()
+    {
+        uint16_t v = PeekInt16();
+        MoveReadOffset(sizeof(v));
+        return v;
+    }
+    uint32_t ReadInt32()
+    {
+        uint32_t v = PeekInt32();
+        MoveReadOffset(sizeof(v));
+        return v;
+    }
+    uint64_t ReadInt64()
+    {
+        uint64_t v = PeekInt64();
+        MoveReadOffset(sizeof(v));
+        return v;
+    }
+    void WriteInt8(uint8_t v)
+    {
+        Write(&v, sizeof(v));
+    }
+    void WriteInt16(uint16_t v)
+    {
+        v = htobe16(v);
+        Write(&v, sizeof(v));
+    }
+    void WriteInt32(uint32_t v)
+    {
+        v = htobe32(v);
+        Write(&v, sizeof(v));
+    }
+    void WriteInt64(uint64_t v)
+    {
+        v = htobe64(v);
+        Write(&v, sizeof(v));
+    }
+    void PrependInt8(uint8_t v)
+    {
+        Prepend(&v, sizeof(v));
+    }
+    void PrependInt16(uint16_t v)
+    {
+        v = htobe16(v);
+        Prepend(&v, sizeof(v));
+    }
+    void PrependInt32(uint32_t v)
+    {
+        v = htobe32(v);
+        Prepend(&v, sizeof(v));
+    }
+    void PrependInt64(uint64_t v)
+    {
+        v = htobe64(v);
+        Prepend(&v, sizeof(v));
+    }
+
+    // 读取指定长度并以 string 形式返回
+    std::string ReadAsString(uint64_t len)
+    {
+        assert(len <= ReadAbleSize());
+        std::string str;
+        str.resize(len);
+        Read(&str[0], len);
+        return str;
+    }
+
+    // 查找当前可读区中的 '\n'
+    char *FindCRLF()
+    {
+        void *res = memchr(ReadPos(), '\n', ReadAbleSize());
+        return static_cast<char *>(res);
+    }
+
+    // 读取一行数据（包含 '\n'）
+    std::string GetLine()
+    {
+        char *pos = FindCRLF();
+        if (pos == nullptr)
+            return "";
+        return ReadAsString(pos - ReadPos() + 1);
+    }
+
+    // 清空缓冲区（逻辑清空，不释放内存）
+    void Clear()
+    {
+        _reader_idx = _prepend;
+        _writer_idx = _prepend;
+    }
+
+    // 底层存储容量
+    uint64_t Capacity()
+    {
+        return _buffer.size();
+    }
+
+    // 容量超过 limit 时释放内存，回到默认大小（供对象池回收时使用，避免长期占用大块内存）
+    void Shrink(uint64_t limit)
+    {
+        Clear();
+        if (_buffer.size() > limit)
+            std::vector<char, ArenaAllocator<char>>(_prepend + DEFAULT_BUFFER_SIZE).swap(_buffer);
+    }
+
+    ~Buffer() {}
+
+private:
+    // 可读数据不一定按整数类型对齐，用 memcpy 读取
+    void PeekRaw(void *out, uint64_t len)
+    {
+        assert(len <= ReadAbleSize());
+        std::memcpy(out, ReadPos(), len);
+    }
+
+private:
+    std::vector<char, ArenaAllocator<char>> _buffer; // 实际存储空间，在事件循环线程中分配时来自该线程的 Arena
+    uint64_t _reader_idx;      // 读指针
+    uint64_t _writer_idx;      // 写指针
+    uint64_t _prepend;         // 头部预留空间大小
+};
+
+// ================================================================
+//                            Socket模块
+// ================================================================
+#define MAX_LISTEN 1024
+
+// 旧版本 glibc 头文件中可能缺少零拷贝相关定义
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+// 套接字调优配置：声明式描述，监听时和 accept 后分别应用
+// 数值型字段为 -1 表示保持内核默认值
+struct SocketOptions
+{
+    bool tcp_nodelay;      // 关闭 Nagle，小包立即发送
+    bool tcp_quickack;     // 立即 ACK(内核会自动退回延迟ACK，Connection 每次读后重新设置)
+    int rcvbuf;            // SO_RCVBUF，需在 listen 前设置才能影响窗口扩大因子
+    int sndbuf;            // SO_SNDBUF
+    int defer_accept;      // TCP_DEFER_ACCEPT(秒)，数据到达后才唤醒 accept，仅监听套接字
+    int fastopen_qlen;     // TCP_FASTOPEN 队列长度，仅监听套接字
+    int busy_poll_us;      // SO_BUSY_POLL(微秒)，超过 net.core.busy_poll 需要 CAP_NET_ADMIN
+    int notsent_lowat;     // TCP_NOTSENT_LOWAT，限制内核中未发送数据量，降低排队延迟
+    bool ipv6_only;        // IPv6 监听套接字只接受 IPv6(IPV6_V6ONLY)，默认双栈，IPv4 客户端以 ::ffff:a.b.c.d 出现
+
+    SocketOptions()
+        : tcp_nodelay(false), tcp_quickack(false), rcvbuf(-1), sndbuf(-1), defer_accept(-1),
+          fastopen_qlen(-1), busy_poll_us(-1), notsent_lowat(-1), ipv6_only(false)
+    { }
+
+    // 去掉对该地址族无效的选项：Unix 套接字没有 TCP 层，也不经过网卡队列
+    SocketOptions ForFamily(int family) const
+    {
+        SocketOptions opts = *this;
+        if (family == AF_UNIX)
+        {
+            opts.tcp_nodelay = false;
+            opts.tcp_quickack = false;
+            opts.defer_accept = -1;
+            opts.fastopen_qlen = -1;
+            opts.busy_poll_us = -1;
+            opts.notsent_lowat = -1;
+        }
+        return opts;
+    }
+
+    // 低延迟 RPC：小请求、长连接、对尾延迟敏感
+    static SocketOptions LowLatencyRpc()
+    {
+        SocketOptions opts;
+        opts.tcp_nodelay = true;
+        opts.tcp_quickack = true;
+        opts.defer_accept = 1;
+        opts.fastopen_qlen = 256;
+        opts.busy_poll_us = 50;
+        opts.notsent_lowat = 16 * 1024;
+        return opts;
+    }
+
+    // 大块传输：吞吐优先，保留 Nagle，放大收发缓冲区
+    static SocketOptions BulkTransfer()
+    {
+        SocketOptions opts;
+        opts.rcvbuf = 4 * 1024 * 1024;
+        opts.sndbuf = 4 * 1024 * 1024;
+        opts.notsent_lowat = 256 * 1024;
+        return opts;
+    }
+};
+
+// 套接字地址：IPv4、IPv6 与 Unix 流套接字(文件路径或抽象命名空间)。
+// 字符串形式(ip 参数)：
+//   "127.0.0.1"、"0.0.0.0"       IPv4
+//   "::1"、"::"、"[fe80::1]"      IPv6("::" 监听时默认双栈，见 SocketOptions::ipv6_only)
+//   "unix:/run/app.sock"         Unix 文件路径，端口被忽略
+//   "unix:@app"                  Unix 抽象命名空间(不在文件系统中，进程退出后自动消失)
+class SockAddr
+{
+public:
+    SockAddr()
+        : _len(0)
+    {
+        memset(&_addr, 0, sizeof(_addr));
+    }
+    // 解析失败时 Valid() 为 false
+    SockAddr(const std::string &ip, uint16_t port)
+        : _len(0)
+    {
+        memset(&_addr, 0, sizeof(_addr));
+        if (ip.compare(0, 5, "unix:") == 0)
+        {
+            SetUnix(ip.substr(5));
+            return;
+        }
+        std::string host = ip;
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2);
+        if (host.find(':') != std::string::npos)
+        {
+            sockaddr_in6 *in6 = (sockaddr_in6 *)&_addr;
+            if (inet_pton(AF_INET6, host.c_str(), &in6->sin6_addr) != 1)
+                return;
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(port);
+            _len = sizeof(sockaddr_in6);
+            return;
+        }
+        sockaddr_in *in = (sockaddr_in *)&_addr;
+        if (inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1)
+            return;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        _len = sizeof(sockaddr_in);
+    }
+
+    // Unix 套接字地址，path 以 '@' 开头表示抽象命名空间
+    static SockAddr Unix(const std::string &path)
+    {
+        SockAddr addr;
+        addr.SetUnix(path);
+        return addr;
+    }
+    // 已连接套接字的对端地址/本端地址
+    static SockAddr Peer(int fd)
+    {
+        SockAddr addr;
+        socklen_t len = sizeof(addr._addr);
+        if (getpeername(fd, (sockaddr *)&addr._addr, &len) == 0)
+            addr._len = len;
+        return addr;
+    }
+    static SockAddr Local(int fd)
+    {
+        SockAddr addr;
+        socklen_t len = sizeof(addr._addr);
+        if (getsockname(fd, (sockaddr *)&addr._addr, &len) == 0)
+            addr._len = len;
+        return addr;
+    }
+
+    bool Valid() const
+    {
+        return _len > 0;
+    }
+    int Family() const
+    {
+        return _len > 0 ? _addr.ss_family : AF_UNSPEC;
+    }
+    const sockaddr *Addr() const
+    {
+        return (const sockaddr *)&_addr;
+    }
+    socklen_t Len() const
+    {
+        return _len;
+    }
+    uint16_t Port() const
+    {
+        if (Family() == AF_INET)
+            return ntohs(((const sockaddr_in *)&_addr)->sin_port);
+        if (Family() == AF_INET6)
+            return ntohs(((const sockaddr_in6 *)&_addr)->sin6_port);
+        return 0;
+    }
+    // 抽象命名空间的 Unix 地址
+    bool Abstract() const
+    {
+        return Family() == AF_UNIX && _len > offsetof(sockaddr_un, sun_path) &&
+               ((const sockaddr_un *)&_addr)->sun_path[0] == '\0';
+    }
+    // Unix 地址的路径(抽象命名空间以 '@' 开头)，未命名的套接字(如客户端一侧)为空
+    std::string Path() const
+    {
+        if (Family() != AF_UNIX || _len <= offsetof(sockaddr_un, sun_path))
+            return "";
+        const char *p = ((const sockaddr_un *)&_addr)->sun_path;
+        size_t n = _len - offsetof(sockaddr_un, sun_path);
+        if (p[0] == '\0')
+            return "@" + std::string(p + 1, n - 1);
+        return std::string(p, strnlen(p, n));
+    }
+    // IP 的文本形式，双栈套接字上的 IPv4 映射地址还原为 IPv4；Unix 地址为空
+    std::string Ip() const
+    {
+        char buf[INET6_ADDRSTRLEN];
+        if (Family() == AF_INET)
+            return inet_ntop(AF_INET, &((const sockaddr_in *)&_addr)->sin_addr, buf, sizeof(buf)) ? buf : "";
+        if (Family() != AF_INET6)
+            return "";
+        const in6_addr *a = &((const sockaddr_in6 *)&_addr)->sin6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(a))
+            return inet_ntop(AF_INET, &a->s6_addr[12], buf, sizeof(buf)) ? buf : "";
+        return inet_ntop(AF_INET6, a, buf, sizeof(buf)) ? buf : "";
+    }
+    // 日志用："1.2.3.4:80"、"[::1]:80"、"unix:/path"、"unix:@name"(IPv4 映射地址按 IPv4 显示)
+    std::string ToString() const
+    {
+        if (Family() == AF_UNIX)
+            return "unix:" + Path();
+        if (Family() != AF_INET && Family() != AF_INET6)
+            return "invalid";
+        std::string ip = Ip();
+        if (ip.find(':') != std::string::npos)
+            return "[" + ip + "]:" + std::to_string(Port());
+        return ip + ":" + std::to_string(Port());
+    }
+
+private:
+    void SetUnix(const std::string &path)
+    {
+        sockaddr_un *un = (sockaddr_un *)&_addr;
+        if (path.empty() || path.size() >= sizeof(un->sun_path))
+            return;
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.data(), path.size());
+        if (path[0] == '@')
+            un->sun_path[0] = '\0'; // 抽象地址的长度精确到名字末尾，不含结尾的 '\0'
+        _len = offsetof(sockaddr_un, sun_path) + path.size() + (path[0] == '@' ? 0 : 1);
+    }
+
+private:
+    sockaddr_storage _addr;
+    socklen_t _len; // 0 表示无效
+};
+
+// Socket：对流套接字(TCP / Unix)的最小、正确、非阻塞封装
+// 职责：
+//   1. 封装系统调用（socket / bind / listen / accept / recv / send）
+//   2. 正确处理 errno 语义（EAGAIN / EINTR / peer closed）
+//   3. 不涉及任何业务逻辑、不做 Buffer 拼包
+
+class Socket
+{
+public:
+    // 构造一个无效 socket
+    Socket()
+        : _sockfd(-1)
+    {
+    }
+
+    // 用已有 fd 构造（常用于 accept 之后）
+    Socket(int fd)
+        : _sockfd(fd)
+    {
+    }
+
+    // 创建流套接字
+    // family : AF_INET(IPv4) / AF_INET6(IPv6) / AF_UNIX(本机)
+    bool CreateSocket(int family = AF_INET)
+    {
+        int fd = socket(family, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            ERR_LOG("Creat Socket ERR");
+            return false;
+        }
+        _sockfd = fd;
+        return true;
+    }
+
+    // 绑定 IP + 端口
+    bool Bind(uint16_t port, const std::string &ip)
+    {
+        return Bind(SockAddr(ip, port));
+    }
+    bool Bind(const SockAddr &addr)
+    {
+        int ret = bind(_sockfd, addr.Addr(), addr.Len());
+        if (ret < 0)
+        {
+            ERR_LOG("Bind %s ERR: %s", addr.ToString().c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // 监听套接字，进入 LISTEN 状态
+    bool Listen(int backlog = MAX_LISTEN)
+    {
+        // backlog 是内核对半连接队列 / 全连接队列的容量提示
+        int ret = listen(_sockfd, backlog);
+        if (ret < 0)
+        {
+            ERR_LOG("Listen ERR");
+            return false;
+        }
+        return true;
+    }
+
+    // 接受新连接
+    // flags 直接交给 accept4，默认新 fd 即为非阻塞 + CLOEXEC，省去一次 fcntl
+    // 返回值：
+    //   >=0 : 新连接 fd
+    //   -1  : 当前无可 accept 的连接（EAGAIN / EINTR），或系统错误（errno 保留给调用者判断）
+    int Accept(int flags = SOCK_NONBLOCK | SOCK_CLOEXEC)
+    {
+        // 非阻塞 listen fd 下，accept 可能频繁返回 EAGAIN
+        int fd = accept4(_sockfd, nullptr, nullptr, flags);
+        if (fd < 0)
+        {
+            // 非异常情况：当前无连接、被信号中断或连接在握手完成前被对端重置
+            if (errno == EAGAIN || errno == EINTR || errno == ECONNABORTED)
+                return -1;
+
+            // 描述符耗尽由 Acceptor 处理，这里不刷日志
+            if (errno == EMFILE || errno == ENFILE)
+                return -1;
+
+            // 真正的系统错误
+            ERR_LOG("Accept ERR: %s", strerror(errno));
+            return -1;
+        }
+        return fd;
+    }
+
+    // 客户端主动发起连接
+    bool Connect(uint16_t port, const std::string &ip)
+    {
+        return Connect(SockAddr(ip, port));
+    }
+    bool Connect(const SockAddr &addr)
+    {
+        int ret = connect(_sockfd, addr.Addr(), addr.Len());
+        if (ret < 0)
+        {
             ERR_LOG("Connect ERR");
             return false;
         }
         return true;
     }
 
-    // 接收数据
-    // 返回值语义（与 muduo 对齐）：
-    //   >0 : 实际读取的字节数
-    //    0 : 对端关闭连接，或当前不可读（EAGAIN / EINTR）
-    //   -1 : 发生系统错误
-    ssize_t Recv(void *buf, size_t len, int flag = 0)
+    // 非阻塞连接(套接字须已设为非阻塞)
+    // 返回 0 表示已连接(本机连接可能立即完成)，EINPROGRESS 表示等待可写事件，其余为失败的 errno
+    // Unix 套接字的监听队列满时返回 EAGAIN，按失败处理
+    int ConnectNonBlock(uint16_t port, const std::string &ip)
+    {
+        return ConnectNonBlock(SockAddr(ip, port));
+    }
+    int ConnectNonBlock(const SockAddr &addr)
+    {
+        if (connect(_sockfd, addr.Addr(), addr.Len()) == 0)
+            return 0;
+        return errno == EINTR ? EINPROGRESS : errno;
+    }
+
+    // 接收数据
+    // 返回值语义（与 muduo 对齐）：
+    //   >0 : 实际读取的字节数
+    //    0 : 当前不可读（EAGAIN / EINTR）
+    //   -1 : 对端关闭连接，或发生系统错误
+    ssize_t Recv(void *buf, size_t len, int flag = 0)
+    {
+        ssize_t ret = recv(_sockfd, buf, len, flag);
+        if (ret < 0)
+        {
+            // 非阻塞下的正常情况
+            if (errno == EINTR || errno == EAGAIN)
+                return 0;
+
+            ERR_LOG("Recv ERR");
+            return -1;
+        }
+
+        // ret == 0 表示对端发送 FIN，连接关闭
+        // 与 EAGAIN 区分开，否则上层无法判断连接是否还活着
+        if (ret == 0)
+        {
+            INF_LOG("Peer Closed");
+            return -1;
+        }
+
+        return ret;
+    }
+
+    // 非阻塞接收（通过 MSG_DONTWAIT）
+    ssize_t NonBlockRecv(void *buf, size_t len)
+    {
+        return Recv(buf, len, MSG_DONTWAIT);
+    }
+
+    // 发送数据
+    // 返回值：
+    //   >0 : 实际发送字节数（可能小于 len，属于正常情况）
+    //    0 : 当前不可写（EAGAIN / EINTR）
+    //   -1 : 发送错误
+    ssize_t Send(void *buf, size_t len, int flag = 0)
+    {
+        ssize_t ret = send(_sockfd, buf, len, flag);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return 0;
+
+            ERR_LOG("Send ERR");
+            return -1;
+        }
+        return ret;
+    }
+
+    // 非阻塞发送
+    ssize_t NonBlockSend(void *buf, size_t len)
+    {
+        return Send(buf, len, MSG_DONTWAIT);
+    }
+
+    // 把文件 [offset, offset + len) 从页缓存直接发送(开启内核 TLS 后由内核加密)
+    // 返回值同 Send，文件比预期短(读到文件末尾)时返回 -1
+    ssize_t SendFile(int file_fd, off_t offset, size_t len)
+    {
+        ssize_t ret = sendfile(_sockfd, file_fd, &offset, len);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return 0;
+
+            ERR_LOG("Sendfile ERR: %s", strerror(errno));
+            return -1;
+        }
+        if (ret == 0 && len > 0)
+        {
+            ERR_LOG("Sendfile ERR: file truncated");
+            return -1;
+        }
+        return ret;
+    }
+
+    // 把最多 len 字节从套接字搬进管道写端，数据不经过用户态
+    // 返回值同 Recv：0 表示暂无数据或管道已满(两者内核都返回 EAGAIN)
+    ssize_t SpliceToPipe(int pipe_fd, size_t len)
+    {
+        ssize_t ret = splice(_sockfd, nullptr, pipe_fd, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return 0;
+
+            ERR_LOG("Splice ERR: %s", strerror(errno));
+            return -1;
+        }
+        if (ret == 0)
+        {
+            INF_LOG("Peer Closed");
+            return -1;
+        }
+        return ret;
+    }
+
+    // 把管道读端中的 len 字节发送出去，返回值同 Send
+    ssize_t SpliceFromPipe(int pipe_fd, size_t len)
+    {
+        ssize_t ret = splice(pipe_fd, nullptr, _sockfd, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return 0;
+
+            ERR_LOG("Splice ERR: %s", strerror(errno));
+            return -1;
+        }
+        return ret;
+    }
+
+    // 开启 SO_ZEROCOPY，之后才能使用 MSG_ZEROCOPY 发送
+    bool EnableZeroCopy()
+    {
+        int opt = 1;
+        if (setsockopt(_sockfd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(int)) < 0)
+        {
+            ERR_LOG("Setsockopt SO_ZEROCOPY ERR: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // 零拷贝发送：内核直接引用用户页，在错误队列收到完成通知之前 buf 不能释放或修改
+    // 返回值同 Send，ENOBUFS(锁定内存超限)按暂时不可写处理，等待完成通知释放后重试
+    ssize_t SendZeroCopy(const void *buf, size_t len)
+    {
+        ssize_t ret = send(_sockfd, buf, len, MSG_ZEROCOPY | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR || errno == ENOBUFS)
+                return 0;
+
+            ERR_LOG("Send Zerocopy ERR");
+            return -1;
+        }
+        return ret;
+    }
+
+    // 从错误队列读取一条零拷贝完成通知，[lo, hi] 为完成的发送序号区间
+    // copied 表示内核退回了拷贝(例如回环设备)，此时零拷贝没有收益
+    // 返回值：1 读到通知  0 队列为空  -1 错误或非零拷贝通知
+    int ReadZeroCopyCompletion(uint32_t *lo, uint32_t *hi, bool *copied)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        int ret = recvmsg(_sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (ret < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return 0;
+            return -1;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            struct sock_extended_err *serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+                return -1;
+            *lo = serr->ee_info;
+            *hi = serr->ee_data;
+            *copied = serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+            return 1;
+        }
+        return -1;
+    }
+
+    // 处理该连接数据包的 CPU(网卡队列中断/软中断所在核心)，不支持或尚无数据时返回 -1
+    int IncomingCpu()
+    {
+        return IncomingCpu(_sockfd);
+    }
+    static int IncomingCpu(int fd)
+    {
+        int cpu = -1;
+        socklen_t len = sizeof(cpu);
+        if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+            return -1;
+        return cpu;
+    }
+
+    // 对端进程的 pid/uid/gid(SO_PEERCRED)，只对 Unix 套接字有意义；
+    // 内容为对端 connect(或 listen)时的身份，之后对端切换身份不会更新
+    bool PeerCred(struct ucred *cred)
+    {
+        socklen_t len = sizeof(*cred);
+        if (getsockopt(_sockfd, SOL_SOCKET, SO_PEERCRED, cred, &len) < 0)
+        {
+            ERR_LOG("Getsockopt SO_PEERCRED ERR: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // 套接字的地址族(SO_DOMAIN)，用于接管的描述符
+    int Family()
+    {
+        int family = AF_UNSPEC;
+        socklen_t len = sizeof(family);
+        getsockopt(_sockfd, SOL_SOCKET, SO_DOMAIN, &family, &len);
+        return family;
+    }
+
+    // 获取并清除套接字上的挂起错误
+    int GetError()
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(_sockfd, SOL_SOCKET, SO_ERROR, &err, &len);
+        return err;
+    }
+
+    // 关闭套接字
+    void Close()
+    {
+        if (_sockfd != -1)
+        {
+            close(_sockfd);
+            _sockfd = -1;
+        }
+    }
+
+    // 创建服务器监听 socket
+    // 顺序：
+    //   socket -> nonblock -> reuse addr -> options -> bind -> listen
+    bool CreateServer(uint16_t port, const std::string &ip = "0.0.0.0", bool isBlock = true,
+                      const SocketOptions &opts = SocketOptions())
+    {
+        return CreateServer(SockAddr(ip, port), isBlock, opts);
+    }
+    // Unix 文件路径：先清理上次运行遗留的套接字文件(没有进程在监听时)，
+    // 退出时不删除，热重启接管的进程仍在同一路径上提供服务
+    bool CreateServer(const SockAddr &addr, bool isBlock = true, const SocketOptions &opts = SocketOptions())
+    {
+        if (!addr.Valid())
+        {
+            ERR_LOG("Invalid Listen Address");
+            return false;
+        }
+        if (!CreateSocket(addr.Family()))
+            return false;
+
+        if (!isBlock)
+            SetNonBlock(); // 非阻塞是 Reactor 的前提
+
+        if (addr.Family() == AF_UNIX)
+            RemoveStaleUnixPath(addr);
+        else
+            ReuseAddress(); // 支持服务器快速重启
+        if (addr.Family() == AF_INET6)
+            SetOption(IPPROTO_IPV6, IPV6_V6ONLY, opts.ipv6_only, "IPV6_V6ONLY");
+        ApplyOptions(opts.ForFamily(addr.Family()), true);
+
+        if (!Bind(addr))
+            return false;
+        if (!Listen())
+            return false;
+
+        return true;
+    }
+
+    // 创建客户端 socket
+    bool CreateClient(uint16_t port, const std::string &ip)
+    {
+        return CreateClient(SockAddr(ip, port));
+    }
+    // 按地址族创建套接字，IPv6 与 Unix 地址同样适用
+    bool CreateClient(const SockAddr &addr)
+    {
+        if (!addr.Valid())
+        {
+            ERR_LOG("Invalid Connect Address");
+            return false;
+        }
+        if (!CreateSocket(addr.Family()))
+            return false;
+        if (!Connect(addr))
+            return false;
+        return true;
+    }
+
+    // 开启地址 / 端口复用
+    void ReuseAddress()
+    {
+        int opt = 1;
+        setsockopt(_sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int));
+        setsockopt(_sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int));
+    }
+
+    // 应用调优配置，listening 为 true 时额外设置仅对监听套接字有意义的选项
+    // 单个选项失败(内核不支持或权限不足)只记录日志，不影响其他选项
+    bool ApplyOptions(const SocketOptions &opts, bool listening)
+    {
+        bool ok = true;
+        if (opts.tcp_nodelay)
+            ok &= SetOption(IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+        if (opts.tcp_quickack && !listening)
+            ok &= SetOption(IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+        if (opts.rcvbuf >= 0)
+            ok &= SetOption(SOL_SOCKET, SO_RCVBUF, opts.rcvbuf, "SO_RCVBUF");
+        if (opts.sndbuf >= 0)
+            ok &= SetOption(SOL_SOCKET, SO_SNDBUF, opts.sndbuf, "SO_SNDBUF");
+        if (opts.busy_poll_us >= 0)
+            ok &= SetOption(SOL_SOCKET, SO_BUSY_POLL, opts.busy_poll_us, "SO_BUSY_POLL");
+        if (opts.notsent_lowat >= 0)
+            ok &= SetOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.notsent_lowat, "TCP_NOTSENT_LOWAT");
+        if (listening && opts.defer_accept >= 0)
+            ok &= SetOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, opts.defer_accept, "TCP_DEFER_ACCEPT");
+        if (listening && opts.fastopen_qlen >= 0)
+            ok &= SetOption(IPPROTO_TCP, TCP_FASTOPEN, opts.fastopen_qlen, "TCP_FASTOPEN");
+        return ok;
+    }
+
+    // 重新进入快速ACK模式(TCP_QUICKACK 不是永久生效的)
+    void QuickAck()
+    {
+        int opt = 1;
+        setsockopt(_sockfd, IPPROTO_TCP, TCP_QUICKACK, &opt, sizeof(int));
+    }
+
+    // 设置 socket 为非阻塞（文件状态标志）
+    void SetNonBlock()
+    {
+        int fl = fcntl(_sockfd, F_GETFL, 0);
+        fcntl(_sockfd, F_SETFL, fl | O_NONBLOCK);
+    }
+
+    int GetFd() const
+    {
+        return _sockfd;
+    }
+
+    // 交出 fd 的所有权，析构时不再关闭
+    int Release()
+    {
+        int fd = _sockfd;
+        _sockfd = -1;
+        return fd;
+    }
+
+    // 关闭旧 fd 并接管新 fd（对象复用时使用）
+    void Reset(int fd)
+    {
+        Close();
+        _sockfd = fd;
+    }
+
+    // RAII：对象析构时关闭 fd
+    ~Socket()
+    {
+        if (_sockfd > 0)
+            Close();
+    }
+
+private:
+    // 路径上的套接字文件连不上(ECONNREFUSED)说明监听者已经退出，删除后才能重新 bind
+    static void RemoveStaleUnixPath(const SockAddr &addr)
+    {
+        if (addr.Abstract())
+            return;
+        struct stat st;
+        std::string path = addr.Path();
+        if (stat(path.c_str(), &st) < 0 || !S_ISSOCK(st.st_mode))
+            return;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return;
+        if (connect(fd, addr.Addr(), addr.Len()) < 0 && errno == ECONNREFUSED)
+        {
+            INF_LOG("Remove stale unix socket %s", path.c_str());
+            unlink(path.c_str());
+        }
+        close(fd);
+    }
+
+    bool SetOption(int level, int name, int value, const char *desc)
+    {
+        int ret = setsockopt(_sockfd, level, name, &value, sizeof(int));
+        if (ret < 0)
+        {
+            ERR_LOG("Setsockopt %s ERR: %s", desc, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int _sockfd; // 套接字文件描述符
+};
+
+// ================================================================
+//                            Channel模块
+// ================================================================
+// 事件的回调函数
+class EventLoop;
+using EventCallBack = std::function<void()>;
+
+class Channel
+{
+public:
+    // 编译期绑定的分发函数(见 StaticChannel)
+    using DispatchFunc = void (*)(Channel *);
+
+    // 创建一个channel类
+    Channel(EventLoop *loop, int fd)
+        : _fd(fd), _loop(loop), _events(0), _revents(0), _dispatch(nullptr)
+    { }
+    ~Channel()
+    { }
+    // 更新
+    void Update();
+    // 移除监控(从epoll的红黑树上删除掉)
+    void Remove();
+    // 设置就绪事件--(在后面Poller中调用)
+    void SetRevents(uint32_t revents)
+    {
+        _revents = revents;
+    }
+    // 获得fd
+    int GetFd()
+    {
+        return _fd;
+    }
+    // 重新绑定fd(对象池复用时调用，回调保持不变，调用前应已Remove)
+    void ResetFd(int fd)
+    {
+        _fd = fd;
+        _events = 0;
+        _revents = 0;
+    }
+    // 获得该文件描述符要设置的监控事件
+    uint32_t GetEvent()
+    {
+        return _events;
+    }
+    // 获得本次实际就绪的事件
+    uint32_t GetRevents()
+    {
+        return _revents;
+    }
+    // 设置回调函数
+    void SetReadCallBack(const EventCallBack &cb)
+    {
+        _read_cb = cb;
+    }
+    void SetWriteCallBack(const EventCallBack &cb)
+    {
+        _write_cb = cb;
+    }
+    void SetErrorCallBack(const EventCallBack &cb)
+    {
+        _error_cb = cb;
+    }
+    void SetCloseCallBack(const EventCallBack &cb)
+    {
+        _close_cb = cb;
+    }
+    void SetEventCallBack(const EventCallBack &cb)
+    {
+        _event_cb = cb;
+    }
+    // 是否监控了读事件
+    bool ReadAble()
+    {
+        return (_events & EPOLLIN);
+    }
+    // 是否监控了写事件
+    bool WriteAble()
+    {
+        return (_events & EPOLLOUT);
+    }
+    // 启动读事件监控
+    void EnableRead()
+    {
+        _events |= EPOLLIN;
+        Update();
+    }
+    // 启动写事件监控
+    void EnableWrite()
+    {
+        _events |= EPOLLOUT;
+        Update();
+    }
+    // 解除读事件监控
+    void DisableRead()
+    {
+        _events &= ~EPOLLIN;
+        Update();
+    }
+    // 解除写事件监控
+    void DisableWrite()
+    {
+        _events &= ~EPOLLOUT;
+        Update();
+    }
+    // 关闭所有事件监控
+    void DisableAll()
+    {
+        _events = 0;
+        Update();
+    }
+
+    // 解决触发事件
+    void HandleEvent()
+    {
+        if (_dispatch)
+            return _dispatch(this);
+        if (_event_cb)
+        {
+            CallbackScope scope(_fd, CB_EVENT);
+            _event_cb();
+        }
+
+        // ❗错误和关闭优先处理
+        if (_revents & EPOLLERR)
+        {
+            if (_error_cb)
+            {
+                CallbackScope scope(_fd, CB_ERROR);
+                _error_cb();
+            }
+            return;
+        }
+
+        if (_revents & EPOLLHUP)
+        {
+            if (_close_cb)
+            {
+                CallbackScope scope(_fd, CB_CLOSE);
+                _close_cb();
+            }
+            return;
+        }
+
+        // 可读事件
+        if (_revents & (EPOLLIN | EPOLLPRI))
+        {
+            if (_read_cb)
+            {
+                CallbackScope scope(_fd, CB_READ);
+                _read_cb();
+            }
+        }
+
+        // 可写事件
+        if (_revents & EPOLLOUT)
+        {
+            if (_write_cb)
+            {
+                CallbackScope scope(_fd, CB_WRITE);
+                _write_cb();
+            }
+        }
+    }
+
+protected:
+    Channel(EventLoop *loop, int fd, DispatchFunc dispatch)
+        : _fd(fd), _loop(loop), _events(0), _revents(0), _dispatch(dispatch)
+    { }
+
+private:
+    int _fd;
+    EventLoop* _loop;
+    uint32_t _events;        // 需要监控的事件
+    uint32_t _revents;       // 实际就绪的事件
+    DispatchFunc _dispatch;  // 非空时由它分发事件，不再检查下面的回调
+    EventCallBack _read_cb;  // 可写
+    EventCallBack _write_cb; // 可读
+    EventCallBack _error_cb; // 错误产生
+    EventCallBack _close_cb; // 连接关闭
+    EventCallBack _event_cb; // 任意一个事件触发
+};
+
+// 处理函数在编译期确定的Channel：Owner 继承 ChannelOwner<Owner>，实现需要的
+// HandleRead/HandleWrite/HandleClose/HandleError/HandleEvent(可以是私有的，需声明 StaticChannel<Owner> 为友元)。
+// 未实现的处理函数在编译期去掉，事件分发内联为直接调用；ad-hoc 的描述符继续使用 Channel + SetXxxCallBack
+template <typename Owner>
+class ChannelOwner
+{
+public:
+    void HandleRead() { }
+    void HandleWrite() { }
+    void HandleClose() { }
+    void HandleError() { }
+    void HandleEvent() { }
+};
+
+template <typename Owner>
+class StaticChannel : public Channel
+{
+public:
+    StaticChannel(EventLoop *loop, int fd, Owner *owner)
+        : Channel(loop, fd, &StaticChannel::Dispatch), _owner(owner)
+    { }
+
+private:
+    using Default = void (ChannelOwner<Owner>::*)();
+
+    // 与 Channel::HandleEvent 的顺序一致：任意事件 -> 错误/关闭优先 -> 可读 -> 可写
+    static void Dispatch(Channel *channel)
+    {
+        // 处理函数仍是 ChannelOwner 的空实现即为未实现(在函数体中判断，此时 Owner 已是完整类型)
+        const bool kRead = !std::is_same<decltype(&Owner::HandleRead), Default>::value;
+        const bool kWrite = !std::is_same<decltype(&Owner::HandleWrite), Default>::value;
+        const bool kClose = !std::is_same<decltype(&Owner::HandleClose), Default>::value;
+        const bool kError = !std::is_same<decltype(&Owner::HandleError), Default>::value;
+        const bool kEvent = !std::is_same<decltype(&Owner::HandleEvent), Default>::value;
+        Owner *owner = static_cast<StaticChannel *>(channel)->_owner;
+        uint32_t revents = channel->GetRevents();
+        int fd = channel->GetFd();
+        if (kEvent)
+        {
+            CallbackScope scope(fd, CB_EVENT);
+            owner->HandleEvent();
+        }
+        if (revents & EPOLLERR)
+        {
+            if (kError)
+            {
+                CallbackScope scope(fd, CB_ERROR);
+                owner->HandleError();
+            }
+            return;
+        }
+        if (revents & EPOLLHUP)
+        {
+            if (kClose)
+            {
+                CallbackScope scope(fd, CB_CLOSE);
+                owner->HandleClose();
+            }
+            return;
+        }
+        if (kRead && (revents & (EPOLLIN | EPOLLPRI)))
+        {
+            CallbackScope scope(fd, CB_READ);
+            owner->HandleRead();
+        }
+        if (kWrite && (revents & EPOLLOUT))
+        {
+            CallbackScope scope(fd, CB_WRITE);
+            owner->HandleWrite();
+        }
+    }
+
+private:
+    Owner *_owner;
+};
+
+// ================================================================
+//                     Poller模块(EventLoop子模块)
+// ================================================================
+
+#define MAX_EPOLLEREVENTS 1024
+class Poller
+{
+public:
+    // 创建epoll描述符
+    Poller()
+    {
+        _epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epfd < 0)
+        {
+            ERR_LOG("Epoll Create ERR");
+            abort();
+        }
+    }
+    // 更新一个事件的监控事件或着将一个事件添加到监控中
+    void UpdateEvent(Channel *channel)
+    {
+        bool ret = IsExist(channel);
+        if (ret)
+            // 存在，进行修改更新
+            return Update(channel, EPOLL_CTL_MOD);
+        else
+        {
+            // 不存在直接添加
+            _channels[channel->GetFd()] = channel;
+            return Update(channel, EPOLL_CTL_ADD);
+        }
+    }
+
+    // 移除监控
+    void RemoveEvent(Channel *channel)
+    {
+        auto it = _channels.find(channel->GetFd());
+        if (it != _channels.end())
+            _channels.erase(channel->GetFd());
+
+        Update(channel, EPOLL_CTL_DEL);
+    }
+
+    // 开始监控，返回就绪链接数量；timeout 为毫秒，-1 永久阻塞，0 立即返回(忙轮询)
+    int Poll(std::vector<Channel *> *active, int timeout = -1)
+    {
+        // int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+        int nfds = epoll_wait(_epfd, _evs, MAX_EPOLLEREVENTS, timeout);
+        if (nfds < 0)
+        {
+            if (errno == EINTR)
+                return 0;
+            ERR_LOG("Epoll wait ERR");
+            abort();
+        }
+
+        // nfds就是就绪的事件数量
+        // 内核在 events 数组中，写入了 返回值个 epoll_event
+        // events[0] ~ events[n-1] 是有效的
+        // 每一个 epoll_event 对应一个 就绪的 fd / Channel
+        for (int i = 0; i < nfds; i++)
+        {
+            auto it = _channels.find(_evs[i].data.fd);
+            assert(it != _channels.end());
+            it->second->SetRevents(_evs[i].events);
+            active->push_back(it->second);
+        }
+        return nfds;
+    }
+
+    ~Poller()
+    {
+        close(_epfd);
+    }
+
+private:
+    void Update(Channel *channel, int op) // epoll_ctl对epoll的直接操作
+    {
+        // int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+        epoll_event ev;
+        ev.events = channel->GetEvent();
+        ev.data.fd = channel->GetFd();
+        int ret = epoll_ctl(_epfd, op, channel->GetFd(), &ev);
+        if (ret < 0)
+            ERR_LOG("Epoll_ctl error: %s", strerror(errno));
+        return;
+    }
+
+    // 判断一个channel是否已经添加了事件的监控(是否已经管理)
+    bool IsExist(Channel *channel)
+    {
+        auto it = _channels.find(channel->GetFd());
+        if (it == _channels.end())
+            return false;
+        return true;
+    }
+
+private:
+    int _epfd;
+    struct epoll_event _evs[MAX_EPOLLEREVENTS];
+    std::unordered_map<int, Channel *> _channels;
+};
+
+// ================================================================
+//                            TimerWheel模块
+// ================================================================
+// 秒级时间轮(见 Prerequisite/timerwheel.cpp)：
+//   - 槽位持有任务的 shared_ptr，索引表只保存 weak_ptr；槽位清空时任务析构，未取消则执行回调
+//   - 刷新任务即在新的槽位再放一份 shared_ptr，引用计数归零之前不会执行
+//   - 由 timerfd 每秒驱动一次，任务节点从所属线程的 Arena 中分配
+//   - 超过一圈的延迟记下剩余圈数，指针经过时圈数减一后留在原槽位，减到 0 后才释放
+//   - 所有接口只能在所属 EventLoop 线程中调用，跨线程使用 EventLoop::TimerAdd 等接口
+#define TIMER_WHEEL_CAPACITY 60 // 一圈 60 秒
+
+using TaskFunc = std::function<void()>;
+using ReleaseFunc = std::function<void()>;
+
+class TimerTask
+{
+public:
+    TimerTask(uint64_t id, uint32_t timeout, const TaskFunc &cb)
+        : _id(id), _timeout(timeout), _task_cb(cb), _canceled(false)
+    { }
+
+    ~TimerTask()
+    {
+        if (_canceled == false)
+        {
+            if (LoopMetrics *m = LoopMetrics::Current())
+                m->timer_fires.Add();
+            _task_cb();
+        }
+        _release_cb();
+    }
+
+    void SetRelease(const ReleaseFunc &cb)
+    {
+        _release_cb = cb;
+    }
+    uint32_t DelayTime()
+    {
+        return _timeout;
+    }
+    void Cancel()
+    {
+        _canceled = true;
+    }
+
+private:
+    uint64_t _id;
+    uint32_t _timeout;       // 超时时间(秒)
+    TaskFunc _task_cb;       // 到期执行的回调
+    ReleaseFunc _release_cb; // 从时间轮索引中移除
+    bool _canceled;
+};
+
+class TimerWheel : private ChannelOwner<TimerWheel>
+{
+public:
+    using PtrTask = std::shared_ptr<TimerTask>;
+    using WeakTask = std::weak_ptr<TimerTask>;
+
+    TimerWheel(EventLoop *loop)
+        : _tick(0), _capacity(TIMER_WHEEL_CAPACITY), _wheel(_capacity), _loop(loop), _timerfd(CreateTimerFd()),
+          _timer_channel(new StaticChannel<TimerWheel>(loop, _timerfd, this))
+    {
+        _timer_channel->EnableRead();
+    }
+
+    ~TimerWheel()
+    {
+        _timer_channel->DisableAll();
+        _timer_channel->Remove();
+        close(_timerfd);
+        // 析构时不执行尚未到期的任务
+        for (auto &it : _timers)
+        {
+            PtrTask pt = it.second.lock();
+            if (pt)
+                pt->Cancel();
+        }
+        // 任务析构时会回调 RemoveTimer，必须在 _timers 销毁之前释放
+        _wheel.clear();
+    }
+
+    void TimerAdd(uint64_t id, uint32_t delay, const TaskFunc &cb)
+    {
+        PtrTask pt = std::allocate_shared<TimerTask>(ArenaAllocator<TimerTask>(), id, delay, cb);
+        pt->SetRelease(std::bind(&TimerWheel::RemoveTimer, this, id));
+        Schedule(pt, delay);
+        _timers[id] = WeakTask(pt);
+    }
+
+    // 刷新/延迟定时任务
+    void TimerRefresh(uint64_t id)
+    {
+        auto it = _timers.find(id);
+        if (it == _timers.end())
+            return;
+        PtrTask pt = it->second.lock();
+        if (!pt)
+            return;
+        Schedule(pt, pt->DelayTime());
+    }
+
+    void TimerCancel(uint64_t id)
+    {
+        auto it = _timers.find(id);
+        if (it == _timers.end())
+            return;
+        PtrTask pt = it->second.lock();
+        if (pt)
+            pt->Cancel();
+    }
+
+    bool HasTimer(uint64_t id)
+    {
+        return _timers.find(id) != _timers.end();
+    }
+
+private:
+    struct Entry
+    {
+        PtrTask task;
+        uint32_t rounds; // 指针还要经过该槽位几次才释放
+    };
+
+    // 放入 delay 秒后经过的槽位；delay 为一圈的整数倍时第一次经过就在一整圈之后
+    void Schedule(const PtrTask &pt, uint32_t delay)
+    {
+        uint32_t rounds = delay > 0 ? (delay - 1) / _capacity : 0;
+        _wheel[(_tick + delay) % _capacity].push_back(Entry{pt, rounds});
+    }
+
+    static int CreateTimerFd()
+    {
+        int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0)
+        {
+            ERR_LOG("Timerfd Create ERR");
+            abort();
+        }
+        struct itimerspec itime;
+        itime.it_value.tv_sec = 1;
+        itime.it_value.tv_nsec = 0;
+        itime.it_interval.tv_sec = 1; // 第一次超时后每秒触发一次
+        itime.it_interval.tv_nsec = 0;
+        timerfd_settime(timerfd, 0, &itime, nullptr);
+        return timerfd;
+    }
+
+    void RemoveTimer(uint64_t id)
+    {
+        auto it = _timers.find(id);
+        if (it != _timers.end())
+            _timers.erase(it);
+    }
+
+    // 读取超时次数，事件处理耗时较长时一次可能错过多个 tick
+    int ReadTimerFd()
+    {
+        uint64_t times = 0;
+        int ret = read(_timerfd, &times, sizeof(times));
+        if (ret < 0)
+            return 0;
+        return times;
+    }
+
+    // 指针前进一格，取出槽位后再释放，回调中可以安全地添加/刷新任务；还有剩余圈数的任务放回原槽位
+    void RunTimerTask()
+    {
+        _tick = (_tick + 1) % _capacity;
+        std::vector<Entry> expired;
+        expired.swap(_wheel[_tick]);
+        for (auto &entry : expired)
+        {
+            if (entry.rounds > 0)
+                _wheel[_tick].push_back(Entry{std::move(entry.task), entry.rounds - 1});
+        }
+        expired.clear();
+    }
+
+    friend class StaticChannel<TimerWheel>;
+
+    // timerfd 可读：每超时一次前进一格
+    void HandleRead()
+    {
+        int times = ReadTimerFd();
+        for (int i = 0; i < times; i++)
+            RunTimerTask();
+    }
+
+private:
+    int _tick;     // 当前秒针
+    int _capacity; // 时间轮容量
+    std::vector<std::vector<Entry>> _wheel;
+    std::unordered_map<uint64_t, WeakTask> _timers;
+    EventLoop *_loop;
+    int _timerfd;
+    std::unique_ptr<Channel> _timer_channel;
+};
+
+// ================================================================
+//                            EventPoll模块
+// ================================================================
+
+// 1.对事件进行监控 2.就绪事件处理 3.执行任务
+// 自适应忙轮询：每轮先以 timeout=0 轮询至多 spin 微秒，仍无事件再阻塞在 epoll_wait。
+// spin 跟随事件到达间隔的滑动平均调整为其两倍(限制在 [BUSY_POLL_MIN_US, 上限] 内)，
+// 到达间隔超过上限时降到最小值，空闲时几乎不占用 CPU
+#define BUSY_POLL_MIN_US 2
+
+class EventLoop : private ChannelOwner<EventLoop>
+{
+public:
+    using Functor = std::function<void()>;
+    EventLoop()
+    :_thread_id(std::this_thread::get_id())
+    ,_eventfd(CreateEventFd())
+    ,_eventfd_channel(new StaticChannel<EventLoop>(this, _eventfd, this))
+    ,_metrics(MetricsRegistry::Instance().Register())
+    ,_spin_max_us(0)
+    ,_spin_us(0)
+    ,_gap_avg_us(0)
+    ,_arena(nullptr)
+    ,_quit(false)
+    ,_next_timer_id(0)
+    ,_timer_wheel(this)
+    {
+        LoopMetrics::Current() = _metrics; // EventLoop 在其运行的线程中创建
+        _metrics->probe.tid = pthread_self();
+        _eventfd_channel->EnableRead(); // 启动对读事件的监控        
+    }
+
+    ~EventLoop()
+    {
+        if(_arena)
+        {
+            if(LoopArena::Current() == _arena)
+                LoopArena::Current() = nullptr;
+            LoopArena::Retire(_arena);
+        }
+        if(LoopMetrics::Current() == _metrics)
+            LoopMetrics::Current() = nullptr;
+        MetricsRegistry::Instance().Retire(_metrics);
+    }
+
+    // 启动eventloop
+    void Start()
+    {
+        std::vector<Channel*> actives;
+        // 事件监控
+        if(_spin_max_us > 0)
+            BusyPoll(&actives);
+        else
+            _poll.Poll(&actives);
+        uint64_t begin = MonotonicMicros(); // 阻塞等待的时间不计入循环耗时
+        LoopProbe &probe = _metrics->probe;
+        probe.iter_seq.store(probe.iter_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        probe.iter_begin_us.store(begin, std::memory_order_release);
+        _metrics->polls.Add();
+        _metrics->events.Add(actives.size());
+        _metrics->events_per_poll.Observe(actives.size());
+
+        // 事件处理
+        for(auto& ch : actives)
+            ch->HandleEvent();
+
+        // 执行任务(将任务队列中的任务全部执行一次)
+        RunAllTasks();
+        probe.iter_begin_us.store(0, std::memory_order_release);
+        _metrics->iteration_us.Observe(MonotonicMicros() - begin);
+    }
+
+    // 循环运行直到 Quit
+    void Loop()
+    {
+        while(!_quit.load(std::memory_order_acquire))
+            Start();
+    }
+
+    // 任意线程调用：当前这一轮结束后 Loop 返回
+    void Quit()
+    {
+        _quit.store(true, std::memory_order_release);
+        if(!IsInLoop())
+            WeakUpEventFd();
+    }
+
+    bool IsQuit()
+    {
+        return _quit.load(std::memory_order_acquire);
+    }
+
+    // 定时任务：delay 秒后执行 cb(精度 1 秒，延迟不受时间轮一圈的限制)，id 由调用者保证唯一
+    void TimerAdd(uint64_t id, uint32_t delay, const TaskFunc& cb)
+    {
+        RunInLoop(std::bind(&TimerWheel::TimerAdd, &_timer_wheel, id, delay, cb));
+    }
+    void TimerRefresh(uint64_t id)
+    {
+        RunInLoop(std::bind(&TimerWheel::TimerRefresh, &_timer_wheel, id));
+    }
+    void TimerCancel(uint64_t id)
+    {
+        RunInLoop(std::bind(&TimerWheel::TimerCancel, &_timer_wheel, id));
+    }
+    // 只能在所属线程中调用
+    bool HasTimer(uint64_t id)
+    {
+        AssertInLoop();
+        return _timer_wheel.HasTimer(id);
+    }
+    // delay 秒后执行一次 cb，返回可用于取消的 id(最高位置 1，不与调用者自定的 id 冲突)
+    uint64_t RunAfter(uint32_t delay, const TaskFunc& cb)
+    {
+        uint64_t id = (1ULL << 63) | _next_timer_id.fetch_add(1, std::memory_order_relaxed);
+        TimerAdd(id, delay, cb);
+        return id;
+    }
+
+    // 本EventLoop的指标
+    LoopMetrics& Metrics()
+    {
+        return *_metrics;
+    }
+
+    // 开启自适应忙轮询，max_us 为单轮最长轮询时间，0 关闭。只能在所属线程中调用
+    void SetBusyPoll(uint64_t max_us)
+    {
+        AssertInLoop();
+        _spin_max_us = max_us;
+        _spin_us = max_us;
+        _gap_avg_us = 0;
+        _metrics->spin_budget_us.Set(_spin_us);
+    }
+    uint64_t BusyPollBudget()
+    {
+        return _spin_us;
+    }
+
+    // 启用本地内存区：之后在本线程中创建的 Buffer 存储与 Connection 对象都从中分配。
+    // 只能在所属线程中调用，应先绑核(节点在启用时确定)
+    void EnableArena(const ArenaOptions& opts = ArenaOptions())
+    {
+        AssertInLoop();
+        if(_arena)
+            return;
+        _arena = new LoopArena(opts);
+        LoopArena::Current() = _arena;
+    }
+    LoopArena* Arena()
+    {
+        return _arena;
+    }
+    
+    // 在当前线程中则直接执行，否则压入任务队列
+    void RunInLoop(const Functor& cb)
+    {
+        if(IsInLoop())
+            return cb();
+        return QueueInLoop(cb);
+    }
+
+    // 压入任务队列，并唤醒可能阻塞在epoll_wait上的线程
+    void QueueInLoop(const Functor& cb)
+    {
+        {
+            std::unique_lock<std::mutex> _lock(_mtx);
+            _tasks.push_back(cb);
+        }
+        WeakUpEventFd();
+    }
+
+    // 判断当前线程是否是EventLoop所在的线程
+    bool IsInLoop()
+    {
+        return _thread_id == std::this_thread::get_id();
+    }
+
+    void AssertInLoop()
+    {
+        assert(_thread_id == std::this_thread::get_id());
+    }
+
+    void UpdateEvent(Channel* channel)
+    {
+        _poll.UpdateEvent(channel);
+    }
+
+    void RemoveEvent(Channel* channel)
+    {
+        _poll.RemoveEvent(channel);
+    }
+private:
+    friend class StaticChannel<EventLoop>;
+
+    // eventfd 可读：清空计数
+    void HandleRead()
+    {
+        uint64_t res = 0;
+        int ret = read(_eventfd, &res, sizeof(res));
+        if(ret < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN)
+                return;
+            ERR_LOG("Read Eventfd ERR");
+            abort();
+        }
+    }
+
+    void BusyPoll(std::vector<Channel*>* actives)
+    {
+        uint64_t start = MonotonicMicros();
+        uint64_t now = start;
+        do
+        {
+            if(_poll.Poll(actives, 0) > 0)
+            {
+                _metrics->spin_hits.Add();
+                AdaptSpin(MonotonicMicros() - start);
+                return;
+            }
+            now = MonotonicMicros();
+        } while(now - start < _spin_us);
+        _metrics->spin_misses.Add();
+        _poll.Poll(actives, -1);
+        AdaptSpin(MonotonicMicros() - start);
+    }
+
+    // 用本轮等待事件的时间更新到达间隔的滑动平均(1/8 权重)，长时间空闲的样本截断避免拖慢恢复
+    void AdaptSpin(uint64_t gap)
+    {
+        gap = std::min(gap, _spin_max_us * 4);
+        _gap_avg_us = _gap_avg_us == 0 ? gap : (_gap_avg_us * 7 + gap) / 8;
+        if(_gap_avg_us > _spin_max_us)
+            _spin_us = BUSY_POLL_MIN_US;
+        else
+            _spin_us = std::max<uint64_t>(BUSY_POLL_MIN_US, std::min(_spin_max_us, _gap_avg_us * 2));
+        _metrics->spin_budget_us.Set(_spin_us);
+    }
+
+public:
+    static int CreateEventFd()
+    {
+        int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); // 设置初始计数器为0， 禁止子进程复制，非阻塞
+        if(efd < 0)
+        {
+            ERR_LOG("Eventfd ERR");
+            abort();
+        }        
+        return efd;
+    }
+
+    // 向eventfd写入一次通知，唤醒事件监控
+    void WeakUpEventFd()
+    {
+        uint64_t val = 1;
+        int ret = write(_eventfd, &val, sizeof(val));
+        if(ret < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN)
+                return;
+            ERR_LOG("Write Eventfd ERR");
+            abort();
+        }
+    }
+
+    // 执行任务队列中的任务
+    void RunAllTasks()
+    {
+        std::vector<Functor> functor;
+        {
+            std::unique_lock<std::mutex> _lock(_mtx); // 用花括号限定作用域，出了作用域锁会自动释放
+            _tasks.swap(functor); // 清空现有的任务队列，并执行任务
+        }
+        _metrics->task_queue_depth.Set(functor.size());
+        _metrics->task_depth.Observe(functor.size());
+        _metrics->tasks.Add(functor.size());
+        for(auto& e : functor)
+        {
+            CallbackScope scope(-1, CB_TASK);
+            e();
+        }
+    }
+private:    
+    std::thread::id _thread_id; // 判断回调的任务在不在当前线程中，如果在当前线程就直接执行，如果不在就添加到任务队列中
+    std::vector<Functor> _tasks; // 任务队列
+    std::mutex _mtx; // 给任务队列加的锁
+    Poller _poll; // 对事件进行监控
+    int _eventfd; // 用于解决监控IO事件阻塞导致任务队列中的任务无法执行的错误
+    std::unique_ptr<Channel> _eventfd_channel; // 管理enventfd  
+    LoopMetrics* _metrics; // 本线程的指标
+    uint64_t _spin_max_us; // 忙轮询上限，0 表示不忙轮询
+    uint64_t _spin_us;     // 当前忙轮询时长
+    uint64_t _gap_avg_us;  // 事件到达间隔的滑动平均
+    LoopArena* _arena;     // 本地内存区，销毁时退役(内存全部归还后才释放)
+    std::atomic<bool> _quit;
+    std::atomic<uint64_t> _next_timer_id;
+    TimerWheel _timer_wheel; // 最后声明：析构时最先移除定时器的监控
+};
+
+void Channel::Update()
+{
+    _loop->UpdateEvent(this);
+}
+void Channel::Remove()
+{
+    _loop->RemoveEvent(this);
+}
+
+// ================================================================
+//                            Any模块
+// ================================================================
+// 通用类型容器：连接的协议处理上下文(例如 HTTP 请求解析状态)保存在这里
+class Any
+{
+public:
+    Any()
+        : _content(nullptr)
+    { }
+
+    template <class T>
+    Any(const T &val)
+        : _content(new PlaceHolder<T>(val))
+    { }
+
+    Any(const Any &other)
+        : _content(other._content ? other._content->clone() : nullptr)
+    { }
+
+    ~Any()
+    {
+        delete _content;
+    }
+
+    Any &swap(Any &other)
+    {
+        std::swap(_content, other._content);
+        return *this;
+    }
+
+    // 获取保存的数据的指针
+    template <class T>
+    T *Get()
+    {
+        assert(_content != nullptr && typeid(T) == _content->type());
+        return &((PlaceHolder<T> *)_content)->_val;
+    }
+
+    bool Empty() const
+    {
+        return _content == nullptr;
+    }
+
+    template <class T>
+    Any &operator=(const T &val)
+    {
+        Any(val).swap(*this);
+        return *this;
+    }
+
+    Any &operator=(const Any &other)
+    {
+        Any(other).swap(*this);
+        return *this;
+    }
+
+private:
+    class Holder
+    {
+    public:
+        virtual ~Holder() { }
+        virtual const std::type_info &type() = 0;
+        virtual Holder *clone() = 0;
+    };
+
+    template <class T>
+    class PlaceHolder : public Holder
+    {
+    public:
+        PlaceHolder(const T &val)
+            : _val(val)
+        { }
+        virtual const std::type_info &type()
+        {
+            return typeid(T);
+        }
+        virtual Holder *clone()
+        {
+            return new PlaceHolder(_val);
+        }
+
+    public:
+        T _val;
+    };
+    Holder *_content;
+};
+
+// ================================================================
+//                            Connection模块
+// ================================================================
+// 连接对象不再随accept new/delete，而是由所属EventLoop的ConnectionPool统一管理：
+//   1. Connection、两个Buffer以及Channel作为一个整体被复用，回调只在构造时绑定一次
+//   2. 槽位回收时代数(generation)加一，其他线程持有的ConnHandle因代数不匹配自动失效
+//   3. Connection* 只允许在所属EventLoop线程中使用，跨线程只传递ConnHandle
+
+typedef enum
+{
+    DISCONNECTED,  // 连接已关闭(槽位空闲)
+    CONNECTING,    // 已分配，等待Established
+    CONNECTED,     // 连接建立完成，可以通信
+    DISCONNECTING  // 待关闭状态，等待发送缓冲区清空
+} ConnStatu;
+
+// 跨线程引用连接的句柄：(槽位下标, 代数)，代数为0表示无效句柄
+struct ConnHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    ConnHandle()
+        : index(0), generation(0)
+    { }
+    ConnHandle(uint32_t idx, uint32_t gen)
+        : index(idx), generation(gen)
+    { }
+    bool Valid() const
+    {
+        return generation != 0;
+    }
+    bool operator==(const ConnHandle &other) const
+    {
+        return index == other.index && generation == other.generation;
+    }
+};
+
+class Connection;
+class ConnectionPool;
+using ConnectedCallBack = std::function<void(Connection *)>;
+using MessageCallBack = std::function<void(Connection *, Buffer *)>;
+using ClosedCallBack = std::function<void(Connection *)>;
+using AnyEventCallBack = std::function<void(Connection *)>;
+using HighWaterMarkCallBack = std::function<void(Connection *, size_t)>;
+using LowWaterMarkCallBack = std::function<void(Connection *)>;
+using SpliceCallBack = std::function<void(Connection *, size_t)>;
+
+#define CONN_READ_SIZE 65536
+#define POOL_BUFFER_RETAIN_SIZE (64 * 1024) // 回收时Buffer超过该容量则释放，避免空闲槽位长期占用大块内存
+#define DEFAULT_HIGH_WATER_MARK (4 * 1024 * 1024)
+#define DEFAULT_LOW_WATER_MARK (1024 * 1024)
+#define DEFAULT_OUTPUT_BUDGET (1024ULL * 1024 * 1024)
+#define DEFAULT_ZEROCOPY_THRESHOLD (64 * 1024) // 小于该大小的数据走普通拷贝发送，零拷贝的页锁定和通知开销不划算
+
+// 连接之间转发数据用的内核管道：源连接用 splice 把套接字中的数据搬进管道(Connection::SpliceInput)，
+// 目标连接再从管道 splice 到自己的套接字(Connection::SendPipe)，数据只在内核页之间移动。
+// 同一时刻只有一个源连接写入；只在所属线程中使用
+class SplicePipe
+{
+public:
+    // size 为管道容量(F_SETPIPE_SZ)，0 表示内核默认值，超出 /proc/sys/fs/pipe-max-size 时保持默认
+    SplicePipe(size_t size = 0)
+        : _size(0), _capacity(0)
+    {
+        _fds[0] = _fds[1] = -1;
+        if (pipe2(_fds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            ERR_LOG("Pipe ERR: %s", strerror(errno));
+            return;
+        }
+        if (size > 0)
+            fcntl(_fds[1], F_SETPIPE_SZ, (int)size);
+        int cap = fcntl(_fds[1], F_GETPIPE_SZ);
+        _capacity = cap > 0 ? cap : 65536;
+    }
+    ~SplicePipe()
+    {
+        if (_fds[0] >= 0)
+            close(_fds[0]);
+        if (_fds[1] >= 0)
+            close(_fds[1]);
+    }
+
+    bool Ok()
+    {
+        return _fds[0] >= 0;
+    }
+    int ReadFd()
+    {
+        return _fds[0];
+    }
+    int WriteFd()
+    {
+        return _fds[1];
+    }
+    // 管道中尚未取出的字节数
+    size_t Size()
+    {
+        return _size;
+    }
+    size_t Capacity()
+    {
+        return _capacity;
+    }
+    // 管道中的数据被取出后调用(源连接据此恢复读取)
+    void SetDrainCallBack(const std::function<void()> &cb)
+    {
+        _drain_cb = cb;
+    }
+    void Filled(size_t len)
+    {
+        _size += len;
+    }
+    void Drained(size_t len)
+    {
+        _size -= len;
+        if (_drain_cb)
+            _drain_cb();
+    }
+    // 目标连接需要在用户态编码时读出数据，返回值同 read
+    ssize_t Read(char *buf, size_t len)
+    {
+        ssize_t ret = read(_fds[0], buf, len);
+        if (ret > 0)
+            Drained(ret);
+        return ret;
+    }
+
+private:
+    int _fds[2];
+    size_t _size;
+    size_t _capacity;
+    std::function<void()> _drain_cb;
+};
+
+// 排在输出缓冲区之后的待发送数据块
+// 零拷贝块持有调用者交出的数据引用，直到内核的完成通知到达才释放
+// 文件块用 sendfile 发送，最后一个引用释放时关闭文件描述符
+// 管道块用 splice 发送管道中接下来的 length 字节
+struct OutSegment
+{
+    std::shared_ptr<const std::string> block; // 零拷贝数据
+    std::string copy;                         // 普通拷贝数据(跟在零拷贝块后面的小数据)
+    std::shared_ptr<int> file;                // 文件块的描述符
+    std::shared_ptr<SplicePipe> pipe;         // 管道块
+    off_t offset;                             // 文件块起始偏移
+    size_t length;                            // 文件块/管道块长度
+    size_t sent;                              // 已交给内核的字节数
+    uint32_t last_seq;                        // 最后一次 MSG_ZEROCOPY 发送的序号
+    bool zerocopy;
+
+    OutSegment()
+        : offset(0), length(0), sent(0), last_seq(0), zerocopy(false)
+    { }
+    const char *Data() const
+    {
+        return zerocopy ? block->data() : copy.data();
+    }
+    size_t Size() const
+    {
+        if (file || pipe)
+            return length;
+        return zerocopy ? block->size() : copy.size();
+    }
+    // 普通拷贝块，后续的拷贝数据可以继续追加在后面
+    bool Appendable() const
+    {
+        return !zerocopy && !file && !pipe;
+    }
+};
+
+// ================================================================
+//                        TransportFilter模块
+// ================================================================
+// 位于套接字与连接缓冲区之间的传输层(如 TLS)，只在连接所属线程中调用。
+// wire 为要原样发给对端的字节，由连接放入输出队列
+class TransportFilter
+{
+public:
+    virtual ~TransportFilter() { }
+    // 解码收到的数据，明文写入 plain；返回 false 时连接发出 wire 中的数据(如告警)后关闭
+    virtual bool Decode(const char *data, size_t len, Buffer *plain, Buffer *wire) = 0;
+    // 编码待发送的明文；握手完成前先暂存，之后在 Decode/OnDrained 中写出
+    virtual bool Encode(const char *data, size_t len, Buffer *wire) = 0;
+    // 为 true 时明文直接写入套接字(如内核 TLS)，不再调用 Encode
+    virtual bool Passthrough() = 0;
+    // 输出队列已全部交给内核，可以在这里切换套接字的发送方式
+    virtual void OnDrained(int fd, Buffer *wire) = 0;
+    // 连接即将关闭，写出关闭通知
+    virtual void Close(Buffer *wire) = 0;
+};
+using TransportFilterFactory = std::function<TransportFilter *()>;
+
+// 所有连接输出缓冲区的全局内存预算(进程级)
+// 超出预算后：新数据会让发送方暂停读取；已经积压超过高水位的慢连接直接断开
+class OutputBudget
+{
+public:
+    // 设置全局上限，0 表示不限制
+    static void SetLimit(uint64_t bytes)
+    {
+        Limit().store(bytes, std::memory_order_relaxed);
+    }
+    static uint64_t GetLimit()
+    {
+        return Limit().load(std::memory_order_relaxed);
+    }
+    // 当前所有连接待发送数据总量
+    static uint64_t Used()
+    {
+        return Usage().load(std::memory_order_relaxed);
+    }
+    static void Charge(uint64_t len)
+    {
+        Usage().fetch_add(len, std::memory_order_relaxed);
+    }
+    static void Refund(uint64_t len)
+    {
+        Usage().fetch_sub(len, std::memory_order_relaxed);
+    }
+    static bool Exceeded()
+    {
+        uint64_t limit = GetLimit();
+        return limit != 0 && Used() > limit;
+    }
+
+private:
+    static std::atomic<uint64_t> &Limit()
+    {
+        static std::atomic<uint64_t> limit(DEFAULT_OUTPUT_BUDGET);
+        return limit;
+    }
+    static std::atomic<uint64_t> &Usage()
+    {
+        static std::atomic<uint64_t> used(0);
+        return used;
+    }
+};
+
+class Connection : private ChannelOwner<Connection>
+{
+public:
+    Connection(ConnectionPool *pool, EventLoop *loop, uint32_t index)
+        : _pool(pool), _loop(loop), _index(index), _generation(1), _status(DISCONNECTED), _channel(loop, -1, this),
+          _high_water_mark(DEFAULT_HIGH_WATER_MARK), _low_water_mark(DEFAULT_LOW_WATER_MARK), _read_paused(false),
+          _input_paused(false), _quickack(false), _seg_bytes(0), _plain_bytes(0), _zc_threshold(0), _zc_seq(0), _zc_copied(0),
+          _splice_left(0), _splice_paused(false)
+    { }
+    ~Connection()
+    { }
+
+    // 连接对象由 ConnectionPool 在所属线程中创建，从该线程的 Arena 分配
+    static void *operator new(size_t n)
+    {
+        return LoopArena::Allocate(n);
+    }
+    static void operator delete(void *p)
+    {
+        LoopArena::Free(p);
+    }
+
+    ConnHandle Handle() const
+    {
+        return ConnHandle(_index, _generation);
+    }
+    int GetFd()
+    {
+        return _socket.GetFd();
+    }
+    EventLoop *Loop()
+    {
+        return _loop;
+    }
+    ConnectionPool *Pool()
+    {
+        return _pool;
+    }
+    ConnStatu Status()
+    {
+        return _status;
+    }
+    // 输入缓冲区(在所属线程中继续处理之前暂缓的数据时使用)
+    Buffer *InBuffer()
+    {
+        return &_in_buffer;
+    }
+    bool Connected()
+    {
+        return _status == CONNECTED;
+    }
+
+    void SetConnectedCallBack(const ConnectedCallBack &cb)
+    {
+        _connected_cb = cb;
+    }
+    void SetMessageCallBack(const MessageCallBack &cb)
+    {
+        _message_cb = cb;
+    }
+    void SetClosedCallBack(const ClosedCallBack &cb)
+    {
+        _closed_cb = cb;
+    }
+    void SetAnyEventCallBack(const AnyEventCallBack &cb)
+    {
+        _event_cb = cb;
+    }
+    // 输出缓冲区超过高水位：暂停读取对端数据，并回调当前积压量
+    void SetHighWaterMarkCallBack(const HighWaterMarkCallBack &cb)
+    {
+        _high_water_cb = cb;
+    }
+    // 输出缓冲区回落到低水位：恢复读取
+    void SetLowWaterMarkCallBack(const LowWaterMarkCallBack &cb)
+    {
+        _low_water_cb = cb;
+    }
+    void SetWaterMark(size_t low, size_t high)
+    {
+        assert(low <= high);
+        _low_water_mark = low;
+        _high_water_mark = high;
+    }
+    // 尚未交给内核的待发送数据量(输出缓冲区 + 数据块 + 等待传输层编码的明文)
+    size_t PendingOutput()
+    {
+        return _out_buffer.ReadAbleSize() + _seg_bytes + _plain_bytes;
+    }
+    // 已交给内核、等待完成通知的零拷贝数据块数量
+    size_t ZeroCopyInflight()
+    {
+        return _zc_inflight.size();
+    }
+    // 内核退回普通拷贝的零拷贝发送次数
+    uint64_t ZeroCopyCopied()
+    {
+        return _zc_copied;
+    }
+    // 开启零拷贝发送，threshold 以上的数据块使用 MSG_ZEROCOPY
+    // 内核不支持时返回false，继续使用普通拷贝
+    bool EnableZeroCopy(size_t threshold = DEFAULT_ZEROCOPY_THRESHOLD)
+    {
+        _loop->AssertInLoop();
+        if (!_socket.EnableZeroCopy())
+            return false;
+        _zc_threshold = threshold > 0 ? threshold : 1;
+        return true;
+    }
+    // 是否因背压暂停了读取
+    bool ReadPaused()
+    {
+        return _read_paused;
+    }
+    // 应用层暂停/恢复读取(如流式请求体的处理方来不及消费)，与输出积压导致的暂停相互独立，
+    // 两者都解除后才重新监控读事件。恢复后输入缓冲区中剩余的数据需由调用者自行处理
+    void PauseInput()
+    {
+        _loop->AssertInLoop();
+        _input_paused = true;
+        if (_status != DISCONNECTED && _channel.ReadAble())
+            _channel.DisableRead();
+    }
+    void ResumeInput()
+    {
+        _loop->AssertInLoop();
+        _input_paused = false;
+        if (_status == CONNECTED && !_read_paused && !_splice_paused && !_channel.ReadAble())
+            _channel.EnableRead();
+    }
+    bool InputPaused()
+    {
+        return _input_paused;
+    }
+    size_t HighWaterMark()
+    {
+        return _high_water_mark;
+    }
+    // 设置/获取协议上下文(槽位回收时清空)
+    void SetContext(const Any &context)
+    {
+        _context = context;
+    }
+    Any *GetContext()
+    {
+        return &_context;
+    }
+    // 对端地址；对端进程的身份(仅 Unix 套接字，见 Socket::PeerCred)
+    SockAddr PeerAddress()
+    {
+        return SockAddr::Peer(_socket.GetFd());
+    }
+    bool PeerCred(struct ucred *cred)
+    {
+        return _socket.PeerCred(cred);
+    }
+    // 对已接受的连接应用调优配置
+    void ApplySocketOptions(const SocketOptions &opts)
+    {
+        _socket.ApplyOptions(opts, false);
+        _quickack = opts.tcp_quickack;
+    }
+
+    // 连接就绪：启动读事件监控，调用连接建立回调
+    void Established()
+    {
+        _loop->RunInLoop(std::bind(&Connection::EstablishedInLoop, this));
+    }
+    // 发送数据：在所属线程中直接写入发送缓冲区，跨线程请使用 ConnectionPool::Send(ConnHandle, ...)
+    void Send(const char *data, size_t len)
+    {
+        _loop->AssertInLoop();
+        SendInLoop(data, len);
+    }
+    // 发送一整块数据：达到零拷贝阈值时不再拷贝进输出缓冲区，由连接持有引用直到内核释放
+    // 适合大响应体(生成的下载文件、代理的数据块)，未开启零拷贝或低于阈值时自动走普通拷贝
+    void SendBlock(const std::shared_ptr<const std::string> &block)
+    {
+        _loop->AssertInLoop();
+        SendBlockInLoop(block);
+    }
+    // 发送文件 [offset, offset + len)，连接接管 file_fd 并在发送完或关闭时关闭它。
+    // 排在前面的数据发送完后用 sendfile 发送；传输层需要在用户态编码(如未开启内核 TLS)时，
+    // 随着输出队列的消耗分块读入后编码，内存占用与文件大小无关
+    void SendFile(int file_fd, off_t offset, size_t len)
+    {
+        _loop->AssertInLoop();
+        SendFileInLoop(file_fd, offset, len);
+    }
+    // 发送管道中接下来的 len 字节(由另一个连接的 SpliceInput 搬入)，排在前面的数据发送完后用 splice 发送；
+    // 传输层需要在用户态编码时随输出的消耗分块读出后编码，管道满时源连接暂停搬入
+    void SendPipe(const std::shared_ptr<SplicePipe> &pipe, size_t len)
+    {
+        _loop->AssertInLoop();
+        SendPipeInLoop(pipe, len);
+    }
+    // 接下来的 len 字节(0 表示直到对端关闭)不再读入输入缓冲区，而是用 splice 搬进 pipe，每搬入一段回调一次，
+    // 回调中通常把这一段交给目标连接的 SendPipe。管道满时暂停读取，目标连接取走数据后自动恢复；
+    // 搬完 len 字节后恢复普通读取(回调中 Splicing() 已为 false)。调用时输入缓冲区须为空，不能有传输层
+    void SpliceInput(const std::shared_ptr<SplicePipe> &pipe, uint64_t len, const SpliceCallBack &cb);
+    bool Splicing()
+    {
+        return _splice_pipe != nullptr;
+    }
+    // 关闭连接：发送缓冲区中的数据发送完毕后才真正释放
+    void Shutdown()
+    {
+        _loop->AssertInLoop();
+        ShutdownInLoop();
+    }
+    // 设置传输层(接管所有权)，须在 Established 之前调用
+    void SetTransportFilter(TransportFilter *filter)
+    {
+        assert(_status == CONNECTING);
+        _filter.reset(filter);
+    }
+    TransportFilter *GetTransportFilter()
+    {
+        return _filter.get();
+    }
+
+private:
+    friend class ConnectionPool;
+    friend class StaticChannel<Connection>;
+
+    // 从对象池中取出时绑定新的fd
+    void Reset(int fd)
+    {
+        _socket.Reset(fd);
+        _channel.ResetFd(fd);
+        _status = CONNECTING;
+        _read_paused = false;
+        _input_paused = false;
+        _quickack = false;
+        _zc_threshold = 0;
+        _zc_seq = 0;
+        _zc_copied = 0;
+        _splice_left = 0;
+        _splice_paused = false;
+    }
+
+    // 描述符可读事件触发
+    void HandleRead()
+    {
+        if (_splice_pipe)
+            return SpliceRead();
+        char buf[CONN_READ_SIZE];
+        ssize_t ret = _socket.NonBlockRecv(buf, sizeof(buf));
+        if (ret < 0)
+            return ShutdownInLoop(); // 出错或对端关闭，处理完剩余数据再释放
+        if (_quickack)
+            _socket.QuickAck();
+        _loop->Metrics().bytes_in.Add(ret);
+        if (_filter)
+        {
+            if (!FilterInput(buf, ret))
+                return;
+        }
+        else
+            _in_buffer.Write(buf, ret);
+        if (_in_buffer.ReadAbleSize() > 0 && _message_cb)
+            _message_cb(this, &_in_buffer);
+        CloseIfDrained();
+    }
+
+    // 直通模式下的读事件：数据搬进管道，不经过输入缓冲区
+    void SpliceRead()
+    {
+        std::shared_ptr<SplicePipe> pipe = _splice_pipe; // 回调中可能结束直通
+        size_t want = pipe->Capacity();
+        if (_splice_left > 0)
+            want = std::min<uint64_t>(want, _splice_left);
+        ssize_t ret = _socket.SpliceToPipe(pipe->WriteFd(), want);
+        if (ret < 0)
+            return ShutdownInLoop();
+        if (ret == 0)
+        {
+            // 管道中还有数据时按管道已满处理，等目标连接取走后再读(水平触发下不能空转)
+            if (pipe->Size() > 0 && !_splice_paused)
+            {
+                _splice_paused = true;
+                if (_channel.ReadAble())
+                    _channel.DisableRead();
+            }
+            return;
+        }
+        if (_quickack)
+            _socket.QuickAck();
+        _loop->Metrics().bytes_in.Add(ret);
+        pipe->Filled(ret);
+        SpliceCallBack cb = _splice_cb;
+        if (_splice_left > 0 && (_splice_left -= ret) == 0)
+        {
+            _splice_pipe.reset();
+            _splice_cb = nullptr;
+        }
+        cb(this, ret);
+    }
+
+    // 管道中的数据被目标连接取走
+    void ResumeSplice()
+    {
+        if (!_splice_paused)
+            return;
+        _splice_paused = false;
+        if (_status == CONNECTED && !_read_paused && !_input_paused && !_channel.ReadAble())
+            _channel.EnableRead();
+    }
+
+    // 描述符可写事件触发
+    void HandleWrite()
+    {
+        if (_status == DISCONNECTED)
+            return;
+        size_t before = PendingOutput();
+        bool ok = true;
+        if (_out_buffer.ReadAbleSize() > 0)
+        {
+            ssize_t ret = _socket.NonBlockSend(_out_buffer.ReadPos(), _out_buffer.ReadAbleSize());
+            if (ret < 0)
+                ok = false;
+            else
+                _out_buffer.MoveReadOffset(ret);
+        }
+        // 输出缓冲区发送完毕后才能发送后面的数据块，保证顺序
+        if (ok && _out_buffer.ReadAbleSize() == 0)
+            ok = WriteSegments();
+        _loop->Metrics().bytes_out.Add(before - PendingOutput());
+        OutputBudget::Refund(before - PendingOutput());
+        if (!ok)
+        {
+            if (_in_buffer.ReadAbleSize() > 0 && _message_cb)
+                _message_cb(this, &_in_buffer);
+            return Release();
+        }
+        if (_read_paused && PendingOutput() <= _low_water_mark)
+            ResumeRead();
+        if (_filter && WireOutput() == 0)
+            FilterDrained();
+        if (!_plain_segments.empty())
+            EncodePlain();
+        if (WireOutput() == 0)
+        {
+            _channel.DisableWrite(); // 没有数据可写(待编码的明文等传输层就绪后产生输出时再开启)
+            if (_status == DISCONNECTING && PendingOutput() == 0 && _zc_inflight.empty())
+                return Release();
+            CloseIfDrained();
+        }
+    }
+
+    // 对象池正在优雅关闭且连接已空闲：不再等待新的请求，发送完剩余数据后关闭
+    void CloseIfDrained();
+
+    // 依次发送数据块，返回false表示发送出错
+    bool WriteSegments()
+    {
+        while (!_segments.empty())
+        {
+            OutSegment &seg = _segments.front();
+            const char *data = seg.Data() + seg.sent;
+            size_t len = seg.Size() - seg.sent;
+            ssize_t ret;
+            if (seg.file)
+                ret = _socket.SendFile(*seg.file, seg.offset + seg.sent, len);
+            else if (seg.pipe)
+            {
+                ret = _socket.SpliceFromPipe(seg.pipe->ReadFd(), len);
+                if (ret > 0)
+                    seg.pipe->Drained(ret);
+            }
+            else if (seg.zerocopy)
+            {
+                ret = _socket.SendZeroCopy(data, len);
+                if (ret > 0)
+                    seg.last_seq = _zc_seq++; // 内核对每次成功的零拷贝发送调用递增序号
+            }
+            else
+                ret = _socket.NonBlockSend((void *)data, len);
+            if (ret < 0)
+                return false;
+            if (ret == 0)
+                break; // 内核发送缓冲区已满
+            seg.sent += ret;
+            _seg_bytes -= ret;
+            if (seg.sent < seg.Size())
+                break;
+            if (seg.zerocopy)
+                _zc_inflight.push_back(std::move(seg)); // 等待完成通知后才释放数据
+            _segments.pop_front();
+        }
+        return true;
+    }
+
+    // 读取错误队列中的零拷贝完成通知，释放已完成的数据块
+    // 返回是否读到了通知(EPOLLERR 是由完成通知触发的)
+    bool ReapZeroCopy()
+    {
+        bool reaped = false;
+        uint32_t lo, hi;
+        bool copied;
+        while (_socket.ReadZeroCopyCompletion(&lo, &hi, &copied) == 1)
+        {
+            reaped = true;
+            if (copied)
+                _zc_copied += hi - lo + 1;
+            // TCP 按序确认，完成通知按序号递增到达
+            while (!_zc_inflight.empty() && (int32_t)(hi - _zc_inflight.front().last_seq) >= 0)
+                _zc_inflight.pop_front();
+        }
+        return reaped;
+    }
+
+    void HandleClose()
+    {
+        if (_status == DISCONNECTED)
+            return;
+        if (_in_buffer.ReadAbleSize() > 0 && _message_cb)
+            _message_cb(this, &_in_buffer);
+        Release();
+    }
+
+    void HandleError()
+    {
+        // 开启零拷贝后，完成通知同样以 EPOLLERR 的形式到达，并不是连接出错
+        if (_zc_threshold > 0 && ReapZeroCopy() && _socket.GetError() == 0)
+        {
+            uint32_t revents = _channel.GetRevents();
+            if (revents & (EPOLLIN | EPOLLPRI))
+                HandleRead();
+            if ((revents & EPOLLOUT) && _status != DISCONNECTED)
+                HandleWrite();
+            else if (_status == DISCONNECTING && PendingOutput() == 0 && _zc_inflight.empty())
+                Release();
+            return;
+        }
+        HandleClose();
+    }
+
+    void HandleEvent()
+    {
+        if (_event_cb)
+            _event_cb(this);
+    }
+
+    void EstablishedInLoop()
+    {
+        assert(_status == CONNECTING);
+        _status = CONNECTED;
+        _channel.EnableRead();
+        if (_connected_cb)
+            _connected_cb(this);
+    }
+
+    void SendInLoop(const char *data, size_t len)
+    {
+        if (!AdmitOutput())
+            return;
+        size_t pending = PendingOutput();
+        if (_filter && !_filter->Passthrough())
+        {
+            // 前面有待编码的明文时排在其后，保证按发送顺序编码
+            if (!_plain_segments.empty())
+            {
+                if (!_plain_segments.back().Appendable())
+                    _plain_segments.push_back(OutSegment());
+                _plain_segments.back().copy.append(data, len);
+                _plain_bytes += len;
+                return OutputCharged(pending, len);
+            }
+            Buffer *wire = WireBuffer();
+            size_t before = wire->ReadAbleSize();
+            bool ok = _filter->Encode(data, len, wire);
+            WireQueued(wire, pending, before);
+            if (!ok)
+            {
+                ERR_LOG("Transport encode failed, close fd:%d", GetFd());
+                ForceClose();
+            }
+            return;
+        }
+        if (_segments.empty())
+            _out_buffer.Write(data, len);
+        else
+        {
+            // 前面还有数据块未发送，追加到末尾的拷贝块中保证顺序
+            if (!_segments.back().Appendable())
+                _segments.push_back(OutSegment());
+            _segments.back().copy.append(data, len);
+            _seg_bytes += len;
+        }
+        OutputCharged(pending, len);
+    }
+
+    void SendBlockInLoop(const std::shared_ptr<const std::string> &block)
+    {
+        // 传输层加密后的数据与原数据不同，无法引用原数据块
+        if (_filter || _zc_threshold == 0 || block->size() < _zc_threshold)
+            return SendInLoop(block->data(), block->size());
+        if (!AdmitOutput())
+            return;
+        size_t pending = PendingOutput();
+        OutSegment seg;
+        seg.block = block;
+        seg.zerocopy = true;
+        _segments.push_back(std::move(seg));
+        _seg_bytes += block->size();
+        OutputCharged(pending, block->size());
+    }
+
+    void SendFileInLoop(int file_fd, off_t offset, size_t len)
+    {
+        std::shared_ptr<int> file(new int(file_fd), [](int *fd) {
+            close(*fd);
+            delete fd;
+        });
+        if (len == 0 || !AdmitOutput())
+            return;
+        size_t pending = PendingOutput();
+        OutSegment seg;
+        seg.file = file;
+        seg.offset = offset;
+        seg.length = len;
+        if (_filter && !_filter->Passthrough())
+        {
+            // 用户态编码：放入待编码队列，由 EncodePlain 随输出的消耗分块读入编码
+            _plain_segments.push_back(std::move(seg));
+            _plain_bytes += len;
+            OutputCharged(pending, len);
+            return EncodePlain();
+        }
+        _segments.push_back(std::move(seg));
+        _seg_bytes += len;
+        OutputCharged(pending, len);
+    }
+
+    void SendPipeInLoop(const std::shared_ptr<SplicePipe> &pipe, size_t len)
+    {
+        if (len == 0 || !AdmitOutput())
+            return;
+        size_t pending = PendingOutput();
+        // 用户态编码：放入待编码队列，由 EncodePlain 随输出的消耗分块读出编码
+        bool encode = _filter && !_filter->Passthrough();
+        std::deque<OutSegment> &queue = encode ? _plain_segments : _segments;
+        // 同一管道上连续搬入的数据合并为一块
+        if (!queue.empty() && queue.back().pipe == pipe)
+            queue.back().length += len;
+        else
+        {
+            OutSegment seg;
+            seg.pipe = pipe;
+            seg.length = len;
+            queue.push_back(std::move(seg));
+        }
+        (encode ? _plain_bytes : _seg_bytes) += len;
+        OutputCharged(pending, len);
+        if (encode)
+            EncodePlain();
+    }
+
+    // 已经可以交给内核的字节数(不含等待编码的明文)
+    size_t WireOutput()
+    {
+        return _out_buffer.ReadAbleSize() + _seg_bytes;
+    }
+
+    // 按顺序编码待编码队列中的明文，已编码未发送的数据达到 CONN_READ_SIZE 时停下，等输出消耗后再继续；
+    // 传输层暂存明文(握手未完成)时也停下，它产生输出后再继续。传输层改为直通(内核 TLS)后剩余部分直接入队
+    void EncodePlain()
+    {
+        char buf[CONN_READ_SIZE];
+        while (!_plain_segments.empty() && _status != DISCONNECTED)
+        {
+            OutSegment &seg = _plain_segments.front();
+            size_t left = seg.Size() - seg.sent;
+            if (_filter->Passthrough())
+            {
+                if (seg.file || seg.pipe)
+                {
+                    seg.offset += seg.sent;
+                    seg.length = left;
+                }
+                else
+                    seg.copy.erase(0, seg.sent);
+                seg.sent = 0;
+                _plain_bytes -= left;
+                _seg_bytes += left;
+                _segments.push_back(std::move(seg));
+                _plain_segments.pop_front();
+                if (!_channel.WriteAble())
+                    _channel.EnableWrite();
+                continue;
+            }
+            if (WireOutput() >= CONN_READ_SIZE)
+                return;
+            const char *data = seg.copy.data() + seg.sent;
+            size_t n = std::min(left, sizeof(buf));
+            if (seg.file)
+            {
+                ssize_t ret = pread(*seg.file, buf, n, seg.offset + seg.sent);
+                if (ret <= 0)
+                {
+                    ERR_LOG("Read file for fd:%d failed", GetFd());
+                    return ForceClose();
+                }
+                data = buf;
+                n = ret;
+            }
+            else if (seg.pipe)
+            {
+                ssize_t ret = seg.pipe->Read(buf, n); // 取走后源连接恢复搬入
+                if (ret <= 0)
+                {
+                    ERR_LOG("Read pipe for fd:%d failed", GetFd());
+                    return ForceClose();
+                }
+                data = buf;
+                n = ret;
+            }
+            // 明文已计入预算，编码产生的字节由 WireQueued 重新计入
+            OutputBudget::Refund(n);
+            _plain_bytes -= n;
+            size_t pending = PendingOutput();
+            Buffer *wire = WireBuffer();
+            size_t before = wire->ReadAbleSize();
+            bool ok = _filter->Encode(data, n, wire);
+            bool produced = wire->ReadAbleSize() > before;
+            seg.sent += n;
+            if (seg.sent == seg.Size())
+                _plain_segments.pop_front();
+            WireQueued(wire, pending, before);
+            if (!ok)
+            {
+                ERR_LOG("Transport encode failed, close fd:%d", GetFd());
+                return ForceClose();
+            }
+            if (!produced)
+                break;
+        }
+        // 关闭时推迟的关闭通知排在全部明文之后
+        if (_plain_segments.empty() && _status == DISCONNECTING)
+            FilterClose();
+    }
+
+    // 传输层产生的字节写到这里：输出缓冲区后面没有数据块时直接写入输出缓冲区，否则先写入暂存区
+    Buffer *WireBuffer()
+    {
+        return _segments.empty() ? &_out_buffer : &_wire_buffer;
+    }
+    // 传输层写完后入队，pending 与 before 为写入前的积压量和 wire 中的数据量
+    void WireQueued(Buffer *wire, size_t pending, size_t before)
+    {
+        size_t len = wire->ReadAbleSize() - before;
+        if (len == 0)
+            return;
+        if (wire == &_wire_buffer)
+        {
+            if (!_segments.back().Appendable())
+                _segments.push_back(OutSegment());
+            _segments.back().copy.append(_wire_buffer.ReadPos(), len);
+            _seg_bytes += len;
+            _wire_buffer.MoveReadOffset(len);
+        }
+        OutputCharged(pending, len);
+    }
+    // 经传输层解码收到的数据，协议错误时发出告警后关闭连接
+    bool FilterInput(const char *data, size_t len)
+    {
+        size_t pending = PendingOutput();
+        Buffer *wire = WireBuffer();
+        size_t before = wire->ReadAbleSize();
+        bool ok = _filter->Decode(data, len, &_in_buffer, wire);
+        WireQueued(wire, pending, before);
+        if (!ok)
+        {
+            ERR_LOG("Transport decode failed, close fd:%d", GetFd());
+            ShutdownInLoop();
+            return false;
+        }
+        if (WireOutput() == 0)
+            FilterDrained();
+        if (!_plain_segments.empty())
+            EncodePlain(); // 握手完成后继续编码握手期间排队的明文
+        return true;
+    }
+    void FilterClose()
+    {
+        size_t pending = PendingOutput();
+        Buffer *wire = WireBuffer();
+        size_t before = wire->ReadAbleSize();
+        _filter->Close(wire);
+        WireQueued(wire, pending, before);
+    }
+    void FilterDrained()
+    {
+        size_t pending = PendingOutput();
+        Buffer *wire = WireBuffer();
+        size_t before = wire->ReadAbleSize();
+        _filter->OnDrained(GetFd(), wire);
+        WireQueued(wire, pending, before);
+    }
+
+    // 全局预算耗尽时，已经积压到高水位的慢连接直接断开，防止内存无限增长
+    bool AdmitOutput()
+    {
+        if (_status == DISCONNECTED)
+            return false;
+        size_t pending = PendingOutput();
+        if (pending >= _high_water_mark && OutputBudget::Exceeded())
+        {
+            ERR_LOG("Output budget exceeded, drop slow connection fd:%d pending:%lu", GetFd(), (unsigned long)pending);
+            ForceClose();
+            return false;
+        }
+        return true;
+    }
+
+    // 新数据入队后：计入预算、开启写事件监控、检查高水位
+    void OutputCharged(size_t pending, size_t len)
+    {
+        OutputBudget::Charge(len);
+        if (!_channel.WriteAble())
+            _channel.EnableWrite();
+
+        size_t now = pending + len;
+        if (pending < _high_water_mark && now >= _high_water_mark)
+        {
+            PauseRead();
+            if (_high_water_cb)
+                _high_water_cb(this, now);
+        }
+        else if (OutputBudget::Exceeded())
+            PauseRead();
+    }
+
+    // 暂停读取：对端不再产生新的请求，输出缓冲区不会继续增长
+    void PauseRead()
+    {
+        if (_read_paused || _status == DISCONNECTED)
+            return;
+        _read_paused = true;
+        if (_channel.ReadAble())
+            _channel.DisableRead();
+    }
+
+    void ResumeRead()
+    {
+        if (!_read_paused)
+            return;
+        _read_paused = false;
+        if (_status == CONNECTED && !_input_paused && !_splice_paused && !_channel.ReadAble())
+            _channel.EnableRead();
+        if (_low_water_cb)
+            _low_water_cb(this);
+    }
+
+    // 丢弃待发送数据立即关闭
+    void ForceClose()
+    {
+        if (_status == DISCONNECTED)
+            return;
+        _status = DISCONNECTING;
+        _channel.DisableAll();
+        Release();
+    }
+
+    void ShutdownInLoop()
+    {
+        if (_status == DISCONNECTED)
+            return;
+        // 还有待编码的明文时，关闭通知等它们编码完再写出
+        if (_filter && _status != DISCONNECTING && _plain_segments.empty())
+            FilterClose();
+        _status = DISCONNECTING;
+        if (_in_buffer.ReadAbleSize() > 0 && _message_cb)
+            _message_cb(this, &_in_buffer);
+        if (PendingOutput() > 0)
+        {
+            if (!_channel.WriteAble())
+                _channel.EnableWrite();
+        }
+        // 零拷贝数据块在内核释放前不能关闭连接，由完成通知触发释放
+        if (PendingOutput() == 0 && _zc_inflight.empty())
+            Release();
+    }
+
+    // 释放操作延迟到任务队列中执行，避免本轮后续就绪事件访问到已复用的槽位
+    // 携带当前代数，重复投递的释放任务在槽位复用后自动失效
+    void Release()
+    {
+        _loop->QueueInLoop(std::bind(&Connection::ReleaseInLoop, this, _generation));
+    }
+
+    void ReleaseInLoop(uint32_t generation);
+
+private:
+    ConnectionPool *_pool;
+    EventLoop *_loop;
+    uint32_t _index;      // 在对象池中的槽位下标
+    uint32_t _generation; // 槽位代数，每次回收加一
+    ConnStatu _status;
+    Socket _socket;
+    StaticChannel<Connection> _channel;
+    Buffer _in_buffer;  // 输入缓冲区
+    Buffer _out_buffer; // 输出缓冲区
+    Buffer _wire_buffer; // 传输层输出暂存(输出缓冲区后面还有数据块时)
+    std::unique_ptr<TransportFilter> _filter;
+    Any _context;       // 协议处理上下文
+    size_t _high_water_mark;
+    size_t _low_water_mark;
+    bool _read_paused; // 输出积压导致读事件被暂停
+    bool _input_paused; // 应用层暂停读取
+    bool _quickack;    // 每次读后重新设置 TCP_QUICKACK
+    std::deque<OutSegment> _segments;    // 排在输出缓冲区之后的待发送数据块
+    std::deque<OutSegment> _zc_inflight; // 已交给内核、等待完成通知的零拷贝数据块
+    size_t _seg_bytes;                   // _segments 中未发送的字节数
+    std::deque<OutSegment> _plain_segments; // 等待传输层编码的明文(文件块、管道块与排在其后的数据)，按顺序分块编码
+    size_t _plain_bytes;                    // _plain_segments 中未编码的字节数
+    size_t _zc_threshold;                // 零拷贝阈值，0 表示未开启
+    uint32_t _zc_seq;                    // 下一次零拷贝发送的序号
+    uint64_t _zc_copied;
+    std::shared_ptr<SplicePipe> _splice_pipe; // 非空时处于直通模式，读到的数据搬进该管道
+    uint64_t _splice_left;                    // 直通模式剩余字节数，0 表示直到对端关闭
+    bool _splice_paused;                      // 管道已满导致读事件被暂停
+    SpliceCallBack _splice_cb;
+    ConnectedCallBack _connected_cb;
+    MessageCallBack _message_cb;
+    ClosedCallBack _closed_cb;
+    AnyEventCallBack _event_cb;
+    HighWaterMarkCallBack _high_water_cb;
+    LowWaterMarkCallBack _low_water_cb;
+};
+
+// ================================================================
+//                          ConnectionPool模块
+// ================================================================
+// 每个EventLoop一个对象池，除 RunInLoop/Send/Shutdown 外的接口都只能在所属线程调用
+class ConnectionPool
+{
+public:
+    using ConnTask = std::function<void(Connection *)>;
+    using IdlePredicate = std::function<bool(Connection *)>;
+
+    // max 为同时存活的连接上限，0 表示不限制
+    ConnectionPool(EventLoop *loop, size_t max = 0)
+        : _loop(loop), _max(max), _active(0), _draining(false), _drain_timer(0)
+    { }
+
+    // 预先创建 n 个连接对象，避免运行期分配
+    void Reserve(size_t n)
+    {
+        while (_slots.size() < n)
+        {
+            uint32_t idx = _slots.size();
+            _slots.emplace_back(new Connection(this, _loop, idx));
+            _free.push_back(idx);
+        }
+    }
+
+    // 取出一个空闲连接并绑定fd，达到上限时返回nullptr(fd由调用者处理)
+    Connection *Acquire(int fd)
+    {
+        _loop->AssertInLoop();
+        if (_draining || (_max != 0 && _active >= _max))
+            return nullptr;
+        uint32_t idx;
+        if (_free.empty())
+        {
+            idx = _slots.size();
+            _slots.emplace_back(new Connection(this, _loop, idx));
+        }
+        else
+        {
+            idx = _free.back();
+            _free.pop_back();
+        }
+        Connection *conn = _slots[idx].get();
+        conn->Reset(fd);
+        _active++;
+        _loop->Metrics().conn_opened.Add();
+        return conn;
+    }
+
+    // 通过句柄查找连接，句柄过期返回nullptr
+    Connection *Get(ConnHandle handle)
+    {
+        _loop->AssertInLoop();
+        if (handle.index >= _slots.size())
+            return nullptr;
+        Connection *conn = _slots[handle.index].get();
+        if (conn->_generation != handle.generation || conn->_status == DISCONNECTED)
+            return nullptr;
+        return conn;
+    }
+
+    // 任意线程调用：在所属线程中对仍然存活的连接执行任务
+    void RunInLoop(ConnHandle handle, const ConnTask &task)
+    {
+        _loop->RunInLoop(std::bind(&ConnectionPool::RunTask, this, handle, task));
+    }
+
+    // 与 RunInLoop 相同，但即使在所属线程中也放入任务队列，适合在连接的回调中安排后续处理
+    void QueueInLoop(ConnHandle handle, const ConnTask &task)
+    {
+        _loop->QueueInLoop(std::bind(&ConnectionPool::RunTask, this, handle, task));
+    }
+
+    // 任意线程调用：向连接发送数据，连接已失效则丢弃
+    void Send(ConnHandle handle, const char *data, size_t len)
+    {
+        if (_loop->IsInLoop())
+        {
+            Connection *conn = Get(handle);
+            if (conn)
+                conn->SendInLoop(data, len);
+            return;
+        }
+        std::string copy(data, len);
+        _loop->QueueInLoop(std::bind(&ConnectionPool::SendString, this, handle, copy));
+    }
+
+    // 任意线程调用：发送整块数据(见 Connection::SendBlock)
+    void SendBlock(ConnHandle handle, const std::shared_ptr<const std::string> &block)
+    {
+        _loop->RunInLoop(std::bind(&ConnectionPool::SendBlockHandle, this, handle, block));
+    }
+
+    // 任意线程调用：关闭连接
+    void Shutdown(ConnHandle handle)
+    {
+        _loop->RunInLoop(std::bind(&ConnectionPool::ShutdownHandle, this, handle));
+    }
+
+    // 连接是否空闲(没有处理到一半的请求)，默认：输入缓冲区为空且没有待发送的数据
+    void SetIdlePredicate(const IdlePredicate &pred)
+    {
+        _idle_pred = pred;
+    }
+    bool IsIdle(Connection *conn)
+    {
+        if (_idle_pred)
+            return _idle_pred(conn);
+        return conn->_in_buffer.ReadAbleSize() == 0 && conn->PendingOutput() == 0;
+    }
+
+    // 所属线程调用，优雅关闭：不再接收新连接，空闲连接立即关闭，其余连接空闲后关闭，
+    // deadline 秒后强制关闭剩余连接；全部关闭后调用 done
+    void Drain(uint32_t deadline, const TaskFunc &done)
+    {
+        _loop->AssertInLoop();
+        if (_draining)
+            return;
+        _draining = true;
+        _drained_cb = done;
+        for (auto &slot : _slots)
+            slot->CloseIfDrained();
+        if (deadline == 0)
+            ForceCloseAll();
+        else
+            _drain_timer = _loop->RunAfter(deadline, std::bind(&ConnectionPool::ForceCloseAll, this));
+        CheckDrained();
+    }
+    bool Draining()
+    {
+        return _draining;
+    }
+
+    EventLoop *Loop()
+    {
+        return _loop;
+    }
+    // 已创建的连接对象数量
+    size_t Capacity()
+    {
+        return _slots.size();
+    }
+    // 当前正在使用的连接数量
+    size_t ActiveCount()
+    {
+        return _active;
+    }
+
+private:
+    friend class Connection;
+
+    // 由 Connection::ReleaseInLoop 调用，代数加一使旧句柄失效
+    void Recycle(Connection *conn)
+    {
+        conn->_generation++;
+        if (conn->_generation == 0) // 回绕时跳过无效代数
+            conn->_generation = 1;
+        OutputBudget::Refund(conn->PendingOutput()); // 未发送完的数据归还预算
+        conn->_segments.clear();
+        conn->_zc_inflight.clear(); // 连接已关闭，无法再收到完成通知
+        conn->_seg_bytes = 0;
+        conn->_plain_segments.clear();
+        conn->_plain_bytes = 0;
+        conn->_splice_pipe.reset();
+        conn->_splice_cb = nullptr;
+        conn->_filter.reset();
+        conn->_context = Any();
+        conn->_in_buffer.Shrink(POOL_BUFFER_RETAIN_SIZE);
+        conn->_out_buffer.Shrink(POOL_BUFFER_RETAIN_SIZE);
+        _free.push_back(conn->_index);
+        _active--;
+        _loop->Metrics().conn_closed.Add();
+        CheckDrained();
+    }
+
+    // 关闭期限已到
+    void ForceCloseAll()
+    {
+        for (auto &slot : _slots)
+        {
+            if (slot->_status != DISCONNECTED)
+            {
+                INF_LOG("Drain deadline reached, force close fd %d", slot->GetFd());
+                slot->ForceClose();
+            }
+        }
+    }
+
+    void CheckDrained()
+    {
+        if (!_draining || _active != 0 || !_drained_cb)
+            return;
+        if (_drain_timer != 0)
+            _loop->TimerCancel(_drain_timer);
+        TaskFunc cb = _drained_cb;
+        _drained_cb = nullptr;
+        cb();
+    }
+
+    void RunTask(ConnHandle handle, const ConnTask &task)
+    {
+        Connection *conn = Get(handle);
+        if (conn)
+            task(conn);
+    }
+
+    void SendString(ConnHandle handle, const std::string &data)
+    {
+        Connection *conn = Get(handle);
+        if (conn)
+            conn->SendInLoop(data.data(), data.size());
+    }
+
+    void SendBlockHandle(ConnHandle handle, const std::shared_ptr<const std::string> &block)
+    {
+        Connection *conn = Get(handle);
+        if (conn)
+            conn->SendBlockInLoop(block);
+    }
+
+    void ShutdownHandle(ConnHandle handle)
+    {
+        Connection *conn = Get(handle);
+        if (conn)
+            conn->ShutdownInLoop();
+    }
+
+private:
+    EventLoop *_loop;
+    size_t _max;
+    size_t _active;
+    std::vector<std::unique_ptr<Connection>> _slots; // 槽位，对象只增不减
+    std::vector<uint32_t> _free;                     // 空闲槽位下标
+    IdlePredicate _idle_pred;
+    bool _draining;
+    uint64_t _drain_timer; // 关闭期限定时任务
+    TaskFunc _drained_cb;
+};
+
+void Connection::CloseIfDrained()
+{
+    if (_status != CONNECTED || !_pool->Draining())
+        return;
+    if (_pool->IsIdle(this))
+        ShutdownInLoop();
+}
+
+void Connection::SpliceInput(const std::shared_ptr<SplicePipe> &pipe, uint64_t len, const SpliceCallBack &cb)
+{
+    _loop->AssertInLoop();
+    assert(!_filter && _in_buffer.ReadAbleSize() == 0);
+    _splice_pipe = pipe;
+    _splice_left = len;
+    _splice_cb = cb;
+    ConnectionPool *pool = _pool;
+    ConnHandle handle = Handle();
+    pipe->SetDrainCallBack([pool, handle]() {
+        Connection *conn = pool->Get(handle);
+        if (conn)
+            conn->ResumeSplice();
+    });
+}
+
+void Connection::ReleaseInLoop(uint32_t generation)
+{
+    if (generation != _generation || _status == DISCONNECTED)
+        return;
+    _status = DISCONNECTED;
+    _channel.Remove();
+    _socket.Close();
+    if (_closed_cb)
+        _closed_cb(this);
+    _pool->Recycle(this);
+}
+
+// ================================================================
+//                            Acceptor模块
+// ================================================================
+// 对监听套接字的管理：
+//   1. 每次可读事件循环 accept4 直到 EAGAIN，单轮最多 accept _budget 个，避免饿死其他连接
+//   2. 预留一个空闲 fd，描述符耗尽(EMFILE/ENFILE)时释放它来接受并立即关闭新连接，
+//      否则监听套接字一直可读，事件循环会空转
+//   3. 可选令牌桶限速：令牌耗尽时暂停监听读事件，由 timerfd 在下一个令牌到来时恢复，
+//      未处理的连接留在内核全连接队列中
+#define DEFAULT_ACCEPT_BUDGET 64
+
+// 已经处于监听状态的套接字(如热重启时从旧进程接收)，与端口号区分开避免重载歧义
+struct ListenFd
+{
+    explicit ListenFd(int f)
+        : fd(f)
+    { }
+    int fd;
+};
+
+// 令牌桶：rate 为每秒产生的令牌数，burst 为桶容量
+class TokenBucket
+{
+public:
+    TokenBucket()
+        : _rate(0), _burst(0), _tokens(0), _last(std::chrono::steady_clock::now())
+    { }
+
+    void Reset(double rate, double burst)
+    {
+        _rate = rate;
+        _burst = burst < 1 ? 1 : burst;
+        _tokens = _burst;
+        _last = std::chrono::steady_clock::now();
+    }
+
+    // rate 为 0 表示不限速
+    bool Enabled()
+    {
+        return _rate > 0;
+    }
+
+    // 尝试取出一个令牌
+    bool TryTake()
+    {
+        if (!Enabled())
+            return true;
+        Refill();
+        if (_tokens < 1)
+            return false;
+        _tokens -= 1;
+        return true;
+    }
+
+    // 距离下一个令牌产生的微秒数
+    uint64_t WaitMicros()
     {
-        ssize_t ret = recv(_sockfd, buf, len, flag);
-        if (ret < 0)
+        Refill();
+        if (_tokens >= 1)
+            return 0;
+        return (uint64_t)((1 - _tokens) / _rate * 1000000) + 1;
+    }
+
+private:
+    void Refill()
+    {
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - _last).count();
+        _last = now;
+        _tokens = std::min(_burst, _tokens + elapsed * _rate);
+    }
+
+private:
+    double _rate;
+    double _burst;
+    double _tokens;
+    std::chrono::steady_clock::time_point _last;
+};
+
+class Acceptor : private ChannelOwner<Acceptor>
+{
+public:
+    using AcceptCallBack = std::function<void(int)>;
+
+    Acceptor(EventLoop *loop, uint16_t port, const std::string &ip = "0.0.0.0",
+             const SocketOptions &opts = SocketOptions())
+        : _loop(loop), _channel(loop, CreateServer(SockAddr(ip, port), opts), this), _budget(DEFAULT_ACCEPT_BUDGET),
+          _spare_fd(OpenSpareFd()), _timerfd(-1), _shed(0), _stopped(false)
+    {
+    }
+    Acceptor(EventLoop *loop, const SockAddr &addr, const SocketOptions &opts = SocketOptions())
+        : _loop(loop), _channel(loop, CreateServer(addr, opts), this), _budget(DEFAULT_ACCEPT_BUDGET),
+          _spare_fd(OpenSpareFd()), _timerfd(-1), _shed(0), _stopped(false)
+    {
+    }
+
+    // 接管已在监听的套接字
+    Acceptor(EventLoop *loop, ListenFd listen_fd)
+        : _loop(loop), _channel(loop, AdoptServer(listen_fd.fd), this), _budget(DEFAULT_ACCEPT_BUDGET),
+          _spare_fd(OpenSpareFd()), _timerfd(-1), _shed(0), _stopped(false)
+    {
+    }
+
+    ~Acceptor()
+    {
+        Stop();
+        if (_timer_channel)
+            close(_timerfd);
+        if (_spare_fd >= 0)
+            close(_spare_fd);
+    }
+
+    // 停止接受新连接(监听套接字保持打开，未处理的连接留在内核队列中，可由接管的进程继续处理)
+    void Stop()
+    {
+        if (_stopped)
+            return;
+        _stopped = true;
+        _channel.DisableAll();
+        _channel.Remove();
+        if (_timer_channel)
         {
-            // 非阻塞下的正常情况
-            if (errno == EINTR || errno == EAGAIN)
-                return 0;
+            _timer_channel->DisableAll();
+            _timer_channel->Remove();
+        }
+    }
 
-            ERR_LOG("Recv ERR");
-            return -1;
+    // 新连接回调，参数为已设置为非阻塞的通信套接字
+    void SetAcceptCallBack(const AcceptCallBack &cb)
+    {
+        _accept_cb = cb;
+    }
+
+    // 单次可读事件最多接受的连接数
+    void SetAcceptBudget(int budget)
+    {
+        _budget = budget > 0 ? budget : 1;
+    }
+
+    // 每秒最多接受 rate 个连接，允许 burst 个突发；rate 为 0 关闭限速
+    void SetRateLimit(double rate, double burst)
+    {
+        _bucket.Reset(rate, burst);
+        if (rate > 0 && _timerfd < 0)
+        {
+            _timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (_timerfd < 0)
+            {
+                ERR_LOG("Timerfd Create ERR");
+                abort();
+            }
+            _timer_channel.reset(new Channel(_loop, _timerfd));
+            _timer_channel->SetReadCallBack(std::bind(&Acceptor::HandleTimer, this));
+            _timer_channel->EnableRead();
+        }
+    }
+
+    // 开始监听
+    void Listen()
+    {
+        _channel.EnableRead();
+    }
+
+    Socket &GetSocket()
+    {
+        return _socket;
+    }
+
+    // 因描述符耗尽被拒绝的连接数
+    uint64_t ShedCount()
+    {
+        return _shed;
+    }
+
+private:
+    friend class StaticChannel<Acceptor>;
+
+    int CreateServer(const SockAddr &addr, const SocketOptions &opts)
+    {
+        // 绑定或监听失败(端口被占用、地址非法)时没有可用的监听套接字，不能继续运行
+        if (!_socket.CreateServer(addr, false, opts))
+        {
+            ERR_LOG("Create listen socket on %s failed", addr.ToString().c_str());
+            abort();
         }
+        return _socket.GetFd();
+    }
+
+    int AdoptServer(int fd)
+    {
+        assert(fd >= 0);
+        _socket.Reset(fd);
+        _socket.SetNonBlock();
+        return fd;
+    }
+
+    static int OpenSpareFd()
+    {
+        return open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    void HandleRead()
+    {
+        for (int i = 0; i < _budget; i++)
+        {
+            if (!_bucket.TryTake())
+                return PauseForToken();
+
+            int fd = _socket.Accept();
+            if (fd < 0)
+            {
+                if ((errno == EMFILE || errno == ENFILE) && ShedOne())
+                    continue;
+                return; // EAGAIN 等：本轮已取完
+            }
+            _loop->Metrics().accepts.Add();
+            if (_accept_cb)
+                _accept_cb(fd);
+            else
+                close(fd);
+        }
+    }
+
+    // 描述符耗尽：释放预留fd接受一个连接后立即关闭，让客户端尽快收到FIN而不是一直挂起
+    // 返回是否拒绝了一个连接(为false说明已无待处理连接)
+    bool ShedOne()
+    {
+        if (_spare_fd < 0)
+        {
+            ERR_LOG("Accept ERR: too many open files");
+            return false;
+        }
+        close(_spare_fd);
+        int fd = accept(_socket.GetFd(), nullptr, nullptr);
+        if (fd >= 0)
+            close(fd);
+        _spare_fd = OpenSpareFd();
+        if (fd < 0)
+            return false;
+        _shed++;
+        _loop->Metrics().accept_shed.Add();
+        ERR_LOG("Accept ERR: too many open files, shed connection");
+        return true;
+    }
+
+    // 令牌耗尽：暂停监听读事件，等待下一个令牌
+    void PauseForToken()
+    {
+        if (_channel.ReadAble())
+            _channel.DisableRead();
+        uint64_t us = _bucket.WaitMicros();
+        if (us == 0)
+            us = 1;
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec = us / 1000000;
+        its.it_value.tv_nsec = (us % 1000000) * 1000;
+        timerfd_settime(_timerfd, 0, &its, nullptr);
+    }
+
+    void HandleTimer()
+    {
+        uint64_t times;
+        int ret = read(_timerfd, &times, sizeof(times));
+        (void)ret;
+        if (!_channel.ReadAble())
+            _channel.EnableRead();
+    }
+
+private:
+    EventLoop *_loop;
+    Socket _socket; // 监听套接字
+    StaticChannel<Acceptor> _channel;
+    int _budget;    // 单轮accept上限
+    int _spare_fd;  // 预留的空闲描述符
+    int _timerfd;   // 限速恢复定时器
+    std::unique_ptr<Channel> _timer_channel;
+    TokenBucket _bucket;
+    uint64_t _shed;
+    AcceptCallBack _accept_cb;
+    bool _stopped;
+};
+
+// ================================================================
+//                            LoopThread模块
+// ================================================================
+// 一个线程对应一个EventLoop：EventLoop必须在线程内部实例化，保证_thread_id正确
+// 在 EventLoop 线程开始循环前执行，用于绑核、调整调度策略、开启忙轮询等(index 为线程序号)
+using ThreadInitCallBack = std::function<void(EventLoop *, int)>;
+
+// 将当前线程绑定到给定的 CPU 集合上，失败返回 false
+inline bool BindCurrentThread(const std::vector<int> &cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (ret != 0)
+    {
+        ERR_LOG("Bind Thread To CPU Failed: %s", strerror(ret));
+        return false;
+    }
+    return true;
+}
+
+// 事件循环线程的放置配置：loops[i] 为第 i 个从属线程可运行的 CPU 集合，base 为主Reactor，空表示不绑定
+struct LoopPlacement
+{
+    std::vector<int> base;
+    std::vector<std::vector<int>> loops;
+
+    // 每个从属线程独占一个核心：first, first + stride, ...
+    static LoopPlacement OnePerCore(int count, int first = 0, int stride = 1)
+    {
+        LoopPlacement placement;
+        for (int i = 0; i < count; i++)
+            placement.loops.push_back(std::vector<int>(1, first + i * stride));
+        return placement;
+    }
+
+    // 解析 "0-3,8" 形式的 CPU 列表(与 /sys/devices/system/cpu/isolated 等格式一致)
+    static std::vector<int> ParseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < list.size())
+        {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string item = list.substr(pos, end - pos);
+            size_t dash = item.find('-');
+            if (!item.empty())
+            {
+                int lo = atoi(item.c_str());
+                int hi = dash == std::string::npos ? lo : atoi(item.c_str() + dash + 1);
+                for (int cpu = lo; cpu <= hi; cpu++)
+                    cpus.push_back(cpu);
+            }
+            pos = end + 1;
+        }
+        return cpus;
+    }
+
+    std::vector<int> CpusOf(int index) const
+    {
+        if (index < 0 || index >= (int)loops.size())
+            return std::vector<int>();
+        return loops[index];
+    }
+};
+
+inline std::string CpuListString(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+        return "any";
+    std::string out;
+    for (size_t i = 0; i < cpus.size(); i++)
+        out += (i ? "," : "") + std::to_string(cpus[i]);
+    return out;
+}
+
+class LoopThread
+{
+public:
+    LoopThread(const ThreadInitCallBack &init_cb = ThreadInitCallBack(), int index = 0,
+               const std::vector<int> &cpus = std::vector<int>())
+        : _loop(nullptr), _started(false), _init_cb(init_cb), _index(index), _cpus(cpus), _bound(false), _cpu(-1),
+          _node(-1), _tid(0), _thread(std::thread(&LoopThread::ThreadEntry, this))
+    { }
 
-        // ret == 0 表示对端发送 FIN，连接关闭
-        if (ret == 0)
+    // 让事件循环退出并等待线程结束
+    ~LoopThread()
+    {
         {
-            INF_LOG("Peer Closed");
-            return 0;
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_loop)
+                _loop->Quit();
         }
+        _thread.join();
+    }
 
-        return ret;
+    // 启动诊断：配置的 CPU 集合、是否绑定成功、启动时所在的 CPU/节点与线程号
+    std::string Describe()
+    {
+        GetLoop();
+        char line[256];
+        snprintf(line, sizeof(line), "loop %d: tid=%d cpus=%s bound=%s running_on=cpu%d node%d", _index, _tid,
+                 CpuListString(_cpus).c_str(), _cpus.empty() ? "-" : (_bound ? "yes" : "no"), _cpu, _node);
+        return line;
+    }
+    const std::vector<int> &Cpus()
+    {
+        return _cpus;
     }
 
-    // 非阻塞接收（通过 MSG_DONTWAIT）
-    ssize_t NonBlockRecv(void *buf, size_t len)
+    // 获取线程中的EventLoop，未创建完成时阻塞等待；事件循环退出后返回 nullptr
+    EventLoop *GetLoop()
     {
-        return Recv(buf, len, MSG_DONTWAIT);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [&]() { return _started; });
+        return _loop;
     }
 
-    // 发送数据
-    // 返回值：
-    //   >0 : 实际发送字节数（可能小于 len，属于正常情况）
-    //    0 : 当前不可写（EAGAIN / EINTR）
-    //   -1 : 发送错误
-    ssize_t Send(void *buf, size_t len, int flag = 0)
+private:
+    void ThreadEntry()
     {
-        ssize_t ret = send(_sockfd, buf, len, flag);
-        if (ret < 0)
+        EventLoop loop;
+        // 先绑核再执行初始化回调，回调中创建的本地资源(如 Arena)落在正确的节点上
+        if (!_cpus.empty())
+            _bound = BindCurrentThread(_cpus);
+        _cpu = sched_getcpu();
+        _node = LoopArena::CurrentNode();
+        _tid = syscall(SYS_gettid);
+        if (_init_cb)
+            _init_cb(&loop, _index);
         {
-            if (errno == EAGAIN || errno == EINTR)
-                return 0;
-
-            ERR_LOG("Send ERR");
-            return -1;
+            std::unique_lock<std::mutex> lock(_mutex);
+            _loop = &loop;
+            _started = true;
+            _cond.notify_all();
         }
-        return ret;
+        loop.Loop();
+        // EventLoop 即将析构，之后不能再通过 _loop 访问
+        std::unique_lock<std::mutex> lock(_mutex);
+        _loop = nullptr;
     }
 
-    // 非阻塞发送
-    ssize_t NonBlockSend(void *buf, size_t len)
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    EventLoop *_loop;
+    bool _started;
+    ThreadInitCallBack _init_cb;
+    int _index;
+    std::vector<int> _cpus;
+    bool _bound;
+    int _cpu;
+    int _node;
+    int _tid;
+    std::thread _thread;
+};
+
+class LoopThreadPool
+{
+public:
+    LoopThreadPool(EventLoop *baseloop)
+        : _thread_count(0), _next_idx(0), _baseloop(baseloop)
+    { }
+
+    void SetThreadCount(int count)
     {
-        return Send(buf, len, MSG_DONTWAIT);
+        _thread_count = count;
+    }
+    void SetThreadInitCallBack(const ThreadInitCallBack &cb)
+    {
+        _init_cb = cb;
+    }
+    void SetPlacement(const LoopPlacement &placement)
+    {
+        _placement = placement;
     }
 
-    // 关闭套接字
-    void Close()
+    void Create()
     {
-        if (_sockfd != -1)
+        for (int i = 0; i < _thread_count; i++)
         {
-            close(_sockfd);
-            _sockfd = -1;
+            _threads.emplace_back(new LoopThread(_init_cb, i, _placement.CpusOf(i)));
+            _loops.push_back(_threads[i]->GetLoop());
+            for (int cpu : _threads[i]->Cpus())
+            {
+                if (_cpu_loops.find(cpu) == _cpu_loops.end())
+                    _cpu_loops[cpu] = _loops[i];
+            }
         }
     }
 
-    // 创建服务器监听 socket
-    // 顺序：
-    //   socket -> nonblock -> reuse addr -> bind -> listen
-    bool CreateServer(uint16_t port, const std::string &ip = "0.0.0.0", bool isBlock = true)
+    // 轮询分配从属Reactor，没有从属线程时由主Reactor处理
+    EventLoop *NextLoop()
     {
-        if (!CreateSocket())
-            return false;
+        if (_thread_count == 0)
+            return _baseloop;
+        _next_idx = (_next_idx + 1) % _thread_count;
+        return _loops[_next_idx];
+    }
 
-        if (!isBlock)
-            SetNonBlock(); // 非阻塞是 Reactor 的前提
+    // 把 CPU 上收到的连接交给绑定在该 CPU 上的从属Reactor，没有对应的返回 nullptr
+    EventLoop *LoopForCpu(int cpu)
+    {
+        auto it = _cpu_loops.find(cpu);
+        if (it == _cpu_loops.end())
+            return nullptr;
+        return it->second;
+    }
 
-        ReuseAddress(); // 支持服务器快速重启
+    // 每个从属线程一行放置信息
+    std::vector<std::string> Describe()
+    {
+        std::vector<std::string> lines;
+        for (auto &t : _threads)
+            lines.push_back(t->Describe());
+        return lines;
+    }
 
-        if (!Bind(port, ip))
-            return false;
-        if (!Listen())
-            return false;
+    // 退出并回收所有从属线程
+    void Stop()
+    {
+        _threads.clear();
+        _loops.clear();
+        _cpu_loops.clear();
+    }
 
-        return true;
+    // 所有处理连接的EventLoop
+    std::vector<EventLoop *> AllLoops()
+    {
+        if (_thread_count == 0)
+            return std::vector<EventLoop *>(1, _baseloop);
+        return _loops;
     }
 
-    // 创建客户端 socket
-    bool CreateClient(uint16_t port, const std::string &ip)
+private:
+    int _thread_count;
+    int _next_idx;
+    EventLoop *_baseloop;
+    ThreadInitCallBack _init_cb;
+    LoopPlacement _placement;
+    std::unordered_map<int, EventLoop *> _cpu_loops; // CPU -> 绑定在该 CPU 上的从属Reactor
+    std::vector<std::unique_ptr<LoopThread>> _threads;
+    std::vector<EventLoop *> _loops;
+};
+
+// ================================================================
+//                            ComputePool模块
+// ================================================================
+// 阻塞/计算密集型业务的工作线程池，避免慢处理函数占住事件循环：
+//   - 每个工作线程一个双端队列，自己从尾部取(LIFO，缓存友好)，空闲时从其他线程头部窃取
+//   - 排队任务总数有上限，超过时 Submit 返回 false，由调用者降级(如回 503)
+//   - 结果由任务自己通过 EventLoop::QueueInLoop / ConnectionPool::RunInLoop 送回连接所属线程
+#define DEFAULT_COMPUTE_QUEUE_LIMIT 1024
+
+class ComputePool
+{
+public:
+    using Task = std::function<void()>;
+
+    ComputePool(int threads, size_t max_pending = DEFAULT_COMPUTE_QUEUE_LIMIT)
+        : _max_pending(max_pending), _pending(0), _idle(0), _next(0), _stop(false),
+          _submitted(0), _rejected(0), _completed(0)
     {
-        if (!CreateSocket())
-            return false;
-        if (!Connect(port, ip))
+        assert(threads > 0);
+        for (int i = 0; i < threads; i++)
+            _workers.emplace_back(new Worker());
+        for (int i = 0; i < threads; i++)
+            _workers[i]->thread = std::thread(&ComputePool::WorkerEntry, this, i);
+    }
+
+    ~ComputePool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(_sleep_mtx);
+            _stop = true;
+        }
+        _cond.notify_all();
+        for (auto &w : _workers)
+            w->thread.join();
+    }
+
+    // 任意线程调用：排队任务达到上限时拒绝。工作线程内提交的任务进入自己的队列
+    bool Submit(const Task &task)
+    {
+        if (_pending.fetch_add(1) >= _max_pending)
+        {
+            _pending.fetch_sub(1);
+            _rejected.fetch_add(1, std::memory_order_relaxed);
             return false;
+        }
+        _submitted.fetch_add(1, std::memory_order_relaxed);
+        int idx = CurrentWorker().first == this ? CurrentWorker().second
+                                                : (int)(_next.fetch_add(1, std::memory_order_relaxed) % _workers.size());
+        {
+            std::unique_lock<std::mutex> lock(_workers[idx]->mtx);
+            _workers[idx]->tasks.push_back(task);
+        }
+        // _pending 与 _idle 都是顺序一致的原子操作：要么工作线程睡眠前看到新任务，要么这里看到它在睡眠
+        if (_idle.load() > 0)
+        {
+            std::unique_lock<std::mutex> lock(_sleep_mtx);
+            _cond.notify_one();
+        }
         return true;
     }
 
-    // 开启地址 / 端口复用
-    void ReuseAddress()
+    // 已排队尚未开始执行的任务数
+    size_t Pending()
     {
-        int opt = 1;
-        setsockopt(_sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int));
-        setsockopt(_sockfd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int));
+        return _pending.load(std::memory_order_relaxed);
+    }
+    size_t MaxPending()
+    {
+        return _max_pending;
+    }
+    uint64_t Submitted()
+    {
+        return _submitted.load(std::memory_order_relaxed);
+    }
+    uint64_t Rejected()
+    {
+        return _rejected.load(std::memory_order_relaxed);
+    }
+    uint64_t Completed()
+    {
+        return _completed.load(std::memory_order_relaxed);
+    }
+    size_t ThreadCount()
+    {
+        return _workers.size();
     }
 
-    // 设置 socket 为非阻塞（文件状态标志）
-    void SetNonBlock()
+private:
+    struct Worker
     {
-        int fl = fcntl(_sockfd, F_GETFL, 0);
-        fcntl(_sockfd, F_SETFL, fl | O_NONBLOCK);
+        std::mutex mtx;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    // 当前线程所属的线程池与下标，用于把工作线程内提交的任务放进自己的队列
+    static std::pair<ComputePool *, int> &CurrentWorker()
+    {
+        static thread_local std::pair<ComputePool *, int> current(nullptr, -1);
+        return current;
     }
 
-    int GetFd() const
+    // 先取自己队列尾部，再依次从其他队列头部窃取
+    bool TryPop(int self, Task *task)
     {
-        return _sockfd;
+        size_t n = _workers.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            Worker &w = *_workers[(self + i) % n];
+            std::unique_lock<std::mutex> lock(w.mtx);
+            if (w.tasks.empty())
+                continue;
+            if (i == 0)
+            {
+                *task = std::move(w.tasks.back());
+                w.tasks.pop_back();
+            }
+            else
+            {
+                *task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+            }
+            _pending.fetch_sub(1);
+            return true;
+        }
+        return false;
     }
 
-    // RAII：对象析构时关闭 fd
-    ~Socket()
+    void WorkerEntry(int self)
     {
-        if (_sockfd > 0)
-            Close();
+        CurrentWorker() = std::make_pair(this, self);
+        while (true)
+        {
+            Task task;
+            if (TryPop(self, &task))
+            {
+                task();
+                _completed.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_sleep_mtx);
+            if (_stop)
+                break;
+            _idle.fetch_add(1);
+            _cond.wait(lock, [this]() { return _stop || _pending.load() > 0; });
+            _idle.fetch_sub(1);
+        }
     }
 
 private:
-    int _sockfd; // 套接字文件描述符
+    std::vector<std::unique_ptr<Worker>> _workers;
+    size_t _max_pending;
+    std::atomic<size_t> _pending; // 所有队列中的任务总数
+    std::atomic<int> _idle;       // 正在睡眠的工作线程数
+    std::atomic<size_t> _next;    // 外部线程提交时轮询选择队列
+    std::mutex _sleep_mtx;
+    std::condition_variable _cond;
+    bool _stop;
+    std::atomic<uint64_t> _submitted;
+    std::atomic<uint64_t> _rejected;
+    std::atomic<uint64_t> _completed;
 };
 
 // ================================================================
-//                            Channel模块
+//                            TcpServer模块
 // ================================================================
-// 事件的回调函数
-class Poller;
-using EventCallBack = std::function<void()>;
+// 优雅关闭与热重启：
+//   - Shutdown(deadline)：停止 accept，空闲连接立即关闭，处理中的连接空闲后关闭，
+//     期限到达时强制关闭剩余连接，所有从属Reactor清空后 Start 返回
+//   - EnableHandoff(path)：在 Unix 域套接字上等待新进程连接，通过 SCM_RIGHTS 交出监听套接字后进入优雅关闭；
+//     新进程用 TakeOverListenFd(path) 取得监听套接字，以 TcpServer(ListenFd(fd)) 启动，旧进程未 accept 的连接由它继续处理
+#define DEFAULT_DRAIN_DEADLINE 30 // 秒，期限由时间轮计时，可以超过一圈
 
-class Channel
+// 通过 Unix 域套接字发送描述符
+inline bool SendFds(int sock, const std::vector<int> &fds)
+{
+    char data = 'F';
+    struct iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) != 1)
+    {
+        ERR_LOG("Send Fds Failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// 接收最多 max 个描述符(接收到的描述符带 CLOEXEC)
+inline bool RecvFds(int sock, std::vector<int> *fds, size_t max)
+{
+    char data;
+    struct iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * max));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != 1)
+    {
+        ERR_LOG("Recv Fds Failed: %s", strerror(errno));
+        return false;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *p = (int *)CMSG_DATA(cmsg);
+        fds->insert(fds->end(), p, p + n);
+    }
+    return !fds->empty();
+}
+
+inline bool FillUnixAddr(const std::string &path, sockaddr_un *addr)
+{
+    if (path.size() >= sizeof(addr->sun_path))
+        return false;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+class TcpServer
 {
 public:
-    // 创建一个channel类
-    Channel(EventLoop *loop, int fd)
-        : _loop(loop), _fd(fd), _events(0), _revents(0)
-    { }
-    ~Channel()
+    // opts 在监听套接字上应用一次，之后对每个新连接再应用一次
+    // ip 可以是 IPv6 地址或 "unix:/path"、"unix:@name"(见 SockAddr)
+    TcpServer(uint16_t port, const std::string &ip = "0.0.0.0", const SocketOptions &opts = SocketOptions())
+        : TcpServer(SockAddr(ip, port), opts)
     { }
-    // 更新
-    void Update();
-    // 移除监控(从epoll的红黑树上删除掉)
-    void Remove();
-    // 设置就绪事件--(在后面Poller中调用)
-    void SetRevents(uint32_t revents)
+    TcpServer(const SockAddr &addr, const SocketOptions &opts = SocketOptions())
+        : _acceptor(&_baseloop, addr, opts), _pool(&_baseloop), _max_conns(0), _zc_threshold(0), _busy_poll_us(0),
+          _arena_enabled(false), _incoming_cpu(false), _sock_opts(opts.ForFamily(addr.Family())), _shutting_down(false),
+          _drain_pending(0), _handoff_deadline(DEFAULT_DRAIN_DEADLINE), _handoff_fd(-1), _signal_fd(-1),
+          _signal_deadline(DEFAULT_DRAIN_DEADLINE)
     {
-        _revents = revents;
+        _acceptor.SetAcceptCallBack(std::bind(&TcpServer::NewConnection, this, std::placeholders::_1));
     }
-    // 获得fd
-    int GetFd()
+
+    // 接管已在监听的套接字(热重启)，opts 只应用到新连接上
+    TcpServer(ListenFd listen_fd, const SocketOptions &opts = SocketOptions())
+        : _acceptor(&_baseloop, listen_fd), _pool(&_baseloop), _max_conns(0), _zc_threshold(0), _busy_poll_us(0),
+          _arena_enabled(false), _incoming_cpu(false), _sock_opts(opts), _shutting_down(false), _drain_pending(0),
+          _handoff_deadline(DEFAULT_DRAIN_DEADLINE), _handoff_fd(-1), _signal_fd(-1), _signal_deadline(DEFAULT_DRAIN_DEADLINE)
     {
-        return _fd;
+        _sock_opts = opts.ForFamily(_acceptor.GetSocket().Family());
+        _acceptor.SetAcceptCallBack(std::bind(&TcpServer::NewConnection, this, std::placeholders::_1));
     }
-    // 获得该文件描述符要设置的监控事件
-    uint32_t GetEvent()
+
+    ~TcpServer()
     {
-        return _events;
+        _pool.Stop(); // 先停止从属线程，再销毁它们使用的连接池
+        if (_handoff_channel)
+        {
+            _handoff_channel->DisableAll();
+            _handoff_channel->Remove();
+            close(_handoff_fd);
+            unlink(_handoff_path.c_str());
+        }
+        if (_signal_channel)
+        {
+            _signal_channel->DisableAll();
+            _signal_channel->Remove();
+            close(_signal_fd);
+        }
     }
-    // 设置回调函数
-    void SetReadCallBack(const EventCallBack &cb)
+
+    // 任意线程调用：优雅关闭，deadline 秒后强制关闭仍未结束的连接
+    void Shutdown(uint32_t deadline = DEFAULT_DRAIN_DEADLINE)
     {
-        _read_cb = cb;
+        _baseloop.RunInLoop(std::bind(&TcpServer::ShutdownInLoop, this, deadline));
     }
-    void SetWriteCallBack(const EventCallBack &cb)
+    // 判断连接是否空闲，优雅关闭时只等待非空闲的连接(见 ConnectionPool::SetIdlePredicate)
+    void SetIdlePredicate(const ConnectionPool::IdlePredicate &pred)
     {
-        _write_cb = cb;
+        _idle_pred = pred;
     }
-    void SetErrorCallBack(const EventCallBack &cb)
+    // 收到这些信号时优雅关闭(Start 中屏蔽信号并通过 signalfd 在主Reactor中处理)
+    void SetShutdownSignals(const std::vector<int> &signals, uint32_t deadline = DEFAULT_DRAIN_DEADLINE)
     {
-        _error_cb = cb;
+        _signals = signals;
+        _signal_deadline = deadline;
     }
-    void SetCloseCallBack(const EventCallBack &cb)
+    // 热重启：新进程连接 path 后交出监听套接字，随后本进程优雅关闭
+    void EnableHandoff(const std::string &path, uint32_t deadline = DEFAULT_DRAIN_DEADLINE)
     {
-        _close_cb = cb;
+        _handoff_path = path;
+        _handoff_deadline = deadline;
     }
-    void SetEventCallBack(const EventCallBack &cb)
+    // 新进程调用：从旧进程取得监听套接字，失败返回 -1
+    static int TakeOverListenFd(const std::string &path)
+    {
+        sockaddr_un addr;
+        if (!FillUnixAddr(path, &addr))
+            return -1;
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock < 0)
+            return -1;
+        std::vector<int> fds;
+        if (connect(sock, (sockaddr *)&addr, sizeof(addr)) < 0 || !RecvFds(sock, &fds, 1))
+        {
+            ERR_LOG("Take Over Listen Fd From %s Failed", path.c_str());
+            close(sock);
+            return -1;
+        }
+        close(sock);
+        return fds[0];
+    }
+
+    void SetThreadCount(int count)
+    {
+        _pool.SetThreadCount(count);
+    }
+    // 每个从属Reactor上同时存活的连接上限，0 表示不限制
+    void SetMaxConnectionsPerLoop(size_t max)
+    {
+        _max_conns = max;
+    }
+    // 对新连接开启零拷贝发送，0 表示关闭
+    void SetZeroCopyThreshold(size_t threshold)
+    {
+        _zc_threshold = threshold;
+    }
+    // 为每个新连接创建传输层(如 TLS)，在从属Reactor线程中调用
+    void SetTransportFilterFactory(const TransportFilterFactory &factory)
+    {
+        _filter_factory = factory;
+    }
+    // 处理连接的 EventLoop 开启自适应忙轮询(见 EventLoop::SetBusyPoll)，0 表示关闭
+    void SetBusyPoll(uint64_t max_us)
+    {
+        _busy_poll_us = max_us;
+    }
+    // 处理连接的 EventLoop 启用本地内存区(见 EventLoop::EnableArena)。
+    // 需要按节点放置时，应在 ThreadInitCallBack 中先绑核再调用 EnableArena
+    void SetArenaOptions(const ArenaOptions &opts)
+    {
+        _arena_enabled = true;
+        _arena_opts = opts;
+    }
+    // 从属Reactor线程启动时的回调(没有从属线程时不调用)，在按 LoopPlacement 绑核之后执行
+    void SetThreadInitCallBack(const ThreadInitCallBack &cb)
+    {
+        _pool.SetThreadInitCallBack(cb);
+    }
+    // 事件循环线程绑核，启动时打印每个线程的放置情况
+    void SetPlacement(const LoopPlacement &placement)
+    {
+        _placement = placement;
+        _pool.SetPlacement(placement);
+    }
+    // 按 SO_INCOMING_CPU 把新连接交给绑定在软中断所在核心上的从属Reactor，没有匹配时仍轮询分配
+    void SetIncomingCpuDispatch(bool on)
+    {
+        _incoming_cpu = on;
+    }
+    // 启动诊断信息(Start 之后有效)
+    std::string PlacementReport()
+    {
+        std::string out = "base: cpus=" + CpuListString(_placement.base) + "\n";
+        for (auto &line : _pool.Describe())
+            out += line + "\n";
+        return out;
+    }
+    void SetConnectedCallBack(const ConnectedCallBack &cb)
+    {
+        _connected_cb = cb;
+    }
+    void SetMessageCallBack(const MessageCallBack &cb)
+    {
+        _message_cb = cb;
+    }
+    void SetClosedCallBack(const ClosedCallBack &cb)
+    {
+        _closed_cb = cb;
+    }
+    void SetAnyEventCallBack(const AnyEventCallBack &cb)
     {
         _event_cb = cb;
     }
-    // 是否监控了读事件
-    bool ReadAble()
+    Acceptor &GetAcceptor()
     {
-        return (_events & EPOLLIN);
+        return _acceptor;
     }
-    // 是否监控了写事件
-    bool WriteAble()
+    EventLoop *BaseLoop()
     {
-        return (_events & EPOLLOUT);
+        return &_baseloop;
     }
-    // 启动读事件监控
-    void EnableRead()
+
+    // 运行直到优雅关闭完成
+    void Start()
     {
-        _events |= EPOLLIN;
-        Update();
+        if (!_placement.base.empty())
+            BindCurrentThread(_placement.base);
+        SetupSignals(); // 在创建从属线程之前屏蔽信号，新线程继承信号屏蔽字
+        _pool.Create();
+        for (auto &line : _pool.Describe())
+            INF_LOG("%s", line.c_str());
+        std::vector<EventLoop *> loops = _pool.AllLoops();
+        for (auto loop : loops)
+        {
+            _conn_pools[loop].reset(new ConnectionPool(loop, _max_conns));
+            if (_busy_poll_us > 0)
+                loop->RunInLoop(std::bind(&EventLoop::SetBusyPoll, loop, _busy_poll_us));
+            if (_arena_enabled)
+                loop->RunInLoop(std::bind(&EventLoop::EnableArena, loop, _arena_opts));
+            if (_idle_pred)
+                _conn_pools[loop]->SetIdlePredicate(_idle_pred);
+        }
+        SetupHandoff();
+        _acceptor.Listen();
+        _baseloop.Loop();
     }
-    // 启动写事件监控
-    void EnableWrite()
+
+    bool ShuttingDown()
     {
-        _events |= EPOLLOUT;
-        Update();
+        return _shutting_down;
     }
-    // 解除读事件监控
-    void DisableRead()
+
+private:
+    void ShutdownInLoop(uint32_t deadline)
     {
-        _events &= ~EPOLLIN;
-        Update();
+        if (_shutting_down)
+            return;
+        _shutting_down = true;
+        INF_LOG("Shutting down, drain deadline %u s", deadline);
+        _acceptor.Stop();
+        std::vector<EventLoop *> loops = _pool.AllLoops();
+        _drain_pending = loops.size();
+        for (auto loop : loops)
+        {
+            ConnectionPool *pool = _conn_pools[loop].get();
+            TaskFunc done = [this]() { _baseloop.RunInLoop(std::bind(&TcpServer::OnLoopDrained, this)); };
+            loop->RunInLoop(std::bind(&ConnectionPool::Drain, pool, deadline, done));
+        }
     }
-    // 解除写事件监控
-    void DisableWrite()
+
+    // 在主Reactor中统计，全部从属Reactor清空后退出所有事件循环
+    void OnLoopDrained()
     {
-        _events &= ~EPOLLOUT;
-        Update();
+        if (--_drain_pending > 0)
+            return;
+        INF_LOG("All connections drained");
+        for (auto loop : _pool.AllLoops())
+            loop->Quit();
+        _baseloop.Quit();
     }
-    // 关闭所有事件监控
-    void DisableAll()
+
+    void SetupSignals()
     {
-        _events = 0;
-        Update();
+        if (_signals.empty() || _signal_fd >= 0)
+            return;
+        sigset_t mask;
+        sigemptyset(&mask);
+        for (int sig : _signals)
+            sigaddset(&mask, sig);
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        _signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (_signal_fd < 0)
+        {
+            ERR_LOG("Signalfd Create ERR: %s", strerror(errno));
+            return;
+        }
+        _signal_channel.reset(new Channel(&_baseloop, _signal_fd));
+        _signal_channel->SetReadCallBack(std::bind(&TcpServer::HandleSignal, this));
+        _signal_channel->EnableRead();
     }
 
-    // 解决触发事件
-    void HandleEvent()
+    void HandleSignal()
     {
-        if (_event_cb)
-            _event_cb();
+        struct signalfd_siginfo info;
+        while (read(_signal_fd, &info, sizeof(info)) == sizeof(info))
+            INF_LOG("Received signal %u", info.ssi_signo);
+        ShutdownInLoop(_signal_deadline);
+    }
 
-        // ❗错误和关闭优先处理
-        if (_revents & EPOLLERR)
+    void SetupHandoff()
+    {
+        if (_handoff_path.empty() || _handoff_fd >= 0)
+            return;
+        sockaddr_un addr;
+        if (!FillUnixAddr(_handoff_path, &addr))
         {
-            if (_error_cb)
-                _error_cb();
+            ERR_LOG("Handoff Path Too Long: %s", _handoff_path.c_str());
             return;
         }
-
-        if (_revents & EPOLLHUP)
+        _handoff_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(_handoff_path.c_str());
+        if (bind(_handoff_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_handoff_fd, 1) < 0)
         {
-            if (_close_cb)
-                _close_cb();
+            ERR_LOG("Handoff Listen On %s Failed: %s", _handoff_path.c_str(), strerror(errno));
+            close(_handoff_fd);
+            _handoff_fd = -1;
             return;
         }
+        _handoff_channel.reset(new Channel(&_baseloop, _handoff_fd));
+        _handoff_channel->SetReadCallBack(std::bind(&TcpServer::HandleHandoff, this));
+        _handoff_channel->EnableRead();
+    }
 
-        // 可读事件
-        if (_revents & (EPOLLIN | EPOLLPRI))
+    // 新进程已连接：交出监听套接字后停止 accept 并进入优雅关闭
+    void HandleHandoff()
+    {
+        int sock = accept4(_handoff_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (sock < 0)
+            return;
+        if (_shutting_down || !SendFds(sock, std::vector<int>(1, _acceptor.GetSocket().GetFd())))
         {
-            if (_read_cb)
-                _read_cb();
+            close(sock);
+            return;
         }
+        close(sock);
+        INF_LOG("Listen socket handed off via %s", _handoff_path.c_str());
+        _handoff_channel->DisableAll();
+        ShutdownInLoop(_handoff_deadline);
+    }
 
-        // 可写事件
-        if (_revents & EPOLLOUT)
+    // 在主Reactor中获取新连接，交给从属Reactor的对象池
+    void NewConnection(int fd)
+    {
+        EventLoop *loop = nullptr;
+        if (_incoming_cpu)
+            loop = _pool.LoopForCpu(Socket::IncomingCpu(fd));
+        if (loop == nullptr)
+            loop = _pool.NextLoop();
+        ConnectionPool *pool = _conn_pools[loop].get();
+        loop->RunInLoop(std::bind(&TcpServer::SetupConnection, this, pool, fd));
+    }
+
+    void SetupConnection(ConnectionPool *pool, int fd)
+    {
+        Connection *conn = pool->Acquire(fd);
+        if (conn == nullptr)
         {
-            if (_write_cb)
-                _write_cb();
+            close(fd);
+            return;
         }
+        conn->ApplySocketOptions(_sock_opts);
+        if (_filter_factory)
+            conn->SetTransportFilter(_filter_factory());
+        else if (_zc_threshold > 0)
+            conn->EnableZeroCopy(_zc_threshold);
+        conn->SetConnectedCallBack(_connected_cb);
+        conn->SetMessageCallBack(_message_cb);
+        conn->SetClosedCallBack(_closed_cb);
+        conn->SetAnyEventCallBack(_event_cb);
+        conn->Established();
     }
 
 private:
-    int _fd;
-    EventLoop* _loop;
-    uint32_t _events;        // 需要监控的事件
-    uint32_t _revents;       // 实际就绪的事件
-    EventCallBack _read_cb;  // 可写
-    EventCallBack _write_cb; // 可读
-    EventCallBack _error_cb; // 错误产生
-    EventCallBack _close_cb; // 连接关闭
-    EventCallBack _event_cb; // 任意一个事件触发
+    EventLoop _baseloop; // 主Reactor，只负责获取新连接
+    Acceptor _acceptor;
+    LoopThreadPool _pool;
+    size_t _max_conns;
+    size_t _zc_threshold;
+    uint64_t _busy_poll_us;
+    bool _arena_enabled;
+    ArenaOptions _arena_opts;
+    bool _incoming_cpu;
+    LoopPlacement _placement;
+    SocketOptions _sock_opts;
+    bool _shutting_down;
+    size_t _drain_pending; // 尚未清空的从属Reactor数量
+    ConnectionPool::IdlePredicate _idle_pred;
+    std::string _handoff_path;
+    uint32_t _handoff_deadline;
+    int _handoff_fd;
+    std::unique_ptr<Channel> _handoff_channel;
+    std::vector<int> _signals;
+    int _signal_fd;
+    uint32_t _signal_deadline;
+    std::unique_ptr<Channel> _signal_channel;
+    std::unordered_map<EventLoop *, std::unique_ptr<ConnectionPool>> _conn_pools;
+    TransportFilterFactory _filter_factory;
+    ConnectedCallBack _connected_cb;
+    MessageCallBack _message_cb;
+    ClosedCallBack _closed_cb;
+    AnyEventCallBack _event_cb;
 };
 
 // ================================================================
-//                     Poller模块(EventLoop子模块)
+//                            TcpClient模块
 // ================================================================
+// 在事件循环中发起出站连接：非阻塞 connect，由可写事件得到结果，连接超时由时间轮触发。
+// 建立的连接来自客户端自己的 ConnectionPool，收发方式与服务端连接相同。
+// 每个事件循环一个，只在所属线程中使用；与 TcpServer 中的连接池一样，须在事件循环停止后销毁
+#define DEFAULT_CONNECT_TIMEOUT 3 // 秒，由时间轮触发，精度 1 秒
 
-#define MAX_EPOLLEREVENTS 1024
-class Poller
+class TcpClient
 {
 public:
-    // 创建epoll描述符
-    Poller()
-    {
-        _epfd = epoll_create1(EPOLL_CLOEXEC);
-        if (_epfd < 0)
-        {
-            ERR_LOG("Epoll Create ERR");
-            abort();
-        }
-    }
-    // 更新一个事件的监控事件或着将一个事件添加到监控中
-    void UpdateEvent(Channel *channel)
+    // 连接成功时参数为已建立的连接(在回调中设置消息/关闭回调)，失败或超时为 nullptr；
+    // 回调总是在 Connect 返回之后执行
+    using ConnectCallBack = std::function<void(Connection *)>;
+
+    TcpClient(EventLoop *loop)
+        : _loop(loop), _conns(loop), _next_seq(1), _connects(0), _failures(0), _timeouts(0)
+    { }
+    ~TcpClient()
     {
-        bool ret = IsExist(channel);
-        if (ret)
-            // 存在，进行修改更新
-            return Update(channel, EPOLL_CTL_MOD);
-        else
-        {
-            // 不存在直接添加
-            _channels[channel->GetFd()] = channel;
-            return Update(channel, EPOLL_CTL_ADD);
-        }
+        for (auto &it : _pending)
+            close(it.second->channel.GetFd());
     }
 
-    // 移除监控
-    void RemoveEvent(Channel *channel)
+    // 新连接的调优配置
+    void SetSocketOptions(const SocketOptions &opts)
     {
-        auto it = _channels.find(channel->GetFd());
-        if (it != _channels.end())
-            _channels.erase(channel->GetFd());
-
-        Update(channel, EPOLL_CTL_DEL);
+        _sock_opts = opts;
     }
 
-    // 开始监控，返回就绪链接
-    void Poll(std::vector<Channel *> *active)
+    // timeout 为 0 表示不限时(由内核的 SYN 重传决定)；ip 的写法见 SockAddr，Unix 套接字忽略 port
+    void Connect(const std::string &ip, uint16_t port, const ConnectCallBack &cb, uint32_t timeout = DEFAULT_CONNECT_TIMEOUT)
     {
-        // int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
-        int nfds = epoll_wait(_epfd, _evs, MAX_EPOLLEREVENTS, -1); // 设置为永久阻塞
-        if (nfds < 0)
+        _loop->AssertInLoop();
+        _connects++;
+        SockAddr addr(ip, port);
+        Socket sock;
+        int err = addr.Valid() ? EMFILE : EINVAL;
+        if (addr.Valid() && sock.CreateSocket(addr.Family()))
         {
-            if (errno == EINTR)
-                return;
-            ERR_LOG("Epoll wait ERR");
-            abort();
+            sock.SetNonBlock();
+            err = sock.ConnectNonBlock(addr);
         }
-
-        // nfds就是就绪的事件数量
-        // 内核在 events 数组中，写入了 返回值个 epoll_event
-        // events[0] ~ events[n-1] 是有效的
-        // 每一个 epoll_event 对应一个 就绪的 fd / Channel
-        for (int i = 0; i < nfds; i++)
+        // 立即连上时同样等待可写事件，回调统一在之后执行
+        if (err != 0 && err != EINPROGRESS)
         {
-            auto it = _channels.find(_evs[i].data.fd);
-            assert(it != _channels.end());
-            it->second->SetRevents(_evs[i].events);
-            active->push_back(it->second);
+            DBG_LOG("Connect %s:%u ERR: %s", ip.c_str(), port, strerror(err));
+            _failures++;
+            _loop->QueueInLoop(std::bind(cb, (Connection *)nullptr));
+            return;
         }
+        uint64_t seq = _next_seq++;
+        std::shared_ptr<PendingConnect> pc = std::make_shared<PendingConnect>(_loop, sock.Release(), addr.Family());
+        pc->cb = cb;
+        EventCallBack done = std::bind(&TcpClient::HandleConnect, this, seq);
+        pc->channel.SetWriteCallBack(done);
+        pc->channel.SetErrorCallBack(done);
+        pc->channel.SetCloseCallBack(done);
+        pc->channel.EnableWrite();
+        if (timeout > 0)
+            pc->timer = _loop->RunAfter(timeout, std::bind(&TcpClient::HandleTimeout, this, seq));
+        _pending[seq] = pc;
     }
 
-    ~Poller()
+    // 出站连接所在的连接池(用 ConnHandle 查找连接)
+    ConnectionPool *Pool()
     {
-        close(_epfd);
+        return &_conns;
+    }
+    EventLoop *Loop()
+    {
+        return _loop;
+    }
+    // 正在进行的连接数
+    size_t Pending()
+    {
+        return _pending.size();
+    }
+    // 发起的连接总数、失败数(含超时)、超时数
+    uint64_t Connects()
+    {
+        return _connects;
+    }
+    uint64_t Failures()
+    {
+        return _failures;
+    }
+    uint64_t Timeouts()
+    {
+        return _timeouts;
     }
 
 private:
-    void Update(Channel *channel, int op) // epoll_ctl对epoll的直接操作
+    struct PendingConnect
     {
-        // int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
-        epoll_event ev;
-        ev.events = channel->GetEvent();
-        ev.data.fd = channel->GetFd();
-        int ret = epoll_ctl(_epfd, op, channel->GetFd(), &ev);
-        if (ret < 0)
-            ERR_LOG("Epoll_ctl error: %s", strerror(errno));
-        return;
+        PendingConnect(EventLoop *loop, int fd, int f)
+            : channel(loop, fd), timer(0), family(f)
+        { }
+        Channel channel;
+        uint64_t timer;
+        int family;
+        ConnectCallBack cb;
+    };
+
+    // 取出并注销一个进行中的连接；通道可能正在分发事件，延后到任务队列中销毁
+    std::shared_ptr<PendingConnect> Take(uint64_t seq)
+    {
+        auto it = _pending.find(seq);
+        if (it == _pending.end())
+            return nullptr;
+        std::shared_ptr<PendingConnect> pc = it->second;
+        _pending.erase(it);
+        pc->channel.Remove();
+        _loop->QueueInLoop([pc]() { });
+        return pc;
     }
 
-    // 判断一个channel是否已经添加了事件的监控(是否已经管理)
-    bool IsExist(Channel *channel)
+    void HandleConnect(uint64_t seq)
     {
-        auto it = _channels.find(channel->GetFd());
-        if (it == _channels.end())
-            return false;
-        return true;
+        std::shared_ptr<PendingConnect> pc = Take(seq);
+        if (!pc)
+            return;
+        if (pc->timer != 0)
+            _loop->TimerCancel(pc->timer);
+        int fd = pc->channel.GetFd();
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+            err = errno;
+        Connection *conn = nullptr;
+        if (err == 0)
+            conn = _conns.Acquire(fd);
+        if (conn == nullptr)
+        {
+            DBG_LOG("Connect fd:%d ERR: %s", fd, strerror(err));
+            close(fd);
+            _failures++;
+            return pc->cb(nullptr);
+        }
+        // 槽位复用时清掉上一个使用者留下的回调
+        conn->SetConnectedCallBack(nullptr);
+        conn->SetMessageCallBack(nullptr);
+        conn->SetClosedCallBack(nullptr);
+        conn->SetAnyEventCallBack(nullptr);
+        conn->SetHighWaterMarkCallBack(nullptr);
+        conn->SetLowWaterMarkCallBack(nullptr);
+        conn->ApplySocketOptions(_sock_opts.ForFamily(pc->family));
+        conn->Established();
+        pc->cb(conn);
+    }
+
+    void HandleTimeout(uint64_t seq)
+    {
+        std::shared_ptr<PendingConnect> pc = Take(seq);
+        if (!pc)
+            return;
+        DBG_LOG("Connect fd:%d timeout", pc->channel.GetFd());
+        close(pc->channel.GetFd());
+        _failures++;
+        _timeouts++;
+        pc->cb(nullptr);
     }
 
 private:
-    int _epfd;
-    struct epoll_event _evs[MAX_EPOLLEREVENTS];
-    std::unordered_map<int, Channel *> _channels;
+    EventLoop *_loop;
+    ConnectionPool _conns;
+    SocketOptions _sock_opts;
+    uint64_t _next_seq; // 进行中连接的编号，定时任务与事件回调按编号查找，不受 fd 复用影响
+    std::unordered_map<uint64_t, std::shared_ptr<PendingConnect>> _pending;
+    uint64_t _connects;
+    uint64_t _failures;
+    uint64_t _timeouts;
 };
 
-void Channel::Update()
-{
-    _loop->UpdateEvent(this);
-}
-void Channel::Remove()
-{
-    _loop->RemoveEvent(this);
-}
-
 // ================================================================
-//                            EventPoll模块
+//                            Upstream模块
 // ================================================================
+// 上游地址的长连接池，每个事件循环一份(UpstreamPool)，处理函数在连接所属线程中取用本线程的池：
+//   1. 空闲连接后进先出复用，超过 idle_timeout 的空闲连接被关闭，空闲期间收到数据或对端关闭的连接被丢弃
+//   2. 连续 fail_threshold 次连接失败后标记为不可用，Acquire 立即失败；之后每 check_interval 秒
+//      探测一次，连上后恢复(探测连接留作空闲连接)
+#define DEFAULT_UPSTREAM_MAX_IDLE 32
+#define DEFAULT_UPSTREAM_IDLE_TIMEOUT 30  // 秒
+#define DEFAULT_UPSTREAM_CHECK_INTERVAL 2 // 秒
+#define DEFAULT_UPSTREAM_FAIL_THRESHOLD 3
 
-// 1.对事件进行监控 2.就绪事件处理 3.执行任务
-class EventLoop
+struct UpstreamOptions
+{
+    uint32_t connect_timeout; // 秒
+    size_t max_idle;          // 每个事件循环最多保留的空闲连接数
+    uint32_t idle_timeout;    // 秒
+    uint32_t check_interval;  // 秒，空闲连接回收与不可用时探测的周期
+    uint32_t fail_threshold;  // 连续连接失败多少次标记为不可用
+    SocketOptions socket;     // 新连接的调优配置
+
+    UpstreamOptions()
+        : connect_timeout(DEFAULT_CONNECT_TIMEOUT), max_idle(DEFAULT_UPSTREAM_MAX_IDLE),
+          idle_timeout(DEFAULT_UPSTREAM_IDLE_TIMEOUT), check_interval(DEFAULT_UPSTREAM_CHECK_INTERVAL),
+          fail_threshold(DEFAULT_UPSTREAM_FAIL_THRESHOLD)
+    {
+        socket.tcp_nodelay = true;
+    }
+};
+
+class UpstreamPool
 {
 public:
-    using Functor = std::function<void()>;
-    EventLoop()
-    :_thread_id(std::this_thread::get_id())
-    ,_eventfd(CreateEventFd())
-    ,_eventfd_channel(new Channel(this, _eventfd))
+    using AcquireCallBack = TcpClient::ConnectCallBack;
+
+    // 在 loop 所属线程中构造
+    UpstreamPool(EventLoop *loop, const std::string &ip, uint16_t port, const UpstreamOptions &opts = UpstreamOptions())
+        : _loop(loop), _ip(ip), _port(port), _opts(opts), _client(loop), _healthy(true), _fail_streak(0),
+          _probing(false), _reused(0)
     {
-        _eventfd_channel->SetReadCallBack(std::bind(&EventLoop::ReadEventFd, this));
-        _eventfd_channel->EnableRead(); // 启动对读事件的监控        
+        _client.SetSocketOptions(opts.socket);
+        ScheduleCheck();
     }
 
-    // 启动eventloop
-    void Start()
+    // 取得一个连接，参数为 nullptr 表示上游不可用或连接失败。
+    // 复用空闲连接时在 Acquire 中直接回调，新建连接时在连接完成后回调；
+    // 复用的连接上可能还留着上一次使用时的回调，使用者应重新设置消息/关闭回调
+    void Acquire(const AcquireCallBack &cb)
     {
-        std::vector<Channel*> actives;
-        // 事件监控
-        _poll.Poll(&actives);
+        _loop->AssertInLoop();
+        while (!_idle.empty())
+        {
+            ConnHandle handle = _idle.back().handle;
+            _idle.pop_back();
+            Connection *conn = _client.Pool()->Get(handle);
+            if (conn && conn->Connected())
+            {
+                _reused++;
+                return cb(conn);
+            }
+        }
+        if (!_healthy)
+        {
+            _loop->QueueInLoop(std::bind(cb, (Connection *)nullptr));
+            return;
+        }
+        _client.Connect(_ip, _port, std::bind(&UpstreamPool::OnConnected, this, std::placeholders::_1, cb),
+                        _opts.connect_timeout);
+    }
 
-        // 事件处理
-        for(auto& ch : actives)
-            ch->HandleEvent();
+    // 归还连接：已连接、没有未读数据且空闲连接未满时保留，否则关闭。
+    // 无法确定协议状态(如响应没有读完)时传 reusable = false。
+    // 可以在该连接自己的回调中调用：使用者设置的回调在本轮任务中才被替换，之前仍可能被调用
+    void Release(Connection *conn, bool reusable = true)
+    {
+        _loop->AssertInLoop();
+        assert(conn->Loop() == _loop);
+        if (!reusable || !conn->Connected() || conn->InBuffer()->ReadAbleSize() > 0 || conn->InputPaused() ||
+            _idle.size() >= _opts.max_idle)
+        {
+            if (conn->InputPaused())
+                conn->ResumeInput();
+            conn->InBuffer()->MoveReadOffset(conn->InBuffer()->ReadAbleSize()); // 未读数据已无意义，避免 Shutdown 再交给消息回调
+            conn->Shutdown();
+            return;
+        }
+        ConnHandle handle = conn->Handle();
+        _idle.push_back(IdleConn{handle, MonotonicMicros()});
+        _loop->QueueInLoop(std::bind(&UpstreamPool::ArmIdle, this, handle));
+    }
 
-        // 执行任务(将任务队列中的任务全部执行一次)
-        RunAllTasks();
+    bool Healthy()
+    {
+        return _healthy;
     }
-    
-    void RunInLoop(const Functor& cb)
+    // 空闲连接数(可能包含已被对端关闭、尚未清理的连接)
+    size_t IdleCount()
     {
-
+        return _idle.size();
+    }
+    // 复用空闲连接的次数
+    uint64_t Reused()
+    {
+        return _reused;
+    }
+    TcpClient &Client()
+    {
+        return _client;
+    }
+    const std::string &Ip()
+    {
+        return _ip;
+    }
+    uint16_t Port()
+    {
+        return _port;
     }
 
-    void QueueInLoop(const Functor& cb)
-    { }
-
-    void IsInLoop()
+private:
+    struct IdleConn
     {
+        ConnHandle handle;
+        uint64_t since; // 归还时间(微秒)
+    };
 
+    // 换上空闲期间的回调(回调正在执行时不能替换，因此放到任务中)；期间已被再次取走的连接不处理
+    void ArmIdle(ConnHandle handle)
+    {
+        Connection *conn = _client.Pool()->Get(handle);
+        if (conn == nullptr)
+            return;
+        bool idle = false;
+        for (auto &it : _idle)
+            idle |= it.handle == handle;
+        if (!idle)
+            return;
+        conn->SetMessageCallBack(&UpstreamPool::OnIdleMessage);
+        conn->SetConnectedCallBack(nullptr);
+        conn->SetClosedCallBack(nullptr);
+        conn->SetAnyEventCallBack(nullptr);
+        conn->SetHighWaterMarkCallBack(nullptr);
+        conn->SetLowWaterMarkCallBack(nullptr);
+        conn->SetContext(Any());
     }
 
-    void UpdateEvent(Channel* channel)
-    { }
+    // 空闲连接不应收到数据(协议错误或对端的关闭前数据)，直接关闭
+    static void OnIdleMessage(Connection *conn, Buffer *buf)
+    {
+        buf->MoveReadOffset(buf->ReadAbleSize());
+        conn->Shutdown();
+    }
 
-    void RemoveEvent(Channel* channel)
+    void OnConnected(Connection *conn, const AcquireCallBack &cb)
     {
+        if (conn == nullptr)
+        {
+            if (++_fail_streak >= _opts.fail_threshold && _healthy)
+            {
+                _healthy = false;
+                ERR_LOG("Upstream %s:%u marked down after %u failures", _ip.c_str(), _port, _fail_streak);
+            }
+            return cb(nullptr);
+        }
+        _fail_streak = 0;
+        cb(conn);
+    }
 
+    void ScheduleCheck()
+    {
+        if (_opts.check_interval > 0)
+            _loop->RunAfter(_opts.check_interval, std::bind(&UpstreamPool::Check, this));
     }
-public:
-    static int CreateEventFd()
+
+    void Check()
     {
-        int efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); // 设置初始计数器为0， 禁止子进程复制，非阻塞
-        if(efd < 0)
+        // 队首的连接最早归还
+        uint64_t now = MonotonicMicros();
+        while (!_idle.empty() && now - _idle.front().since >= (uint64_t)_opts.idle_timeout * 1000000)
         {
-            ERR_LOG("Eventfd ERR");
-            abort();
-        }        
-        return efd;
+            Connection *conn = _client.Pool()->Get(_idle.front().handle);
+            if (conn)
+                conn->Shutdown();
+            _idle.pop_front();
+        }
+        if (!_healthy && !_probing)
+        {
+            _probing = true;
+            _client.Connect(_ip, _port, std::bind(&UpstreamPool::OnProbe, this, std::placeholders::_1),
+                            _opts.connect_timeout);
+        }
+        ScheduleCheck();
     }
 
-    // 从eventfd中读取通知次数
-    void ReadEventFd()
+    void OnProbe(Connection *conn)
     {
+        _probing = false;
+        if (conn == nullptr)
+            return;
+        INF_LOG("Upstream %s:%u is up again", _ip.c_str(), _port);
+        _healthy = true;
+        _fail_streak = 0;
+        Release(conn);
+    }
 
-    } 
+private:
+    EventLoop *_loop;
+    std::string _ip;
+    uint16_t _port;
+    UpstreamOptions _opts;
+    TcpClient _client;
+    std::deque<IdleConn> _idle;
+    bool _healthy;
+    uint32_t _fail_streak; // 连续连接失败次数
+    bool _probing;
+    uint64_t _reused;
+};
 
-    // 执行任务队列中的任务
-    void RunAllTasks()
+// 一个上游地址在所有事件循环中的连接池；生命周期须长于使用它的服务器
+class Upstream
+{
+public:
+    Upstream(const std::string &ip, uint16_t port, const UpstreamOptions &opts = UpstreamOptions())
+        : _ip(ip), _port(port), _opts(opts)
+    { }
+
+    // 所属线程调用：本线程的连接池，首次调用时创建
+    UpstreamPool *For(EventLoop *loop)
     {
-        std::vector<Functor> functor;
-        {
-            std::unique_lock<std::mutex> _lock(_mtx); // 用花括号限定作用域，出了作用域锁会自动释放
-            _tasks.swap(functor); // 清空现有的任务队列，并执行任务
-        }
-        for(auto& e : functor)
-            e();
+        loop->AssertInLoop();
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::unique_ptr<UpstreamPool> &pool = _pools[loop];
+        if (!pool)
+            pool.reset(new UpstreamPool(loop, _ip, _port, _opts));
+        return pool.get();
     }
-private:    
-    std::thread::id _thread_id; // 判断回调的任务在不在当前线程中，如果在当前线程就直接执行，如果不在就添加到任务队列中
-    std::vector<Functor> _tasks; // 任务队列
-    std::mutex _mtx; // 给任务队列加的锁
-    Poller _poll; // 对事件进行监控
-    int _eventfd; // 用于解决监控IO事件阻塞导致任务队列中的任务无法执行的错误
-    std::unique_ptr<Channel> _eventfd_channel; // 管理enventfd  
-};
\ No newline at end of file
+    const std::string &Ip()
+    {
+        return _ip;
+    }
+    uint16_t Port()
+    {
+        return _port;
+    }
+
+private:
+    std::string _ip;
+    uint16_t _port;
+    UpstreamOptions _opts;
+    std::mutex _mutex; // 只保护 _pools 的增删，各池只在所属线程中访问
+    std::unordered_map<EventLoop *, std::unique_ptr<UpstreamPool>> _pools;
+};
@@ -0,0 +1,566 @@
+#pragma once
+
+#include "../server.hpp"
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/kdf.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <linux/tls.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+#define TLS_RECORD_HEADER 5
+#define TLS_READ_CHUNK (16 * 1024)         // 单次 SSL_read 的明文大小(一条记录的上限)
+#define DEFAULT_TLS_SESSION_CACHE 20480    // 服务端会话缓存条数
+#define DEFAULT_TLS_SESSION_TIMEOUT 7200   // 会话与 ticket 有效期(秒)
+#define DEFAULT_TLS_TICKETS 2              // TLS1.3 握手后发给客户端的 ticket 数量
+
+// ================================================================
+//                            TlsContext模块
+// ================================================================
+// 服务端 TLS 配置，所有从属Reactor共享同一个 SSL_CTX(会话缓存与 ticket 密钥随之共享)
+struct TlsOptions
+{
+    std::string cert_file;    // PEM 证书链
+    std::string key_file;     // PEM 私钥
+    std::string ciphersuites; // TLS1.3 密码套件，空表示 OpenSSL 默认
+    std::string cipher_list;  // TLS1.2 密码套件，空表示 OpenSSL 默认
+    bool tls12;               // 是否允许 TLS1.2
+    size_t session_cache;     // 会话缓存条数(按会话 ID 恢复)，0 表示关闭
+    long session_timeout;
+    int tickets;              // 0 表示不发 ticket，只能按会话 ID 恢复
+    bool ktls;                // 握手完成后尝试把发送交给内核 TLS(仅 TLS1.3 AES-GCM/CHACHA20)
+
+    TlsOptions()
+        : tls12(true), session_cache(DEFAULT_TLS_SESSION_CACHE), session_timeout(DEFAULT_TLS_SESSION_TIMEOUT),
+          tickets(DEFAULT_TLS_TICKETS), ktls(true)
+    { }
+};
+
+class TlsFilter;
+class TlsContext
+{
+public:
+    TlsContext(const TlsOptions &opts)
+        : _opts(opts), _ctx(SSL_CTX_new(TLS_server_method())), _ok(false), _handshakes(0), _resumed(0), _ktls(0),
+          _ktls_unavailable(false)
+    {
+        if (_ctx == nullptr)
+            return;
+        SSL_CTX_set_min_proto_version(_ctx, opts.tls12 ? TLS1_2_VERSION : TLS1_3_VERSION);
+        // 内存 BIO 一次写入整条数据，不需要部分写；发送缓冲区由连接管理，释放 OpenSSL 的空闲缓冲区
+        SSL_CTX_set_mode(_ctx, SSL_MODE_RELEASE_BUFFERS);
+        if (!opts.ciphersuites.empty() && SSL_CTX_set_ciphersuites(_ctx, opts.ciphersuites.c_str()) != 1)
+        {
+            Error("set ciphersuites");
+            return;
+        }
+        if (!opts.cipher_list.empty() && SSL_CTX_set_cipher_list(_ctx, opts.cipher_list.c_str()) != 1)
+        {
+            Error("set cipher list");
+            return;
+        }
+        if (SSL_CTX_use_certificate_chain_file(_ctx, opts.cert_file.c_str()) != 1)
+        {
+            Error("load certificate");
+            return;
+        }
+        if (SSL_CTX_use_PrivateKey_file(_ctx, opts.key_file.c_str(), SSL_FILETYPE_PEM) != 1)
+        {
+            Error("load private key");
+            return;
+        }
+        if (SSL_CTX_check_private_key(_ctx) != 1)
+        {
+            Error("check private key");
+            return;
+        }
+
+        static const unsigned char sid_ctx[] = "http-v1";
+        SSL_CTX_set_session_id_context(_ctx, sid_ctx, sizeof(sid_ctx) - 1);
+        SSL_CTX_set_timeout(_ctx, opts.session_timeout);
+        if (opts.session_cache > 0)
+        {
+            SSL_CTX_set_session_cache_mode(_ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(_ctx, opts.session_cache);
+        }
+        else
+            SSL_CTX_set_session_cache_mode(_ctx, SSL_SESS_CACHE_OFF);
+        // ticket 密钥由 OpenSSL 在创建 SSL_CTX 时随机生成，进程内共享
+        if (opts.tickets > 0)
+            SSL_CTX_set_num_tickets(_ctx, opts.tickets);
+        else
+        {
+            SSL_CTX_set_options(_ctx, SSL_OP_NO_TICKET);
+            SSL_CTX_set_num_tickets(_ctx, 0);
+        }
+        if (opts.ktls)
+            SSL_CTX_set_keylog_callback(_ctx, &TlsContext::KeyLog);
+        _ok = true;
+    }
+    ~TlsContext()
+    {
+        if (_ctx)
+            SSL_CTX_free(_ctx);
+    }
+
+    bool Ok()
+    {
+        return _ok;
+    }
+    SSL_CTX *Native()
+    {
+        return _ctx;
+    }
+    const TlsOptions &Options()
+    {
+        return _opts;
+    }
+    // 为新连接创建传输层
+    TransportFilter *NewFilter();
+    // 交给 TcpServer::SetTransportFilterFactory，TlsContext 的生命周期须长于服务器
+    TransportFilterFactory Factory()
+    {
+        return std::bind(&TlsContext::NewFilter, this);
+    }
+
+    // 统计：完成的握手数、其中恢复会话的次数、切换到内核 TLS 的连接数
+    uint64_t Handshakes()
+    {
+        return _handshakes.load(std::memory_order_relaxed);
+    }
+    uint64_t Resumed()
+    {
+        return _resumed.load(std::memory_order_relaxed);
+    }
+    uint64_t KtlsConnections()
+    {
+        return _ktls.load(std::memory_order_relaxed);
+    }
+
+    // 生成自签名证书与 P-256 私钥(本地测试与压测用)
+    static bool WriteSelfSigned(const std::string &cert_file, const std::string &key_file,
+                                const std::string &cn = "localhost", int days = 365)
+    {
+        EVP_PKEY *pkey = EVP_EC_gen("P-256");
+        X509 *x509 = X509_new();
+        bool ok = pkey != nullptr && x509 != nullptr;
+        if (ok)
+        {
+            X509_set_version(x509, 2);
+            ASN1_INTEGER_set(X509_get_serialNumber(x509), (long)time(nullptr));
+            X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+            X509_gmtime_adj(X509_getm_notAfter(x509), (long)days * 24 * 3600);
+            X509_set_pubkey(x509, pkey);
+            X509_NAME *name = X509_get_subject_name(x509);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)cn.c_str(), -1, -1, 0);
+            X509_set_issuer_name(x509, name);
+            ok = X509_sign(x509, pkey, EVP_sha256()) > 0;
+        }
+        FILE *fp;
+        if (ok && (ok = (fp = fopen(key_file.c_str(), "w")) != nullptr))
+        {
+            ok = PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+            fclose(fp);
+        }
+        if (ok && (ok = (fp = fopen(cert_file.c_str(), "w")) != nullptr))
+        {
+            ok = PEM_write_X509(fp, x509) == 1;
+            fclose(fp);
+        }
+        X509_free(x509);
+        EVP_PKEY_free(pkey);
+        return ok;
+    }
+
+private:
+    friend class TlsFilter;
+
+    void Error(const char *what)
+    {
+        char err[256];
+        ERR_error_string_n(ERR_get_error(), err, sizeof(err));
+        ERR_LOG("TLS %s failed: %s", what, err);
+    }
+    static void KeyLog(const SSL *ssl, const char *line);
+
+private:
+    TlsOptions _opts;
+    SSL_CTX *_ctx;
+    bool _ok;
+    std::atomic<uint64_t> _handshakes;
+    std::atomic<uint64_t> _resumed;
+    std::atomic<uint64_t> _ktls;
+    std::atomic<bool> _ktls_unavailable; // 内核没有 tls 模块，不再尝试
+};
+
+// ================================================================
+//                            TlsFilter模块
+// ================================================================
+// 每个连接一个 SSL 对象，经一对内存 BIO 与连接的读写回调对接：
+//   Decode: 收到的密文写入读 BIO，推进握手或读出明文；握手与告警产生的密文从写 BIO 取出交给连接发送
+//   Encode: 明文经 SSL_write 加密后从写 BIO 取出；握手完成前先暂存
+// 开启 ktls 时，握手完成且之前的密文全部发出后，按 TLS1.3 的发送密钥配置 TCP_ULP "tls"，
+// 之后明文(包括 sendfile)直接写入套接字由内核加密；接收仍在用户态解密。
+// 内核不支持或套件不支持时继续在用户态加密
+typedef enum
+{
+    TLS_HANDSHAKE,   // 握手中，待发送的明文暂存
+    TLS_AWAIT_DRAIN, // 握手完成，等待输出队列清空后切换到内核 TLS，待发送的明文暂存
+    TLS_OPEN,        // 用户态加密
+    TLS_KERNEL,      // 内核加密
+    TLS_FAILED
+} TlsState;
+
+class TlsFilter : public TransportFilter
+{
+public:
+    TlsFilter(TlsContext *ctx)
+        : _ctx(ctx), _ssl(SSL_new(ctx->Native())), _state(TLS_HANDSHAKE), _tx_seq(0), _counting(false),
+          _secret_len(0), _closed(false)
+    {
+        if (_ssl == nullptr)
+        {
+            _state = TLS_FAILED;
+            return;
+        }
+        _rbio = BIO_new(BIO_s_mem());
+        _wbio = BIO_new(BIO_s_mem());
+        SSL_set_bio(_ssl, _rbio, _wbio);
+        SSL_set_accept_state(_ssl);
+        SSL_set_app_data(_ssl, this);
+    }
+    ~TlsFilter()
+    {
+        OPENSSL_cleanse(_secret, sizeof(_secret));
+        if (_ssl)
+            SSL_free(_ssl);
+    }
+
+    virtual bool Decode(const char *data, size_t len, Buffer *plain, Buffer *wire)
+    {
+        if (_state == TLS_FAILED)
+            return false;
+        BIO_write(_rbio, data, len);
+        if (_state == TLS_HANDSHAKE)
+        {
+            int ret = SSL_do_handshake(_ssl);
+            if (ret <= 0)
+            {
+                int err = SSL_get_error(_ssl, ret);
+                DrainWire(wire);
+                if (err == SSL_ERROR_WANT_READ)
+                    return true;
+                return Fail("handshake");
+            }
+            HandshakeDone(wire);
+        }
+        while (true)
+        {
+            // 直接解密到连接的输入缓冲区
+            plain->EnsureWriteSpace(TLS_READ_CHUNK);
+            int n = SSL_read(_ssl, plain->WritePos(), TLS_READ_CHUNK);
+            if (n > 0)
+            {
+                plain->MoveWriteOffset(n);
+                continue;
+            }
+            int err = SSL_get_error(_ssl, n);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_ZERO_RETURN) // 后者为对端发来关闭通知
+                break;
+            DrainWire(wire);
+            return Fail("read");
+        }
+        // 内核接管发送后 OpenSSL 不能再写记录(如回应 KeyUpdate)，否则序号错乱
+        if (_state == TLS_KERNEL && BIO_ctrl_pending(_wbio) > 0)
+            return Fail("post-handshake message after kernel TLS");
+        DrainWire(wire);
+        return true;
+    }
+
+    virtual bool Encode(const char *data, size_t len, Buffer *wire)
+    {
+        switch (_state)
+        {
+        case TLS_HANDSHAKE:
+        case TLS_AWAIT_DRAIN:
+            _held.Write(data, len);
+            return true;
+        case TLS_OPEN:
+            return Encrypt(data, len, wire);
+        case TLS_KERNEL:
+            wire->Write(data, len);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    virtual bool Passthrough()
+    {
+        return _state == TLS_KERNEL;
+    }
+
+    virtual void OnDrained(int fd, Buffer *wire)
+    {
+        if (_state != TLS_AWAIT_DRAIN)
+            return;
+        if (EnableKernelTls(fd))
+        {
+            _state = TLS_KERNEL;
+            _ctx->_ktls.fetch_add(1, std::memory_order_relaxed);
+            wire->WriteBufferAndConsume(_held);
+        }
+        else
+            FlushHeld(wire);
+        OPENSSL_cleanse(_secret, sizeof(_secret));
+        _held.Shrink(0);
+    }
+
+    // 用户态加密时发送 close_notify；内核加密时直接关闭连接
+    virtual void Close(Buffer *wire)
+    {
+        if (_closed)
+            return;
+        _closed = true;
+        if (_state == TLS_AWAIT_DRAIN)
+            FlushHeld(wire);
+        if (_state != TLS_OPEN)
+            return;
+        SSL_shutdown(_ssl);
+        DrainWire(wire);
+    }
+
+    TlsState State()
+    {
+        return _state;
+    }
+    SSL *Native()
+    {
+        return _ssl;
+    }
+
+    // TLS1.3 HKDF-Expand-Label(secret, label, "", out_len)
+    static bool ExpandLabel(const EVP_MD *md, const unsigned char *secret, size_t secret_len, const char *label,
+                            unsigned char *out, size_t out_len)
+    {
+        unsigned char info[2 + 1 + 255 + 1];
+        size_t label_len = strlen(label) + 6;
+        if (label_len > 255)
+            return false;
+        info[0] = out_len >> 8;
+        info[1] = out_len & 0xff;
+        info[2] = label_len;
+        memcpy(info + 3, "tls13 ", 6);
+        memcpy(info + 9, label, label_len - 6);
+        info[3 + label_len] = 0; // 空的上下文
+        EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+        if (pctx == nullptr)
+            return false;
+        bool ok = EVP_PKEY_derive_init(pctx) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+                  EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+                  EVP_PKEY_CTX_set1_hkdf_key(pctx, secret, secret_len) > 0 &&
+                  EVP_PKEY_CTX_add1_hkdf_info(pctx, info, 4 + label_len) > 0 &&
+                  EVP_PKEY_derive(pctx, out, &out_len) > 0;
+        EVP_PKEY_CTX_free(pctx);
+        return ok;
+    }
+
+private:
+    friend class TlsContext;
+
+    // 握手完成后 OpenSSL 写出的记录(ticket 等)都用发送密钥加密，从此开始计数
+    void HandshakeDone(Buffer *wire)
+    {
+        _counting = true;
+        DrainWire(wire);
+        _ctx->_handshakes.fetch_add(1, std::memory_order_relaxed);
+        if (SSL_session_reused(_ssl))
+            _ctx->_resumed.fetch_add(1, std::memory_order_relaxed);
+        if (_secret_len > 0 && SSL_version(_ssl) == TLS1_3_VERSION && !_ctx->_ktls_unavailable.load(std::memory_order_relaxed))
+            _state = TLS_AWAIT_DRAIN;
+        else
+            FlushHeld(wire);
+    }
+
+    void FlushHeld(Buffer *wire)
+    {
+        _state = TLS_OPEN;
+        if (_held.ReadAbleSize() > 0 && Encrypt(_held.ReadPos(), _held.ReadAbleSize(), wire))
+            _held.Clear();
+    }
+
+    bool Encrypt(const char *data, size_t len, Buffer *wire)
+    {
+        // 内存 BIO 没有容量限制，SSL_write 一次写完(按记录大小分成多条记录)
+        if (len > 0 && SSL_write(_ssl, data, len) <= 0)
+        {
+            DrainWire(wire);
+            return Fail("write");
+        }
+        DrainWire(wire);
+        return true;
+    }
+
+    // 取出写 BIO 中的密文
+    void DrainWire(Buffer *wire)
+    {
+        size_t pending = BIO_ctrl_pending(_wbio);
+        if (pending == 0)
+            return;
+        wire->EnsureWriteSpace(pending);
+        int n = BIO_read(_wbio, wire->WritePos(), pending);
+        if (n <= 0)
+            return;
+        if (_counting)
+            CountRecords(wire->WritePos(), n);
+        wire->MoveWriteOffset(n);
+    }
+
+    // OpenSSL 每次向内存 BIO 写入完整的记录
+    void CountRecords(const char *data, size_t len)
+    {
+        size_t pos = 0;
+        while (pos + TLS_RECORD_HEADER <= len)
+        {
+            size_t body = ((unsigned char)data[pos + 3] << 8) | (unsigned char)data[pos + 4];
+            pos += TLS_RECORD_HEADER + body;
+            _tx_seq++;
+        }
+    }
+
+    bool Fail(const char *what)
+    {
+        unsigned long code = ERR_get_error();
+        char err[256];
+        ERR_error_string_n(code, err, sizeof(err));
+        DBG_LOG("TLS %s failed: %s", what, code ? err : "-");
+        ERR_clear_error();
+        _state = TLS_FAILED;
+        return false;
+    }
+
+    // 以 TLS1.3 发送流量密钥配置内核 TLS，记录序号从 OpenSSL 已写出的记录数开始
+    bool EnableKernelTls(int fd)
+    {
+        const SSL_CIPHER *cipher = SSL_get_current_cipher(_ssl);
+        if (cipher == nullptr)
+            return false;
+        uint16_t id = SSL_CIPHER_get_id(cipher) & 0xffff;
+        const EVP_MD *md = id == 0x1302 ? EVP_sha384() : EVP_sha256();
+        size_t key_len = id == 0x1301 ? 16 : 32;
+        if (id != 0x1301 && id != 0x1302 && id != 0x1303)
+            return false;
+        unsigned char key[32], iv[12], seq[8];
+        if (!ExpandLabel(md, _secret, _secret_len, "key", key, key_len) || !ExpandLabel(md, _secret, _secret_len, "iv", iv, 12))
+            return false;
+        for (int i = 0; i < 8; i++)
+            seq[i] = _tx_seq >> (56 - 8 * i);
+        if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0)
+        {
+            if ((errno == ENOENT || errno == ENOPROTOOPT) && !_ctx->_ktls_unavailable.exchange(true))
+                INF_LOG("Kernel TLS unavailable (%s), encrypt in user space", strerror(errno));
+            OPENSSL_cleanse(key, sizeof(key));
+            return false;
+        }
+        int ret;
+        if (id == 0x1303)
+        {
+            struct tls12_crypto_info_chacha20_poly1305 info;
+            memset(&info, 0, sizeof(info));
+            info.info.version = TLS_1_3_VERSION;
+            info.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            memcpy(info.key, key, sizeof(info.key));
+            memcpy(info.iv, iv, sizeof(info.iv));
+            memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+            ret = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+            OPENSSL_cleanse(&info, sizeof(info));
+        }
+        else if (id == 0x1302)
+        {
+            struct tls12_crypto_info_aes_gcm_256 info;
+            memset(&info, 0, sizeof(info));
+            info.info.version = TLS_1_3_VERSION;
+            info.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+            memcpy(info.key, key, sizeof(info.key));
+            memcpy(info.salt, iv, sizeof(info.salt)); // 12 字节 IV = salt(4) + iv(8)
+            memcpy(info.iv, iv + 4, sizeof(info.iv));
+            memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+            ret = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+            OPENSSL_cleanse(&info, sizeof(info));
+        }
+        else
+        {
+            struct tls12_crypto_info_aes_gcm_128 info;
+            memset(&info, 0, sizeof(info));
+            info.info.version = TLS_1_3_VERSION;
+            info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+            memcpy(info.key, key, sizeof(info.key));
+            memcpy(info.salt, iv, sizeof(info.salt));
+            memcpy(info.iv, iv + 4, sizeof(info.iv));
+            memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+            ret = setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info));
+            OPENSSL_cleanse(&info, sizeof(info));
+        }
+        OPENSSL_cleanse(key, sizeof(key));
+        // 只挂上 ULP 而没有配置 TLS_TX 时套接字仍按普通 TCP 发送，可以安全回退
+        if (ret < 0)
+        {
+            DBG_LOG("TLS_TX setsockopt failed: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // keylog 回调：只保留服务端应用流量密钥
+    void SetTrafficSecret(const char *hex)
+    {
+        size_t len = strlen(hex) / 2;
+        if (len > sizeof(_secret))
+            return;
+        for (size_t i = 0; i < len; i++)
+        {
+            unsigned int byte;
+            if (sscanf(hex + 2 * i, "%2x", &byte) != 1)
+                return;
+            _secret[i] = byte;
+        }
+        _secret_len = len;
+    }
+
+private:
+    TlsContext *_ctx;
+    SSL *_ssl;
+    BIO *_rbio; // 收到的密文
+    BIO *_wbio; // 待发送的密文
+    TlsState _state;
+    Buffer _held;     // 握手完成或切换内核 TLS 之前暂存的明文
+    uint64_t _tx_seq; // 握手完成后 OpenSSL 已写出的记录数
+    bool _counting;
+    unsigned char _secret[EVP_MAX_MD_SIZE]; // SERVER_TRAFFIC_SECRET_0
+    size_t _secret_len;
+    bool _closed;
+};
+
+TransportFilter *TlsContext::NewFilter()
+{
+    return new TlsFilter(this);
+}
+
+void TlsContext::KeyLog(const SSL *ssl, const char *line)
+{
+    static const char label[] = "SERVER_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, label, sizeof(label) - 1) != 0)
+        return;
+    const char *secret = strchr(line + sizeof(label) - 1, ' '); // 跳过 client random
+    TlsFilter *filter = (TlsFilter *)SSL_get_app_data(ssl);
+    if (secret != nullptr && filter != nullptr)
+        filter->SetTrafficSecret(secret + 1);
+}
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <dirent.h>
+#include <sys/resource.h>
+#include "../../source/server.hpp"
+#include "../testutil.hpp"
+
+// Acceptor 测试：单轮 accept 上限、非阻塞 fd、令牌桶限速、描述符耗尽时的预留 fd
+
+static std::vector<int> g_accepted;
+
+void OnAccept(int fd)
+{
+    g_accepted.push_back(fd);
+}
+
+uint16_t LocalPort(Acceptor &acceptor)
+{
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(acceptor.GetSocket().GetFd(), (sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+// 当前进程中最大的描述符
+int MaxFd()
+{
+    int max = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != nullptr)
+        max = std::max(max, atoi(ent->d_name));
+    closedir(dir);
+    return max;
+}
+
+void CloseAll(std::vector<int> &fds)
+{
+    for (int fd : fds)
+        close(fd);
+    fds.clear();
+}
+
+int main()
+{
+    std::cout << "==== Acceptor Test Begin ====\n";
+
+    EventLoop loop;
+    std::vector<int> clients;
+
+    /* =========================
+     * 1. 单轮 accept 上限 + accept4 标志位
+     * ========================= */
+    {
+        Acceptor acceptor(&loop, 0, "127.0.0.1");
+        acceptor.SetAcceptCallBack(OnAccept);
+        acceptor.SetAcceptBudget(2);
+        acceptor.Listen();
+        uint16_t port = LocalPort(acceptor);
+
+        for (int i = 0; i < 5; i++)
+            clients.push_back(Connect(port));
+
+        loop.Start();
+        assert(g_accepted.size() == 2);
+        loop.Start();
+        assert(g_accepted.size() == 4);
+        loop.Start();
+        assert(g_accepted.size() == 5);
+
+        int fd = g_accepted[0];
+        assert(fcntl(fd, F_GETFL) & O_NONBLOCK);
+        assert(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+
+        CloseAll(g_accepted);
+        CloseAll(clients);
+        std::cout << "[OK] accept budget + nonblock/cloexec\n";
+    }
+
+    /* =========================
+     * 2. 令牌桶限速
+     * ========================= */
+    {
+        Acceptor acceptor(&loop, 0, "127.0.0.1");
+        acceptor.SetAcceptCallBack(OnAccept);
+        acceptor.SetRateLimit(20, 2); // 每秒 20 个，突发 2 个
+        acceptor.Listen();
+        uint16_t port = LocalPort(acceptor);
+
+        for (int i = 0; i < 4; i++)
+            clients.push_back(Connect(port));
+
+        auto start = std::chrono::steady_clock::now();
+        loop.Start();
+        assert(g_accepted.size() == 2);
+        while (g_accepted.size() < 4)
+            loop.Start();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        assert(ms >= 80); // 后两个连接至少各等待一个令牌(50ms)
+
+        CloseAll(g_accepted);
+        CloseAll(clients);
+        std::cout << "[OK] token bucket rate limit (" << ms << "ms)\n";
+    }
+
+    /* =========================
+     * 3. 描述符耗尽：释放预留 fd 接受并关闭新连接
+     * ========================= */
+    {
+        Acceptor acceptor(&loop, 0, "127.0.0.1");
+        acceptor.SetAcceptCallBack(OnAccept);
+        acceptor.Listen();
+        uint16_t port = LocalPort(acceptor);
+        clients.push_back(Connect(port));
+
+        struct rlimit old, lim;
+        getrlimit(RLIMIT_NOFILE, &old);
+        lim = old;
+        lim.rlim_cur = MaxFd() + 1;
+        setrlimit(RLIMIT_NOFILE, &lim);
+        std::vector<int> fillers; // 占满剩余的空洞，不再允许打开新的描述符
+        int fd;
+        while ((fd = open("/dev/null", O_RDONLY)) >= 0)
+            fillers.push_back(fd);
+
+        loop.Start();
+        CloseAll(fillers);
+        setrlimit(RLIMIT_NOFILE, &old);
+
+        assert(g_accepted.empty());
+        assert(acceptor.ShedCount() == 1);
+        char c;
+        ssize_t n = read(clients[0], &c, 1);
+        assert(n == 0); // 客户端收到 FIN，而不是一直挂起
+
+        CloseAll(clients);
+        std::cout << "[OK] spare fd on EMFILE\n";
+    }
+
+    std::cout << "==== Acceptor Test All Passed ====\n";
+    return 0;
+}
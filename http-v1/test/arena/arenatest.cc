@@ -0,0 +1,115 @@
+#include <iostream>
+#include <string>
+#include <future>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// Arena 测试：分级复用、大块单独映射、未启用时回退 malloc、事件循环中的 Buffer/Connection 来自本地 Arena、
+// 页面节点统计、大页回退、事件循环销毁后仍可释放
+
+void TestFallback()
+{
+    assert(LoopArena::Current() == nullptr);
+    void *p = LoopArena::Allocate(100);
+    memset(p, 1, 100);
+    LoopArena::Free(p);
+    Buffer buf; // 不在事件循环线程中，存储来自全局 operator new
+    buf.WriteString(std::string(5000, 'a'));
+    assert(buf.ReadAbleSize() == 5000);
+    std::cout << "fallback ok" << std::endl;
+}
+
+void TestArena()
+{
+    std::thread([]() {
+        EventLoop loop;
+        loop.EnableArena();
+        LoopArena *arena = loop.Arena();
+        assert(LoopArena::Current() == arena);
+        assert(arena->Node() == LoopArena::CurrentNode());
+
+        // 同一分级释放后复用
+        void *a = LoopArena::Allocate(1000);
+        size_t used = arena->InUseBytes();
+        assert(used == 1024 + ARENA_HEADER_SIZE);
+        LoopArena::Free(a);
+        assert(arena->InUseBytes() == 0);
+        void *b = LoopArena::Allocate(600);
+        assert(a == b);
+        LoopArena::Free(b);
+        assert(arena->MappedBytes() == ARENA_CHUNK_SIZE);
+
+        // 超过最大分级单独映射，释放即归还
+        void *big = LoopArena::Allocate(3 * 1024 * 1024);
+        memset(big, 1, 3 * 1024 * 1024);
+        assert(arena->MappedBytes() > ARENA_CHUNK_SIZE + 3 * 1024 * 1024);
+        LoopArena::Free(big);
+        assert(arena->MappedBytes() == ARENA_CHUNK_SIZE);
+
+        // 连接对象与其 Buffer 都来自本地 Arena
+        ConnectionPool pool(&loop);
+        pool.Reserve(4);
+        assert(arena->InUseBytes() >= 4 * (sizeof(Connection) + 2 * DEFAULT_BUFFER_SIZE));
+        size_t before = arena->InUseBytes();
+        Buffer buf;
+        buf.WriteString(std::string(100000, 'x'));
+        assert(arena->InUseBytes() >= before + 100000);
+
+        // 已访问的页面都在本节点
+        uint64_t local = 0, remote = 0;
+        double ratio = arena->LocalRatio(&local, &remote);
+        assert(local > 0);
+        std::cout << arena->Report();
+        assert(ratio == 1.0 && remote == 0);
+        assert(loop.Metrics().arena_bytes.Get() == arena->MappedBytes());
+        assert(loop.Metrics().arena_local_pages.Get() == local);
+        std::string text = MetricsRegistry::Instance().ExportPrometheus();
+        assert(text.find("reactor_arena_bytes{loop=\"" + std::to_string(loop.Metrics().id) + "\"} " +
+                         std::to_string(arena->MappedBytes())) != std::string::npos);
+    }).join();
+    std::cout << "arena ok" << std::endl;
+}
+
+void TestHugePage()
+{
+    std::thread([]() {
+        EventLoop loop;
+        ArenaOptions opts;
+        opts.huge_page = HUGE_PAGE_EXPLICIT;
+        loop.EnableArena(opts);
+        void *p = LoopArena::Allocate(4096);
+        memset(p, 1, 4096);
+        // 没有预留大页时回退为透明大页
+        assert(loop.Arena()->HugePage() == HUGE_PAGE_EXPLICIT || loop.Arena()->HugePage() == HUGE_PAGE_TRANSPARENT);
+        std::cout << loop.Arena()->Report();
+        LoopArena::Free(p);
+    }).join();
+    std::cout << "huge page ok" << std::endl;
+}
+
+void TestRetire()
+{
+    // 事件循环销毁后，仍在使用的 Buffer 可以在其他线程中安全释放
+    std::promise<Buffer *> done;
+    std::thread([&done]() {
+        EventLoop loop;
+        loop.EnableArena();
+        Buffer *buf = new Buffer();
+        buf->WriteString(std::string(50000, 'y'));
+        done.set_value(buf);
+    }).join();
+    Buffer *buf = done.get_future().get();
+    assert(buf->ReadAbleSize() == 50000 && buf->ReadPos()[49999] == 'y');
+    delete buf;
+    std::cout << "retire ok" << std::endl;
+}
+
+int main()
+{
+    TestFallback();
+    TestArena();
+    TestHugePage();
+    TestRetire();
+    std::cout << "==== Arena Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "../../source/server.hpp"
+
+// 基准测试服务端：基于 TcpServer 的回显 / HTTP 固定响应服务
+//   ./bench_server --port 8500 --threads 2 --mode echo|http --body 128 --profile default|rpc|bulk
+//     [--busy-poll US] [--cpus 0,1,...] [--incoming-cpu 0|1]
+
+struct ServerArgs
+{
+    uint16_t port = 8500;
+    int threads = 1;
+    std::string mode = "echo";
+    size_t body = 128;
+    std::string profile = "default";
+    uint64_t busy_poll = 0;     // 忙轮询上限(微秒)，0 关闭
+    std::vector<int> cpus;      // 从属线程依次绑定的 CPU，空表示不绑定
+    bool incoming_cpu = false;  // 按 SO_INCOMING_CPU 分配连接
+};
+
+static std::string g_http_response; // 预先序列化好的 HTTP 响应
+
+void OnEchoMessage(Connection *conn, Buffer *buf)
+{
+    conn->Send(buf->ReadPos(), buf->ReadAbleSize());
+    buf->MoveReadOffset(buf->ReadAbleSize());
+}
+
+// 只做最小解析：按空行切分请求头，跳过 Content-Length 指定的请求体，支持流水线
+void OnHttpMessage(Connection *conn, Buffer *buf)
+{
+    while (buf->ReadAbleSize() > 0)
+    {
+        const char *begin = buf->ReadPos();
+        const char *end = (const char *)memmem(begin, buf->ReadAbleSize(), "\r\n\r\n", 4);
+        if (end == nullptr)
+            return;
+        size_t head = end - begin + 4;
+        size_t body = 0;
+        const char *cl = (const char *)memmem(begin, head, "Content-Length:", 15);
+        if (cl != nullptr)
+            body = strtoul(cl + 15, nullptr, 10);
+        if (buf->ReadAbleSize() < head + body)
+            return;
+        buf->MoveReadOffset(head + body);
+        conn->Send(g_http_response.data(), g_http_response.size());
+    }
+}
+
+bool ParseArgs(int argc, char *argv[], ServerArgs *args)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string key = argv[i], val = argv[i + 1];
+        if (key == "--port")
+            args->port = atoi(val.c_str());
+        else if (key == "--threads")
+            args->threads = atoi(val.c_str());
+        else if (key == "--mode")
+            args->mode = val;
+        else if (key == "--body")
+            args->body = strtoul(val.c_str(), nullptr, 10);
+        else if (key == "--profile")
+            args->profile = val;
+        else if (key == "--busy-poll")
+            args->busy_poll = strtoull(val.c_str(), nullptr, 10);
+        else if (key == "--cpus")
+            args->cpus = LoopPlacement::ParseCpuList(val);
+        else if (key == "--incoming-cpu")
+            args->incoming_cpu = atoi(val.c_str()) != 0;
+        else
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    ServerArgs args;
+    if (!ParseArgs(argc, argv, &args))
+    {
+        fprintf(stderr, "usage: %s [--port N] [--threads N] [--mode echo|http] [--body N] [--profile default|rpc|bulk] [--busy-poll US] [--cpus 0-3] [--incoming-cpu 0|1]\n", argv[0]);
+        return 1;
+    }
+
+    SocketOptions opts;
+    if (args.profile == "rpc")
+        opts = SocketOptions::LowLatencyRpc();
+    else if (args.profile == "bulk")
+        opts = SocketOptions::BulkTransfer();
+
+    g_http_response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " +
+                      std::to_string(args.body) + "\r\n\r\n" + std::string(args.body, 'x');
+
+    TcpServer server(args.port, "0.0.0.0", opts);
+    server.SetThreadCount(args.threads);
+    server.SetBusyPoll(args.busy_poll);
+    if (!args.cpus.empty())
+    {
+        // 从属线程依次独占列表中的一个核心，启动时打印放置情况
+        LoopPlacement placement;
+        for (int i = 0; i < args.threads; i++)
+            placement.loops.push_back(std::vector<int>(1, args.cpus[i % args.cpus.size()]));
+        server.SetPlacement(placement);
+    }
+    server.SetIncomingCpuDispatch(args.incoming_cpu);
+    if (args.mode == "http")
+        server.SetMessageCallBack(OnHttpMessage);
+    else
+        server.SetMessageCallBack(OnEchoMessage);
+    server.Start();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#pragma once
+// 基准测试公用的延迟直方图(HDR Histogram 风格的对数-线性分桶)
+//   - 数值按 2 的幂分段，每段再线性划分 64 个子桶，相对误差 < 1/64
+//   - 记录 O(1)、无分配，每个线程一份，结束后合并
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#define HIST_SUB_BITS 6
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_SHIFT 40 // 可记录到 2^46 ns，足够覆盖任何延迟
+
+class Histogram
+{
+public:
+    Histogram()
+        : _counts((HIST_MAX_SHIFT + 1) * HIST_SUB_COUNT, 0), _total(0), _max(0), _sum(0)
+    { }
+
+    void Record(uint64_t value)
+    {
+        _counts[Index(value)]++;
+        _total++;
+        _sum += value;
+        _max = std::max(_max, value);
+    }
+
+    void Merge(const Histogram &other)
+    {
+        for (size_t i = 0; i < _counts.size(); i++)
+            _counts[i] += other._counts[i];
+        _total += other._total;
+        _sum += other._sum;
+        _max = std::max(_max, other._max);
+    }
+
+    void Reset()
+    {
+        std::fill(_counts.begin(), _counts.end(), 0);
+        _total = 0;
+        _sum = 0;
+        _max = 0;
+    }
+
+    // q 取值 [0, 1]，返回对应分位数所在桶的上界
+    uint64_t Percentile(double q) const
+    {
+        if (_total == 0)
+            return 0;
+        uint64_t rank = (uint64_t)(q * _total);
+        if (rank >= _total)
+            rank = _total - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < _counts.size(); i++)
+        {
+            seen += _counts[i];
+            if (seen > rank)
+                return std::min(UpperBound(i), _max);
+        }
+        return _max;
+    }
+
+    uint64_t Count() const
+    {
+        return _total;
+    }
+    uint64_t Max() const
+    {
+        return _max;
+    }
+    double Mean() const
+    {
+        return _total ? (double)_sum / _total : 0;
+    }
+
+private:
+    // 小于 64 的值直接落在第 0 段；否则第 shift+1 段覆盖 [64 << shift, 128 << shift)，段内按高 7 位线性划分
+    static size_t Index(uint64_t v)
+    {
+        if (v < HIST_SUB_COUNT)
+            return v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - HIST_SUB_BITS;
+        if (shift >= HIST_MAX_SHIFT)
+            return (HIST_MAX_SHIFT + 1) * HIST_SUB_COUNT - 1;
+        size_t sub = (v >> shift) - HIST_SUB_COUNT;
+        return (shift + 1) * HIST_SUB_COUNT + sub;
+    }
+
+    static uint64_t UpperBound(size_t idx)
+    {
+        size_t seg = idx / HIST_SUB_COUNT;
+        size_t sub = idx % HIST_SUB_COUNT;
+        if (seg == 0)
+            return sub;
+        size_t shift = seg - 1;
+        return ((uint64_t)(HIST_SUB_COUNT + sub) << shift) + ((1ULL << shift) - 1);
+    }
+
+private:
+    std::vector<uint64_t> _counts;
+    uint64_t _total;
+    uint64_t _max;
+    uint64_t _sum;
+};
@@ -0,0 +1,370 @@
+// 多线程 epoll 负载生成器(闭环)：每个连接保持固定的流水线深度，收到一个完整响应就补发一个请求
+//   ./loadgen --port 8500 --mode echo|http --threads 2 --conns 64 --size 64 --pipeline 1 --duration 5
+// 结果以一行 JSON 输出，便于多次运行之间比较
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "histogram.hpp"
+
+struct LoadArgs
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 8500;
+    std::string mode = "echo";
+    std::string path = "/";
+    int threads = 1;
+    int conns = 16;
+    size_t size = 64;   // echo: 每个请求的字节数；http: 请求体大小(0 为 GET)
+    int pipeline = 1;
+    double duration = 5;
+    double warmup = 1;
+    int server_pid = 0; // 指定后统计服务端 CPU 时间
+    std::string label;  // 附加到输出中的标签
+};
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 进程 CPU 时间(微秒)，pid 为 0 表示当前进程
+static uint64_t CpuMicros(int pid)
+{
+    if (pid == 0)
+    {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_utime.tv_sec * 1000000ULL + ru.ru_utime.tv_usec + ru.ru_stime.tv_sec * 1000000ULL + ru.ru_stime.tv_usec;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (fp == nullptr)
+        return 0;
+    char buf[1024];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = 0;
+    // 第 14、15 个字段为 utime、stime(时钟滴答)，comm 字段可能带空格，从 ')' 之后开始解析
+    const char *p = strrchr(buf, ')');
+    if (p == nullptr)
+        return 0;
+    unsigned long utime = 0, stime = 0;
+    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime);
+    return (utime + stime) * 1000000ULL / sysconf(_SC_CLK_TCK);
+}
+
+struct ClientConn
+{
+    int fd = -1;
+    std::string out;               // 待发送数据
+    size_t out_off = 0;
+    std::string in;                // 已接收未解析数据
+    std::deque<uint64_t> inflight; // 每个未完成请求的发送时间
+};
+
+class Worker
+{
+public:
+    Worker(const LoadArgs &args, int conns, std::atomic<bool> *recording, std::atomic<bool> *stop)
+        : _args(args), _conns(conns), _recording(recording), _stop(stop), _requests(0), _errors(0)
+    {
+        if (args.mode == "http")
+        {
+            if (args.size == 0)
+                _request = "GET " + args.path + " HTTP/1.1\r\nHost: bench\r\n\r\n";
+            else
+                _request = "POST " + args.path + " HTTP/1.1\r\nHost: bench\r\nContent-Length: " +
+                           std::to_string(args.size) + "\r\n\r\n" + std::string(args.size, 'b');
+        }
+        else
+            _request.assign(args.size, 'e');
+    }
+
+    void Run()
+    {
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        std::vector<ClientConn> conns(_conns);
+        for (int i = 0; i < _conns; i++)
+        {
+            if (!Connect(&conns[i]))
+            {
+                _errors++;
+                continue;
+            }
+            epoll_event ev;
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.u32 = i;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, conns[i].fd, &ev);
+            for (int p = 0; p < _args.pipeline; p++)
+                Enqueue(&conns[i]);
+        }
+
+        epoll_event evs[256];
+        while (!_stop->load(std::memory_order_relaxed))
+        {
+            int n = epoll_wait(epfd, evs, 256, 100);
+            for (int i = 0; i < n; i++)
+            {
+                ClientConn *c = &conns[evs[i].data.u32];
+                if (c->fd < 0)
+                    continue;
+                if (evs[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    Drop(c);
+                    continue;
+                }
+                if (evs[i].events & EPOLLIN)
+                    OnRead(c);
+                if (c->fd >= 0 && (evs[i].events & EPOLLOUT))
+                    Flush(c);
+                if (c->fd >= 0)
+                {
+                    epoll_event ev;
+                    ev.events = EPOLLIN | (c->out_off < c->out.size() ? (uint32_t)EPOLLOUT : 0);
+                    ev.data.u32 = evs[i].data.u32;
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+                }
+            }
+        }
+        for (auto &c : conns)
+            if (c.fd >= 0)
+                close(c.fd);
+        close(epfd);
+    }
+
+    Histogram &Hist()
+    {
+        return _hist;
+    }
+    uint64_t Requests()
+    {
+        return _requests;
+    }
+    uint64_t Errors()
+    {
+        return _errors;
+    }
+
+private:
+    bool Connect(ClientConn *c)
+    {
+        c->fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(_args.port);
+        addr.sin_addr.s_addr = inet_addr(_args.host.c_str());
+        if (connect(c->fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        {
+            close(c->fd);
+            c->fd = -1;
+            return false;
+        }
+        int one = 1;
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    void Enqueue(ClientConn *c)
+    {
+        if (c->out_off == c->out.size())
+        {
+            c->out.clear();
+            c->out_off = 0;
+        }
+        c->out += _request;
+        c->inflight.push_back(NowNs());
+    }
+
+    void Flush(ClientConn *c)
+    {
+        while (c->out_off < c->out.size())
+        {
+            ssize_t n = send(c->fd, c->out.data() + c->out_off, c->out.size() - c->out_off, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EINTR)
+                    Drop(c);
+                return;
+            }
+            c->out_off += n;
+        }
+    }
+
+    void OnRead(ClientConn *c)
+    {
+        char buf[65536];
+        while (true)
+        {
+            ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+                return Drop(c);
+            if (n < 0)
+                break;
+            c->in.append(buf, n);
+        }
+        size_t consumed = 0, len;
+        while ((len = ResponseLength(c->in, consumed)) > 0)
+        {
+            consumed += len;
+            if (c->inflight.empty())
+                break;
+            uint64_t latency = NowNs() - c->inflight.front();
+            c->inflight.pop_front();
+            if (_recording->load(std::memory_order_relaxed))
+            {
+                _hist.Record(latency);
+                _requests++;
+            }
+            Enqueue(c);
+        }
+        c->in.erase(0, consumed);
+        Flush(c);
+    }
+
+    // 返回从 off 开始的一个完整响应的长度，不完整返回 0
+    size_t ResponseLength(const std::string &in, size_t off)
+    {
+        size_t avail = in.size() - off;
+        if (_args.mode != "http")
+            return avail >= _request.size() ? _request.size() : 0;
+        size_t end = in.find("\r\n\r\n", off);
+        if (end == std::string::npos)
+            return 0;
+        size_t head = end + 4 - off;
+        size_t body = 0;
+        size_t cl = in.find("Content-Length:", off);
+        if (cl != std::string::npos && cl < end)
+            body = strtoul(in.c_str() + cl + 15, nullptr, 10);
+        return avail >= head + body ? head + body : 0;
+    }
+
+    void Drop(ClientConn *c)
+    {
+        _errors++;
+        close(c->fd);
+        c->fd = -1;
+    }
+
+private:
+    LoadArgs _args;
+    int _conns;
+    std::atomic<bool> *_recording;
+    std::atomic<bool> *_stop;
+    std::string _request;
+    Histogram _hist;
+    uint64_t _requests;
+    uint64_t _errors;
+};
+
+bool ParseArgs(int argc, char *argv[], LoadArgs *args)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string key = argv[i], val = argv[i + 1];
+        if (key == "--host")
+            args->host = val;
+        else if (key == "--port")
+            args->port = atoi(val.c_str());
+        else if (key == "--mode")
+            args->mode = val;
+        else if (key == "--path")
+            args->path = val;
+        else if (key == "--threads")
+            args->threads = atoi(val.c_str());
+        else if (key == "--conns")
+            args->conns = atoi(val.c_str());
+        else if (key == "--size")
+            args->size = strtoul(val.c_str(), nullptr, 10);
+        else if (key == "--pipeline")
+            args->pipeline = atoi(val.c_str());
+        else if (key == "--duration")
+            args->duration = atof(val.c_str());
+        else if (key == "--warmup")
+            args->warmup = atof(val.c_str());
+        else if (key == "--server-pid")
+            args->server_pid = atoi(val.c_str());
+        else if (key == "--label")
+            args->label = val;
+        else
+            return false;
+    }
+    return args->threads > 0 && args->conns >= args->threads && args->pipeline > 0;
+}
+
+int main(int argc, char *argv[])
+{
+    LoadArgs args;
+    if (!ParseArgs(argc, argv, &args))
+    {
+        fprintf(stderr, "usage: %s [--host IP] [--port N] [--mode echo|http] [--path /] [--threads N] [--conns N]\n"
+                        "          [--size N] [--pipeline N] [--duration S] [--warmup S] [--server-pid PID] [--label STR]\n",
+                argv[0]);
+        return 1;
+    }
+
+    std::atomic<bool> recording(false), stop(false);
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < args.threads; i++)
+    {
+        int n = args.conns / args.threads + (i < args.conns % args.threads ? 1 : 0);
+        workers.emplace_back(new Worker(args, n, &recording, &stop));
+    }
+    for (auto &w : workers)
+        threads.emplace_back(&Worker::Run, w.get());
+
+    // 预热阶段不计入统计
+    std::this_thread::sleep_for(std::chrono::duration<double>(args.warmup));
+    uint64_t cli_cpu0 = CpuMicros(0), svr_cpu0 = args.server_pid ? CpuMicros(args.server_pid) : 0;
+    uint64_t t0 = NowNs();
+    recording = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(args.duration));
+    recording = false;
+    uint64_t t1 = NowNs();
+    uint64_t cli_cpu1 = CpuMicros(0), svr_cpu1 = args.server_pid ? CpuMicros(args.server_pid) : 0;
+    stop = true;
+    for (auto &t : threads)
+        t.join();
+
+    Histogram hist;
+    uint64_t requests = 0, errors = 0;
+    for (auto &w : workers)
+    {
+        hist.Merge(w->Hist());
+        requests += w->Requests();
+        errors += w->Errors();
+    }
+    double secs = (t1 - t0) / 1e9;
+    double per_req = requests ? 1.0 / requests : 0;
+    printf("{\"label\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"conns\":%d,\"size\":%zu,\"pipeline\":%d,"
+           "\"duration_s\":%.2f,\"requests\":%lu,\"errors\":%lu,\"rps\":%.0f,"
+           "\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,"
+           "\"client_cpu_us_per_req\":%.2f,\"server_cpu_us_per_req\":%.2f}\n",
+           args.label.c_str(), args.mode.c_str(), args.threads, args.conns, args.size, args.pipeline,
+           secs, (unsigned long)requests, (unsigned long)errors, requests / secs,
+           hist.Mean() / 1e3, hist.Percentile(0.5) / 1e3, hist.Percentile(0.99) / 1e3,
+           hist.Percentile(0.999) / 1e3, hist.Max() / 1e3,
+           (cli_cpu1 - cli_cpu0) * per_req, args.server_pid ? (svr_cpu1 - svr_cpu0) * per_req : 0.0);
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "../../source/http/http.hpp"
+
+// 反向代理基准：同一进程内的后端 HttpServer、两个代理(splice 与用户态拷贝)和阻塞客户端
+//   下载：GET 固定大小的响应体；上传：POST 固定大小的请求体，后端流式丢弃后回 "ok"
+//   每个大小、每个方向在同一个长连接上连续请求 seconds 秒
+//   ./proxybench [秒数，默认 2]
+// 客户端、代理与后端共用 CPU，数值用于对比两种转发方式，不代表单独代理的上限
+
+#define BACKEND_BENCH_PORT 18146
+#define SPLICE_BENCH_PORT 18147
+#define COPY_BENCH_PORT 18148
+
+static const size_t kSizes[] = {4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024};
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static int ConnectServer(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (int i = 0; connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0; i++)
+    {
+        if (i > 100)
+            abort();
+        close(fd);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        usleep(20 * 1000);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void SendAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, 0);
+        if (n <= 0)
+            abort();
+        data += n;
+        len -= n;
+    }
+}
+
+// 读一个响应：Content-Length 正文读满，chunked 正文读到结束块；返回正文字节数(含分块行)
+static uint64_t ReadResponse(int fd, std::string *pending)
+{
+    static char buf[256 * 1024];
+    size_t head_end;
+    while ((head_end = pending->find("\r\n\r\n")) == std::string::npos)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            abort();
+        pending->append(buf, n);
+    }
+    std::string head = pending->substr(0, head_end);
+    pending->erase(0, head_end + 4);
+    if (head.compare(0, 12, "HTTP/1.1 200") != 0)
+        abort();
+    size_t pos = head.find("Content-Length: ");
+    if (pos == std::string::npos)
+    {
+        while (pending->find("0\r\n\r\n") == std::string::npos)
+        {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                abort();
+            pending->append(buf, n);
+        }
+        size_t len = pending->find("0\r\n\r\n") + 5;
+        pending->erase(0, len);
+        return len;
+    }
+    uint64_t left = strtoull(head.c_str() + pos + 16, nullptr, 10);
+    uint64_t total = left;
+    size_t take = std::min<uint64_t>(left, pending->size());
+    pending->erase(0, take);
+    left -= take;
+    while (left > 0)
+    {
+        ssize_t n = recv(fd, buf, std::min<uint64_t>(left, sizeof(buf)), 0);
+        if (n <= 0)
+            abort();
+        left -= n;
+    }
+    return total;
+}
+
+static void Run(const char *mode, uint16_t port, const std::shared_ptr<ReverseProxy> &proxy, bool upload, size_t size,
+                double seconds)
+{
+    static std::string body(kSizes[3], 'u');
+    std::string req = upload ? "POST /sink HTTP/1.1\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n"
+                             : "GET /data/" + std::to_string(size) + " HTTP/1.1\r\n\r\n";
+    int fd = ConnectServer(port);
+    std::string pending;
+    uint64_t spliced = proxy->SplicedBytes(), copied = proxy->CopiedBytes();
+    uint64_t count = 0, bytes = 0;
+    uint64_t t0 = NowNs(), end = t0 + (uint64_t)(seconds * 1e9), now = t0;
+    while (now < end)
+    {
+        SendAll(fd, req.data(), req.size());
+        if (upload)
+            SendAll(fd, body.data(), size);
+        uint64_t got = ReadResponse(fd, &pending);
+        bytes += upload ? size : got;
+        count++;
+        now = NowNs();
+    }
+    close(fd);
+    double secs = (now - t0) / 1e9;
+    printf("{\"case\":\"%s_%s\",\"size\":%lu,\"requests\":%lu,\"req_per_s\":%.0f,\"mb_per_s\":%.1f,"
+           "\"spliced_mb\":%.1f,\"copied_mb\":%.1f}\n",
+           upload ? "upload" : "download", mode, (unsigned long)size, (unsigned long)count, count / secs,
+           bytes / secs / (1024 * 1024), (proxy->SplicedBytes() - spliced) / (1024.0 * 1024),
+           (proxy->CopiedBytes() - copied) / (1024.0 * 1024));
+    fflush(stdout);
+}
+
+static void Backend()
+{
+    static std::map<size_t, std::string> bodies;
+    for (size_t size : kSizes)
+        bodies[size] = std::string(size, 'd');
+    HttpServer server(BACKEND_BENCH_PORT, "127.0.0.1");
+    server.SetThreadCount(1);
+    server.Get("/data/(\\d+)", [](const HttpRequest &req, HttpResponse *rsp) {
+        rsp->SetContent(bodies.at(std::stoul(req._matches[1].str())), "application/octet-stream");
+    });
+    server.Stream("POST", "/sink", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+        HttpStream *s = stream.get();
+        stream->OnData([](const char *data, size_t len) {});
+        stream->OnEnd([s]() {
+            s->Write("ok");
+            s->End();
+        });
+    });
+    server.Listen();
+}
+
+static void Proxy(uint16_t port, std::shared_ptr<ReverseProxy> proxy)
+{
+    HttpServer server(port, "127.0.0.1");
+    server.SetThreadCount(1);
+    server.Proxy("/.*", proxy);
+    server.Listen();
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+    signal(SIGPIPE, SIG_IGN);
+    ProxyOptions copy_opts;
+    copy_opts.splice = false;
+    std::shared_ptr<ReverseProxy> splice_proxy = std::make_shared<ReverseProxy>();
+    std::shared_ptr<ReverseProxy> copy_proxy = std::make_shared<ReverseProxy>(copy_opts);
+    splice_proxy->AddUpstream("127.0.0.1", BACKEND_BENCH_PORT);
+    copy_proxy->AddUpstream("127.0.0.1", BACKEND_BENCH_PORT);
+    std::thread(Backend).detach();
+    std::thread(Proxy, SPLICE_BENCH_PORT, splice_proxy).detach();
+    std::thread(Proxy, COPY_BENCH_PORT, copy_proxy).detach();
+    usleep(100 * 1000);
+    for (int upload = 0; upload < 2; upload++)
+    {
+        for (size_t size : kSizes)
+        {
+            Run("copy", COPY_BENCH_PORT, copy_proxy, upload, size, seconds);
+            Run("splice", SPLICE_BENCH_PORT, splice_proxy, upload, size, seconds);
+        }
+    }
+    return 0;
+}
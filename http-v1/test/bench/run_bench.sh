@@ -0,0 +1,42 @@
+#!/bin/bash
+# 反应堆基准测试矩阵：回显 / HTTP 两种场景 × 连接数 × 负载大小 × 流水线深度
+# 每个组合输出一行 JSON 到结果文件，便于不同提交之间对比
+#   ./run_bench.sh [结果文件] [服务端线程数] [压测线程数]
+# 可通过环境变量覆盖矩阵：CONNS="1 64" SIZES="64" PIPELINES="1" DURATION=5 PROFILE=rpc
+# BUSY_POLL="0 50" 分别以关闭/开启忙轮询(上限 50us)运行，对比 p99；CPUS="2,3" 绑定从属线程
+
+OUT=${1:-bench_$(date +%Y%m%d_%H%M%S).jsonl}
+SVR_THREADS=${2:-2}
+CLI_THREADS=${3:-2}
+CONNS=${CONNS:-"1 16 128 1024"}
+SIZES=${SIZES:-"64 1024 16384"}
+PIPELINES=${PIPELINES:-"1 8"}
+DURATION=${DURATION:-5}
+WARMUP=${WARMUP:-1}
+PROFILE=${PROFILE:-default}
+PORT=${PORT:-8500}
+BUSY_POLL=${BUSY_POLL:-0}
+CPUS=${CPUS:-}
+
+cd "$(dirname "$0")" && make -s || exit 1
+
+for BP in $BUSY_POLL; do
+for MODE in echo http; do
+    ./bench_server --port $PORT --threads $SVR_THREADS --mode $MODE --profile $PROFILE --busy-poll $BP \
+        ${CPUS:+--cpus $CPUS} > /dev/null 2>&1 &
+    SVR=$!
+    sleep 0.5
+    for C in $CONNS; do
+        [ $C -lt $CLI_THREADS ] && T=$C || T=$CLI_THREADS
+        for S in $SIZES; do
+            for P in $PIPELINES; do
+                ./loadgen --port $PORT --mode $MODE --threads $T --conns $C --size $S --pipeline $P \
+                    --duration $DURATION --warmup $WARMUP --server-pid $SVR --label "$PROFILE busy_poll=$BP" | tee -a "$OUT"
+            done
+        done
+    done
+    kill $SVR
+    wait $SVR 2> /dev/null
+done
+done
+echo "results: $OUT"
@@ -0,0 +1,186 @@
+#include "../../source/http/http.hpp"
+
+// 流式请求体/响应基准：同一进程内的 HttpServer 与阻塞客户端，上传/下载 size MB，
+// 输出吞吐量与该阶段的进程内存峰值(VmHWM，阶段开始前经 /proc/self/clear_refs 重置)，
+// 以及服务端连接的输入缓冲区容量与输出积压峰值
+//   ./streambench [size MB，默认 2048] [--buffered]
+// --buffered 额外以普通路由(整块接收请求体)上传同样大小作对比，内存随请求体增长
+
+#define STREAM_BENCH_PORT 18142
+
+static size_t g_max_in_cap = 0;  // 服务端输入缓冲区容量峰值
+static size_t g_max_pending = 0; // 服务端输出积压峰值
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 读取 /proc/self/status 中的字段(kB)
+static long StatusKb(const char *field)
+{
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.compare(0, strlen(field), field) == 0)
+            return atol(line.c_str() + strlen(field) + 1);
+    }
+    return -1;
+}
+
+static void ResetPeak()
+{
+    std::ofstream out("/proc/self/clear_refs");
+    out << "5"; // 重置 VmHWM
+}
+
+static int ConnectServer()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(STREAM_BENCH_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (int i = 0; connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0; i++)
+    {
+        if (i > 100)
+            abort();
+        close(fd);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        usleep(20 * 1000);
+    }
+    return fd;
+}
+
+static void SendAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, data, len, 0);
+        if (n <= 0)
+            abort();
+        data += n;
+        len -= n;
+    }
+}
+
+// 读到 EOF，返回收到的字节数
+static uint64_t Drain(int fd)
+{
+    static char buf[256 * 1024];
+    uint64_t total = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+        total += n;
+    close(fd);
+    return total;
+}
+
+static void Report(const std::string &name, uint64_t bytes, uint64_t ns, long rss_before)
+{
+    printf("{\"case\":\"%s\",\"mb\":%lu,\"mb_per_s\":%.1f,\"peak_rss_mb\":%.1f,\"rss_before_mb\":%.1f,"
+           "\"server_in_buffer_kb\":%lu,\"server_max_pending_kb\":%lu}\n",
+           name.c_str(), (unsigned long)(bytes >> 20), bytes / (ns / 1e9) / (1024 * 1024), StatusKb("VmHWM") / 1024.0,
+           rss_before / 1024.0, (unsigned long)(g_max_in_cap >> 10), (unsigned long)(g_max_pending >> 10));
+    fflush(stdout);
+}
+
+static void Upload(const std::string &name, const std::string &path, uint64_t size)
+{
+    static char chunk[64 * 1024];
+    memset(chunk, 'u', sizeof(chunk));
+    g_max_in_cap = g_max_pending = 0;
+    ResetPeak();
+    long before = StatusKb("VmRSS");
+    uint64_t t0 = NowNs();
+    int fd = ConnectServer();
+    std::string head = "POST " + path + " HTTP/1.1\r\nConnection: close\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+    SendAll(fd, head.data(), head.size());
+    for (uint64_t left = size; left > 0;)
+    {
+        size_t n = std::min<uint64_t>(left, sizeof(chunk));
+        SendAll(fd, chunk, n);
+        left -= n;
+    }
+    Drain(fd);
+    Report(name, size, NowNs() - t0, before);
+}
+
+static void Download(uint64_t size)
+{
+    g_max_in_cap = g_max_pending = 0;
+    ResetPeak();
+    long before = StatusKb("VmRSS");
+    uint64_t t0 = NowNs();
+    int fd = ConnectServer();
+    std::string req = "GET /download?size=" + std::to_string(size) + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+    SendAll(fd, req.data(), req.size());
+    uint64_t got = Drain(fd);
+    if (got < size)
+        abort();
+    Report("stream_download", size, NowNs() - t0, before);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t mb = 2048;
+    bool buffered = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--buffered") == 0)
+            buffered = true;
+        else
+            mb = strtoull(argv[i], nullptr, 10);
+    }
+    uint64_t size = mb << 20;
+
+    std::thread([]() {
+        HttpServer server(STREAM_BENCH_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.Stream("POST", "/upload", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+            HttpStream *s = stream.get();
+            std::shared_ptr<uint64_t> total = std::make_shared<uint64_t>(0);
+            stream->OnData([s, total](const char *data, size_t len) {
+                *total += len;
+                g_max_in_cap = std::max<size_t>(g_max_in_cap, s->GetConnection()->InBuffer()->Capacity());
+            });
+            stream->OnEnd([s, total]() {
+                s->Write(std::to_string(*total));
+                s->End();
+            });
+        });
+        server.Post("/upload_buffered", [](const HttpRequest &req, HttpResponse *rsp) {
+            rsp->SetContent(std::to_string(req._body.size()), "text/plain");
+        });
+        server.Stream("GET", "/download", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+            HttpStream *s = stream.get();
+            std::shared_ptr<uint64_t> left = std::make_shared<uint64_t>(std::stoull(req.GetParam("size")));
+            auto pump = [s, left]() {
+                static std::string chunk(64 * 1024, 'd');
+                while (*left > 0)
+                {
+                    size_t n = std::min<uint64_t>(*left, chunk.size());
+                    *left -= n;
+                    bool more = s->Write(chunk.data(), n);
+                    g_max_pending = std::max<size_t>(g_max_pending, s->GetConnection()->PendingOutput());
+                    if (!more)
+                        return;
+                }
+                s->End();
+            };
+            stream->OnWritable(pump);
+            stream->OnEnd(pump);
+        });
+        server.Listen();
+    }).detach();
+
+    Upload("stream_upload", "/upload", size);
+    Download(size);
+    if (buffered)
+        Upload("buffered_upload", "/upload_buffered", size);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "../../source/http/http.hpp"
+#include "../../source/tls/tls.hpp"
+
+// TLS 基准：同一进程内的 HttpServer(自签名证书)与阻塞客户端
+//   1. 完整握手/恢复握手(TLS1.3 ticket)每秒次数，每次握手后发一个小请求
+//   2. 流式下载 size MB 的吞吐量：明文、TLS(用户态加密或内核 TLS)
+//   ./tlsbench [秒数，默认 3] [size MB，默认 512] [--no-ktls]
+// 客户端与服务端共用 CPU，数值用于对比不同配置，不代表单独服务端的上限
+
+#define TLS_BENCH_PORT 18144
+#define PLAIN_BENCH_PORT 18145
+#define TLS_BENCH_CERT "/tmp/tlsbench.crt"
+#define TLS_BENCH_KEY "/tmp/tlsbench.key"
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static int ConnectServer(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (int i = 0; connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0; i++)
+    {
+        if (i > 100)
+            abort();
+        close(fd);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        usleep(20 * 1000);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// 建立连接、握手、请求 path 并读到连接关闭，返回收到的明文字节数；session 非空时尝试恢复，结束后换成新会话
+static uint64_t TlsRequest(SSL_CTX *ctx, const std::string &path, SSL_SESSION **session, bool *reused)
+{
+    static char buf[256 * 1024];
+    int fd = ConnectServer(TLS_BENCH_PORT);
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (session && *session)
+        SSL_set_session(ssl, *session);
+    if (SSL_connect(ssl) != 1)
+        abort();
+    if (reused)
+        *reused = SSL_session_reused(ssl);
+    std::string req = "GET " + path + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+    SSL_write(ssl, req.data(), req.size());
+    uint64_t total = 0;
+    int n;
+    while ((n = SSL_read(ssl, buf, sizeof(buf))) > 0)
+        total += n;
+    SSL_shutdown(ssl);
+    if (session)
+    {
+        if (*session)
+            SSL_SESSION_free(*session);
+        *session = SSL_get1_session(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+    return total;
+}
+
+static uint64_t PlainRequest(const std::string &path)
+{
+    static char buf[256 * 1024];
+    int fd = ConnectServer(PLAIN_BENCH_PORT);
+    std::string req = "GET " + path + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+    if (send(fd, req.data(), req.size(), 0) != (ssize_t)req.size())
+        abort();
+    uint64_t total = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0)
+        total += n;
+    close(fd);
+    return total;
+}
+
+static void Handshakes(SSL_CTX *ctx, double seconds, bool resume)
+{
+    SSL_SESSION *session = nullptr;
+    uint64_t count = 0, reused_count = 0;
+    uint64_t t0 = NowNs(), end = t0 + (uint64_t)(seconds * 1e9);
+    uint64_t now = t0;
+    while (now < end)
+    {
+        bool reused = false;
+        TlsRequest(ctx, "/hello", resume ? &session : nullptr, &reused);
+        count++;
+        reused_count += reused;
+        now = NowNs();
+    }
+    if (session)
+        SSL_SESSION_free(session);
+    printf("{\"case\":\"%s\",\"handshakes\":%lu,\"reused\":%lu,\"per_s\":%.0f}\n", resume ? "resumed_handshake" : "full_handshake",
+           (unsigned long)count, (unsigned long)reused_count, count / ((now - t0) / 1e9));
+    fflush(stdout);
+}
+
+static void Bulk(SSL_CTX *ctx, uint64_t size, bool secure, uint64_t ktls_before, TlsContext *tls)
+{
+    std::string path = "/bulk?size=" + std::to_string(size);
+    uint64_t t0 = NowNs();
+    uint64_t got = secure ? TlsRequest(ctx, path, nullptr, nullptr) : PlainRequest(path);
+    uint64_t ns = NowNs() - t0;
+    if (got < size)
+        abort();
+    const char *mode = !secure ? "plain" : (tls->KtlsConnections() > ktls_before ? "ktls" : "tls_userspace");
+    printf("{\"case\":\"bulk_%s\",\"mb\":%lu,\"mb_per_s\":%.1f}\n", mode, (unsigned long)(size >> 20),
+           size / (ns / 1e9) / (1024 * 1024));
+    fflush(stdout);
+}
+
+static void Serve(uint16_t port, TlsContext *tls)
+{
+    HttpServer server(port, "127.0.0.1");
+    server.SetThreadCount(1);
+    if (tls)
+        server.GetTcpServer().SetTransportFilterFactory(tls->Factory());
+    server.Get("/hello", [](const HttpRequest &req, HttpResponse *rsp) {
+        rsp->SetContent("hello", "text/plain");
+    });
+    server.Stream("GET", "/bulk", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+        HttpStream *s = stream.get();
+        std::shared_ptr<uint64_t> left = std::make_shared<uint64_t>(std::stoull(req.GetParam("size")));
+        auto pump = [s, left]() {
+            static std::string chunk(64 * 1024, 'b');
+            while (*left > 0)
+            {
+                size_t n = std::min<uint64_t>(*left, chunk.size());
+                *left -= n;
+                if (!s->Write(chunk.data(), n))
+                    return;
+            }
+            s->End();
+        };
+        stream->OnWritable(pump);
+        stream->OnEnd(pump);
+    });
+    server.Listen();
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = 3;
+    uint64_t mb = 512;
+    bool ktls = true;
+    int pos = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--no-ktls") == 0)
+            ktls = false;
+        else if (pos++ == 0)
+            seconds = atof(argv[i]);
+        else
+            mb = strtoull(argv[i], nullptr, 10);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    if (!TlsContext::WriteSelfSigned(TLS_BENCH_CERT, TLS_BENCH_KEY))
+        abort();
+    TlsOptions opts;
+    opts.cert_file = TLS_BENCH_CERT;
+    opts.key_file = TLS_BENCH_KEY;
+    opts.ktls = ktls;
+    TlsContext tls(opts);
+    if (!tls.Ok())
+        abort();
+    std::thread(Serve, TLS_BENCH_PORT, &tls).detach();
+    std::thread(Serve, PLAIN_BENCH_PORT, nullptr).detach();
+
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT);
+    Handshakes(ctx, seconds, false);
+    Handshakes(ctx, seconds, true);
+    Bulk(ctx, mb << 20, false, 0, &tls);
+    Bulk(ctx, mb << 20, true, tls.KtlsConnections(), &tls);
+    SSL_CTX_free(ctx);
+    unlink(TLS_BENCH_CERT);
+    unlink(TLS_BENCH_KEY);
+    return 0;
+}
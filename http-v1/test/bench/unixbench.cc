@@ -0,0 +1,103 @@
+#include "../../source/server.hpp"
+#include "histogram.hpp"
+
+// 本机通信延迟基准：同一进程内的 TcpServer 回显与阻塞客户端，逐个请求-响应往返
+//   传输：回环 TCP(IPv4，LowLatencyRpc 配置)、Unix 文件路径、Unix 抽象命名空间
+//   消息：64 B 与 4 KB，每种组合运行 seconds 秒，输出往返延迟分位数(纳秒)与每秒往返次数
+//   ./unixbench [秒数，默认 2]
+// 客户端与服务端共用 CPU，数值用于对比不同传输方式，不代表单独服务端的上限
+
+#define TCP_BENCH_PORT 18149
+#define UNIX_BENCH_PATH "/tmp/unixbench.sock"
+#define UNIX_BENCH_NAME "@unixbench"
+
+static const size_t kSizes[] = {64, 4096};
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void Serve(const SockAddr &addr)
+{
+    TcpServer server(addr, SocketOptions::LowLatencyRpc());
+    server.SetThreadCount(1);
+    server.SetMessageCallBack([](Connection *conn, Buffer *buf) {
+        conn->Send(buf->ReadPos(), buf->ReadAbleSize());
+        buf->MoveReadOffset(buf->ReadAbleSize());
+    });
+    server.Start();
+}
+
+static int ConnectServer(const SockAddr &addr)
+{
+    int fd = socket(addr.Family(), SOCK_STREAM, 0);
+    for (int i = 0; connect(fd, addr.Addr(), addr.Len()) < 0; i++)
+    {
+        if (i > 100)
+            abort();
+        close(fd);
+        fd = socket(addr.Family(), SOCK_STREAM, 0);
+        usleep(20 * 1000);
+    }
+    if (addr.Family() != AF_UNIX)
+    {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static void Run(const char *name, const SockAddr &addr, size_t size, double seconds)
+{
+    static char out[4096], in[4096];
+    memset(out, 'p', sizeof(out));
+    int fd = ConnectServer(addr);
+    Histogram hist;
+    uint64_t t0 = NowNs(), end = t0 + (uint64_t)(seconds * 1e9), now = t0;
+    while (now < end)
+    {
+        uint64_t start = now;
+        if (send(fd, out, size, 0) != (ssize_t)size)
+            abort();
+        size_t got = 0;
+        while (got < size)
+        {
+            ssize_t n = recv(fd, in + got, size - got, 0);
+            if (n <= 0)
+                abort();
+            got += n;
+        }
+        now = NowNs();
+        hist.Record(now - start);
+    }
+    close(fd);
+    printf("{\"case\":\"%s\",\"size\":%lu,\"round_trips\":%lu,\"per_s\":%.0f,\"p50_ns\":%lu,\"p99_ns\":%lu,"
+           "\"p999_ns\":%lu,\"mean_ns\":%.0f}\n",
+           name, (unsigned long)size, (unsigned long)hist.Count(), hist.Count() / ((now - t0) / 1e9),
+           (unsigned long)hist.Percentile(0.5), (unsigned long)hist.Percentile(0.99),
+           (unsigned long)hist.Percentile(0.999), hist.Mean());
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+    signal(SIGPIPE, SIG_IGN);
+    SockAddr tcp("127.0.0.1", TCP_BENCH_PORT);
+    SockAddr path = SockAddr::Unix(UNIX_BENCH_PATH);
+    SockAddr abstract = SockAddr::Unix(UNIX_BENCH_NAME);
+    std::thread(Serve, tcp).detach();
+    std::thread(Serve, path).detach();
+    std::thread(Serve, abstract).detach();
+    for (size_t size : kSizes)
+    {
+        Run("tcp_loopback", tcp, size, seconds);
+        Run("unix_path", path, size, seconds);
+        Run("unix_abstract", abstract, size, seconds);
+    }
+    unlink(UNIX_BENCH_PATH);
+    return 0;
+}
@@ -0,0 +1,225 @@
+#include <iostream>
+#include <string>
+#include <random>
+#include <new>
+#include "../../source/server.hpp"
+
+// Buffer 微基准：ns/op、吞吐量以及每次操作的内存分配次数
+// 通过替换全局 operator new/delete 统计分配(vector<char> 的扩容都经过这里)
+// 每个用例输出一行 JSON，便于对比不同版本的 Buffer 实现
+//   ./bufferbench [用例名过滤]
+
+static std::atomic<uint64_t> g_allocs(0);
+static std::atomic<uint64_t> g_alloc_bytes(0);
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// 阻止编译器把被测代码优化掉
+template <class T>
+inline void DoNotOptimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static std::string g_filter;
+
+// 运行一个用例：fn 执行 iters 次操作，返回处理的总字节数
+template <class Fn>
+void Bench(const std::string &name, uint64_t iters, Fn fn)
+{
+    if (!g_filter.empty() && name.find(g_filter) == std::string::npos)
+        return;
+    fn(iters / 10 + 1); // 预热
+
+    uint64_t a0 = g_allocs.load(), b0 = g_alloc_bytes.load();
+    uint64_t t0 = NowNs();
+    uint64_t bytes = fn(iters);
+    uint64_t t1 = NowNs();
+    uint64_t a1 = g_allocs.load(), b1 = g_alloc_bytes.load();
+
+    double ns = (double)(t1 - t0) / iters;
+    double mbps = bytes / ((t1 - t0) / 1e9) / (1024 * 1024);
+    printf("{\"case\":\"%s\",\"iters\":%lu,\"ns_per_op\":%.1f,\"mb_per_s\":%.1f,"
+           "\"allocs_per_op\":%.4f,\"alloc_bytes_per_op\":%.1f}\n",
+           name.c_str(), (unsigned long)iters, ns, mbps,
+           (double)(a1 - a0) / iters, (double)(b1 - b0) / iters);
+}
+
+// ----------------------------------------------------------------
+// 消息分布：大量小请求头 + 偶尔出现的大请求体
+// ----------------------------------------------------------------
+struct Message
+{
+    std::vector<std::string> headers; // 每行以 \r\n 结尾
+    std::string body;
+};
+
+std::vector<Message> MakeMix(size_t count, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> nheaders(4, 20);
+    std::uniform_int_distribution<int> hlen(16, 120);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> small_body(0, 512);
+    std::uniform_int_distribution<int> large_body(16 * 1024, 1024 * 1024);
+
+    std::vector<Message> msgs(count);
+    for (auto &m : msgs)
+    {
+        int n = nheaders(rng);
+        for (int i = 0; i < n; i++)
+            m.headers.push_back("X-Header: " + std::string(hlen(rng), 'h') + "\r\n");
+        m.headers.push_back("\r\n");
+        int body = percent(rng) == 0 ? large_body(rng) : small_body(rng); // 1% 为大请求体
+        m.body.assign(body, 'b');
+    }
+    return msgs;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        g_filter = argv[1];
+
+    /* 1. 固定大小的 Write + Read */
+    size_t sizes[] = {16, 64, 512, 4096, 65536};
+    for (size_t n : sizes)
+    {
+        std::string src(n, 'w'), dst(n, 0);
+        Buffer buf;
+        Bench("write_read_" + std::to_string(n), n >= 4096 ? 200000 : 2000000, [&](uint64_t iters) {
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                buf.Write(src.data(), n);
+                buf.Read(&dst[0], n);
+            }
+            DoNotOptimize(dst);
+            return iters * n;
+        });
+    }
+
+    /* 2. EnsureWriteSpace：头部空间复用(memmove 前移) */
+    {
+        std::string chunk(600, 'c');
+        char out[600];
+        Buffer buf;
+        buf.Write(chunk.data(), 100); // 每次写入前都留有 100 字节未读数据，前移时实际搬动它们
+        Bench("ensure_space_compact", 2000000, [&](uint64_t iters) {
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                buf.Write(chunk.data(), 600); // 每两次写入有一次尾部不足，前移未读的 100 字节
+                buf.Read(out, 600);
+            }
+            DoNotOptimize(out);
+            return iters * 600;
+        });
+    }
+
+    /* 3. EnsureWriteSpace：从默认大小扩容到 N */
+    size_t grows[] = {16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    for (size_t n : grows)
+    {
+        std::string chunk(256, 'g');
+        Bench("ensure_space_grow_" + std::to_string(n), n >= 1024 * 1024 ? 200 : 20000, [&](uint64_t iters) {
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                Buffer buf;
+                for (size_t w = 0; w < n; w += chunk.size())
+                    buf.Write(chunk.data(), chunk.size());
+                DoNotOptimize(buf.ReadPos());
+            }
+            return iters * n;
+        });
+    }
+
+    /* 4. GetLine：逐行解析请求头 */
+    {
+        std::vector<Message> msgs = MakeMix(256, 1);
+        std::string headers;
+        size_t lines = 0;
+        for (auto &m : msgs)
+            for (auto &h : m.headers)
+            {
+                headers += h;
+                lines++;
+            }
+        Buffer buf;
+        Bench("getline_headers", lines * 2000, [&](uint64_t iters) {
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                if (buf.ReadAbleSize() == 0)
+                    buf.WriteString(headers);
+                total += buf.GetLine().size(); // 每次操作取出一行
+            }
+            return total;
+        });
+    }
+
+    /* 5. WriteBufferAndConsume */
+    for (size_t n : sizes)
+    {
+        std::string src(n, 's');
+        char out[65536];
+        Buffer from, to;
+        Bench("write_buffer_consume_" + std::to_string(n), n >= 4096 ? 200000 : 2000000, [&](uint64_t iters) {
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                from.Write(src.data(), n);
+                to.WriteBufferAndConsume(from);
+                to.Read(out, n);
+            }
+            DoNotOptimize(out);
+            return iters * n;
+        });
+    }
+
+    /* 6. 真实分布：写入完整请求，GetLine 解析头部，Read 取出请求体 */
+    {
+        std::vector<Message> msgs = MakeMix(4096, 2);
+        std::string body;
+        Buffer buf;
+        Bench("mixed_request_stream", 4096 * 20, [&](uint64_t iters) {
+            uint64_t total = 0;
+            for (uint64_t i = 0; i < iters; i++)
+            {
+                const Message &m = msgs[i % msgs.size()];
+                for (auto &h : m.headers)
+                    buf.WriteString(h);
+                buf.WriteString(m.body);
+                for (size_t l = 0; l < m.headers.size(); l++)
+                    total += buf.GetLine().size();
+                body.resize(m.body.size());
+                if (!body.empty())
+                    buf.Read(&body[0], body.size());
+                total += body.size();
+            }
+            return total;
+        });
+    }
+    return 0;
+}
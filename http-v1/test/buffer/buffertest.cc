@@ -142,6 +142,89 @@ int main()
         std::cout << "[OK] Clear\n";
     }
 
+    /* =========================
+     * 9. 网络字节序整数读写
+     * ========================= */
+    {
+        Buffer b;
+        b.WriteInt8(0xAB);
+        b.WriteInt16(0x1234);
+        b.WriteInt32(0xDEADBEEF);
+        b.WriteInt64(0x0102030405060708ULL);
+
+        assert(b.ReadAbleSize() == 15);
+        assert((unsigned char)b.ReadPos()[1] == 0x12); // 大端
+        assert(b.PeekInt8() == 0xAB);
+        assert(b.ReadInt8() == 0xAB);
+        assert(b.PeekInt16() == 0x1234 && b.ReadAbleSize() == 14);
+        assert(b.ReadInt16() == 0x1234);
+        assert(b.ReadInt32() == 0xDEADBEEF);
+        assert(b.ReadInt64() == 0x0102030405060708ULL);
+        assert(b.ReadAbleSize() == 0);
+
+        std::cout << "[OK] Int Read/Write\n";
+    }
+
+    /* =========================
+     * 10. Prepend 行为测试
+     * ========================= */
+    {
+        // 头部有已读空间：原地写入
+        Buffer b;
+        b.WriteString("xxxxbody");
+        b.MoveReadOffset(4);
+        b.PrependInt32(4);
+        assert(b.ReadAbleSize() == 8);
+        assert(b.ReadInt32() == 4);
+        assert(b.ReadAsString(4) == "body");
+
+        // 头部空间不足(超过预留空间)：后移可读数据
+        Buffer c;
+        std::string big(DEFAULT_BUFFER_SIZE, 'z');
+        std::string head(DEFAULT_BUFFER_PREPEND + 8, 'h');
+        c.WriteString(big);
+        c.PrependInt16(7);
+        c.Prepend(head.data(), head.size());
+        assert(c.ReadAbleSize() == big.size() + head.size() + 2);
+        assert(c.ReadAsString(head.size()) == head);
+        assert(c.ReadInt16() == 7);
+        assert(c.ReadAsString(c.ReadAbleSize()) == big);
+
+        std::cout << "[OK] Prepend\n";
+    }
+
+    /* =========================
+     * 11. 头部预留空间
+     * ========================= */
+    {
+        // 预留空间内前插不移动消息体
+        Buffer b;
+        assert(b.PrependSize() == DEFAULT_BUFFER_PREPEND && b.HeadIdleSize() == DEFAULT_BUFFER_PREPEND);
+        b.WriteString("body");
+        char *body = b.ReadPos();
+        b.PrependInt64(4);
+        assert(b.ReadPos() + 8 == body);
+        assert(b.ReadInt64() == 4 && b.ReadAsString(4) == "body");
+
+        // 整理(前移可读数据)与清空后仍保留预留空间
+        Buffer c(32);
+        std::string data(DEFAULT_BUFFER_SIZE - 100, 'd');
+        c.WriteString(data);
+        c.MoveReadOffset(500);
+        c.WriteString(std::string(300, 'e'));
+        assert(c.Capacity() == 32 + DEFAULT_BUFFER_SIZE); // 复用头部空间，没有扩容
+        assert(c.HeadIdleSize() == 32);
+        char *pos = c.ReadPos();
+        c.Prepend(std::string(32, 'p').data(), 32);
+        assert(c.ReadPos() + 32 == pos);
+        c.Clear();
+        assert(c.HeadIdleSize() == 32 && c.ReadAbleSize() == 0);
+        c.Shrink(0);
+        assert(c.HeadIdleSize() == 32 && c.Capacity() == 32 + DEFAULT_BUFFER_SIZE);
+
+        std::cout << "[OK] Prepend Reserve\n";
+    }
+
     std::cout << "==== Buffer Test All Passed ====\n";
     return 0;
 }
\ No newline at end of file
@@ -1,62 +1,38 @@
 #include "../../source/server.hpp"
 
-// 设置回调函数
-void HandleClose(Channel* channel)
+// 通信套接字交给连接对象池管理，不再每次 accept 都 new Channel
+void HandleMessage(Connection* conn, Buffer* buf)
 {
-    std::cout << "Close: " << channel->GetFd() << std::endl;
-    channel->Remove();// 移除监控
-    close(channel->GetFd());
-}
-
-void HandleRead(Channel* channel)
-{
-    int fd = channel->GetFd();
-    char buf[1024] = {0};
-    int ret = recv(fd, buf, sizeof(buf), 0);
-    if(ret <= 0)
-        return HandleClose(channel);
-    
-    // 服务器要开始向客户端返回信息，所以要开启对可写事件的监控
-    channel->EnableWrite(); 
-    std::cout << recv << std::endl;
-}
-
-void HandleWrite(Channel* channel)
-{
-    char buf[1024] = "To ByteDance !!!";
-    int ret = send(channel->GetFd(), buf, sizeof(buf), 0);
-    if(ret <= 0)
-        return HandleClose(channel);
-    
-    // 无数据可写，关闭对写事件的监控
-    channel->DisableWrite();
-}
+    std::string msg = buf->ReadAsString(buf->ReadAbleSize());
+    std::cout << "Get a msg: " << msg << std::endl;
 
-void HandleError(Channel* channel)
-{
-    return HandleClose(channel);
+    // 服务器要开始向客户端返回信息，写入发送缓冲区后会自动开启可写事件监控
+    char send[1024] = "To ByteDance !!!";
+    conn->Send(send, sizeof(send));
 }
 
-void HandleEvent(Channel* channel)
+void HandleClosed(Connection* conn)
 {
-    std::cout << "Get a msg !" << std::endl;
+    std::cout << "Close: " << conn->GetFd() << std::endl;
 }
 
 // 设置监听服务器的读回调，实际上就是获取链接
-void Acceptor(Poller* poller, Channel* lis_channel)
+void Acceptor(ConnectionPool* pool, Channel* lis_channel)
 {
     int newfd = accept(lis_channel->GetFd(), nullptr, nullptr);
     if(newfd < 0) 
         return;
 
-    // 给获取上来的通信套接字创建channel进行管理
-    Channel* channel = new Channel(poller, newfd);
-    channel->SetReadCallBack(std::bind(HandleRead, channel));
-    channel->SetWriteCallBack(std::bind(HandleWrite, channel));
-    channel->SetErrorCallBack(std::bind(HandleError, channel));
-    channel->SetCloseCallBack(std::bind(HandleClose, channel));
-    channel->SetEventCallBack(std::bind(HandleEvent, channel));
-    channel->EnableRead();
+    // 从对象池中取出一个连接对象管理通信套接字，关闭后自动归还
+    Connection* conn = pool->Acquire(newfd);
+    if(conn == nullptr)
+    {
+        close(newfd);
+        return;
+    }
+    conn->SetMessageCallBack(HandleMessage);
+    conn->SetClosedCallBack(HandleClosed);
+    conn->Established();
 }
 
 int main()
@@ -66,20 +42,18 @@ int main()
     // 构建监听服务器
     bool ret = sock.CreateServer(8080); // 不是进行通信的fd(是在饭店门口揽客的)
 
-    Poller epoll;
+    EventLoop loop;
+    ConnectionPool pool(&loop);
     // 管理链接的文件描述符
-    Channel channel(&epoll, sock.GetFd());
+    Channel channel(&loop, sock.GetFd());
     // 设置回调函数
-    channel.SetReadCallBack(std::bind(Acceptor, &epoll, &channel));
+    channel.SetReadCallBack(std::bind(Acceptor, &pool, &channel));
     channel.EnableRead(); // 开始关注该文件描述符的读事件，读事件就绪->获取到新链接了
 
     while (1)
     {
-       std::vector<Channel* > actives;
-       epoll.Poll(&actives);
-       for(auto& e : actives)
-            e->HandleEvent();
+        loop.Start();
     }
     sock.Close();
     return 0;
-}
\ No newline at end of file
+}
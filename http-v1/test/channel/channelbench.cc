@@ -0,0 +1,145 @@
+#include <iostream>
+#include <string>
+#include "../../source/server.hpp"
+
+// Channel 事件分发微基准：运行期 std::function 回调(Channel) 与编译期绑定(StaticChannel)的每事件开销
+// 模拟 EventLoop 处理一批就绪的连接：HandleEvent + 读/写回调，每个用例输出一行 JSON
+//   ./channelbench [用例名过滤]
+// 用例名带 _loop 的在 EventLoop 线程中运行(CallbackScope 开启计时)，反映实际处理路径的开销
+
+#define CHANNELS 64
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static std::string g_filter;
+
+// 与 Connection 相同的一组处理函数
+class FakeConn : private ChannelOwner<FakeConn>
+{
+public:
+    FakeConn()
+        : _channel(nullptr, -1, this), _reads(0), _writes(0), _events(0)
+    { }
+    Channel *GetChannel()
+    {
+        return &_channel;
+    }
+    uint64_t Count()
+    {
+        return _reads + _writes + _events;
+    }
+    // 运行期绑定：与改造前的 Connection 一样设置五个回调
+    void Bind(Channel *ch)
+    {
+        ch->SetReadCallBack(std::bind(&FakeConn::HandleRead, this));
+        ch->SetWriteCallBack(std::bind(&FakeConn::HandleWrite, this));
+        ch->SetCloseCallBack(std::bind(&FakeConn::HandleClose, this));
+        ch->SetErrorCallBack(std::bind(&FakeConn::HandleError, this));
+        ch->SetEventCallBack(std::bind(&FakeConn::HandleEvent, this));
+    }
+
+private:
+    friend class StaticChannel<FakeConn>;
+
+    void HandleRead()
+    {
+        _reads++;
+    }
+    void HandleWrite()
+    {
+        _writes++;
+    }
+    void HandleClose()
+    {
+        _events--;
+    }
+    void HandleError()
+    {
+        _events--;
+    }
+    void HandleEvent()
+    {
+        _events++;
+    }
+
+private:
+    StaticChannel<FakeConn> _channel;
+    uint64_t _reads;
+    uint64_t _writes;
+    uint64_t _events;
+};
+
+// 运行一个用例：每次迭代分发 CHANNELS 个事件
+void Bench(const std::string &name, uint64_t iters, std::vector<Channel *> &channels, std::vector<FakeConn> &conns)
+{
+    if (!g_filter.empty() && name.find(g_filter) == std::string::npos)
+        return;
+    auto run = [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++)
+            for (auto ch : channels)
+                ch->HandleEvent();
+    };
+    run(iters / 10 + 1); // 预热
+    uint64_t before = 0, after = 0;
+    for (auto &c : conns)
+        before += c.Count();
+    uint64_t t0 = NowNs();
+    run(iters);
+    uint64_t t1 = NowNs();
+    for (auto &c : conns)
+        after += c.Count();
+    uint64_t events = iters * channels.size();
+    assert(after - before >= events); // 每个事件至少调用一次处理函数
+    printf("{\"case\":\"%s\",\"events\":%lu,\"ns_per_event\":%.2f}\n", name.c_str(), (unsigned long)events,
+           (double)(t1 - t0) / events);
+}
+
+void RunAll(const std::string &suffix, uint64_t iters)
+{
+    // 读事件为主，夹杂可写与读写同时就绪
+    uint32_t pattern[] = {EPOLLIN, EPOLLIN, EPOLLIN, EPOLLOUT, EPOLLIN | EPOLLOUT, EPOLLIN, EPOLLIN, EPOLLIN};
+    std::vector<FakeConn> conns(CHANNELS);
+
+    std::vector<std::unique_ptr<Channel>> owned;
+    std::vector<Channel *> dynamic, statics;
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        owned.emplace_back(new Channel(nullptr, -1));
+        conns[i].Bind(owned.back().get());
+        dynamic.push_back(owned.back().get());
+        statics.push_back(conns[i].GetChannel());
+    }
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        dynamic[i]->SetRevents(EPOLLIN);
+        statics[i]->SetRevents(EPOLLIN);
+    }
+    Bench("dynamic_read" + suffix, iters, dynamic, conns);
+    Bench("static_read" + suffix, iters, statics, conns);
+    for (int i = 0; i < CHANNELS; i++)
+    {
+        dynamic[i]->SetRevents(pattern[i % 8]);
+        statics[i]->SetRevents(pattern[i % 8]);
+    }
+    Bench("dynamic_mixed" + suffix, iters, dynamic, conns);
+    Bench("static_mixed" + suffix, iters, statics, conns);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        g_filter = argv[1];
+    // 不在事件循环线程中：CallbackScope 不计时，只剩分发本身
+    RunAll("", 200000);
+    // 在事件循环线程中：与 EventLoop::Start 中的处理路径相同
+    std::thread([]() {
+        EventLoop loop;
+        RunAll("_loop", 20000);
+    }).join();
+    return 0;
+}
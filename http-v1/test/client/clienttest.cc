@@ -0,0 +1,231 @@
+#include <iostream>
+#include <string>
+#include <future>
+#include <cassert>
+#include "../../source/http/http.hpp"
+#include "../testutil.hpp"
+
+// 出站连接测试：非阻塞连接成功/被拒绝/超时，上游连接池的复用、空闲回收、不可用标记与恢复，
+// 以及 HttpServer 流式路由经连接池访问上游
+
+#define ECHO_PORT 18050
+#define PROXY_PORT 18051
+#define LATE_PORT 18052
+#define CLOSED_PORT 18053
+#define FULL_PORT 18054
+
+// 在事件循环线程中执行并等待结果
+template <typename T>
+T RunSync(EventLoop *loop, const std::function<T()> &fn)
+{
+    std::promise<T> p;
+    loop->RunInLoop([&]() { p.set_value(fn()); });
+    return p.get_future().get();
+}
+
+void StartEcho(uint16_t port)
+{
+    std::thread([port]() {
+        TcpServer server(port, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetMessageCallBack([](Connection *conn, Buffer *buf) {
+            conn->Send(buf->ReadPos(), buf->ReadAbleSize());
+            buf->MoveReadOffset(buf->ReadAbleSize());
+        });
+        server.Start();
+    }).detach();
+}
+
+// 发起一次连接，返回结果(连接成功时发送 ping 并等待回显)
+std::string ConnectOnce(EventLoop *loop, TcpClient *client, uint16_t port, uint32_t timeout)
+{
+    std::promise<std::string> result;
+    std::shared_ptr<std::string> echo = std::make_shared<std::string>();
+    loop->RunInLoop([&, echo]() {
+        client->Connect("127.0.0.1", port, [&, echo](Connection *conn) {
+            if (conn == nullptr)
+                return result.set_value("failed");
+            conn->SetMessageCallBack([&, echo](Connection *c, Buffer *buf) {
+                echo->append(buf->ReadAsString(buf->ReadAbleSize()));
+                if (*echo == "ping")
+                {
+                    c->Shutdown();
+                    result.set_value(*echo);
+                }
+            });
+            conn->Send("ping", 4);
+        }, timeout);
+    });
+    return result.get_future().get();
+}
+
+void TestConnect(EventLoop *loop)
+{
+    TcpClient *client = RunSync<TcpClient *>(loop, [loop]() { return new TcpClient(loop); });
+    // 成功
+    std::string result = ConnectOnce(loop, client, ECHO_PORT, 1);
+    assert(result == "ping");
+    // 被拒绝：立即失败，不等待超时
+    uint64_t start = MonotonicMicros();
+    result = ConnectOnce(loop, client, CLOSED_PORT, 2);
+    assert(result == "failed");
+    assert(MonotonicMicros() - start < 1000000);
+    // 超时：全连接队列已满的监听套接字丢弃 SYN
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(FULL_PORT);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int ret = bind(lfd, (sockaddr *)&addr, sizeof(addr));
+    assert(ret == 0);
+    ret = listen(lfd, 0);
+    assert(ret == 0);
+    std::vector<int> fillers;
+    for (int i = 0; i < 4; i++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        connect(fd, (sockaddr *)&addr, sizeof(addr));
+        fillers.push_back(fd);
+    }
+    usleep(100 * 1000);
+    start = MonotonicMicros();
+    result = ConnectOnce(loop, client, FULL_PORT, 1);
+    assert(result == "failed");
+    assert(MonotonicMicros() - start >= 500000);
+    assert(RunSync<uint64_t>(loop, [client]() { return client->Timeouts(); }) == 1);
+    assert(RunSync<uint64_t>(loop, [client]() { return client->Failures(); }) == 2);
+    assert(RunSync<size_t>(loop, [client]() { return client->Pending(); }) == 0);
+    for (int fd : fillers)
+        close(fd);
+    close(lfd);
+    std::cout << "connect ok" << std::endl;
+}
+
+// 通过连接池发送一次请求，结束后归还连接；返回回显内容
+std::string PoolRequest(EventLoop *loop, UpstreamPool *pool, const std::string &msg)
+{
+    std::promise<std::string> result;
+    std::shared_ptr<std::string> echo = std::make_shared<std::string>();
+    loop->RunInLoop([&, echo]() {
+        pool->Acquire([&, echo](Connection *conn) {
+            if (conn == nullptr)
+                return result.set_value("failed");
+            conn->SetMessageCallBack([&, echo](Connection *c, Buffer *buf) {
+                echo->append(buf->ReadAsString(buf->ReadAbleSize()));
+                if (echo->size() == msg.size())
+                {
+                    pool->Release(c);
+                    result.set_value(*echo);
+                }
+            });
+            conn->Send(msg.data(), msg.size());
+        });
+    });
+    return result.get_future().get();
+}
+
+void TestUpstreamPool(EventLoop *loop)
+{
+    // 复用与空闲回收
+    UpstreamOptions opts;
+    opts.idle_timeout = 1;
+    opts.check_interval = 1;
+    UpstreamPool *pool = RunSync<UpstreamPool *>(loop, [&]() { return new UpstreamPool(loop, "127.0.0.1", ECHO_PORT, opts); });
+    for (int i = 0; i < 5; i++)
+    {
+        std::string echo = PoolRequest(loop, pool, "req-" + std::to_string(i));
+        assert(echo == "req-" + std::to_string(i));
+    }
+    assert(RunSync<uint64_t>(loop, [pool]() { return pool->Client().Connects(); }) == 1);
+    assert(RunSync<uint64_t>(loop, [pool]() { return pool->Reused(); }) == 4);
+    assert(RunSync<size_t>(loop, [pool]() { return pool->IdleCount(); }) == 1);
+    WaitUntil([&]() { return RunSync<size_t>(loop, [pool]() { return pool->Client().Pool()->ActiveCount(); }) == 0; });
+    assert(RunSync<size_t>(loop, [pool]() { return pool->IdleCount(); }) == 0);
+    std::cout << "upstream reuse/idle ok" << std::endl;
+
+    // 上游未启动：连续失败后标记为不可用，之后立即失败；上游启动后由探测恢复
+    opts.fail_threshold = 2;
+    opts.idle_timeout = 30;
+    UpstreamPool *late = RunSync<UpstreamPool *>(loop, [&]() { return new UpstreamPool(loop, "127.0.0.1", LATE_PORT, opts); });
+    std::string echo = PoolRequest(loop, late, "x");
+    assert(echo == "failed");
+    assert(RunSync<bool>(loop, [late]() { return late->Healthy(); }));
+    echo = PoolRequest(loop, late, "x");
+    assert(echo == "failed");
+    assert(!RunSync<bool>(loop, [late]() { return late->Healthy(); }));
+    uint64_t connects = RunSync<uint64_t>(loop, [late]() { return late->Client().Connects(); });
+    echo = PoolRequest(loop, late, "x");
+    assert(echo == "failed");
+    StartEcho(LATE_PORT);
+    WaitUntil([&]() { return RunSync<bool>(loop, [late]() { return late->Healthy(); }); });
+    assert(RunSync<size_t>(loop, [late]() { return late->IdleCount(); }) == 1); // 探测连接留作空闲连接
+    echo = PoolRequest(loop, late, "back");
+    assert(echo == "back");
+    assert(RunSync<uint64_t>(loop, [late]() { return late->Reused(); }) == 1);
+    assert(RunSync<uint64_t>(loop, [late]() { return late->Client().Connects(); }) > connects);
+    std::cout << "upstream health ok" << std::endl;
+    // 连接池须在事件循环停止后销毁，与事件循环一同留到进程结束
+}
+
+void TestProxy()
+{
+    static Upstream upstream("127.0.0.1", ECHO_PORT);
+    static std::atomic<uint64_t> reused(0);
+    std::thread([]() {
+        HttpServer server(PROXY_PORT, "127.0.0.1");
+        server.SetThreadCount(2);
+        // 把查询参数 msg 发给上游，回显作为响应体；等待上游期间事件循环继续处理其他连接
+        server.Stream("GET", "/proxy", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+            std::string msg = req.GetParam("msg");
+            UpstreamPool *pool = upstream.For(stream->Loop());
+            pool->Acquire([stream, pool, msg](Connection *conn) {
+                if (conn == nullptr)
+                {
+                    HttpResponse rsp(502);
+                    stream->WriteHead(rsp);
+                    return stream->End();
+                }
+                reused = pool->Reused();
+                std::shared_ptr<std::string> echo = std::make_shared<std::string>();
+                conn->SetMessageCallBack([stream, pool, msg, echo](Connection *c, Buffer *buf) {
+                    echo->append(buf->ReadAsString(buf->ReadAbleSize()));
+                    if (echo->size() < msg.size())
+                        return;
+                    pool->Release(c);
+                    stream->Write(*echo);
+                    stream->End();
+                });
+                conn->Send(msg.data(), msg.size());
+            });
+        });
+        server.Listen();
+    }).detach();
+
+    int fd = Connect(PROXY_PORT);
+    // 同一连接上的多个请求经同一个事件循环的连接池，第二个起复用上游连接
+    std::string req;
+    for (int i = 0; i < 3; i++)
+        req += "GET /proxy?msg=hello" + std::to_string(i) + " HTTP/1.1\r\n" + (i == 2 ? "Connection: close\r\n" : "") + "\r\n";
+    SendAll(fd, req);
+    std::string rsp = RecvAll(fd);
+    for (int i = 0; i < 3; i++)
+        assert(rsp.find("hello" + std::to_string(i)) != std::string::npos);
+    assert(reused == 2);
+    std::cout << "proxy through upstream pool ok" << std::endl;
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    StartEcho(ECHO_PORT);
+    LoopThread *thread = new LoopThread();
+    EventLoop *loop = thread->GetLoop();
+    TestConnect(loop);
+    TestUpstreamPool(loop);
+    TestProxy();
+    std::cout << "==== Client Test All Passed ====" << std::endl;
+    return 0;
+}
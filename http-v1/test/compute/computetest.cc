@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <set>
+#include <cassert>
+#include "../../source/http/http.hpp"
+#include "../testutil.hpp"
+
+// ComputePool 测试：任务执行、工作窃取、排队上限；HttpServer 按路由卸载到线程池，满时回 503
+
+#define TEST_PORT 18035
+
+void TestRun()
+{
+    ComputePool pool(4);
+    std::atomic<int> sum(0);
+    for (int i = 1; i <= 1000; i++)
+    {
+        bool ok = pool.Submit([&sum, i]() { sum += i; });
+        assert(ok);
+    }
+    WaitUntil([&]() { return pool.Completed() == 1000; });
+    assert(sum == 500500);
+    assert(pool.Pending() == 0);
+    std::cout << "run ok" << std::endl;
+}
+
+void TestSteal()
+{
+    // 子任务都进入提交者自己的队列，其余线程只能靠窃取拿到
+    ComputePool pool(4);
+    std::mutex mtx;
+    std::set<std::thread::id> ids;
+    std::atomic<int> done(0);
+    pool.Submit([&]() {
+        for (int i = 0; i < 16; i++)
+        {
+            pool.Submit([&]() {
+                usleep(10 * 1000);
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    ids.insert(std::this_thread::get_id());
+                }
+                done++;
+            });
+        }
+    });
+    WaitUntil([&]() { return done == 16; });
+    assert(ids.size() > 1);
+    std::cout << "steal ok, " << ids.size() << " threads" << std::endl;
+}
+
+void TestBounded()
+{
+    ComputePool pool(1, 2);
+    std::atomic<bool> release(false);
+    bool ok = pool.Submit([&]() { while (!release) usleep(1000); });
+    assert(ok);
+    WaitUntil([&]() { return pool.Pending() == 0; }); // 第一个任务已开始执行
+    ok = pool.Submit([]() {});
+    assert(ok);
+    ok = pool.Submit([]() {});
+    assert(ok);
+    ok = pool.Submit([]() {});
+    assert(!ok);
+    assert(pool.Rejected() == 1);
+    release = true;
+    WaitUntil([&]() { return pool.Completed() == 3; });
+    ok = pool.Submit([]() {});
+    assert(ok);
+    std::cout << "bounded ok" << std::endl;
+}
+
+std::atomic<bool> g_release(false);
+
+void TestHttp()
+{
+    std::thread([]() {
+        HttpServer server(TEST_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetComputePool(1, 1);
+        server.Get("/slow/(\\d+)", [](const HttpRequest &req, HttpResponse *rsp) {
+            while (!g_release)
+                usleep(1000);
+            // 处理函数不在事件循环线程中执行
+            std::string where = LoopMetrics::Current() == nullptr ? "worker" : "loop";
+            rsp->SetContent("slow-" + std::string(req._matches[1]) + "-" + where, "text/plain");
+        }, true);
+        server.Get("/fast", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("fast", "text/plain");
+        });
+        server.Listen();
+    }).detach();
+
+    // a 占住唯一的工作线程，并在同一次写入中流水线发送第二个请求
+    int a = Connect(TEST_PORT);
+    SendAll(a, "GET /slow/1 HTTP/1.1\r\n\r\nGET /fast HTTP/1.1\r\nConnection: close\r\n\r\n");
+    usleep(50 * 1000);
+    // b 排队，c 超出上限被拒绝
+    int b = Connect(TEST_PORT);
+    SendAll(b, "GET /slow/2 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    usleep(50 * 1000);
+    int c = Connect(TEST_PORT);
+    SendAll(c, "GET /slow/3 HTTP/1.1\r\nConnection: close\r\n\r\n");
+    std::string rc = RecvAll(c);
+    assert(rc.find("HTTP/1.1 503 Service Unavailable\r\n") == 0);
+    assert(rc.find("Retry-After: 1\r\n") != std::string::npos);
+
+    // 事件循环没有被阻塞
+    int d = Connect(TEST_PORT);
+    SendAll(d, "GET /fast HTTP/1.1\r\nConnection: close\r\n\r\n");
+    std::string rd = RecvAll(d);
+    assert(rd.find("\r\n\r\nfast") != std::string::npos);
+
+    g_release = true;
+    std::string ra = RecvAll(a);
+    size_t first = ra.find("slow-1-worker");
+    size_t second = ra.find("\r\n\r\nfast");
+    assert(first != std::string::npos && second != std::string::npos && first < second);
+    std::string rb = RecvAll(b);
+    assert(rb.find("HTTP/1.1 200 OK\r\n") == 0);
+    assert(rb.find("slow-2-worker") != std::string::npos);
+    std::cout << "http offload ok" << std::endl;
+}
+
+int main()
+{
+    TestRun();
+    TestSteal();
+    TestBounded();
+    TestHttp();
+    std::cout << "==== ComputePool Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// 用 socketpair 模拟一条已建立的连接，一端交给对象池管理，另一端作为客户端
+
+static std::string g_recv;
+static int g_closed = 0;
+
+void OnMessage(Connection *conn, Buffer *buf)
+{
+    g_recv += buf->ReadAsString(buf->ReadAbleSize());
+    conn->Send("pong", 4);
+}
+
+void OnClosed(Connection *conn)
+{
+    g_closed++;
+}
+
+// 跑若干轮事件循环(唤醒一次，保证不会阻塞在 epoll_wait 上)
+void Spin(EventLoop &loop, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        loop.WeakUpEventFd();
+        loop.Start();
+    }
+}
+
+int main()
+{
+    std::cout << "==== ConnectionPool Test Begin ====\n";
+
+    EventLoop loop;
+    ConnectionPool pool(&loop);
+
+    /* =========================
+     * 1. 取出连接，收发数据
+     * ========================= */
+    int fds[2];
+    int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(ret == 0);
+
+    Connection *conn = pool.Acquire(fds[0]);
+    assert(conn != nullptr);
+    conn->SetMessageCallBack(OnMessage);
+    conn->SetClosedCallBack(OnClosed);
+    conn->Established();
+    ConnHandle h1 = conn->Handle();
+    assert(h1.Valid());
+    assert(pool.Get(h1) == conn);
+    assert(pool.ActiveCount() == 1);
+
+    ssize_t n = write(fds[1], "ping", 4);
+    assert(n == 4);
+    Spin(loop, 2);
+    assert(g_recv == "ping");
+
+    char out[16] = {0};
+    n = read(fds[1], out, sizeof(out));
+    assert(n == 4);
+    assert(std::string(out) == "pong");
+    std::cout << "[OK] acquire + send/recv\n";
+
+    /* =========================
+     * 2. 对端关闭，槽位回收，旧句柄失效
+     * ========================= */
+    close(fds[1]);
+    Spin(loop, 2);
+    assert(g_closed == 1);
+    assert(pool.ActiveCount() == 0);
+    assert(pool.Get(h1) == nullptr);
+
+    // 过期句柄上的发送/关闭被直接丢弃
+    pool.Send(h1, "stale", 5);
+    pool.Shutdown(h1);
+    std::cout << "[OK] recycle invalidates handle\n";
+
+    /* =========================
+     * 3. 槽位复用：同一对象，新的代数
+     * ========================= */
+    ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(ret == 0);
+    Connection *conn2 = pool.Acquire(fds[0]);
+    assert(conn2 == conn);
+    assert(pool.Capacity() == 1);
+    ConnHandle h2 = conn2->Handle();
+    assert(h2.index == h1.index && h2.generation != h1.generation);
+    assert(pool.Get(h1) == nullptr);
+    conn2->Established();
+
+    // 跨线程通过句柄投递发送任务
+    std::thread t([&]() { pool.Send(h2, "from-thread", 11); });
+    t.join();
+    Spin(loop, 2);
+    memset(out, 0, sizeof(out));
+    n = read(fds[1], out, sizeof(out));
+    assert(n == 11);
+    assert(std::string(out) == "from-thread");
+    std::cout << "[OK] slot reuse + cross-thread send\n";
+
+    /* =========================
+     * 4. 主动关闭，重复关闭不会释放到新连接
+     * ========================= */
+    pool.Shutdown(h2);
+    pool.Shutdown(h2);
+    Spin(loop, 2);
+    assert(g_closed == 2);
+    assert(pool.ActiveCount() == 0);
+    n = read(fds[1], out, sizeof(out));
+    assert(n == 0); // 服务端已关闭
+    close(fds[1]);
+    std::cout << "[OK] shutdown\n";
+
+    /* =========================
+     * 5. 连接数上限
+     * ========================= */
+    ConnectionPool limited(&loop, 1);
+    Connection *first = limited.Acquire(dup(0));
+    assert(first != nullptr);
+    Connection *second = limited.Acquire(0);
+    assert(second == nullptr);
+    std::cout << "[OK] max connections\n";
+
+    std::cout << "==== ConnectionPool Test All Passed ====\n";
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// 输出缓冲区高/低水位与全局内存预算测试
+
+static size_t g_high = 0;
+static int g_low = 0;
+static int g_closed = 0;
+
+void OnHigh(Connection *conn, size_t pending)
+{
+    g_high = pending;
+}
+
+void OnLow(Connection *conn)
+{
+    g_low++;
+}
+
+void OnClosed(Connection *conn)
+{
+    g_closed++;
+}
+
+void Spin(EventLoop &loop, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        loop.WeakUpEventFd();
+        loop.Start();
+    }
+}
+
+int main()
+{
+    std::cout << "==== WaterMark Test Begin ====\n";
+
+    EventLoop loop;
+    ConnectionPool pool(&loop);
+    std::string data(100, 'x');
+
+    /* =========================
+     * 1. 超过高水位暂停读取，发送完毕回落到低水位后恢复
+     * ========================= */
+    {
+        int fds[2];
+        int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        assert(ret == 0);
+        Connection *conn = pool.Acquire(fds[0]);
+        conn->SetWaterMark(16, 64);
+        conn->SetHighWaterMarkCallBack(OnHigh);
+        conn->SetLowWaterMarkCallBack(OnLow);
+        conn->SetClosedCallBack(OnClosed);
+        conn->Established();
+
+        conn->Send(data.data(), data.size());
+        assert(g_high == 100);
+        assert(conn->ReadPaused());
+        assert(conn->PendingOutput() == 100);
+        assert(OutputBudget::Used() == 100);
+
+        Spin(loop, 2);
+        assert(!conn->ReadPaused());
+        assert(g_low == 1);
+        assert(conn->PendingOutput() == 0);
+        assert(OutputBudget::Used() == 0);
+
+        char out[128];
+        ssize_t n = read(fds[1], out, sizeof(out));
+        assert(n == 100);
+        close(fds[1]);
+        Spin(loop, 2);
+        assert(g_closed == 1);
+        std::cout << "[OK] high/low water mark\n";
+    }
+
+    /* =========================
+     * 2. 全局预算耗尽时断开积压的慢连接，并归还预算
+     * ========================= */
+    {
+        OutputBudget::SetLimit(150);
+        int fds[2];
+        int ret = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        assert(ret == 0);
+        Connection *conn = pool.Acquire(fds[0]);
+        conn->SetWaterMark(16, 64);
+        conn->Established();
+
+        conn->Send(data.data(), data.size());
+        conn->Send(data.data(), data.size()); // 超出全局预算
+        assert(OutputBudget::Exceeded());
+        conn->Send(data.data(), data.size()); // 积压超过高水位且预算耗尽：断开
+        assert(conn->Status() == DISCONNECTING);
+
+        Spin(loop, 2);
+        assert(g_closed == 2);
+        assert(pool.ActiveCount() == 0);
+        assert(OutputBudget::Used() == 0);
+        close(fds[1]);
+        OutputBudget::SetLimit(DEFAULT_OUTPUT_BUDGET);
+        std::cout << "[OK] global output budget\n";
+    }
+
+    std::cout << "==== WaterMark Test All Passed ====\n";
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/server.hpp"
+#include "../testutil.hpp"
+
+// 忙轮询测试：线程启动回调、高频到达时轮询命中且时长增长、空闲时时长回落到最小值
+
+#define MAX_SPIN_US 200
+
+std::atomic<int> g_init_index(-1);
+std::atomic<bool> g_bound(false);
+
+void OnThreadInit(EventLoop *loop, int index)
+{
+    g_init_index = index;
+    g_bound = BindCurrentThread(std::vector<int>(1, 0));
+    loop->SetBusyPoll(MAX_SPIN_US);
+}
+
+void WaitTasks(EventLoop *loop, uint64_t n)
+{
+    WaitUntil([&]() { return loop->Metrics().tasks.Get() >= n; }, 1000);
+}
+
+int main()
+{
+    LoopThread *thread = new LoopThread(OnThreadInit, 3); // 事件循环线程不会退出，不释放
+    EventLoop *loop = thread->GetLoop();
+    assert(g_init_index == 3);
+    assert(g_bound == true);
+    LoopMetrics &m = loop->Metrics();
+    assert(m.spin_budget_us.Get() == MAX_SPIN_US);
+
+    // 空闲：每次都等不到事件，时长回落到最小值
+    for (int i = 0; i < 20; i++)
+    {
+        loop->QueueInLoop([]() {});
+        usleep(5 * 1000);
+    }
+    WaitTasks(loop, 20);
+    assert(m.spin_misses.Get() > 0);
+    assert(m.spin_budget_us.Get() == BUSY_POLL_MIN_US);
+    std::cout << "idle decay ok, misses=" << m.spin_misses.Get() << std::endl;
+
+    // 高频到达：连续投递任务，轮询期间即可拿到事件
+    uint64_t hits = m.spin_hits.Get();
+    for (int i = 0; i < 2000; i++)
+    {
+        loop->QueueInLoop([]() {});
+        if (i % 10 == 0)
+            usleep(20);
+    }
+    WaitTasks(loop, 2020);
+    assert(m.spin_hits.Get() > hits);
+    std::cout << "busy hits ok, hits=" << m.spin_hits.Get() << " budget=" << m.spin_budget_us.Get() << "us" << std::endl;
+
+    // 关闭后不再轮询
+    loop->RunInLoop(std::bind(&EventLoop::SetBusyPoll, loop, 0));
+    usleep(10 * 1000);
+    uint64_t polls = m.spin_hits.Get() + m.spin_misses.Get();
+    loop->QueueInLoop([]() {});
+    usleep(10 * 1000);
+    assert(m.spin_hits.Get() + m.spin_misses.Get() == polls);
+    std::cout << "==== BusyPoll Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/server.hpp"
+#include "../testutil.hpp"
+
+// 线程放置测试：CPU 列表解析、按配置绑核与启动诊断、按 SO_INCOMING_CPU 分配连接
+
+#define TEST_PORT 18038
+
+void TestParse()
+{
+    std::vector<int> cpus = LoopPlacement::ParseCpuList("0-2,5");
+    assert((cpus == std::vector<int>{0, 1, 2, 5}));
+    assert(LoopPlacement::ParseCpuList("").empty());
+    LoopPlacement p = LoopPlacement::OnePerCore(2, 1, 2);
+    assert(p.loops.size() == 2 && p.CpusOf(0) == std::vector<int>(1, 1) && p.CpusOf(1) == std::vector<int>(1, 3));
+    assert(p.CpusOf(2).empty());
+    assert(CpuListString(cpus) == "0,1,2,5");
+    std::cout << "parse ok" << std::endl;
+}
+
+void TestPlacement()
+{
+    EventLoop base;
+    LoopThreadPool *pool = new LoopThreadPool(&base); // 事件循环线程不会退出，不释放
+    LoopPlacement placement;
+    placement.loops.push_back(std::vector<int>(1, 0));
+    placement.loops.push_back(std::vector<int>());
+    std::atomic<int> init_cpu(-2);
+    pool->SetThreadCount(2);
+    pool->SetPlacement(placement);
+    pool->SetThreadInitCallBack([&init_cpu](EventLoop *loop, int index) {
+        if (index == 0)
+            init_cpu = sched_getcpu(); // 初始化回调在绑核之后执行
+    });
+    pool->Create();
+    std::vector<std::string> lines = pool->Describe();
+    for (auto &line : lines)
+        std::cout << line << std::endl;
+    assert(lines.size() == 2);
+    assert(lines[0].find("cpus=0 bound=yes running_on=cpu0") != std::string::npos);
+    assert(lines[1].find("cpus=any bound=-") != std::string::npos);
+    assert(init_cpu == 0);
+    assert(pool->LoopForCpu(0) == pool->AllLoops()[0]);
+    assert(pool->LoopForCpu(7) == nullptr);
+    std::cout << "placement ok" << std::endl;
+}
+
+TcpServer *g_server = nullptr;
+
+void TestIncomingCpu()
+{
+    std::atomic<bool> ready(false);
+    std::thread([&ready]() {
+        TcpServer *server = new TcpServer(TEST_PORT, "127.0.0.1");
+        server->SetThreadCount(2);
+        // 只有 loop 0 绑定在 CPU 0 上，本机回环连接的软中断都在 CPU 0 时应全部交给它
+        LoopPlacement placement;
+        placement.loops.push_back(std::vector<int>(1, 0));
+        placement.loops.push_back(std::vector<int>());
+        server->SetPlacement(placement);
+        server->SetIncomingCpuDispatch(true);
+        g_server = server;
+        ready = true;
+        server->Start();
+    }).detach();
+    while (!ready)
+        usleep(1000);
+
+    int n = 8;
+    std::vector<int> fds;
+    for (int i = 0; i < n; i++)
+        fds.push_back(Connect(TEST_PORT));
+    usleep(100 * 1000);
+    std::string report = g_server->PlacementReport();
+    std::cout << report;
+    assert(report.find("base: cpus=any") == 0);
+
+    // 以各从属Reactor打开的连接数检验分配结果
+    std::string text = MetricsRegistry::Instance().ExportPrometheus();
+    int nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    int cpu0 = 0;
+    for (int fd : fds)
+    {
+        int cpu = Socket::IncomingCpu(fd);
+        assert(cpu >= -1 && cpu < nproc);
+        cpu0 += cpu == 0;
+    }
+    std::cout << "connections with client-side incoming cpu 0: " << cpu0 << "/" << n << std::endl;
+    if (nproc == 1)
+    {
+        // 单核机器上所有连接的软中断都在 CPU 0
+        bool found = false;
+        for (int id = 0; id < MAX_METRIC_LOOPS && !found; id++)
+        {
+            std::string key = "reactor_connections_opened_total{loop=\"" + std::to_string(id) + "\"} " + std::to_string(n) + "\n";
+            found = text.find(key) != std::string::npos;
+        }
+        assert(found);
+    }
+    for (int fd : fds)
+        close(fd);
+    std::cout << "incoming cpu dispatch ok" << std::endl;
+}
+
+int main()
+{
+    TestParse();
+    TestPlacement();
+    TestIncomingCpu();
+    std::cout << "==== Placement Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,788 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <zlib.h>
+#include "../../source/http/http.hpp"
+#include "../testutil.hpp"
+
+// HTTP 层测试：请求解析(分段到达/流水线/长短连接判断) 与 /metrics 指标导出
+
+#define TEST_PORT 18033
+#define CACHE_PORT 18041
+#define STREAM_PORT 18042
+#define COMPRESS_PORT 18043
+#define WS_PORT 18047
+
+void TestParse()
+{
+    // 请求分两次到达
+    HttpContext ctx;
+    Buffer buf;
+    buf.WriteString("GET /a%20b?x=1&y=hello+world HTTP/1.1\r\nHost: local");
+    ctx.RecvHttpRequest(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_HEAD);
+    buf.WriteString("\r\nContent-Length: 5\r\n\r\nhel");
+    ctx.RecvHttpRequest(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_BODY);
+    buf.WriteString("loGET / HTTP/1.0\r\n\r\n");
+    ctx.RecvHttpRequest(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_OVER);
+    HttpRequest &req = ctx.Request();
+    assert(req._method == "GET");
+    assert(req._path == "/a b");
+    assert(req.GetParam("x") == "1");
+    assert(req.GetParam("y") == "hello world");
+    assert(req.GetHeader("Host") == "local");
+    assert(req._body == "hello");
+    assert(req.Close() == false);
+
+    // 流水线中的第二个请求：HTTP/1.0 默认短连接
+    ctx.ReSet();
+    ctx.RecvHttpRequest(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_OVER);
+    assert(ctx.Request()._version == "HTTP/1.0");
+    assert(ctx.Request().Close() == true);
+    assert(buf.ReadAbleSize() == 0);
+
+    // 请求行格式错误
+    ctx.ReSet();
+    buf.WriteString("BREW /pot HTTP/1.1\r\n\r\n");
+    ctx.RecvHttpRequest(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_ERROR);
+    assert(ctx.RespStatu() == 400);
+
+    // Content-Length 非法或溢出：回 400，不抛异常
+    const char *bad_lengths[] = {"abc", "-1", " 5", "5x", "0x10", "", "99999999999999999999", "18446744073709551616"};
+    for (const char *len : bad_lengths)
+    {
+        ctx.ReSet();
+        buf.WriteString(std::string("POST / HTTP/1.1\r\nContent-Length: ") + len + "\r\n\r\n");
+        ctx.RecvHttpRequest(&buf);
+        assert(ctx.RecvStatu() == RECV_HTTP_ERROR);
+        assert(ctx.RespStatu() == 400);
+        buf.MoveReadOffset(buf.ReadAbleSize());
+    }
+    size_t len = 0;
+    bool parsed = Util::ParseLength("18446744073709551615", &len);
+    assert(parsed && len == 18446744073709551615ULL);
+
+    // 分帧字段：名字统一大小写；chunked 为最后一个编码时去掉 Content-Length；
+    // 其他编码结尾回 501，重复的 Content-Length 回 400
+    ctx.ReSet();
+    buf.WriteString("POST / HTTP/1.1\r\ncontent-length: 5\r\nTransfer-Encoding: gzip\r\ntransfer-encoding: chunked\r\n\r\n");
+    ctx.RecvHttpRequestHead(&buf);
+    assert(ctx.RecvStatu() == RECV_HTTP_BODY && ctx.Request().Chunked());
+    assert(ctx.Request().GetHeader("Transfer-Encoding") == "gzip, chunked" && !ctx.Request().HasHeader("Content-Length"));
+    const char *bad_framing[] = {"Transfer-Encoding: chunked, gzip\r\n", "Transfer-Encoding: chunkedx\r\n",
+                                 "Content-Length: 5\r\nContent-Length: 5\r\n", "Content-Length: 5\r\ncontent-length: 6\r\n"};
+    for (const char *fields : bad_framing)
+    {
+        ctx.ReSet();
+        buf.MoveReadOffset(buf.ReadAbleSize());
+        buf.WriteString(std::string("POST / HTTP/1.1\r\n") + fields + "\r\n");
+        ctx.RecvHttpRequest(&buf);
+        assert(ctx.RecvStatu() == RECV_HTTP_ERROR);
+        assert(ctx.RespStatu() == (strncmp(fields, "Transfer", 8) == 0 ? 501 : 400));
+    }
+    buf.MoveReadOffset(buf.ReadAbleSize());
+
+    assert(Util::ValidPath("/a/../b") == true);
+    assert(Util::ValidPath("/../etc/passwd") == false);
+    assert(Util::UrlDecode(Util::UrlEncode("a b/c?", true), true) == "a b/c?");
+    std::cout << "parse ok" << std::endl;
+}
+
+std::string Fetch(const std::string &request, uint16_t port = TEST_PORT)
+{
+    int fd = Connect(port);
+    SendAll(fd, request);
+    // 服务端在 Connection: close 时关闭连接，读到 EOF 为止
+    return RecvAll(fd);
+}
+
+// 各个循环上某个计数器的导出值之和
+uint64_t MetricSum(const std::string &text, const std::string &name)
+{
+    uint64_t sum = 0;
+    std::string prefix = name + "{";
+    for (size_t pos = text.find(prefix); pos != std::string::npos; pos = text.find(prefix, pos + 1))
+    {
+        if (pos > 0 && text[pos - 1] != '\n')
+            continue;
+        sum += std::stoull(text.substr(text.find("} ", pos) + 2));
+    }
+    return sum;
+}
+
+std::atomic<bool> g_timer_fired(false);
+
+void TestMetrics()
+{
+    std::thread([]() {
+        HttpServer server(TEST_PORT, "127.0.0.1");
+        server.SetThreadCount(2);
+        server.EnableMetrics();
+        server.Get("/hello", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("hello", "text/plain");
+        });
+        // 一个 1 秒后到期的定时任务，用于检查 reactor_timer_fires_total
+        server.GetTcpServer().BaseLoop()->RunAfter(1, []() { g_timer_fired = true; });
+        server.Listen();
+    }).detach();
+
+    std::string rsp = Fetch("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 200 OK\r\n") == 0);
+    assert(rsp.find("\r\n\r\nhello") != std::string::npos);
+
+    rsp = Fetch("GET /nothing HTTP/1.0\r\n\r\n");
+    assert(rsp.find("HTTP/1.0 404 Not Found\r\n") == 0);
+
+    // 非法的 Content-Length 只让这个连接收到 400，服务进程不受影响
+    rsp = Fetch("POST /hello HTTP/1.1\r\nContent-Length: abc\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 400") == 0);
+    rsp = Fetch("POST /hello HTTP/1.1\r\nContent-Length: 99999999999999999999\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 400") == 0);
+
+    WaitUntil([]() { return g_timer_fired.load(); });
+    rsp = Fetch("GET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 200 OK\r\n") == 0);
+    assert(rsp.find("Content-Type: text/plain; version=0.0.4") != std::string::npos);
+    assert(MetricSum(rsp, "reactor_timer_fires_total") == 1);
+    assert(rsp.find("# TYPE reactor_polls_total counter") != std::string::npos);
+    assert(rsp.find("reactor_accepts_total{loop=\"0\"}") != std::string::npos);
+    assert(rsp.find("reactor_loop_iteration_us_bucket") != std::string::npos);
+    assert(rsp.find("le=\"+Inf\"") != std::string::npos);
+    std::cout << rsp.substr(rsp.find("\r\n\r\n") + 4, 400) << "..." << std::endl;
+    std::cout << "metrics ok" << std::endl;
+}
+
+void TestCacheLru()
+{
+    ResponseCache cache(100);
+    auto block = [](char c) { return std::make_shared<const std::string>(30, c); };
+    cache.Put("a", block('a'));
+    cache.Put("b", block('b'));
+    cache.Put("c", block('c'));
+    assert(cache.Count() == 3 && cache.Bytes() == 93);
+    auto hit = cache.Get("a"); // a 变为最近使用
+    assert(hit != nullptr);
+    cache.Put("d", block('d')); // 淘汰最久未使用的 b
+    hit = cache.Get("b");
+    assert(hit == nullptr);
+    hit = cache.Get("a");
+    assert(hit && *hit == std::string(30, 'a'));
+    assert(cache.Evictions() == 1 && cache.Bytes() == 93);
+    cache.Put("e", std::make_shared<const std::string>(200, 'e')); // 超过预算不缓存
+    hit = cache.Get("e");
+    assert(hit == nullptr && cache.Count() == 3);
+    ResponseCache expired(100, 0);
+    expired.Put("a", block('a'));
+    hit = expired.Get("a");
+    assert(hit == nullptr && expired.Count() == 0);
+    std::cout << "cache lru ok" << std::endl;
+}
+
+std::atomic<int> g_hot_calls(0);
+
+void TestCache()
+{
+    std::thread([]() {
+        HttpServer server(CACHE_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.EnableResponseCache(1024 * 1024, DEFAULT_RESPONSE_CACHE_TTL, std::vector<std::string>{"Accept-Encoding"});
+        server.Get("/hot", [](const HttpRequest &req, HttpResponse *rsp) {
+            rsp->SetContent("hot-" + std::to_string(++g_hot_calls) + "-" + req.GetParam("v"), "text/plain");
+            rsp->SetCacheable();
+        });
+        server.Get("/cold", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("cold-" + std::to_string(++g_hot_calls), "text/plain");
+        });
+        server.Listen();
+    }).detach();
+
+    // 同一连接上：第一次生成并缓存，第二次命中；HEAD 与不同的 Vary 头/查询字符串各自缓存
+    std::string rsp = Fetch("GET /hot?v=1 HTTP/1.1\r\n\r\n"
+                            "GET /hot?v=1 HTTP/1.1\r\n\r\n"
+                            "HEAD /hot?v=1 HTTP/1.1\r\n\r\n"
+                            "GET /hot?v=1 HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n"
+                            "GET /hot?v=2 HTTP/1.1\r\n\r\n"
+                            "GET /hot?v=2 HTTP/1.1\r\n\r\n"
+                            "GET /cold HTTP/1.1\r\n\r\n"
+                            "GET /cold HTTP/1.1\r\nConnection: close\r\n\r\n",
+                            CACHE_PORT);
+    size_t first = rsp.find("\r\n\r\nhot-1-1");
+    assert(first != std::string::npos);
+    assert(rsp.find("\r\n\r\nhot-1-1", first + 1) != std::string::npos); // 第二次命中缓存
+    assert(rsp.find("\r\n\r\nhot-3-1") != std::string::npos);            // Accept-Encoding 不同
+    assert(rsp.find("\r\n\r\nhot-4-2") != std::string::npos);
+    assert(rsp.find("\r\n\r\nhot-5-2") == std::string::npos);            // v=2 第二次命中
+    assert(rsp.find("\r\n\r\ncold-5") != std::string::npos && rsp.find("\r\n\r\ncold-6") != std::string::npos);
+    assert(g_hot_calls == 6); // GET, HEAD, gzip, v=2 各生成一次，cold 两次
+
+    // 新连接命中同一分片
+    rsp = Fetch("GET /hot?v=1 HTTP/1.1\r\n\r\nGET /cold HTTP/1.1\r\nConnection: close\r\n\r\n", CACHE_PORT);
+    assert(rsp.find("\r\n\r\nhot-1-1") != std::string::npos);
+    assert(rsp.find("Connection: keep-alive") != std::string::npos);
+    assert(g_hot_calls == 7);
+    std::cout << "response cache ok" << std::endl;
+}
+
+// 解码 chunked 响应体
+std::string Dechunk(const std::string &body)
+{
+    std::string out;
+    size_t pos = 0;
+    while (true)
+    {
+        size_t eol = body.find("\r\n", pos);
+        assert(eol != std::string::npos);
+        size_t len = strtoul(body.c_str() + pos, nullptr, 16);
+        if (len == 0)
+            break;
+        out.append(body, eol + 2, len);
+        pos = eol + 2 + len + 2;
+    }
+    return out;
+}
+
+std::atomic<size_t> g_max_in_buffer(0);
+std::atomic<size_t> g_max_pending(0);
+
+void TestStream()
+{
+    std::thread([]() {
+        HttpServer server(STREAM_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        // 上传：统计长度与校验和，中途暂停一次读取
+        server.Stream("POST", "/upload", [](const HttpRequest &, const std::shared_ptr<HttpStream> &stream) {
+            std::shared_ptr<uint64_t> total = std::make_shared<uint64_t>(0), sum = std::make_shared<uint64_t>(0);
+            HttpStream *s = stream.get();
+            stream->OnData([s, total, sum](const char *data, size_t len) {
+                for (size_t i = 0; i < len; i++)
+                    *sum += (unsigned char)data[i];
+                *total += len;
+                size_t cap = s->GetConnection()->InBuffer()->Capacity();
+                if (cap > g_max_in_buffer)
+                    g_max_in_buffer = cap;
+                if (*total >= 1024 * 1024 && *total - len < 1024 * 1024)
+                {
+                    s->PauseInput();
+                    s->Loop()->QueueInLoop([s]() { s->ResumeInput(); });
+                }
+            });
+            stream->OnEnd([s, total, sum]() {
+                s->Write("len=" + std::to_string(*total) + " sum=" + std::to_string(*sum));
+                s->End();
+            });
+        });
+        // 下载：按输出水位分段写出 size 字节
+        server.Stream("GET", "/download", [](const HttpRequest &req, const std::shared_ptr<HttpStream> &stream) {
+            std::shared_ptr<uint64_t> left = std::make_shared<uint64_t>(std::stoull(req.GetParam("size")));
+            HttpStream *s = stream.get();
+            auto pump = [s, left]() {
+                std::string chunk(64 * 1024, 'd');
+                while (*left > 0)
+                {
+                    size_t n = std::min<uint64_t>(*left, chunk.size());
+                    *left -= n;
+                    bool more = s->Write(chunk.data(), n);
+                    size_t pending = s->GetConnection()->PendingOutput();
+                    if (pending > g_max_pending)
+                        g_max_pending = pending;
+                    if (!more)
+                        return; // 等待 OnWritable
+                }
+                s->End();
+            };
+            stream->OnWritable(pump);
+            stream->OnEnd(pump);
+        });
+        server.Get("/after", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("after", "text/plain");
+        });
+        server.Listen();
+    }).detach();
+
+    // Content-Length 上传 32MB，后面流水线一个普通请求
+    size_t size = 32 * 1024 * 1024;
+    uint64_t sum = 0;
+    std::string body(size, 0);
+    for (size_t i = 0; i < size; i++)
+    {
+        body[i] = (char)(i * 7);
+        sum += (unsigned char)body[i];
+    }
+    int fd = Connect(STREAM_PORT);
+    std::thread sender([&]() {
+        SendAll(fd, "POST /upload HTTP/1.1\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n");
+        SendAll(fd, body);
+        SendAll(fd, "GET /after HTTP/1.1\r\nConnection: close\r\n\r\n");
+    });
+    std::string rsp = RecvAll(fd);
+    sender.join();
+    assert(rsp.find("HTTP/1.1 200 OK\r\n") == 0);
+    assert(rsp.find("Transfer-Encoding: chunked") != std::string::npos);
+    size_t second = rsp.find("HTTP/1.1 200 OK\r\n", 1);
+    assert(second != std::string::npos && rsp.find("\r\n\r\nafter") != std::string::npos);
+    std::string first = rsp.substr(0, second);
+    std::string reply = Dechunk(first.substr(first.find("\r\n\r\n") + 4));
+    assert(reply == "len=" + std::to_string(size) + " sum=" + std::to_string(sum));
+    assert(g_max_in_buffer <= 4 * CONN_READ_SIZE); // 输入缓冲区不随请求体增长
+    std::cout << "stream upload ok, max in buffer " << g_max_in_buffer << std::endl;
+
+    // chunked 上传
+    rsp = Fetch("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"
+                "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n",
+                STREAM_PORT);
+    reply = Dechunk(rsp.substr(rsp.find("\r\n\r\n") + 4));
+    assert(reply == "len=11 sum=" + std::to_string(1116));
+    assert(rsp.find("Connection: close") != std::string::npos);
+    std::cout << "chunked upload ok" << std::endl;
+
+    // 下载 64MB，客户端慢读，服务端积压受高水位限制
+    size = 64 * 1024 * 1024;
+    fd = Connect(STREAM_PORT);
+    SendAll(fd, "GET /download?size=" + std::to_string(size) + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+    rsp = RecvAll(fd);
+    std::string data = Dechunk(rsp.substr(rsp.find("\r\n\r\n") + 4));
+    assert(data.size() == size && data.find_first_not_of('d') == std::string::npos);
+    assert(g_max_pending <= DEFAULT_HIGH_WATER_MARK + 128 * 1024);
+    std::cout << "stream download ok, max pending " << g_max_pending << std::endl;
+
+    // HTTP/1.0 不分块，写完关闭连接
+    rsp = Fetch("GET /download?size=10 HTTP/1.0\r\n\r\n", STREAM_PORT);
+    assert(rsp.find("Transfer-Encoding") == std::string::npos);
+    assert(rsp.substr(rsp.find("\r\n\r\n") + 4) == "dddddddddd");
+    std::cout << "http/1.0 stream ok" << std::endl;
+}
+
+// windowBits 15+32 自动识别 gzip 与 zlib 头
+std::string Inflate(const std::string &in)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    int ret = inflateInit2(&zs, 15 + 32);
+    assert(ret == Z_OK);
+    zs.next_in = (Bytef *)in.data();
+    zs.avail_in = in.size();
+    std::string out;
+    char tmp[16384];
+    do
+    {
+        zs.next_out = (Bytef *)tmp;
+        zs.avail_out = sizeof(tmp);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        assert(ret == Z_OK || ret == Z_STREAM_END);
+        out.append(tmp, sizeof(tmp) - zs.avail_out);
+    } while (ret != Z_STREAM_END);
+    inflateEnd(&zs);
+    return out;
+}
+
+std::string Body(const std::string &rsp)
+{
+    return rsp.substr(rsp.find("\r\n\r\n") + 4);
+}
+
+void TestCompress()
+{
+    assert(Compressor::Negotiate("") == CODING_IDENTITY);
+    assert(Compressor::Negotiate("gzip, deflate") == CODING_GZIP);
+    assert(Compressor::Negotiate("deflate") == CODING_DEFLATE);
+    assert(Compressor::Negotiate("gzip;q=0, deflate") == CODING_DEFLATE);
+    assert(Compressor::Negotiate("gzip;q=0.0") == CODING_IDENTITY);
+    assert(Compressor::Accepts("GZIP ; q=0.5", CODING_GZIP));
+
+    std::string text;
+    for (int i = 0; text.size() < 512 * 1024; i++)
+        text += "line " + std::to_string(i) + " of some compressible text\n";
+    char dir[] = "/tmp/httpgzXXXXXX";
+    char *made = mkdtemp(dir);
+    assert(made != nullptr);
+    std::string base = dir;
+    // 预压缩文件的内容故意与原文件不同，便于区分发送的是哪一个
+    std::string gz_plain = "precompressed sibling";
+    {
+        std::ofstream(base + "/app.js") << "original file";
+        gzFile gz = gzopen((base + "/app.js.gz").c_str(), "wb");
+        gzwrite(gz, gz_plain.data(), gz_plain.size());
+        gzclose(gz);
+    }
+    std::thread([&text, base]() {
+        HttpServer server(COMPRESS_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetBaseDir(base);
+        server.SetComputePool(1);
+        CompressOptions opts;
+        opts.offload_size = 256 * 1024;
+        server.EnableCompression(opts);
+        server.Get("/text", [&text](const HttpRequest &req, HttpResponse *rsp) {
+            rsp->SetContent(text.substr(0, std::stoul(req.GetParam("size"))), "text/plain");
+        });
+        server.Get("/png", [&text](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent(text.substr(0, 4096), "image/png");
+        });
+        server.Get("/heavy", [&text](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent(text, "application/json");
+        }, true);
+        server.Stream("GET", "/events", [](const HttpRequest &, const std::shared_ptr<HttpStream> &stream) {
+            HttpResponse head(200);
+            head.SetHeader("Content-Type", "text/event-stream");
+            stream->WriteHead(head);
+            for (int i = 0; i < 100; i++)
+            {
+                stream->Write("data: event " + std::to_string(i) + "\n\n");
+                stream->Flush();
+            }
+            stream->End();
+        });
+        server.Listen();
+    }).detach();
+
+    // gzip 与 deflate 往返
+    std::string rsp = Fetch("GET /text?size=8192 HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: gzip") != std::string::npos);
+    assert(rsp.find("Vary: Accept-Encoding") != std::string::npos);
+    assert(Body(rsp).size() < 8192 && Inflate(Body(rsp)) == text.substr(0, 8192));
+    rsp = Fetch("GET /text?size=8192 HTTP/1.1\r\nAccept-Encoding: deflate\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: deflate") != std::string::npos);
+    assert(Inflate(Body(rsp)) == text.substr(0, 8192));
+    std::cout << "compress gzip/deflate ok" << std::endl;
+
+    // 不接受压缩、q=0、响应太小或类型不可压缩时原样发送
+    rsp = Fetch("GET /text?size=8192 HTTP/1.1\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding") == std::string::npos && Body(rsp) == text.substr(0, 8192));
+    rsp = Fetch("GET /text?size=8192 HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding") == std::string::npos);
+    rsp = Fetch("GET /text?size=100 HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding") == std::string::npos && Body(rsp) == text.substr(0, 100));
+    rsp = Fetch("GET /png HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding") == std::string::npos);
+    std::cout << "compress identity ok" << std::endl;
+
+    // 预压缩的静态资源
+    rsp = Fetch("GET /app.js HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: gzip") != std::string::npos);
+    assert(rsp.find("Content-Type: text/javascript") != std::string::npos);
+    assert(Inflate(Body(rsp)) == gz_plain);
+    rsp = Fetch("GET /app.js HTTP/1.1\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(Body(rsp) == "original file");
+    std::cout << "precompressed ok" << std::endl;
+
+    // 计算线程池中执行的路由与大响应在工作线程中压缩
+    rsp = Fetch("GET /heavy HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: gzip") != std::string::npos && Inflate(Body(rsp)) == text);
+    rsp = Fetch("GET /text?size=400000 HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: gzip") != std::string::npos && Inflate(Body(rsp)) == text.substr(0, 400000));
+    std::cout << "offloaded compress ok" << std::endl;
+
+    // 流式响应边写边压缩
+    rsp = Fetch("GET /events HTTP/1.1\r\nAccept-Encoding: gzip\r\nConnection: close\r\n\r\n", COMPRESS_PORT);
+    assert(rsp.find("Content-Encoding: gzip") != std::string::npos);
+    std::string events = Inflate(Dechunk(Body(rsp)));
+    assert(events.find("data: event 0\n\n") == 0 && events.find("data: event 99\n\n") != std::string::npos);
+    std::cout << "stream compress ok" << std::endl;
+
+    unlink((base + "/app.js").c_str());
+    unlink((base + "/app.js.gz").c_str());
+    rmdir(dir);
+}
+
+// 客户端帧：带随机掩码
+std::string WsFrame(int op, const std::string &payload, bool fin = true)
+{
+    std::string frame;
+    frame += (char)((fin ? 0x80 : 0) | op);
+    if (payload.size() < 126)
+        frame += (char)(0x80 | payload.size());
+    else if (payload.size() <= 0xFFFF)
+    {
+        frame += (char)(0x80 | 126);
+        frame += (char)(payload.size() >> 8);
+        frame += (char)payload.size();
+    }
+    else
+    {
+        frame += (char)(0x80 | 127);
+        for (int i = 0; i < 8; i++)
+            frame += (char)((uint64_t)payload.size() >> (56 - 8 * i));
+    }
+    unsigned char mask[4] = {(unsigned char)rand(), (unsigned char)rand(), (unsigned char)rand(), (unsigned char)rand()};
+    frame.append((char *)mask, 4);
+    for (size_t i = 0; i < payload.size(); i++)
+        frame += (char)(payload[i] ^ mask[i & 3]);
+    return frame;
+}
+
+bool RecvExact(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = recv(fd, buf + got, len - got, 0);
+        if (n <= 0)
+            return false;
+        got += n;
+    }
+    return true;
+}
+
+// 读一个服务端帧，连接关闭时返回 -1
+int WsRecv(int fd, std::string *payload)
+{
+    unsigned char head[2];
+    if (!RecvExact(fd, (char *)head, 2))
+        return -1;
+    assert((head[1] & 0x80) == 0); // 服务端帧不带掩码
+    uint64_t len = head[1] & 0x7F;
+    unsigned char ext[8];
+    if (len == 126)
+    {
+        bool ok = RecvExact(fd, (char *)ext, 2);
+        assert(ok);
+        len = ext[0] << 8 | ext[1];
+    }
+    else if (len == 127)
+    {
+        bool ok = RecvExact(fd, (char *)ext, 8);
+        assert(ok);
+        len = 0;
+        for (int i = 0; i < 8; i++)
+            len = len << 8 | ext[i];
+    }
+    payload->resize(len);
+    if (len > 0)
+    {
+        bool ok = RecvExact(fd, &(*payload)[0], len);
+        assert(ok);
+    }
+    return head[0] & 0x0F;
+}
+
+// 握手并返回 101 响应头
+int WsConnect(const std::string &path, std::string *rsp, const std::string &extra = "")
+{
+    int fd = Connect(WS_PORT);
+    SendAll(fd, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: keep-alive, Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n" + extra + "\r\n");
+    rsp->clear();
+    char c;
+    while (rsp->find("\r\n\r\n") == std::string::npos && recv(fd, &c, 1, 0) == 1)
+        *rsp += c;
+    return fd;
+}
+
+WebSocketGroup g_ws_group;
+std::atomic<int> g_ws_close_code(0);
+
+void TestWebSocket()
+{
+    // 握手密钥与 SHA-1/Base64(RFC 6455 与 FIPS 180 的示例)
+    assert(Util::Base64Encode(Util::Sha1("abc")) == "qZk+NkcGgWq6PiVxeFDCbJzQ2J0=");
+    assert(Util::Base64Encode(Util::Sha1("")) == "2jmj7l5rSw0yVb/vlWAYkK/YBwk=");
+    assert(WebSocket::AcceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    // 向量化去掩码与逐字节结果一致(各种长度与起始相位)
+    unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    for (size_t len = 0; len < 300; len += 7)
+    {
+        for (size_t phase = 0; phase < 4; phase++)
+        {
+            std::string data(len, 0), expect(len, 0);
+            for (size_t i = 0; i < len; i++)
+            {
+                data[i] = (char)rand();
+                expect[i] = (char)(data[i] ^ mask[(phase + i) & 3]);
+            }
+            WebSocket::Unmask(&data[0], len, mask, phase);
+            assert(data == expect);
+        }
+    }
+    assert(Util::ValidUtf8("hello", 5));
+    assert(Util::ValidUtf8("\xe4\xbd\xa0\xe5\xa5\xbd", 6));
+    assert(Util::ValidUtf8("\xf0\x9f\x98\x80", 4));
+    assert(!Util::ValidUtf8("\xc0\xaf", 2));             // 过长编码
+    assert(!Util::ValidUtf8("\xed\xa0\x80", 3));         // 代理区
+    assert(!Util::ValidUtf8("\xe4\xbd", 2));             // 截断
+    assert(!Util::ValidUtf8("\xf4\x90\x80\x80", 4));     // 超出 U+10FFFF
+    std::string ascii(100, 'a');
+    ascii[77] = (char)0xff;
+    assert(!Util::ValidUtf8(ascii.data(), ascii.size())); // 快速路径之后的非法字节
+
+    std::thread([]() {
+        HttpServer server(WS_PORT, "127.0.0.1");
+        server.SetThreadCount(2);
+        WebSocketOptions echo_opts;
+        echo_opts.max_message = 1024 * 1024;
+        echo_opts.protocols = {"chat"};
+        server.WebSocketRoute("/echo", [](const HttpRequest &, const std::shared_ptr<WebSocket> &ws) {
+            WebSocket *w = ws.get();
+            ws->OnMessage([w](const char *data, size_t len, bool binary) {
+                if (len == 5 && memcmp(data, "close", 5) == 0)
+                    return w->Close(WS_CLOSE_NORMAL, "bye");
+                if (len == 4 && memcmp(data, "frag", 4) == 0)
+                {
+                    w->SendFragment("ab", 2, false, false);
+                    w->SendFragment("cd", 2, false, true);
+                    return;
+                }
+                w->Send(data, len, binary);
+            });
+            ws->OnClose([](uint16_t code, const std::string &reason) { g_ws_close_code = code; });
+        }, echo_opts);
+        WebSocketOptions ping_opts;
+        ping_opts.ping_interval = 1;
+        server.WebSocketRoute("/ping", [](const HttpRequest &, const std::shared_ptr<WebSocket> &) {}, ping_opts);
+        server.WebSocketRoute("/room", [](const HttpRequest &, const std::shared_ptr<WebSocket> &ws) {
+            g_ws_group.Join(ws);
+        });
+        server.Get("/plain", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("plain", "text/plain");
+        });
+        server.Listen();
+    }).detach();
+
+    // 握手、子协议、回显(小/中/大帧)与分片消息
+    std::string rsp, payload;
+    int op;
+    int fd = WsConnect("/echo", &rsp, "Sec-WebSocket-Protocol: superchat, chat\r\n");
+    assert(rsp.find("HTTP/1.1 101 Switching Protocols\r\n") == 0);
+    assert(rsp.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    assert(rsp.find("Sec-WebSocket-Protocol: chat\r\n") != std::string::npos);
+    std::string mid(300, 'm'), big(70000, 0);
+    for (size_t i = 0; i < big.size(); i++)
+        big[i] = (char)i;
+    SendAll(fd, WsFrame(WS_TEXT, "hello") + WsFrame(WS_TEXT, mid) + WsFrame(WS_BINARY, big));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_TEXT && payload == "hello");
+    op = WsRecv(fd, &payload);
+    assert(op == WS_TEXT && payload == mid);
+    op = WsRecv(fd, &payload);
+    assert(op == WS_BINARY && payload == big);
+    // 分片之间插入 ping，控制帧立即回应
+    SendAll(fd, WsFrame(WS_TEXT, "hel", false) + WsFrame(WS_PING, "p") + WsFrame(WS_CONTINUATION, "lo ", false));
+    SendAll(fd, WsFrame(WS_CONTINUATION, "world"));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_PONG && payload == "p");
+    op = WsRecv(fd, &payload);
+    assert(op == WS_TEXT && payload == "hello world");
+    SendAll(fd, WsFrame(WS_TEXT, "frag"));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_TEXT && payload == "ab");
+    op = WsRecv(fd, &payload);
+    assert(op == WS_CONTINUATION && payload == "cd");
+    // 服务端发起关闭握手
+    SendAll(fd, WsFrame(WS_TEXT, "close"));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_CLOSE && payload == std::string("\x03\xe8" "bye", 5));
+    SendAll(fd, WsFrame(WS_CLOSE, std::string("\x03\xe8", 2)));
+    op = WsRecv(fd, &payload);
+    assert(op == -1);
+    close(fd);
+    WaitUntil([]() { return g_ws_close_code == WS_CLOSE_NORMAL; }, 1000);
+    std::cout << "websocket echo ok" << std::endl;
+
+    // 客户端发起关闭握手
+    fd = WsConnect("/echo", &rsp);
+    assert(rsp.find("Sec-WebSocket-Protocol") == std::string::npos);
+    SendAll(fd, WsFrame(WS_CLOSE, std::string("\x0f\xa0" "done", 6)));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_CLOSE && payload == std::string("\x0f\xa0", 2));
+    op = WsRecv(fd, &payload);
+    assert(op == -1);
+    close(fd);
+
+    // 协议错误：未加掩码、非法 UTF-8、超长消息、非法关闭码、分片控制帧
+    struct
+    {
+        std::string frame;
+        uint16_t code;
+    } cases[] = {
+        {std::string("\x81\x02hi", 4), WS_CLOSE_PROTOCOL_ERROR},
+        {WsFrame(WS_TEXT, "\xff\xfe"), WS_CLOSE_INVALID_DATA},
+        {WsFrame(WS_BINARY, std::string(1024 * 1024 + 1, 'x')).substr(0, 20), WS_CLOSE_TOO_BIG},
+        {WsFrame(WS_CLOSE, std::string("\x03\xec", 2)), WS_CLOSE_PROTOCOL_ERROR},
+        {WsFrame(WS_PING, "x", false), WS_CLOSE_PROTOCOL_ERROR},
+        {WsFrame(WS_CONTINUATION, "x"), WS_CLOSE_PROTOCOL_ERROR},
+        {WsFrame(3, "x"), WS_CLOSE_PROTOCOL_ERROR},
+        // 分片后跟 64 位长度的续帧：最高位为 1 是协议错误，否则按超长消息拒绝，长度不能回绕
+        {WsFrame(WS_TEXT, "x", false) + std::string("\x80\xff\xff\xff\xff\xff\xff\xff\xff\xff" "mask", 14),
+         WS_CLOSE_PROTOCOL_ERROR},
+        {WsFrame(WS_TEXT, "x", false) + std::string("\x80\xff\x7f\xff\xff\xff\xff\xff\xff\xff" "mask", 14),
+         WS_CLOSE_TOO_BIG},
+    };
+    for (auto &c : cases)
+    {
+        fd = WsConnect("/echo", &rsp);
+        SendAll(fd, c.frame);
+        op = WsRecv(fd, &payload);
+        assert(op == WS_CLOSE);
+        assert(payload.size() >= 2 && ((unsigned char)payload[0] << 8 | (unsigned char)payload[1]) == c.code);
+        op = WsRecv(fd, &payload);
+        assert(op == -1);
+        close(fd);
+    }
+    std::cout << "websocket protocol errors ok" << std::endl;
+
+    // 握手失败：缺少密钥回 400，版本不对回 426；没有 Upgrade 头的请求照常走普通路由
+    rsp = Fetch("GET /echo HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Version: 13\r\n\r\n", WS_PORT);
+    assert(rsp.find("HTTP/1.1 400") == 0);
+    rsp = Fetch("GET /echo HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 8\r\n\r\n",
+                WS_PORT);
+    assert(rsp.find("HTTP/1.1 426") == 0 && rsp.find("Sec-WebSocket-Version: 13\r\n") != std::string::npos);
+    rsp = Fetch("GET /plain HTTP/1.1\r\nConnection: close\r\n\r\n", WS_PORT);
+    assert(Body(rsp) == "plain");
+    std::cout << "websocket handshake errors ok" << std::endl;
+
+    // 心跳：空闲一个周期后收到 ping，回 pong 后连接保持，不回应则被断开
+    fd = WsConnect("/ping", &rsp);
+    op = WsRecv(fd, &payload);
+    assert(op == WS_PING);
+    SendAll(fd, WsFrame(WS_PONG, payload));
+    op = WsRecv(fd, &payload);
+    assert(op == WS_PING);
+    op = WsRecv(fd, &payload);
+    assert(op == -1);
+    close(fd);
+    std::cout << "websocket keepalive ok" << std::endl;
+
+    // 广播：连接分布在两个事件循环上，每条消息只序列化一次
+    const int clients = 4;
+    int fds[clients];
+    for (int i = 0; i < clients; i++)
+        fds[i] = WsConnect("/room", &rsp);
+    WaitUntil([&]() { return g_ws_group.Size() == clients; }, 1000);
+    g_ws_group.Broadcast("news-1");
+    g_ws_group.Broadcast(std::string("\x01\x02", 2), true);
+    for (int i = 0; i < clients; i++)
+    {
+        op = WsRecv(fds[i], &payload);
+        assert(op == WS_TEXT && payload == "news-1");
+        op = WsRecv(fds[i], &payload);
+        assert(op == WS_BINARY && payload == std::string("\x01\x02", 2));
+    }
+    close(fds[0]);
+    usleep(100 * 1000);
+    g_ws_group.Broadcast("news-2");
+    for (int i = 1; i < clients; i++)
+    {
+        op = WsRecv(fds[i], &payload);
+        assert(op == WS_TEXT && payload == "news-2");
+        close(fds[i]);
+    }
+    assert(g_ws_group.Size() == clients - 1 && g_ws_group.Dropped() == 0);
+    std::cout << "websocket broadcast ok" << std::endl;
+}
+
+int main()
+{
+    TestParse();
+    TestMetrics();
+    TestCacheLru();
+    TestCache();
+    TestStream();
+    TestCompress();
+    TestWebSocket();
+    std::cout << "all http tests passed" << std::endl;
+    return 0;
+}
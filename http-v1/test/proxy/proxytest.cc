@@ -0,0 +1,331 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/http/http.hpp"
+#include "../testutil.hpp"
+
+// 反向代理测试：大响应体/请求体经 splice 转发，chunked 与以关闭连接结束的响应，
+// 轮询与最少未完成请求的负载均衡，上游超时回 504、不可用回 502，与上游之间的长连接复用
+
+#define PROXY_PORT 18055
+#define BACKEND_A_PORT 18056
+#define BACKEND_B_PORT 18057
+#define RAW_PORT 18058
+#define SILENT_PORT 18059
+#define DOWN_PORT 18060
+
+std::shared_ptr<ReverseProxy> g_rr;
+std::shared_ptr<ReverseProxy> g_lp;
+std::shared_ptr<ReverseProxy> g_copy;
+std::shared_ptr<ReverseProxy> g_raw;
+std::shared_ptr<ReverseProxy> g_silent;
+std::shared_ptr<ReverseProxy> g_down;
+std::atomic<int> g_raw_connections(0);
+
+std::string Pattern(size_t size)
+{
+    std::string body(size, 0);
+    for (size_t i = 0; i < size; i++)
+        body[i] = 'a' + i % 26;
+    return body;
+}
+
+// 发送请求(可以是多个流水线请求)并读到连接关闭
+std::string Fetch(const std::string &request)
+{
+    int fd = Connect(PROXY_PORT);
+    SendAll(fd, request);
+    return RecvAll(fd);
+}
+
+std::string Body(const std::string &rsp)
+{
+    return rsp.substr(rsp.find("\r\n\r\n") + 4);
+}
+
+std::string Dechunk(const std::string &body)
+{
+    std::string out;
+    size_t pos = 0;
+    while (true)
+    {
+        size_t eol = body.find("\r\n", pos);
+        assert(eol != std::string::npos);
+        size_t len = strtoul(body.c_str() + pos, nullptr, 16);
+        if (len == 0)
+            break;
+        out.append(body, eol + 2, len);
+        pos = eol + 2 + len + 2;
+    }
+    return out;
+}
+
+size_t Count(const std::string &s, const std::string &token)
+{
+    size_t n = 0;
+    for (size_t pos = s.find(token); pos != std::string::npos; pos = s.find(token, pos + 1))
+        n++;
+    return n;
+}
+
+void StartBackend(uint16_t port, const std::string &name)
+{
+    std::thread([port, name]() {
+        HttpServer server(port, "127.0.0.1");
+        server.SetThreadCount(2);
+        server.Get(".*/who", [name](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent(name, "text/plain");
+        });
+        server.Get(".*/slow", [name](const HttpRequest &, HttpResponse *rsp) {
+            usleep(800 * 1000);
+            rsp->SetContent(name, "text/plain");
+        });
+        server.Get(".*/big", [](const HttpRequest &req, HttpResponse *rsp) {
+            rsp->SetContent(Pattern(std::stoul(req.GetParam("size"))), "application/octet-stream");
+        });
+        server.Post(".*/echo", [](const HttpRequest &req, HttpResponse *rsp) {
+            rsp->SetContent(req._body, "application/octet-stream");
+        });
+        // 流式上传：请求体(可以是 chunked)收齐后原样返回
+        server.Stream("POST", ".*/upload", [](const HttpRequest &, const std::shared_ptr<HttpStream> &stream) {
+            HttpStream *s = stream.get();
+            std::shared_ptr<std::string> body = std::make_shared<std::string>();
+            stream->OnData([body](const char *data, size_t len) { body->append(data, len); });
+            stream->OnEnd([s, body]() {
+                s->Write(*body);
+                s->End();
+            });
+        });
+        server.Stream("GET", ".*/chunked", [](const HttpRequest &, const std::shared_ptr<HttpStream> &stream) {
+            for (int i = 0; i < 10; i++)
+                stream->Write("chunk-" + std::to_string(i) + ";");
+            stream->End();
+        });
+        server.Listen();
+    }).detach();
+}
+
+// 原始 HTTP 后端：把收到的请求头作为响应体回显(长连接)；路径含 /uc/ 时以 HTTP/1.0 无长度响应并关闭连接
+void StartRawBackend()
+{
+    std::thread([]() {
+        TcpServer server(RAW_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetConnectedCallBack([](Connection *conn) { g_raw_connections++; });
+        server.SetMessageCallBack([](Connection *conn, Buffer *buf) {
+            while (conn->Connected())
+            {
+                const char *begin = buf->ReadPos();
+                const char *end = (const char *)memmem(begin, buf->ReadAbleSize(), "\r\n\r\n", 4);
+                if (end == nullptr)
+                    return;
+                std::string head(begin, end + 4 - begin);
+                buf->MoveReadOffset(head.size());
+                if (head.find(" /uc/") != std::string::npos)
+                {
+                    std::string rsp = "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\n" + Pattern(300 * 1024);
+                    conn->Send(rsp.data(), rsp.size());
+                    buf->MoveReadOffset(buf->ReadAbleSize());
+                    return conn->Shutdown();
+                }
+                std::string rsp = "HTTP/1.1 200 OK\r\nKeep-Alive: timeout=5\r\nContent-Length: " +
+                                  std::to_string(head.size()) + "\r\n\r\n" + head;
+                conn->Send(rsp.data(), rsp.size());
+            }
+        });
+        server.Start();
+    }).detach();
+}
+
+// 只接受连接从不响应的后端
+void StartSilentBackend()
+{
+    std::thread([]() {
+        TcpServer server(SILENT_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetMessageCallBack([](Connection *conn, Buffer *buf) {
+            buf->MoveReadOffset(buf->ReadAbleSize());
+        });
+        server.Start();
+    }).detach();
+}
+
+void StartProxy()
+{
+    g_rr = std::make_shared<ReverseProxy>();
+    g_rr->AddUpstream("127.0.0.1", BACKEND_A_PORT);
+    g_rr->AddUpstream("127.0.0.1", BACKEND_B_PORT);
+    ProxyOptions lp_opts;
+    lp_opts.balance = BALANCE_LEAST_PENDING;
+    g_lp = std::make_shared<ReverseProxy>(lp_opts);
+    g_lp->AddUpstream("127.0.0.1", BACKEND_A_PORT);
+    g_lp->AddUpstream("127.0.0.1", BACKEND_B_PORT);
+    ProxyOptions copy_opts;
+    copy_opts.splice = false;
+    g_copy = std::make_shared<ReverseProxy>(copy_opts);
+    g_copy->AddUpstream("127.0.0.1", BACKEND_A_PORT, 90); // 超时长于时间轮一圈
+    g_raw = std::make_shared<ReverseProxy>();
+    g_raw->AddUpstream("127.0.0.1", RAW_PORT);
+    g_silent = std::make_shared<ReverseProxy>();
+    g_silent->AddUpstream("127.0.0.1", SILENT_PORT, 1);
+    g_down = std::make_shared<ReverseProxy>();
+    g_down->AddUpstream("127.0.0.1", DOWN_PORT);
+    std::thread([]() {
+        HttpServer server(PROXY_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.Proxy("/rr/.*", g_rr);
+        server.Proxy("/lp/.*", g_lp);
+        server.Proxy("/copy/.*", g_copy);
+        server.Proxy("/(raw|uc)/.*", g_raw);
+        server.Proxy("/silent/.*", g_silent);
+        server.Proxy("/down/.*", g_down);
+        server.Get("/local", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("local", "text/plain");
+        });
+        server.Listen();
+    }).detach();
+}
+
+void TestSplice()
+{
+    // 大响应体：头部经缓冲区，正文经管道
+    size_t size = 4 * 1024 * 1024 + 123;
+    std::string rsp = Fetch("GET /rr/big?size=" + std::to_string(size) + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 200") == 0);
+    assert(rsp.find("Connection: close") != std::string::npos);
+    assert(Body(rsp) == Pattern(size));
+    assert(g_rr->SplicedBytes() > 0);
+    // 大请求体：客户端 -> 管道 -> 上游，回显后再经管道回到客户端
+    uint64_t spliced = g_rr->SplicedBytes();
+    std::string body = Pattern(1024 * 1024 + 7);
+    rsp = Fetch("POST /rr/echo HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) +
+                "\r\nConnection: close\r\n\r\n" + body);
+    assert(rsp.find("HTTP/1.1 200") == 0);
+    assert(Body(rsp) == body);
+    assert(g_rr->SplicedBytes() - spliced >= 2 * (body.size() - 64 * 1024));
+    // 关闭 splice 时全部经用户态拷贝，结果相同
+    rsp = Fetch("GET /copy/big?size=" + std::to_string(size) + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(Body(rsp) == Pattern(size));
+    assert(g_copy->SplicedBytes() == 0 && g_copy->CopiedBytes() >= size);
+    std::cout << "splice ok" << std::endl;
+}
+
+void TestFraming()
+{
+    // chunked 响应原样转发
+    std::string rsp = Fetch("GET /rr/chunked HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("Transfer-Encoding: chunked") != std::string::npos);
+    std::string expect;
+    for (int i = 0; i < 10; i++)
+        expect += "chunk-" + std::to_string(i) + ";";
+    assert(Dechunk(Body(rsp)) == expect);
+    // chunked 请求体
+    std::string req = "POST /rr/upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"
+                      "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\n";
+    rsp = Fetch(req);
+    assert(Dechunk(Body(rsp)) == "hello world");
+    // chunked 是最后一个编码时按 chunked 分帧，同时出现的 Content-Length 不参与分帧也不转发
+    req = "POST /rr/upload HTTP/1.1\r\ntransfer-encoding: gzip, chunked\r\nContent-Length: 3\r\nConnection: close\r\n\r\n"
+          "5\r\nhello\r\n0\r\n\r\n";
+    rsp = Fetch(req);
+    assert(rsp.find("HTTP/1.1 200") == 0 && Dechunk(Body(rsp)) == "hello");
+    // 无法确定请求体边界的编码回 501，重复的 Content-Length 回 400，都不转发
+    rsp = Fetch("POST /rr/upload HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n5\r\nhello\r\n0\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 501") == 0);
+    rsp = Fetch("POST /rr/upload HTTP/1.1\r\nContent-Length: 5\r\ncontent-length: 6\r\n\r\nhello!");
+    assert(rsp.find("HTTP/1.1 400") == 0);
+    // 以关闭连接结束的响应：客户端连接随之关闭
+    rsp = Fetch("GET /uc/data HTTP/1.1\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 200") == 0);
+    assert(rsp.find("Connection: close") != std::string::npos);
+    assert(Body(rsp) == Pattern(300 * 1024));
+    // 逐跳头部去掉，追加 X-Forwarded-For，与上游之间为长连接
+    rsp = Fetch("GET /raw/head?x=1 HTTP/1.1\r\nHost: test\r\nConnection: close, X-Hop\r\nX-Hop: 1\r\n"
+                "X-Forwarded-For: 10.0.0.1\r\n\r\n");
+    std::string head = Body(rsp);
+    assert(head.find("GET /raw/head?x=1 HTTP/1.1\r\n") == 0);
+    assert(head.find("Host: test\r\n") != std::string::npos);
+    assert(head.find("X-Hop") == std::string::npos);
+    assert(head.find("X-Forwarded-For: 10.0.0.1, 127.0.0.1\r\n") != std::string::npos);
+    assert(head.find("Connection: keep-alive\r\n") != std::string::npos);
+    assert(rsp.find("Keep-Alive: timeout") == std::string::npos); // 响应中的逐跳头部同样去掉
+    std::cout << "framing ok" << std::endl;
+}
+
+void TestBalance()
+{
+    // 轮询：同一连接上的连续请求依次落到两个上游
+    std::string req;
+    for (int i = 0; i < 4; i++)
+        req += "GET /rr/who HTTP/1.1\r\n" + std::string(i == 3 ? "Connection: close\r\n" : "") + "\r\n";
+    std::string rsp = Fetch(req);
+    assert(Count(rsp, "backend-A") == 2 && Count(rsp, "backend-B") == 2);
+    size_t first = rsp.find("backend-");
+    size_t second = rsp.find("backend-", first + 1);
+    assert(rsp[first + 8] != rsp[second + 8]);
+    // 最少未完成请求：一个慢请求占着某个上游时，其他请求都落到另一个上游
+    std::string slow_rsp;
+    std::thread slow([&slow_rsp]() { slow_rsp = Fetch("GET /lp/slow HTTP/1.1\r\nConnection: close\r\n\r\n"); });
+    WaitUntil([]() { return g_lp->Pending(0) + g_lp->Pending(1) != 0; }, 500);
+    assert(g_lp->Pending(0) + g_lp->Pending(1) == 1);
+    std::string busy = g_lp->Pending(0) ? "backend-A" : "backend-B";
+    req.clear();
+    for (int i = 0; i < 4; i++)
+        req += "GET /lp/who HTTP/1.1\r\n" + std::string(i == 3 ? "Connection: close\r\n" : "") + "\r\n";
+    rsp = Fetch(req);
+    assert(Count(rsp, "backend-") == 4 && Count(rsp, busy) == 0);
+    slow.join();
+    assert(Body(slow_rsp) == busy);
+    assert(g_lp->Pending(0) == 0 && g_lp->Pending(1) == 0);
+    std::cout << "balance ok" << std::endl;
+}
+
+void TestFailures()
+{
+    // 上游不可用：502；同一连接上的后续请求照常处理
+    std::string rsp = Fetch("GET /down/x HTTP/1.1\r\n\r\nGET /local HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 502") == 0);
+    assert(Body(rsp).find("HTTP/1.1 200") != std::string::npos && rsp.find("local") != std::string::npos);
+    assert(g_down->Failures() == 1);
+    // 上游不响应：按该上游的超时回 504
+    uint64_t start = MonotonicMicros();
+    rsp = Fetch("GET /silent/x HTTP/1.1\r\nConnection: close\r\n\r\n");
+    assert(rsp.find("HTTP/1.1 504") == 0);
+    assert(MonotonicMicros() - start >= 900000);
+    assert(g_silent->Timeouts() == 1);
+    std::cout << "failures ok" << std::endl;
+}
+
+void TestKeepAlive()
+{
+    // 与上游之间的连接在请求间复用：/uc/ 用掉一个上游连接，之后所有客户端连接上的请求都复用第二个
+    for (int k = 0; k < 2; k++)
+    {
+        std::string req;
+        for (int i = 0; i < 3; i++)
+            req += "GET /raw/ka" + std::to_string(i) + " HTTP/1.1\r\n" + (i == 2 ? "Connection: close\r\n" : "") + "\r\n";
+        std::string rsp = Fetch(req);
+        assert(Count(rsp, "HTTP/1.1 200") == 3);
+        assert(rsp.find("GET /raw/ka2 ") != std::string::npos);
+    }
+    assert(g_raw_connections == 2);
+    std::cout << "keepalive ok" << std::endl;
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    StartBackend(BACKEND_A_PORT, "backend-A");
+    StartBackend(BACKEND_B_PORT, "backend-B");
+    StartRawBackend();
+    StartSilentBackend();
+    StartProxy();
+    usleep(100 * 1000);
+    TestSplice();
+    TestFraming();
+    TestBalance();
+    TestFailures();
+    TestKeepAlive();
+    std::cout << "==== Proxy Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/rpc/rpc.hpp"
+#include "../testutil.hpp"
+
+// RPC 层测试：长度字段编解码、流水线请求的批量回复、帧被拆分到达、单向消息、超长帧、自定义编解码器
+
+#define RPC_PORT 18048
+#define LINE_PORT 18049
+
+// 读取 len 字节，连接关闭时返回已读到的部分
+std::string RecvSome(int fd, size_t len)
+{
+    std::string out(len, 0);
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = recv(fd, &out[got], len - got, 0);
+        if (n <= 0)
+            break;
+        got += n;
+    }
+    out.resize(got);
+    return out;
+}
+
+std::string Frame32(const std::string &body)
+{
+    Buffer buf;
+    buf.WriteString(body);
+    LengthFieldCodec codec;
+    codec.Encode(&buf);
+    return buf.ReadAsString(buf.ReadAbleSize());
+}
+
+std::string RecvFrame32(int fd)
+{
+    std::string head = RecvSome(fd, 4);
+    if (head.size() < 4)
+        return "<closed>";
+    uint32_t len = (unsigned char)head[0] << 24 | (unsigned char)head[1] << 16 | (unsigned char)head[2] << 8 | (unsigned char)head[3];
+    return RecvSome(fd, len);
+}
+
+void TestCodec()
+{
+    int sizes[] = {1, 2, 4, 8};
+    for (int size : sizes)
+    {
+        LengthFieldCodec codec(size, 100);
+        Buffer buf;
+        buf.WriteString("hello");
+        codec.Encode(&buf);
+        assert(buf.ReadAbleSize() == size + 5u);
+        std::string wire = buf.ReadAsString(buf.ReadAbleSize());
+
+        // 逐字节到达：完整之前都是 INCOMPLETE，读指针不动
+        Frame frame;
+        for (size_t i = 0; i < wire.size(); i++)
+        {
+            buf.WriteString(wire.substr(i, 1));
+            FrameStatu statu = codec.Decode(&buf, &frame);
+            assert(statu == (i + 1 == wire.size() ? FRAME_COMPLETE : FRAME_INCOMPLETE));
+        }
+        assert(std::string(frame.body, frame.body_len) == "hello");
+        assert(frame.body == buf.ReadPos() + size); // 指向缓冲区，不拷贝
+        assert(frame.frame_len == wire.size());
+
+        // 超过上限
+        Buffer big;
+        big.WriteString(std::string(101, 'x'));
+        codec.Encode(&big);
+        FrameStatu statu = codec.Decode(&big, &frame);
+        assert(statu == FRAME_ERROR);
+    }
+    std::cout << "codec ok" << std::endl;
+}
+
+void TestRpcServer()
+{
+    std::thread([]() {
+        RpcServer server(RPC_PORT, "127.0.0.1");
+        server.SetThreadCount(2);
+        server.SetCodec(std::make_shared<LengthFieldCodec>(4, 1024 * 1024));
+        server.SetHandler([](Connection *conn, const char *data, size_t len, Buffer *reply) {
+            std::string req(data, len);
+            if (req == "oneway")
+                return RPC_NO_REPLY;
+            if (req == "bye")
+                return RPC_CLOSE;
+            reply->WriteString(std::string(req.rbegin(), req.rend()));
+            return RPC_REPLY;
+        });
+        server.Start();
+    }).detach();
+
+    // 流水线：1000 个请求一次发出，回复按顺序返回；单向消息没有回复，空请求得到空回复
+    int fd = Connect(RPC_PORT);
+    std::string wire;
+    for (int i = 0; i < 1000; i++)
+    {
+        wire += Frame32("req-" + std::to_string(i));
+        if (i % 100 == 0)
+            wire += Frame32("oneway") + Frame32("");
+    }
+    SendAll(fd, wire);
+    for (int i = 0; i < 1000; i++)
+    {
+        std::string expect = "req-" + std::to_string(i);
+        std::string reply = RecvFrame32(fd);
+        assert(reply == std::string(expect.rbegin(), expect.rend()));
+        if (i % 100 == 0)
+        {
+            reply = RecvFrame32(fd);
+            assert(reply == "");
+        }
+    }
+    std::cout << "pipelined rpc ok" << std::endl;
+
+    // 一帧被拆成多段到达，大帧跨越多次读取
+    std::string big(300 * 1024, 0);
+    for (size_t i = 0; i < big.size(); i++)
+        big[i] = (char)(i * 13);
+    std::string frame = Frame32(big);
+    SendAll(fd, frame.substr(0, 3));
+    usleep(20 * 1000);
+    SendAll(fd, frame.substr(3));
+    std::string reply = RecvFrame32(fd);
+    assert(reply == std::string(big.rbegin(), big.rend()));
+    std::cout << "split frame ok" << std::endl;
+
+    // 处理函数要求关闭连接：本批次中的回复仍然送达，之后的帧不再处理
+    SendAll(fd, Frame32("ab") + Frame32("bye") + Frame32("cd"));
+    reply = RecvFrame32(fd);
+    assert(reply == "ba");
+    reply = RecvFrame32(fd);
+    assert(reply == "");
+    reply = RecvFrame32(fd);
+    assert(reply == "<closed>");
+    close(fd);
+
+    // 超长帧关闭连接
+    fd = Connect(RPC_PORT);
+    SendAll(fd, Frame32("ok") + std::string("\x7f\x00\x00\x00", 4));
+    reply = RecvFrame32(fd);
+    assert(reply == "ko");
+    reply = RecvFrame32(fd);
+    assert(reply == "<closed>");
+    close(fd);
+    std::cout << "bad frame ok" << std::endl;
+}
+
+// 自定义编解码器：以换行分隔的文本帧
+class LineCodec : public FrameCodec
+{
+public:
+    virtual FrameStatu Decode(Buffer *buf, Frame *frame)
+    {
+        char *eol = buf->FindCRLF();
+        if (eol == nullptr)
+            return buf->ReadAbleSize() > 1024 ? FRAME_ERROR : FRAME_INCOMPLETE;
+        frame->body = buf->ReadPos();
+        frame->body_len = eol - buf->ReadPos();
+        frame->frame_len = frame->body_len + 1;
+        return FRAME_COMPLETE;
+    }
+    virtual void Encode(Buffer *buf)
+    {
+        buf->WriteString("\n");
+    }
+};
+
+void TestCustomCodec()
+{
+    std::thread([]() {
+        RpcServer server(LINE_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.SetCodec(std::make_shared<LineCodec>());
+        server.SetHandler([](Connection *conn, const char *data, size_t len, Buffer *reply) {
+            reply->WriteString("echo:");
+            reply->Write(data, len);
+            return RPC_REPLY;
+        });
+        server.Start();
+    }).detach();
+
+    int fd = Connect(LINE_PORT);
+    SendAll(fd, "a\nbb\nc");
+    std::string reply = RecvSome(fd, 15);
+    assert(reply == "echo:a\necho:bb\n");
+    SendAll(fd, "cc\n");
+    reply = RecvSome(fd, 9);
+    assert(reply == "echo:ccc\n");
+    close(fd);
+    std::cout << "custom codec ok" << std::endl;
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    TestCodec();
+    TestRpcServer();
+    TestCustomCodec();
+    std::cout << "==== Rpc Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/http/http.hpp"
+#include "../testutil.hpp"
+
+// 优雅关闭测试：时间轮定时任务；关闭时空闲长连接立即关闭、处理中的请求写完响应后关闭、
+// 卡住的连接在期限到达时强制关闭、Start 返回；监听套接字交给新服务器后由新服务器继续 accept
+
+#define HTTP_PORT 18039
+#define HANDOFF_PORT 18040
+#define HANDOFF_PATH "/tmp/shutdowntest.sock"
+
+uint64_t NowMs()
+{
+    return MonotonicMicros() / 1000;
+}
+
+// 读到包含 end 为止
+std::string RecvUntil(int fd, const std::string &end)
+{
+    std::string rsp;
+    char tmp[4096];
+    while (rsp.find(end) == std::string::npos)
+    {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        assert(n > 0);
+        rsp.append(tmp, n);
+    }
+    return rsp;
+}
+
+void TestTimer()
+{
+    EventLoop *loop = nullptr;
+    std::atomic<int> fired(0);
+    std::thread t([&]() {
+        EventLoop l;
+        loop = &l;
+        l.Loop();
+    });
+    WaitUntil([&]() { return loop != nullptr; });
+    uint64_t begin = NowMs();
+    std::atomic<uint64_t> at(0);
+    loop->RunAfter(1, [&]() { at = NowMs(); fired++; });
+    uint64_t id = loop->RunAfter(1, [&]() { fired += 100; });
+    loop->TimerCancel(id);
+    // 刷新推迟执行
+    loop->TimerAdd(7, 1, [&]() { fired += 10; });
+    usleep(500 * 1000);
+    loop->TimerRefresh(7);
+    WaitUntil([&]() { return fired == 11; });
+    assert(at - begin >= 500 && at - begin <= 2500);
+    // 超过一圈的延迟不回绕：61 秒不会在下一秒执行；循环销毁时还挂着的任务不执行
+    loop->RunAfter(TIMER_WHEEL_CAPACITY + 1, [&]() { fired += 1000; });
+    loop->TimerAdd(8, 2 * TIMER_WHEEL_CAPACITY, [&]() { fired += 1000; });
+    loop->TimerRefresh(8);
+    usleep(1500 * 1000);
+    assert(fired == 11);
+    loop->Quit();
+    t.join();
+    std::cout << "timer ok" << std::endl;
+}
+
+std::atomic<bool> g_release(false);
+
+void TestDrain()
+{
+    HttpServer *server = nullptr;
+    std::atomic<bool> returned(false);
+    std::thread t([&]() {
+        HttpServer s(HTTP_PORT, "127.0.0.1");
+        s.SetThreadCount(1);
+        s.SetComputePool(1);
+        s.Get("/fast", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("fast", "text/plain");
+        });
+        s.Get("/slow", [](const HttpRequest &, HttpResponse *rsp) {
+            while (!g_release)
+                usleep(1000);
+            rsp->SetContent("slow", "text/plain");
+        }, true);
+        server = &s;
+        s.Listen();
+        returned = true;
+    });
+    WaitUntil([&]() { return server != nullptr; });
+
+    // idle：完成一个请求后保持连接；busy：请求在计算线程池中；stuck：请求只发了一半
+    int idle = Connect(HTTP_PORT);
+    SendAll(idle, "GET /fast HTTP/1.1\r\n\r\n");
+    std::string ri = RecvUntil(idle, "fast");
+    assert(ri.find("Connection: keep-alive") != std::string::npos);
+    int busy = Connect(HTTP_PORT);
+    SendAll(busy, "GET /slow HTTP/1.1\r\n\r\n");
+    int stuck = Connect(HTTP_PORT);
+    SendAll(stuck, "GET /fast HTTP/1.1\r\nHost: x");
+    usleep(50 * 1000);
+
+    uint64_t begin = NowMs();
+    server->Shutdown(1);
+    ri = RecvAll(idle);
+    assert(ri.empty());
+    assert(NowMs() - begin < 500);
+    std::cout << "idle keep-alive closed" << std::endl;
+
+    g_release = true;
+    std::string rb = RecvAll(busy);
+    assert(rb.find("HTTP/1.1 200 OK\r\n") == 0);
+    assert(rb.find("Connection: close") != std::string::npos);
+    assert(rb.find("\r\n\r\nslow") != std::string::npos);
+    std::cout << "in-flight request completed" << std::endl;
+
+    std::string rs = RecvAll(stuck);
+    assert(rs.empty());
+    uint64_t cost = NowMs() - begin;
+    assert(cost >= 500 && cost <= 2500);
+    std::cout << "stuck connection force closed after " << cost << " ms" << std::endl;
+
+    WaitUntil([&]() { return returned.load(); });
+    t.join();
+    std::cout << "listen returned" << std::endl;
+}
+
+// 回显：响应带上服务器名字
+void StartEcho(TcpServer *server, const std::string &name)
+{
+    server->SetThreadCount(1);
+    server->SetMessageCallBack([name](Connection *conn, Buffer *buf) {
+        std::string data = buf->ReadAsString(buf->ReadAbleSize());
+        std::string rsp = name + ":" + data;
+        conn->Send(rsp.data(), rsp.size());
+    });
+    server->Start();
+}
+
+std::string Ask(int fd, const std::string &msg)
+{
+    SendAll(fd, msg);
+    char tmp[256];
+    ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+    assert(n > 0);
+    return std::string(tmp, n);
+}
+
+void TestHandoff()
+{
+    std::atomic<bool> old_returned(false);
+    std::thread old_t([&]() {
+        TcpServer old_server(HANDOFF_PORT, "127.0.0.1");
+        old_server.EnableHandoff(HANDOFF_PATH, 1);
+        StartEcho(&old_server, "old");
+        old_returned = true;
+    });
+    int a = Connect(HANDOFF_PORT);
+    std::string reply = Ask(a, "1");
+    assert(reply == "old:1");
+
+    int fd = TcpServer::TakeOverListenFd(HANDOFF_PATH);
+    assert(fd >= 0);
+    std::thread new_t([&]() {
+        TcpServer new_server((ListenFd(fd)));
+        StartEcho(&new_server, "new");
+    });
+    // 旧服务器的空闲连接被关闭，Start 返回
+    reply = RecvAll(a);
+    assert(reply.empty());
+    WaitUntil([&]() { return old_returned.load(); });
+    old_t.join();
+    // 监听套接字仍然打开，新连接由新服务器处理
+    int b = Connect(HANDOFF_PORT);
+    reply = Ask(b, "2");
+    assert(reply == "new:2");
+    close(b);
+    new_t.detach();
+    std::cout << "handoff ok" << std::endl;
+}
+
+int main()
+{
+    TestTimer();
+    TestDrain();
+    TestHandoff();
+    std::cout << "==== Shutdown Test All Passed ====" << std::endl;
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <iostream>
+#include <string>
+#include <future>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// 地址族测试：SockAddr 的解析与格式化，IPv6 双栈/仅 IPv6 监听，Unix 文件路径(含遗留文件清理)
+// 与抽象命名空间监听，SO_PEERCRED，以及 TcpClient 连接 Unix 套接字
+
+#define DUAL_PORT 18061
+#define V6ONLY_PORT 18062
+#define UNIX_PATH "/tmp/familytest.sock"
+
+void TestParse()
+{
+    SockAddr v4("127.0.0.1", 80);
+    assert(v4.Valid() && v4.Family() == AF_INET && v4.Port() == 80 && v4.Len() == sizeof(sockaddr_in));
+    assert(v4.ToString() == "127.0.0.1:80");
+    SockAddr v6("::1", 8080);
+    assert(v6.Valid() && v6.Family() == AF_INET6 && v6.Port() == 8080);
+    assert(v6.ToString() == "[::1]:8080");
+    assert(SockAddr("[fe80::1]", 1).Ip() == "fe80::1");
+    SockAddr path("unix:/run/app.sock", 0);
+    assert(path.Family() == AF_UNIX && !path.Abstract() && path.Path() == "/run/app.sock");
+    assert(path.ToString() == "unix:/run/app.sock");
+    SockAddr abstract = SockAddr::Unix("@app");
+    assert(abstract.Family() == AF_UNIX && abstract.Abstract() && abstract.Path() == "@app");
+    assert(abstract.Len() == offsetof(sockaddr_un, sun_path) + 4); // 长度不含结尾的 '\0'
+    assert(!SockAddr("localhost", 80).Valid());
+    assert(!SockAddr("1.2.3", 80).Valid());
+    assert(!SockAddr("unix:", 0).Valid());
+    assert(!SockAddr::Unix(std::string(200, 'x')).Valid());
+    assert(SockAddr().Family() == AF_UNSPEC);
+    // Unix 套接字去掉 TCP 层的选项，其余不变
+    SocketOptions opts = SocketOptions::LowLatencyRpc().ForFamily(AF_UNIX);
+    assert(!opts.tcp_nodelay && !opts.tcp_quickack && opts.defer_accept < 0 && opts.notsent_lowat < 0);
+    opts = SocketOptions::BulkTransfer().ForFamily(AF_UNIX);
+    assert(opts.rcvbuf == 4 * 1024 * 1024);
+    assert(SocketOptions::LowLatencyRpc().ForFamily(AF_INET6).tcp_nodelay);
+    std::cout << "parse ok" << std::endl;
+}
+
+// 回显服务器：每个连接先发回 "<对端地址> <对端 pid>\n"，之后原样回显
+void StartServer(const SockAddr &addr, const SocketOptions &opts = SocketOptions())
+{
+    std::promise<void> ready;
+    std::thread([&]() {
+        TcpServer server(addr, opts);
+        server.SetThreadCount(1);
+        server.SetConnectedCallBack([](Connection *conn) {
+            struct ucred cred;
+            memset(&cred, 0, sizeof(cred));
+            if (conn->PeerAddress().Family() == AF_UNIX)
+            {
+                bool ok = conn->PeerCred(&cred);
+                assert(ok);
+            }
+            std::string hello = conn->PeerAddress().ToString() + " " + std::to_string(cred.pid) + "\n";
+            conn->Send(hello.data(), hello.size());
+        });
+        server.SetMessageCallBack([](Connection *conn, Buffer *buf) {
+            conn->Send(buf->ReadPos(), buf->ReadAbleSize());
+            buf->MoveReadOffset(buf->ReadAbleSize());
+        });
+        ready.set_value();
+        server.Start();
+    }).detach();
+    ready.get_future().wait();
+}
+
+// 阻塞连接，返回服务器的问候行并检查回显；连接失败返回空串
+std::string Hello(const SockAddr &addr)
+{
+    Socket sock;
+    bool created = sock.CreateSocket(addr.Family());
+    assert(created);
+    if (connect(sock.GetFd(), addr.Addr(), addr.Len()) < 0)
+        return "";
+    std::string line;
+    char c;
+    while (line.empty() || line.back() != '\n')
+    {
+        ssize_t n = recv(sock.GetFd(), &c, 1, 0);
+        assert(n == 1);
+        line += c;
+    }
+    ssize_t sent = send(sock.GetFd(), "ping", 4, 0);
+    assert(sent == 4);
+    char buf[4];
+    size_t got = 0;
+    while (got < 4)
+    {
+        ssize_t n = recv(sock.GetFd(), buf + got, 4 - got, 0);
+        assert(n > 0);
+        got += n;
+    }
+    assert(memcmp(buf, "ping", 4) == 0);
+    line.pop_back();
+    return line;
+}
+
+void TestInet()
+{
+    // 双栈：IPv4 客户端以映射地址 ::ffff:127.0.0.1 出现，Ip()/ToString() 还原为 IPv4
+    StartServer(SockAddr("::", DUAL_PORT));
+    std::string hello = Hello(SockAddr("127.0.0.1", DUAL_PORT));
+    assert(hello.compare(0, 10, "127.0.0.1:") == 0);
+    hello = Hello(SockAddr("::1", DUAL_PORT));
+    assert(hello.compare(0, 6, "[::1]:") == 0);
+    Socket probe;
+    bool connected = probe.CreateSocket(AF_INET6) && probe.Connect(SockAddr("::1", DUAL_PORT));
+    assert(connected);
+    assert(SockAddr::Local(probe.GetFd()).Ip() == "::1");
+    // 阻塞客户端按地址的协议族创建套接字
+    Socket client;
+    connected = client.CreateClient(DUAL_PORT, "::1");
+    assert(connected);
+    assert(SockAddr::Local(client.GetFd()).Family() == AF_INET6);
+    Socket invalid;
+    connected = invalid.CreateClient(DUAL_PORT, "localhost");
+    assert(!connected && invalid.GetFd() < 0);
+    // 仅 IPv6：IPv4 连接被拒绝
+    SocketOptions opts;
+    opts.ipv6_only = true;
+    StartServer(SockAddr("::", V6ONLY_PORT), opts);
+    hello = Hello(SockAddr("::1", V6ONLY_PORT));
+    assert(hello != "");
+    hello = Hello(SockAddr("127.0.0.1", V6ONLY_PORT));
+    assert(hello == "");
+    std::cout << "inet ok" << std::endl;
+}
+
+void TestUnix()
+{
+    // 上次运行遗留的套接字文件(没有进程在监听)在 bind 前被清理
+    unlink(UNIX_PATH);
+    {
+        Socket stale;
+        bool bound = stale.CreateSocket(AF_UNIX) && stale.Bind(SockAddr::Unix(UNIX_PATH));
+        assert(bound);
+    }
+    struct stat st;
+    int ret = stat(UNIX_PATH, &st);
+    assert(ret == 0 && S_ISSOCK(st.st_mode));
+    StartServer(SockAddr("unix:" UNIX_PATH, 0), SocketOptions::LowLatencyRpc());
+    std::string expect = "unix: " + std::to_string(getpid()); // 客户端一侧是未命名的套接字
+    std::string hello = Hello(SockAddr::Unix(UNIX_PATH));
+    assert(hello == expect);
+    // 正在使用的路径不会被删除，第二个监听者 bind 失败
+    Socket second;
+    bool listening = second.CreateServer(SockAddr::Unix(UNIX_PATH));
+    assert(!listening);
+    hello = Hello(SockAddr::Unix(UNIX_PATH));
+    assert(hello == expect);
+    // 阻塞客户端经字符串地址连接 Unix 套接字
+    Socket client;
+    bool connected = client.CreateClient(0, "unix:" UNIX_PATH);
+    assert(connected);
+    assert(SockAddr::Peer(client.GetFd()).Path() == UNIX_PATH);
+
+    // 抽象命名空间：不在文件系统中
+    std::string name = "@familytest-" + std::to_string(getpid());
+    StartServer(SockAddr::Unix(name));
+    hello = Hello(SockAddr::Unix(name));
+    assert(hello == expect);
+    ret = stat(name.c_str(), &st);
+    assert(ret < 0);
+    hello = Hello(SockAddr::Unix(name + "-missing"));
+    assert(hello == "");
+    std::cout << "unix ok" << std::endl;
+
+    // TcpClient 经字符串地址连接 Unix 套接字
+    LoopThread *thread = new LoopThread();
+    EventLoop *loop = thread->GetLoop();
+    std::promise<std::string> result;
+    std::shared_ptr<std::string> got = std::make_shared<std::string>();
+    loop->RunInLoop([&, loop, got]() {
+        TcpClient *client = new TcpClient(loop);
+        client->Connect("unix:" + name, 0, [&, got](Connection *conn) {
+            assert(conn != nullptr);
+            struct ucred cred;
+            bool ok = conn->PeerCred(&cred);
+            assert(ok && cred.pid == getpid() && cred.uid == getuid());
+            conn->SetMessageCallBack([&, got](Connection *c, Buffer *buf) {
+                got->append(buf->ReadAsString(buf->ReadAbleSize()));
+                if (got->find('\n') != std::string::npos)
+                {
+                    c->Shutdown();
+                    result.set_value(*got);
+                }
+            });
+        });
+    });
+    hello = result.get_future().get();
+    assert(hello == expect + "\n");
+    std::cout << "unix client ok" << std::endl;
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    TestParse();
+    TestInet();
+    TestUnix();
+    unlink(UNIX_PATH);
+    std::cout << "==== Address Family Test All Passed ====" << std::endl;
+    return 0;
+}
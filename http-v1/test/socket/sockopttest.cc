@@ -0,0 +1,104 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// 套接字调优配置测试：检查选项确实被应用，并在回环上测量每种配置的请求-响应延迟
+
+#define ROUNDS 20000
+#define MSG_SIZE 64
+
+int GetIntOpt(int fd, int level, int name)
+{
+    int val = 0;
+    socklen_t len = sizeof(val);
+    getsockopt(fd, level, name, &val, &len);
+    return val;
+}
+
+uint16_t LocalPort(Socket &sock)
+{
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(sock.GetFd(), (sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+// 阻塞读满 len 字节
+bool ReadFull(Socket &sock, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = sock.Recv(buf + got, len - got);
+        if (n < 0)
+            return false;
+        got += n;
+    }
+    return true;
+}
+
+void Measure(const char *name, const SocketOptions &opts)
+{
+    Socket lst;
+    bool listening = lst.CreateServer(0, "127.0.0.1", true, opts);
+    assert(listening);
+    uint16_t port = LocalPort(lst);
+
+    if (opts.defer_accept >= 0)
+        assert(GetIntOpt(lst.GetFd(), IPPROTO_TCP, TCP_DEFER_ACCEPT) > 0);
+
+    // 服务端线程：accept 后应用连接级配置，回显固定大小消息
+    std::thread svr([&]() {
+        Socket conn(lst.Accept(SOCK_CLOEXEC));
+        conn.ApplyOptions(opts, false);
+        if (opts.tcp_nodelay)
+            assert(GetIntOpt(conn.GetFd(), IPPROTO_TCP, TCP_NODELAY) == 1);
+        if (opts.notsent_lowat >= 0)
+            assert(GetIntOpt(conn.GetFd(), IPPROTO_TCP, TCP_NOTSENT_LOWAT) == opts.notsent_lowat);
+        if (opts.sndbuf >= 0)
+            assert(GetIntOpt(conn.GetFd(), SOL_SOCKET, SO_SNDBUF) >= opts.sndbuf);
+
+        char buf[MSG_SIZE];
+        while (ReadFull(conn, buf, sizeof(buf)))
+        {
+            if (opts.tcp_quickack)
+                conn.QuickAck();
+            conn.Send(buf, sizeof(buf));
+        }
+    });
+
+    Socket cli;
+    bool connected = cli.CreateClient(port, "127.0.0.1");
+    assert(connected);
+    cli.ApplyOptions(opts, false);
+    // TCP_DEFER_ACCEPT 下，客户端先发数据服务端才会 accept
+
+    std::vector<double> lat;
+    lat.reserve(ROUNDS);
+    char buf[MSG_SIZE] = {0};
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        cli.Send(buf, sizeof(buf));
+        bool echoed = ReadFull(cli, buf, sizeof(buf));
+        assert(echoed);
+        lat.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    cli.Close();
+    svr.join();
+
+    std::sort(lat.begin(), lat.end());
+    printf("[OK] %-16s p50=%.1fus p99=%.1fus p999=%.1fus\n", name,
+           lat[lat.size() / 2], lat[lat.size() * 99 / 100], lat[lat.size() * 999 / 1000]);
+}
+
+int main()
+{
+    std::cout << "==== SocketOptions Test Begin ====\n";
+    Measure("default", SocketOptions());
+    Measure("low-latency-rpc", SocketOptions::LowLatencyRpc());
+    Measure("bulk-transfer", SocketOptions::BulkTransfer());
+    std::cout << "==== SocketOptions Test All Passed ====\n";
+    return 0;
+}
@@ -9,7 +9,7 @@ int main()
     bool ret = sock.CreateServer(8080); // 不是进行通信的fd(是在饭店门口揽客的)
     while (1)
     {
-        int newfd = sock.Accept(); // accept上来的才是真正用来通信的(饭店里一桌一桌的进行服务)
+        int newfd = sock.Accept(SOCK_CLOEXEC); // accept上来的才是真正用来通信的(饭店里一桌一桌的进行服务)
         if (newfd < 0)
             continue;
 
@@ -0,0 +1,62 @@
+#pragma once
+// 测试公用的阻塞式辅助函数：连接本机端口、发送全部数据、读到对端关闭、轮询等待条件
+//   - 系统调用放在 assert 之外，只断言其结果，-DNDEBUG 编译时测试流程不变
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <functional>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// 连接 127.0.0.1:port；服务器线程可能还没开始监听，失败时每 20ms 重试一次，最多 100 次
+inline int Connect(uint16_t port)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (int i = 0;; i++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        assert(fd >= 0);
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        assert(i < 100);
+        usleep(20 * 1000);
+    }
+}
+
+// 阻塞发送，直到全部写出
+inline void SendAll(int fd, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        assert(n > 0);
+        sent += n;
+    }
+}
+
+// 读到对端关闭为止，然后关闭 fd
+inline std::string RecvAll(int fd)
+{
+    std::string rsp;
+    char tmp[65536];
+    ssize_t n;
+    while ((n = recv(fd, tmp, sizeof(tmp), 0)) > 0)
+        rsp.append(tmp, n);
+    close(fd);
+    return rsp;
+}
+
+// 每 2ms 检查一次条件，最多等待 ms 毫秒
+inline void WaitUntil(const std::function<bool()> &cond, int ms = 5000)
+{
+    for (int i = 0; i < ms / 2 && !cond(); i++)
+        usleep(2 * 1000);
+    assert(cond());
+}
@@ -0,0 +1,316 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <malloc.h>
+#include "../../source/http/http.hpp"
+#include "../../source/tls/tls.hpp"
+#include "../testutil.hpp"
+
+// TLS 测试：内存 BIO 驱动的握手与收发、流水线请求、大响应的背压、会话恢复(ticket 与会话 ID)、
+// close_notify、sendfile、非法握手；内核 TLS 不可用时自动回退到用户态加密
+
+#define HTTP_PORT 18044
+#define RAW_PORT 18045
+#define PLAIN_PORT 18046
+#define CERT_FILE "/tmp/tlstest.crt"
+#define KEY_FILE "/tmp/tlstest.key"
+
+// 阻塞式 TLS 客户端
+struct Client
+{
+    SSL *ssl;
+    int fd;
+
+    Client(SSL_CTX *ctx, uint16_t port, SSL_SESSION *session = nullptr)
+    {
+        fd = Connect(port);
+        ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, fd);
+        if (session)
+            SSL_set_session(ssl, session);
+        int ret = SSL_connect(ssl);
+        assert(ret == 1);
+    }
+    ~Client()
+    {
+        SSL_shutdown(ssl); // 未发送关闭通知的会话会被标记为不可恢复
+        SSL_free(ssl);
+        close(fd);
+    }
+    void Write(const std::string &data)
+    {
+        int n = SSL_write(ssl, data.data(), data.size());
+        assert(n == (int)data.size());
+    }
+    // 读到 close_notify 为止，clean 返回是否收到了关闭通知
+    std::string ReadAll(bool *clean = nullptr)
+    {
+        std::string out;
+        char tmp[16384];
+        int n;
+        while ((n = SSL_read(ssl, tmp, sizeof(tmp))) > 0)
+            out.append(tmp, n);
+        if (clean)
+            *clean = SSL_get_error(ssl, n) == SSL_ERROR_ZERO_RETURN;
+        return out;
+    }
+    // 读到包含 end 为止
+    std::string ReadUntil(const std::string &end)
+    {
+        std::string out;
+        char tmp[16384];
+        while (out.find(end) == std::string::npos)
+        {
+            int n = SSL_read(ssl, tmp, sizeof(tmp));
+            assert(n > 0);
+            out.append(tmp, n);
+        }
+        return out;
+    }
+};
+
+SSL_CTX *ClientContext(int max_version, bool tickets)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    SSL_CTX_set_max_proto_version(ctx, max_version);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT);
+    if (!tickets)
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    return ctx;
+}
+
+void TestExpandLabel()
+{
+    // RFC 8448 1-RTT 握手：服务端应用流量密钥推导出的 key/iv
+    unsigned char secret[32], key[16], iv[12];
+    const char *hex = "a11af9f05531f856ad47116b45a950328204b4f44bfb6b3a4b4f1f3fcb631643";
+    for (int i = 0; i < 32; i++)
+        sscanf(hex + 2 * i, "%2hhx", &secret[i]);
+    bool ok = TlsFilter::ExpandLabel(EVP_sha256(), secret, 32, "key", key, 16) &&
+              TlsFilter::ExpandLabel(EVP_sha256(), secret, 32, "iv", iv, 12);
+    assert(ok);
+    const unsigned char want_key[] = {0x9f, 0x02, 0x28, 0x3b, 0x6c, 0x9c, 0x07, 0xef, 0xc2, 0x6b, 0xb9, 0xf2, 0xac, 0x92, 0xe3, 0x56};
+    const unsigned char want_iv[] = {0xcf, 0x78, 0x2b, 0x88, 0xdd, 0x83, 0x54, 0x9a, 0xad, 0xf1, 0xe9, 0x84};
+    assert(memcmp(key, want_key, 16) == 0 && memcmp(iv, want_iv, 12) == 0);
+    std::cout << "expand label ok" << std::endl;
+}
+
+void TestHttps(TlsContext *tls)
+{
+    std::thread([tls]() {
+        HttpServer server(HTTP_PORT, "127.0.0.1");
+        server.SetThreadCount(1);
+        server.GetTcpServer().SetTransportFilterFactory(tls->Factory());
+        server.Get("/hello", [](const HttpRequest &, HttpResponse *rsp) {
+            rsp->SetContent("hello tls", "text/plain");
+        });
+        server.Get("/big", [](const HttpRequest &req, HttpResponse *rsp) {
+            std::string body(std::stoul(req.GetParam("size")), 0);
+            for (size_t i = 0; i < body.size(); i++)
+                body[i] = 'a' + i % 26;
+            rsp->SetContent(body, "application/octet-stream");
+        });
+        server.Listen();
+    }).detach();
+
+    SSL_CTX *ctx = ClientContext(TLS1_3_VERSION, true);
+    {
+        Client c(ctx, HTTP_PORT);
+        c.Write("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        bool clean = false;
+        std::string rsp = c.ReadAll(&clean);
+        assert(rsp.find("HTTP/1.1 200 OK") == 0 && rsp.find("\r\n\r\nhello tls") != std::string::npos);
+        assert(clean); // 服务端关闭前发送了 close_notify
+    }
+    std::cout << "https request ok" << std::endl;
+
+    // 两个请求在同一条记录中，响应按顺序返回
+    {
+        Client c(ctx, HTTP_PORT);
+        c.Write("GET /hello HTTP/1.1\r\n\r\nGET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        std::string rsp = c.ReadAll();
+        size_t first = rsp.find("hello tls");
+        assert(first != std::string::npos && rsp.find("hello tls", first + 1) != std::string::npos);
+    }
+    std::cout << "https pipeline ok" << std::endl;
+
+    // 大响应超过高水位，客户端慢读
+    {
+        size_t size = 16 * 1024 * 1024;
+        Client c(ctx, HTTP_PORT);
+        c.Write("GET /big?size=" + std::to_string(size) + " HTTP/1.1\r\nConnection: close\r\n\r\n");
+        usleep(200 * 1000);
+        std::string rsp = c.ReadAll();
+        std::string body = rsp.substr(rsp.find("\r\n\r\n") + 4);
+        assert(body.size() == size);
+        for (size_t i = 0; i < size; i += 4099)
+            assert(body[i] == (char)('a' + i % 26));
+    }
+    std::cout << "https big response ok" << std::endl;
+
+    // TLS1.3 ticket 恢复：ticket 在握手后到达，读完响应后取会话
+    SSL_SESSION *session;
+    {
+        Client c(ctx, HTTP_PORT);
+        c.Write("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        c.ReadAll();
+        session = SSL_get1_session(c.ssl);
+        assert(session != nullptr && SSL_SESSION_is_resumable(session));
+    }
+    uint64_t resumed = tls->Resumed();
+    {
+        Client c(ctx, HTTP_PORT, session);
+        assert(SSL_session_reused(c.ssl) == 1);
+        c.Write("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        std::string rsp = c.ReadAll();
+        assert(rsp.find("hello tls") != std::string::npos);
+    }
+    SSL_SESSION_free(session);
+    assert(tls->Resumed() == resumed + 1);
+    std::cout << "tls1.3 ticket resumption ok" << std::endl;
+    SSL_CTX_free(ctx);
+
+    // TLS1.2 不使用 ticket，按服务端会话缓存恢复
+    ctx = ClientContext(TLS1_2_VERSION, false);
+    {
+        Client c(ctx, HTTP_PORT);
+        assert(SSL_version(c.ssl) == TLS1_2_VERSION);
+        c.Write("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        c.ReadAll();
+        session = SSL_get1_session(c.ssl);
+    }
+    {
+        Client c(ctx, HTTP_PORT, session);
+        assert(SSL_session_reused(c.ssl) == 1);
+        c.Write("GET /hello HTTP/1.1\r\nConnection: close\r\n\r\n");
+        std::string rsp = c.ReadAll();
+        assert(rsp.find("hello tls") != std::string::npos);
+    }
+    SSL_SESSION_free(session);
+    SSL_CTX_free(ctx);
+    std::cout << "tls1.2 session cache resumption ok" << std::endl;
+
+    // 明文请求发到 TLS 端口：服务端回告警并关闭
+    int fd = Connect(HTTP_PORT);
+    SendAll(fd, "GET /hello HTTP/1.1\r\n\r\n");
+    std::string rsp = RecvAll(fd);
+    assert(rsp.find("hello tls") == std::string::npos);
+    assert(rsp.empty() || rsp[0] == 0x15); // 只可能是告警记录
+    std::cout << "plaintext rejected ok" << std::endl;
+}
+
+std::atomic<long> g_file_heap(0); // 最近一次 SendFile 调用期间堆内存的增长
+
+// TcpServer 层：回显与 sendfile
+void TestSendFile(TlsContext *tls)
+{
+    std::string content(3 * 1024 * 1024 + 123, 0);
+    for (size_t i = 0; i < content.size(); i++)
+        content[i] = (char)(i * 31 + i / 7);
+    char path[] = "/tmp/tlsfileXXXXXX";
+    int tmp = mkstemp(path);
+    assert(tmp >= 0);
+    ssize_t written = write(tmp, content.data(), content.size());
+    assert(written == (ssize_t)content.size());
+    close(tmp);
+    std::string file = path;
+
+    // 同一份处理逻辑分别跑在 TLS 与明文端口上，明文端口走 sendfile 数据块
+    auto serve = [tls, file, content](uint16_t port, bool secure) {
+        TcpServer server(port, "127.0.0.1");
+        if (secure)
+            server.SetTransportFilterFactory(tls->Factory());
+        server.SetMessageCallBack([file, content](Connection *conn, Buffer *buf) {
+            std::string cmd = buf->ReadAsString(buf->ReadAbleSize());
+            if (cmd == "file")
+            {
+                // 文件块前后都有普通数据，检查顺序
+                conn->Send("<", 1);
+                int fd = open(file.c_str(), O_RDONLY);
+                assert(fd >= 0);
+                long heap = mallinfo2().uordblks;
+                conn->SendFile(fd, 0, lseek(fd, 0, SEEK_END));
+                g_file_heap = (long)mallinfo2().uordblks - heap;
+                conn->Send(">", 1);
+                conn->Shutdown();
+            }
+            else if (cmd == "pipe")
+            {
+                // 管道块：用户态编码时同样排在前后数据之间
+                std::shared_ptr<SplicePipe> pipe = std::make_shared<SplicePipe>();
+                size_t len = std::min<size_t>(pipe->Capacity(), content.size());
+                ssize_t n = write(pipe->WriteFd(), content.data(), len);
+                assert(n == (ssize_t)len);
+                pipe->Filled(len);
+                conn->Send("[", 1);
+                conn->SendPipe(pipe, len);
+                conn->Send("]", 1);
+                conn->Shutdown();
+            }
+            else
+                conn->Send(cmd.data(), cmd.size());
+        });
+        server.Start();
+    };
+    std::thread(serve, RAW_PORT, true).detach();
+    std::thread(serve, PLAIN_PORT, false).detach();
+
+    SSL_CTX *ctx = ClientContext(TLS1_3_VERSION, true);
+    {
+        Client c(ctx, RAW_PORT);
+        c.Write("echo");
+        std::string echo = c.ReadUntil("echo");
+        assert(echo == "echo");
+        c.Write("file");
+        std::string data = c.ReadAll();
+        assert(data == "<" + content + ">");
+    }
+    SSL_CTX_free(ctx);
+
+    // TLS1.2 总是用户态加密：文件随输出消耗分块读入编码，不整个读进内存；关闭通知排在文件之后
+    ctx = ClientContext(TLS1_2_VERSION, false);
+    {
+        Client c(ctx, RAW_PORT);
+        c.Write("file");
+        bool clean = false;
+        std::string data = c.ReadAll(&clean);
+        assert(clean && data == "<" + content + ">");
+        assert(g_file_heap < 1024 * 1024);
+    }
+    {
+        Client c(ctx, RAW_PORT);
+        c.Write("pipe");
+        bool clean = false;
+        std::string data = c.ReadAll(&clean);
+        assert(clean && data.size() > 2 && data == "[" + content.substr(0, data.size() - 2) + "]");
+    }
+    SSL_CTX_free(ctx);
+
+    int fd = Connect(PLAIN_PORT);
+    SendAll(fd, "file");
+    std::string data = RecvAll(fd);
+    assert(data == "<" + content + ">");
+    unlink(path);
+    std::cout << "tls sendfile ok, ktls connections " << tls->KtlsConnections() << std::endl;
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+    TestExpandLabel();
+    bool written = TlsContext::WriteSelfSigned(CERT_FILE, KEY_FILE);
+    assert(written);
+    TlsOptions opts;
+    opts.cert_file = CERT_FILE;
+    opts.key_file = KEY_FILE;
+    TlsContext tls(opts);
+    assert(tls.Ok());
+    TestHttps(&tls);
+    TestSendFile(&tls);
+    std::cout << "handshakes " << tls.Handshakes() << " resumed " << tls.Resumed() << std::endl;
+    unlink(CERT_FILE);
+    unlink(KEY_FILE);
+    std::cout << "==== TLS Test All Passed ====" << std::endl;
+    return 0;
+}
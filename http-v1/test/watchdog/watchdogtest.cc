@@ -0,0 +1,115 @@
+#include <iostream>
+#include <string>
+#include <future>
+#include <cassert>
+#include "../../source/server.hpp"
+
+// Watchdog 测试：慢任务/慢读回调超预算记录，单轮卡顿时由看门狗采样卡住线程的调用栈
+
+EventLoop *g_loop = nullptr;
+
+// 非 static，配合 -rdynamic 在符号化的调用栈中可见
+void SlowTask(int ms)
+{
+    usleep(ms * 1000);
+}
+
+void RunLoop(std::promise<EventLoop *> *ready)
+{
+    EventLoop loop;
+    ready->set_value(&loop);
+    while (true)
+        loop.Start();
+}
+
+void WaitRecords(uint64_t n)
+{
+    for (int i = 0; i < 400 && StallLog::Instance().Total() < n; i++)
+        usleep(5 * 1000);
+    assert(StallLog::Instance().Total() >= n);
+}
+
+void TestSlowTask()
+{
+    LoopWatchdog::SetCallbackBudget(5 * 1000);
+    g_loop->QueueInLoop(std::bind(SlowTask, 1)); // 预算之内，不记录
+    g_loop->QueueInLoop(std::bind(SlowTask, 20));
+    WaitRecords(1);
+    usleep(20 * 1000);
+    std::vector<StallRecord> recs = StallLog::Instance().Snapshot();
+    assert(recs.size() == 1);
+    assert(recs[0].stall == false);
+    assert(recs[0].kind == CB_TASK);
+    assert(recs[0].fd == -1);
+    assert(recs[0].elapsed_us >= 20 * 1000);
+    assert(g_loop->Metrics().slow_callbacks.Get() == 1);
+    std::cout << "slow task ok" << std::endl;
+}
+
+void TestSlowRead()
+{
+    StallLog::Instance().Clear();
+    int fds[2];
+    int ret = pipe2(fds, O_NONBLOCK);
+    assert(ret == 0);
+    Channel *ch = new Channel(g_loop, fds[0]);
+    ch->SetReadCallBack([fds]() {
+        char c;
+        while (read(fds[0], &c, 1) == 1)
+            ;
+        SlowTask(15);
+    });
+    g_loop->RunInLoop([ch]() { ch->EnableRead(); });
+    ssize_t n = write(fds[1], "x", 1);
+    assert(n == 1);
+    WaitRecords(1);
+    StallRecord rec = StallLog::Instance().Snapshot()[0];
+    assert(rec.kind == CB_READ);
+    assert(rec.fd == fds[0]);
+    std::cout << "slow read callback ok" << std::endl;
+}
+
+void TestStall()
+{
+    StallLog::Instance().Clear();
+    LoopWatchdog::SetCallbackBudget(0);
+    LoopWatchdog::Instance().Start(30);
+    g_loop->QueueInLoop(std::bind(SlowTask, 200));
+    WaitRecords(1);
+    usleep(250 * 1000);
+    // 同一轮卡顿只上报一次
+    assert(StallLog::Instance().Total() == 1);
+    StallRecord rec = StallLog::Instance().Snapshot()[0];
+    assert(rec.stall == true);
+    assert(rec.kind == CB_TASK);
+    assert(rec.elapsed_us >= 30 * 1000);
+    assert(rec.depth > 0);
+    assert(g_loop->Metrics().stalls.Get() == 1);
+    std::string dump = StallLog::Instance().Dump();
+    std::cout << dump;
+    assert(dump.find("[stall]") != std::string::npos);
+    assert(dump.find("cb=task") != std::string::npos);
+    assert(dump.find("SlowTask") != std::string::npos);
+
+    // 空闲(阻塞在 epoll_wait)不算卡顿
+    usleep(100 * 1000);
+    assert(StallLog::Instance().Total() == 1);
+    LoopWatchdog::Instance().Stop();
+
+    std::string text = MetricsRegistry::Instance().ExportPrometheus();
+    assert(text.find("reactor_stalls_total{loop=\"" + std::to_string(g_loop->Metrics().id) + "\"} 1") != std::string::npos);
+    std::cout << "stall capture ok" << std::endl;
+}
+
+int main()
+{
+    std::promise<EventLoop *> ready;
+    std::thread(RunLoop, &ready).detach();
+    g_loop = ready.get_future().get();
+
+    TestSlowTask();
+    TestSlowRead();
+    TestStall();
+    std::cout << "==== Watchdog Test All Passed ====" << std::endl;
+    return 0;
+}